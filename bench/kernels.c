@@ -0,0 +1,401 @@
+#include "kernels.h"
+#include <stdint.h>
+
+//===========================================================================================
+//                                ASSEMBLER
+//===========================================================================================
+
+// Program under construction, branch targets are instruction indices
+typedef struct {
+  uint32_t* code;
+  size_t length;
+  size_t capacity;
+} assembler_t;
+
+#define PENDING SIZE_MAX               // Forward target, fixed up by patch()
+
+// Register names (RISC-V ABI)
+enum {
+  ZERO = 0, RA = 1, T0 = 5, T1 = 6, T2 = 7, S0 = 8, S1 = 9,
+  A0 = 10, A1 = 11, A2 = 12, A3 = 13, A4 = 14, A5 = 15,
+  S2 = 18, S3 = 19, S4 = 20, T3 = 28, T4 = 29, T5 = 30, T6 = 31
+};
+
+static size_t emit(assembler_t* as, uint32_t word){
+  if (as->length < as->capacity) as->code[as->length] = word;
+  return as->length++;
+}
+
+
+static uint32_t encode_b_immediate(int32_t offset){
+  uint32_t imm = (uint32_t) offset;
+  return ((imm >> 12) & 1) << 31 | ((imm >> 5) & 0x3F) << 25 | ((imm >> 1) & 0xF) << 8 | ((imm >> 11) & 1) << 7;
+}
+
+
+static uint32_t encode_j_immediate(int32_t offset){
+  uint32_t imm = (uint32_t) offset;
+  return ((imm >> 20) & 1) << 31 | ((imm >> 1) & 0x3FF) << 21 | ((imm >> 11) & 1) << 20 | ((imm >> 12) & 0xFF) << 12;
+}
+
+
+static size_t emit_r(assembler_t* as, uint32_t funct7, uint32_t funct3, uint8_t rd, uint8_t rs1, uint8_t rs2){
+  return emit(as, funct7 << 25 | (uint32_t) rs2 << 20 | (uint32_t) rs1 << 15 | funct3 << 12 | (uint32_t) rd << 7 | OPCODE_OP);
+}
+
+
+static size_t emit_i(assembler_t* as, uint32_t opcode, uint32_t funct3, uint8_t rd, uint8_t rs1, int32_t imm){
+  return emit(as, ((uint32_t) imm & 0xFFF) << 20 | (uint32_t) rs1 << 15 | funct3 << 12 | (uint32_t) rd << 7 | opcode);
+}
+
+
+static size_t emit_s(assembler_t* as, uint32_t funct3, uint8_t rs2, uint8_t rs1, int32_t imm){
+  uint32_t u = (uint32_t) imm;
+  return emit(as, ((u >> 5) & 0x7F) << 25 | (uint32_t) rs2 << 20 | (uint32_t) rs1 << 15 | funct3 << 12 |
+                  (u & 0x1F) << 7 | OPCODE_STORE);
+}
+
+
+static size_t emit_b(assembler_t* as, uint32_t funct3, uint8_t rs1, uint8_t rs2, size_t target){
+  int32_t offset = target == PENDING ? 0 : ((int32_t) target - (int32_t) as->length) * 4;
+  return emit(as, encode_b_immediate(offset) | (uint32_t) rs2 << 20 | (uint32_t) rs1 << 15 | funct3 << 12 | OPCODE_BRANCH);
+}
+
+
+static size_t emit_jal(assembler_t* as, uint8_t rd, size_t target){
+  int32_t offset = target == PENDING ? 0 : ((int32_t) target - (int32_t) as->length) * 4;
+  return emit(as, encode_j_immediate(offset) | (uint32_t) rd << 7 | OPCODE_JAL);
+}
+
+
+// Point the branch or JAL at index at to the next instruction
+static void patch(assembler_t* as, size_t at){
+  if (at >= as->capacity) return;
+  int32_t offset = (int32_t) (as->length - at) * 4;
+  uint32_t word = as->code[at];
+  if ((word & 0x7F) == OPCODE_JAL) as->code[at] = (word & 0xFFF) | encode_j_immediate(offset);
+  else as->code[at] = (word & 0x01FFF07F) | encode_b_immediate(offset);
+}
+
+
+// Any 32-bit constant, LUI rounded so the ADDI sign extension lands on it
+static void emit_li(assembler_t* as, uint8_t rd, uint32_t value){
+  uint32_t upper = (value + 0x800) & 0xFFFFF000;
+  emit(as, upper | (uint32_t) rd << 7 | OPCODE_LUI);
+  emit_i(as, OPCODE_OP_IMM, FUNCT3_ADD_SUB, rd, rd, (int32_t) (value - upper));
+}
+
+
+static size_t finish(assembler_t* as){
+  emit(as, 0x00000073);               // ECALL, exit with a0
+  return as->length <= as->capacity ? as->length : 0;
+}
+
+// Mnemonics over the assembler "as" of the enclosing kernel
+#define HERE()                 (as->length)
+#define ADD(rd, a, b)          emit_r(as, FUNCT7_NORMAL, FUNCT3_ADD_SUB, rd, a, b)
+#define SUB(rd, a, b)          emit_r(as, FUNCT7_ALT, FUNCT3_ADD_SUB, rd, a, b)
+#define XOR(rd, a, b)          emit_r(as, FUNCT7_NORMAL, FUNCT3_XOR, rd, a, b)
+#define OR(rd, a, b)           emit_r(as, FUNCT7_NORMAL, FUNCT3_OR, rd, a, b)
+#define AND(rd, a, b)          emit_r(as, FUNCT7_NORMAL, FUNCT3_AND, rd, a, b)
+#define ADDI(rd, rs, imm)      emit_i(as, OPCODE_OP_IMM, FUNCT3_ADD_SUB, rd, rs, imm)
+#define XORI(rd, rs, imm)      emit_i(as, OPCODE_OP_IMM, FUNCT3_XOR, rd, rs, imm)
+#define ANDI(rd, rs, imm)      emit_i(as, OPCODE_OP_IMM, FUNCT3_AND, rd, rs, imm)
+#define SLLI(rd, rs, shamt)    emit_i(as, OPCODE_OP_IMM, FUNCT3_SLL, rd, rs, shamt)
+#define SRLI(rd, rs, shamt)    emit_i(as, OPCODE_OP_IMM, FUNCT3_SRL_SRA, rd, rs, shamt)
+#define LW(rd, rs, imm)        emit_i(as, OPCODE_LOAD, FUNCT3_WORD, rd, rs, imm)
+#define LBU(rd, rs, imm)       emit_i(as, OPCODE_LOAD, FUNCT3_BYTE_U, rd, rs, imm)
+#define SW(src, base, imm)     emit_s(as, FUNCT3_WORD, src, base, imm)
+#define SB(src, base, imm)     emit_s(as, FUNCT3_BYTE, src, base, imm)
+#define BEQ(a, b, target)      emit_b(as, FUNCT3_BEQ, a, b, target)
+#define BNE(a, b, target)      emit_b(as, FUNCT3_BNE, a, b, target)
+#define BLT(a, b, target)      emit_b(as, FUNCT3_BLT, a, b, target)
+#define BLTU(a, b, target)     emit_b(as, FUNCT3_BLTU, a, b, target)
+#define BGEU(a, b, target)     emit_b(as, FUNCT3_BGEU, a, b, target)
+#define JAL(rd, target)        emit_jal(as, rd, target)
+#define JALR(rd, rs, imm)      emit_i(as, OPCODE_JALR, 0, rd, rs, imm)
+#define LI(rd, value)          emit_li(as, rd, value)
+
+// x ^= x << 13; x ^= x >> 17; x ^= x << 5
+#define XORSHIFT(x, scratch)                                  \
+  do {                                                        \
+    SLLI(scratch, x, 13); XOR(x, x, scratch);                 \
+    SRLI(scratch, x, 17); XOR(x, x, scratch);                 \
+    SLLI(scratch, x, 5);  XOR(x, x, scratch);                 \
+  } while (0)
+
+//===========================================================================================
+//                                KERNELS
+//===========================================================================================
+
+// Dhrystone-style: a call per iteration, record stores and reloads, a byte string compare
+static size_t build_dhrystone(uint32_t* code, size_t capacity, uint32_t scale){
+  assembler_t assembler = {code, 0, capacity};
+  assembler_t* as = &assembler;
+
+  LI(S0, 20000 * scale);
+  LI(S1, DATA_MEMORY_BASE);
+  ADDI(A0, ZERO, 0);
+  size_t loop = HERE();
+  ADDI(A1, S0, 0);
+  size_t call = JAL(RA, PENDING);
+  ADD(A0, A0, A1);
+  ADDI(S0, S0, -1);
+  BNE(S0, ZERO, loop);
+  finish(as);
+
+  // Procedure: a1 in, a1 out
+  patch(as, call);
+  SW(A1, S1, 0);
+  ADDI(T0, A1, 7);
+  SW(T0, S1, 4);
+  XOR(T1, T0, A1);
+  SLLI(T2, T1, 3);
+  SW(T2, S1, 8);
+  LW(T3, S1, 0);
+  LW(T4, S1, 4);
+  LW(T5, S1, 8);
+  ADD(T3, T3, T4);
+  SUB(T3, T3, T5);
+  SRLI(T6, T3, 2);
+  OR(A1, T6, T3);
+  size_t negative = BLT(A1, ZERO, PENDING);
+  ANDI(A1, A1, 0xFF);
+  patch(as, negative);
+
+  // Two 8-byte strings that differ at byte 3 for odd a1
+  ADDI(T0, S1, 16);
+  ADDI(T1, S1, 32);
+  ADDI(T2, ZERO, 8);
+  SB(A1, T0, 3);
+  ANDI(T5, A1, 0xFE);
+  SB(T5, T1, 3);
+  size_t compare = HERE();
+  LBU(T3, T0, 0);
+  LBU(T4, T1, 0);
+  size_t differ = BNE(T3, T4, PENDING);
+  ADDI(T0, T0, 1);
+  ADDI(T1, T1, 1);
+  ADDI(T2, T2, -1);
+  BNE(T2, ZERO, compare);
+  patch(as, differ);
+  ADD(A1, A1, T2);
+  JALR(ZERO, RA, 0);
+
+  return as->length <= capacity ? as->length : 0;
+}
+
+
+// Word memset of 4KB followed by a word copy of it, repeated
+static size_t build_memcpy(uint32_t* code, size_t capacity, uint32_t scale){
+  assembler_t assembler = {code, 0, capacity};
+  assembler_t* as = &assembler;
+
+  LI(S0, 100 * scale);
+  LI(S1, DATA_MEMORY_BASE);
+  LI(S2, DATA_MEMORY_BASE + 4096);
+  ADDI(A0, ZERO, 0);
+  size_t outer = HERE();
+  ADDI(T0, S1, 0);
+  ADDI(T1, ZERO, 1024);
+  size_t set = HERE();
+  SW(S0, T0, 0);
+  ADDI(T0, T0, 4);
+  ADDI(T1, T1, -1);
+  BNE(T1, ZERO, set);
+  ADDI(T0, S1, 0);
+  ADDI(T3, S2, 0);
+  ADDI(T1, ZERO, 1024);
+  size_t copy = HERE();
+  LW(T4, T0, 0);
+  SW(T4, T3, 0);
+  ADDI(T0, T0, 4);
+  ADDI(T3, T3, 4);
+  ADDI(T1, T1, -1);
+  BNE(T1, ZERO, copy);
+  ADD(A0, A0, T4);
+  ADDI(S0, S0, -1);
+  BNE(S0, ZERO, outer);
+  return finish(as);
+}
+
+
+// Insertion sort of 256 pseudo-random words, refilled every pass
+static size_t build_sort(uint32_t* code, size_t capacity, uint32_t scale){
+  assembler_t assembler = {code, 0, capacity};
+  assembler_t* as = &assembler;
+
+  LI(S0, 8 * scale);
+  LI(S1, DATA_MEMORY_BASE);
+  LI(S3, 0x12345678);
+  ADDI(A0, ZERO, 0);
+  size_t outer = HERE();
+  ADDI(T0, S1, 0);
+  ADDI(T1, ZERO, 256);
+  size_t fill = HERE();
+  XORSHIFT(S3, T2);
+  SW(S3, T0, 0);
+  ADDI(T0, T0, 4);
+  ADDI(T1, T1, -1);
+  BNE(T1, ZERO, fill);
+
+  ADDI(T0, S1, 4);
+  ADDI(S4, S1, 1024);
+  size_t next_key = HERE();
+  LW(T3, T0, 0);
+  ADDI(T1, T0, -4);
+  size_t shift = HERE();
+  size_t at_start = BLTU(T1, S1, PENDING);
+  LW(T4, T1, 0);
+  size_t in_place = BGEU(T3, T4, PENDING);
+  SW(T4, T1, 4);
+  ADDI(T1, T1, -4);
+  JAL(ZERO, shift);
+  patch(as, at_start);
+  patch(as, in_place);
+  SW(T3, T1, 4);
+  ADDI(T0, T0, 4);
+  BNE(T0, S4, next_key);
+
+  LW(T5, S1, 0);
+  LW(T6, S1, 1020);
+  XOR(T5, T5, T6);
+  ADD(A0, A0, T5);
+  ADDI(S0, S0, -1);
+  BNE(S0, ZERO, outer);
+  return finish(as);
+}
+
+
+// Bitwise CRC-32 over a 1KB buffer, one byte of it changed every pass
+static size_t build_crc32(uint32_t* code, size_t capacity, uint32_t scale){
+  assembler_t assembler = {code, 0, capacity};
+  assembler_t* as = &assembler;
+
+  LI(S0, 20 * scale);
+  LI(S1, DATA_MEMORY_BASE);
+  LI(S2, 0xEDB88320);
+  ADDI(A0, ZERO, 0);
+  ADDI(T0, S1, 0);
+  ADDI(T1, ZERO, 1024);
+  ADDI(T2, ZERO, 0x5A);
+  size_t fill = HERE();
+  SB(T2, T0, 0);
+  ADDI(T2, T2, 7);
+  ADDI(T0, T0, 1);
+  ADDI(T1, T1, -1);
+  BNE(T1, ZERO, fill);
+
+  size_t outer = HERE();
+  ADDI(T0, S1, 0);
+  ADDI(T1, ZERO, 1024);
+  ADDI(A1, ZERO, -1);
+  size_t byte = HERE();
+  LBU(T2, T0, 0);
+  XOR(A1, A1, T2);
+  ADDI(T3, ZERO, 8);
+  size_t bit = HERE();
+  ANDI(T4, A1, 1);
+  SUB(T4, ZERO, T4);
+  AND(T4, T4, S2);
+  SRLI(A1, A1, 1);
+  XOR(A1, A1, T4);
+  ADDI(T3, T3, -1);
+  BNE(T3, ZERO, bit);
+  ADDI(T0, T0, 1);
+  ADDI(T1, T1, -1);
+  BNE(T1, ZERO, byte);
+  XORI(A1, A1, -1);
+  ADD(A0, A0, A1);
+  SB(A1, S1, 0);
+  ADDI(S0, S0, -1);
+  BNE(S0, ZERO, outer);
+  return finish(as);
+}
+
+
+// Four-state machine driven by pseudo-random 3-bit symbols, compare chains everywhere
+static size_t build_state_machine(uint32_t* code, size_t capacity, uint32_t scale){
+  assembler_t assembler = {code, 0, capacity};
+  assembler_t* as = &assembler;
+
+  LI(S0, 100000 * scale);
+  LI(S3, 0x2545F491);
+  ADDI(S2, ZERO, 0);                   // State
+  ADDI(A0, ZERO, 0);
+  ADDI(S4, ZERO, 1);
+  ADDI(A2, ZERO, 2);
+  ADDI(A3, ZERO, 3);
+  ADDI(A4, ZERO, 4);
+  ADDI(A5, ZERO, 5);
+  size_t loop = HERE();
+  XORSHIFT(S3, T2);
+  ANDI(T1, S3, 7);
+  size_t state0 = BEQ(S2, ZERO, PENDING);
+  size_t state1 = BEQ(S2, S4, PENDING);
+  size_t state2 = BEQ(S2, A2, PENDING);
+
+  // State 3: symbols below 4 go to 0, the rest to 2
+  ADDI(A0, A0, 3);
+  size_t low = BLTU(T1, A4, PENDING);
+  ADDI(S2, ZERO, 2);
+  size_t done3 = JAL(ZERO, PENDING);
+  patch(as, low);
+  ADDI(S2, ZERO, 0);
+  size_t done3_low = JAL(ZERO, PENDING);
+
+  // State 0: 0 goes to 1, 1-2 to 2, the rest stay
+  patch(as, state0);
+  size_t zero = BEQ(T1, ZERO, PENDING);
+  size_t small = BLTU(T1, A3, PENDING);
+  size_t done0 = JAL(ZERO, PENDING);
+  patch(as, zero);
+  ADDI(S2, ZERO, 1);
+  size_t done0_zero = JAL(ZERO, PENDING);
+  patch(as, small);
+  ADDI(S2, ZERO, 2);
+  size_t done0_small = JAL(ZERO, PENDING);
+
+  // State 1: odd symbols go to 3, even ones to 0
+  patch(as, state1);
+  ANDI(T2, T1, 1);
+  size_t odd = BNE(T2, ZERO, PENDING);
+  ADDI(S2, ZERO, 0);
+  size_t done1 = JAL(ZERO, PENDING);
+  patch(as, odd);
+  ADDI(S2, ZERO, 3);
+  size_t done1_odd = JAL(ZERO, PENDING);
+
+  // State 2: symbols from 5 go to 1, the rest stay
+  patch(as, state2);
+  ADD(A0, A0, T1);
+  size_t stay = BLTU(T1, A5, PENDING);
+  ADDI(S2, ZERO, 1);
+  patch(as, stay);
+
+  patch(as, done3);
+  patch(as, done3_low);
+  patch(as, done0);
+  patch(as, done0_zero);
+  patch(as, done0_small);
+  patch(as, done1);
+  patch(as, done1_odd);
+  ADD(A0, A0, S2);
+  ADDI(S0, S0, -1);
+  BNE(S0, ZERO, loop);
+  return finish(as);
+}
+
+//===========================================================================================
+//                                KERNEL TABLE
+//===========================================================================================
+
+const bench_kernel_t bench_kernels[] = {
+  {"dhrystone",     "calls, record loads/stores, string compare", build_dhrystone},
+  {"memcpy",        "4KB word memset and copy",                   build_memcpy},
+  {"sort",          "insertion sort of 256 words",                build_sort},
+  {"crc32",         "bitwise CRC-32 over 1KB",                    build_crc32},
+  {"state_machine", "branch-heavy four-state machine",            build_state_machine}
+};
+
+const size_t bench_num_kernels = sizeof(bench_kernels) / sizeof(bench_kernels[0]);
@@ -0,0 +1,25 @@
+#ifndef BENCH_KERNELS_H
+#define BENCH_KERNELS_H
+
+#include "utils/defs.h"
+
+/*
+ * RV32I guest workloads for risc_bench, assembled at startup into flat programs
+ * for simulator_load_binary(). Each one works on data memory only, ends with
+ * ECALL and leaves a checksum in a0, so every engine must report the same exit
+ * code. scale multiplies the iteration counts; scale 1 is about 1-2M instructions.
+ */
+
+#define KERNEL_MAX_INSTRUCTIONS 256
+
+typedef struct {
+  const char* name;
+  const char* description;
+  // Fills code, returns the number of instructions (0 = did not fit)
+  size_t (*build)(uint32_t* code, size_t capacity, uint32_t scale);
+} bench_kernel_t;
+
+extern const bench_kernel_t bench_kernels[];
+extern const size_t bench_num_kernels;
+
+#endif // BENCH_KERNELS_H
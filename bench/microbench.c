@@ -0,0 +1,424 @@
+#include "kernels.h"
+#include "cpu/alu.h"
+#include "decode/instruction.h"
+#include "memory/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HOST_COUNTERS_SUPPORTED 1
+#else
+#define HOST_COUNTERS_SUPPORTED 0
+#endif
+
+/*
+ * risc_microbench [key=value ...]
+ *
+ * Times single components in a tight loop over prepared inputs:
+ *
+ *   decode       decode_instruction() on the instruction words of the risc_bench kernels
+ *   control      generate_control_signals() on the same instructions, decoded
+ *   alu          alu_compute() with the ALU operations of those instructions and
+ *                operands mixing small values, addresses and random words
+ *   branch       evaluate_branch_condition() with the kernels' branch conditions,
+ *                about half of the operand pairs equal
+ *   load, store  memory_load()/memory_store() on a 64KB bank, mostly sequential
+ *                word accesses with random byte/halfword/word accesses mixed in
+ *   reset        memory_reset() of the same bank after one of those stores, so
+ *                one dirty page to clear each call
+ *
+ * Reports ns per call (best and mean of the runs) and, on Linux hosts that allow
+ * perf_event_open, the host instructions per cycle of the best run (null otherwise).
+ *
+ *   iterations=N    calls per run (default 10000000)
+ *   runs=N          runs per component (default 5)
+ *   bench=name      only this component
+ *   format=json     one JSON object per line (default), or format=csv
+ */
+
+#define INPUT_COUNT 4096                  // Prepared inputs per component, power of two
+#define INPUT_MASK (INPUT_COUNT - 1)
+
+typedef enum {
+  FORMAT_JSON,
+  FORMAT_CSV
+} output_format_t;
+
+// Command line options
+typedef struct {
+  uint64_t iterations;
+  uint32_t runs;
+  const char* bench;              // NULL = all
+  output_format_t format;
+} microbench_options_t;
+
+// Inputs of every component, drawn once before timing
+typedef struct {
+  uint32_t words[INPUT_COUNT];
+  uint32_t pcs[INPUT_COUNT];
+  instruction_t instructions[INPUT_COUNT];
+  alu_operation_t alu_ops[INPUT_COUNT];
+  uint32_t operands_a[INPUT_COUNT];
+  uint32_t operands_b[INPUT_COUNT];
+  uint8_t branch_conditions[INPUT_COUNT];
+  uint32_t addresses[INPUT_COUNT];
+  memory_size_t sizes[INPUT_COUNT];
+  memory_bank_t bank;
+} microbench_inputs_t;
+
+// Host counters of one run
+typedef struct {
+  uint64_t cycles;
+  uint64_t instructions;
+  bool valid;
+} host_counters_t;
+
+//===========================================================================================
+//                                HOST COUNTERS
+//===========================================================================================
+
+static uint64_t now_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+#if HOST_COUNTERS_SUPPORTED
+static int open_counter(uint64_t config, int group){
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.disabled = group < 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+
+// Cycle and instruction counters as one group, -1 where the host does not allow them
+static int host_counters_open(void){
+#if HOST_COUNTERS_SUPPORTED
+  int leader = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+  if (leader < 0) return -1;
+  if (open_counter(PERF_COUNT_HW_INSTRUCTIONS, leader) < 0){
+    close(leader);
+    return -1;
+  }
+  return leader;
+#else
+  return -1;
+#endif
+}
+
+
+static void host_counters_start(int group){
+#if HOST_COUNTERS_SUPPORTED
+  if (group < 0) return;
+  ioctl(group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+  (void) group;
+#endif
+}
+
+
+static host_counters_t host_counters_stop(int group){
+  host_counters_t counters = {0};
+#if HOST_COUNTERS_SUPPORTED
+  uint64_t values[3];             // Count, cycles, instructions
+  if (group < 0) return counters;
+  ioctl(group, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  if (read(group, values, sizeof(values)) == (ssize_t) sizeof(values) && values[0] == 2){
+    counters.cycles = values[1];
+    counters.instructions = values[2];
+    counters.valid = values[1] > 0;
+  }
+#else
+  (void) group;
+#endif
+  return counters;
+}
+
+//===========================================================================================
+//                                INPUTS
+//===========================================================================================
+
+static uint32_t next_random(uint32_t* state){
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+
+// Operand mix: small counters, data addresses and arbitrary words
+static uint32_t random_operand(uint32_t* state){
+  uint32_t r = next_random(state);
+  switch (r & 3){
+    case 0:  return (r >> 8) & 0xFF;
+    case 1:  return DATA_MEMORY_BASE + ((r >> 4) & (DATA_MEMORY_SIZE - 4));
+    case 2:  return (uint32_t) -(int32_t) ((r >> 8) & 0xF);
+    default: return next_random(state);
+  }
+}
+
+
+static bool prepare_inputs(microbench_inputs_t* inputs){
+  memset(inputs, 0, sizeof(microbench_inputs_t));
+  if (!memory_init(&inputs->bank, DATA_MEMORY_SIZE, DATA_MEMORY_BASE)) return false;
+
+  // Static instruction mix of the whole-program kernels
+  uint32_t program[KERNEL_MAX_INSTRUCTIONS * 8];
+  size_t length = 0;
+  for (size_t k = 0; k < bench_num_kernels && length + KERNEL_MAX_INSTRUCTIONS <= sizeof(program) / sizeof(program[0]); ++k){
+    length += bench_kernels[k].build(program + length, KERNEL_MAX_INSTRUCTIONS, 1);
+  }
+
+  uint8_t branch_conditions[INPUT_COUNT];
+  size_t num_branches = 0;
+  for (size_t i = 0; i < INPUT_COUNT; ++i){
+    inputs->words[i] = program[i % length];
+    inputs->pcs[i] = INSTRUCTION_MEMORY_BASE + (uint32_t) (i % length) * 4;
+    inputs->instructions[i] = decode_instruction(inputs->words[i], inputs->pcs[i]);
+    inputs->alu_ops[i] = generate_control_signals(&inputs->instructions[i]).alu_op;
+    if ((inputs->words[i] & 0x7F) == OPCODE_BRANCH) branch_conditions[num_branches++] = inputs->instructions[i].funct3;
+  }
+
+  uint32_t state = 0x9E3779B9u;
+  uint32_t sequential = DATA_MEMORY_BASE;
+  static const memory_size_t sizes[] = {MEM_SIZE_BYTE, MEM_SIZE_HALFWORD};
+  for (size_t i = 0; i < INPUT_COUNT; ++i){
+    inputs->operands_a[i] = random_operand(&state);
+    inputs->operands_b[i] = random_operand(&state);
+    inputs->branch_conditions[i] = num_branches ? branch_conditions[i % num_branches] : FUNCT3_BNE;
+    uint32_t r = next_random(&state);
+    if (r & 1) inputs->operands_b[i] = inputs->operands_a[i];   // Loop exits and equal compares
+
+    // Three of four accesses stream through words, the rest land anywhere
+    if ((r >> 1) & 3){
+      inputs->addresses[i] = sequential;
+      inputs->sizes[i] = MEM_SIZE_WORD;
+      sequential = DATA_MEMORY_BASE + ((sequential - DATA_MEMORY_BASE + 4) & (DATA_MEMORY_SIZE - 1));
+    }
+    else {
+      inputs->sizes[i] = (r >> 3) & 1 ? sizes[(r >> 4) & 1] : MEM_SIZE_WORD;
+      uint32_t align = inputs->sizes[i] == MEM_SIZE_WORD ? ~3u : inputs->sizes[i] == MEM_SIZE_HALFWORD ? ~1u : ~0u;
+      inputs->addresses[i] = DATA_MEMORY_BASE + ((next_random(&state) & (DATA_MEMORY_SIZE - 1)) & align);
+    }
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                COMPONENTS
+//===========================================================================================
+
+// Each returns a value depending on every call so the calls cannot be dropped
+static uint64_t bench_decode(microbench_inputs_t* inputs, uint64_t iterations){
+  uint64_t sink = 0;
+  for (uint64_t i = 0; i < iterations; ++i){
+    size_t k = i & INPUT_MASK;
+    instruction_t inst = decode_instruction(inputs->words[k], inputs->pcs[k]);
+    sink += (uint32_t) inst.type + (uint32_t) inst.imm_i;
+  }
+  return sink;
+}
+
+
+static uint64_t bench_control(microbench_inputs_t* inputs, uint64_t iterations){
+  uint64_t sink = 0;
+  for (uint64_t i = 0; i < iterations; ++i){
+    control_signals_t ctrl = generate_control_signals(&inputs->instructions[i & INPUT_MASK]);
+    sink += (uint32_t) ctrl.alu_op + ctrl.reg_write_enable;
+  }
+  return sink;
+}
+
+
+static uint64_t bench_alu(microbench_inputs_t* inputs, uint64_t iterations){
+  uint64_t sink = 0;
+  for (uint64_t i = 0; i < iterations; ++i){
+    size_t k = i & INPUT_MASK;
+    sink += alu_compute(inputs->alu_ops[k], inputs->operands_a[k], inputs->operands_b[k]);
+  }
+  return sink;
+}
+
+
+static uint64_t bench_branch(microbench_inputs_t* inputs, uint64_t iterations){
+  uint64_t sink = 0;
+  for (uint64_t i = 0; i < iterations; ++i){
+    size_t k = i & INPUT_MASK;
+    sink += evaluate_branch_condition(inputs->branch_conditions[k], inputs->operands_a[k], inputs->operands_b[k]);
+  }
+  return sink;
+}
+
+
+static uint64_t bench_load(microbench_inputs_t* inputs, uint64_t iterations){
+  uint64_t sink = 0;
+  for (uint64_t i = 0; i < iterations; ++i){
+    size_t k = i & INPUT_MASK;
+    sink += memory_load(&inputs->bank, inputs->addresses[k], inputs->sizes[k], false);
+  }
+  return sink;
+}
+
+
+static uint64_t bench_store(microbench_inputs_t* inputs, uint64_t iterations){
+  for (uint64_t i = 0; i < iterations; ++i){
+    size_t k = i & INPUT_MASK;
+    memory_store(&inputs->bank, inputs->addresses[k], (uint32_t) i, inputs->sizes[k]);
+  }
+  return inputs->bank.data[0];
+}
+
+
+static uint64_t bench_reset(microbench_inputs_t* inputs, uint64_t iterations){
+  uint64_t sink = 0;
+  for (uint64_t i = 0; i < iterations; ++i){
+    size_t k = i & INPUT_MASK;
+    memory_store(&inputs->bank, inputs->addresses[k], (uint32_t) i | 1, inputs->sizes[k]);
+    memory_reset(&inputs->bank);
+    sink += inputs->bank.data[inputs->addresses[k] - DATA_MEMORY_BASE];
+  }
+  return sink;
+}
+
+
+typedef struct {
+  const char* name;
+  uint64_t (*run)(microbench_inputs_t* inputs, uint64_t iterations);
+} component_t;
+
+static const component_t components[] = {
+  {"decode",  bench_decode},
+  {"control", bench_control},
+  {"alu",     bench_alu},
+  {"branch",  bench_branch},
+  {"load",    bench_load},
+  {"store",   bench_store},
+  {"reset",   bench_reset}
+};
+
+#define NUM_COMPONENTS (sizeof(components) / sizeof(components[0]))
+
+//===========================================================================================
+//                                OPTIONS
+//===========================================================================================
+
+static bool parse_option(microbench_options_t* options, const char* option){
+  char key[32];
+  char* end;
+  const char* value = strchr(option, '=');
+  if (!value) return false;
+  size_t key_length = (size_t) (value - option);
+  if (key_length >= sizeof(key)) return false;
+  memcpy(key, option, key_length);
+  key[key_length] = '\0';
+  value++;
+
+  if (strcmp(key, "iterations") == 0){
+    options->iterations = strtoull(value, &end, 0);
+    return *value && *end == '\0' && options->iterations > 0;
+  }
+  if (strcmp(key, "runs") == 0){
+    unsigned long runs = strtoul(value, &end, 0);
+    options->runs = (uint32_t) runs;
+    return *value && *end == '\0' && runs > 0 && runs <= UINT32_MAX;
+  }
+  if (strcmp(key, "bench") == 0){
+    options->bench = value;
+    for (size_t c = 0; c < NUM_COMPONENTS; ++c){
+      if (strcmp(components[c].name, value) == 0) return true;
+    }
+    return false;
+  }
+  if (strcmp(key, "format") == 0){
+    if (strcmp(value, "json") == 0) options->format = FORMAT_JSON;
+    else if (strcmp(value, "csv") == 0) options->format = FORMAT_CSV;
+    else return false;
+    return true;
+  }
+  return false;
+}
+
+//===========================================================================================
+//                                MAIN
+//===========================================================================================
+
+int main(int argc, char** argv){
+  microbench_options_t options = {.iterations = 10000000, .runs = 5, .bench = NULL, .format = FORMAT_JSON};
+  for (int i = 1; i < argc; ++i){
+    if (!parse_option(&options, argv[i])){
+      fprintf(stderr, "Error: Invalid option '%s'.\n", argv[i]);
+      fprintf(stderr, "Usage: %s [iterations=N] [runs=N] [bench=name] [format=json|csv]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  microbench_inputs_t* inputs = (microbench_inputs_t *) malloc(sizeof(microbench_inputs_t));
+  if (!inputs || !prepare_inputs(inputs)){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in main.\n");
+    free(inputs);
+    return 1;
+  }
+
+  int group = host_counters_open();
+  if (options.format == FORMAT_CSV) printf("component,iterations,runs,ns_best,ns_mean,host_ipc\n");
+
+  volatile uint64_t sink = 0;
+  for (size_t c = 0; c < NUM_COMPONENTS; ++c){
+    const component_t* component = &components[c];
+    if (options.bench && strcmp(options.bench, component->name) != 0) continue;
+
+    double best = 0.0, total = 0.0;
+    host_counters_t best_counters = {0};
+    sink += component->run(inputs, INPUT_COUNT);   // Warm caches and branch predictors
+    for (uint32_t run = 0; run < options.runs; ++run){
+      host_counters_start(group);
+      uint64_t start = now_ns();
+      sink += component->run(inputs, options.iterations);
+      double ns = (double) (now_ns() - start) / (double) options.iterations;
+      host_counters_t counters = host_counters_stop(group);
+      total += ns;
+      if (run == 0 || ns < best){
+        best = ns;
+        best_counters = counters;
+      }
+    }
+
+    char ipc[32] = "null";
+    if (best_counters.valid){
+      snprintf(ipc, sizeof(ipc), "%.3f", (double) best_counters.instructions / (double) best_counters.cycles);
+    }
+    if (options.format == FORMAT_CSV){
+      printf("%s,%lu,%u,%.3f,%.3f,%s\n", component->name, options.iterations, options.runs, best,
+             total / options.runs, best_counters.valid ? ipc : "");
+    }
+    else {
+      printf("{\"component\": \"%s\", \"iterations\": %lu, \"runs\": %u, \"ns_best\": %.3f, \"ns_mean\": %.3f, "
+             "\"host_ipc\": %s}\n", component->name, options.iterations, options.runs, best, total / options.runs, ipc);
+    }
+    fflush(stdout);
+  }
+
+#if HOST_COUNTERS_SUPPORTED
+  if (group >= 0) close(group);
+#endif
+  memory_destroy(&inputs->bank);
+  free(inputs);
+  return 0;
+}
@@ -0,0 +1,297 @@
+#include "kernels.h"
+#include "utils/simulator.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * risc_bench [key=value ...]
+ *
+ * Runs every embedded kernel under every execution engine and prints one record
+ * per kernel and engine: simulated instructions and cycles, host MIPS (mean,
+ * standard deviation, min, max over the measured runs), host nanoseconds and
+ * host cycles per simulated instruction. Each measurement is a full reset,
+ * program load and simulator_run(); only simulator_run() is timed.
+ *
+ *   runs=N          measured runs per kernel and engine (default 5)
+ *   warmup=N        unmeasured runs before them (default 1)
+ *   scale=N         work multiplier of every kernel (default 1)
+ *   kernel=name     only this kernel
+ *   mode=name       only this engine (pipeline, functional, jit)
+ *   format=json     one JSON object per line (default), or format=csv
+ *
+ * Exits with 1 if a kernel does not exit cleanly or engines disagree on its
+ * checksum (exit code).
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HOST_CYCLES_SUPPORTED 1
+#else
+#define HOST_CYCLES_SUPPORTED 0
+#endif
+
+#define BENCH_MAX_RUNS 1000
+
+typedef enum {
+  FORMAT_JSON,
+  FORMAT_CSV
+} output_format_t;
+
+// Command line options
+typedef struct {
+  uint32_t runs;
+  uint32_t warmup;
+  uint32_t scale;
+  const char* kernel;             // NULL = all
+  int mode;                       // -1 = all
+  output_format_t format;
+} bench_options_t;
+
+// Measurements of one kernel on one engine
+typedef struct {
+  uint64_t instructions;          // Per run, identical across runs
+  uint64_t cycles;
+  uint32_t exit_code;
+  double mips[BENCH_MAX_RUNS];
+  double seconds;                 // Sum over the measured runs
+  uint64_t host_cycles;
+} bench_result_t;
+
+//===========================================================================================
+//                                HOST CLOCKS
+//===========================================================================================
+
+static uint64_t now_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+
+// Time-stamp counter, 0 where there is none
+static uint64_t host_cycles(void){
+#if HOST_CYCLES_SUPPORTED
+  return __builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
+//===========================================================================================
+//                                OPTIONS
+//===========================================================================================
+
+static bool parse_u32(const char* value, uint32_t* result){
+  char* end;
+  if (!*value) return false;
+  unsigned long parsed = strtoul(value, &end, 0);
+  if (*end != '\0' || parsed > UINT32_MAX) return false;
+  *result = (uint32_t) parsed;
+  return true;
+}
+
+
+static bool parse_option(bench_options_t* options, const char* option){
+  char key[32];
+  const char* value = strchr(option, '=');
+  if (!value) return false;
+  size_t key_length = (size_t) (value - option);
+  if (key_length >= sizeof(key)) return false;
+  memcpy(key, option, key_length);
+  key[key_length] = '\0';
+  value++;
+
+  if (strcmp(key, "runs") == 0) return parse_u32(value, &options->runs) && options->runs > 0 && options->runs <= BENCH_MAX_RUNS;
+  if (strcmp(key, "warmup") == 0) return parse_u32(value, &options->warmup);
+  if (strcmp(key, "scale") == 0) return parse_u32(value, &options->scale) && options->scale > 0;
+  if (strcmp(key, "kernel") == 0){
+    options->kernel = value;
+    for (size_t k = 0; k < bench_num_kernels; ++k){
+      if (strcmp(bench_kernels[k].name, value) == 0) return true;
+    }
+    return false;
+  }
+  if (strcmp(key, "mode") == 0){
+    for (int mode = EXEC_MODE_PIPELINE; mode <= EXEC_MODE_JIT; ++mode){
+      if (strcmp(simulator_mode_name((execution_mode_t) mode), value) != 0) continue;
+      options->mode = mode;
+      return true;
+    }
+    return false;
+  }
+  if (strcmp(key, "format") == 0){
+    if (strcmp(value, "json") == 0) options->format = FORMAT_JSON;
+    else if (strcmp(value, "csv") == 0) options->format = FORMAT_CSV;
+    else return false;
+    return true;
+  }
+  return false;
+}
+
+
+static bool parse_options(bench_options_t* options, int argc, char** argv){
+  *options = (bench_options_t) {.runs = 5, .warmup = 1, .scale = 1, .kernel = NULL, .mode = -1, .format = FORMAT_JSON};
+  for (int i = 0; i < argc; ++i){
+    if (!parse_option(options, argv[i])){
+      fprintf(stderr, "Error: Invalid option '%s'.\n", argv[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                MEASUREMENT
+//===========================================================================================
+
+// One reset, load and timed run
+static bool run_once(simulator_t* sim, const uint32_t* code, size_t length, bench_result_t* result,
+                     double* seconds, uint64_t* cycles){
+  simulator_reset(sim);
+  if (!simulator_load_binary(sim, code, length)) return false;
+
+  uint64_t start = now_ns();
+  uint64_t start_cycles = host_cycles();
+  simulator_run(sim);
+  *cycles = host_cycles() - start_cycles;
+  *seconds = (double) (now_ns() - start) / 1e9;
+
+  if (sim->stop_reason != STOP_EXIT){
+    fprintf(stderr, "Error: Kernel stopped with '%s' instead of exiting.\n", simulator_stop_reason_name(sim->stop_reason));
+    return false;
+  }
+  result->instructions = sim->cpu.total_instructions;
+  result->cycles = sim->cpu.total_cycles;
+  result->exit_code = sim->exit_code;
+  return true;
+}
+
+
+static bool measure(simulator_t* sim, const uint32_t* code, size_t length, const bench_options_t* options,
+                    bench_result_t* result){
+  memset(result, 0, sizeof(bench_result_t));
+  double seconds;
+  uint64_t cycles;
+
+  for (uint32_t i = 0; i < options->warmup; ++i){
+    if (!run_once(sim, code, length, result, &seconds, &cycles)) return false;
+  }
+  for (uint32_t i = 0; i < options->runs; ++i){
+    if (!run_once(sim, code, length, result, &seconds, &cycles)) return false;
+    result->mips[i] = seconds > 0.0 ? (double) result->instructions / seconds / 1e6 : 0.0;
+    result->seconds += seconds;
+    result->host_cycles += cycles;
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                REPORTING
+//===========================================================================================
+
+static void print_header(const bench_options_t* options){
+  if (options->format == FORMAT_CSV){
+    printf("kernel,mode,runs,instructions,cycles,cpi,exit_code,mips_mean,mips_stddev,mips_min,mips_max,"
+           "host_ns_per_instruction,host_cycles_per_instruction\n");
+  }
+}
+
+
+static void print_result(const char* kernel, execution_mode_t mode, const bench_options_t* options,
+                         const bench_result_t* result){
+  uint32_t runs = options->runs;
+  double mean = 0.0, variance = 0.0, min = result->mips[0], max = result->mips[0];
+  for (uint32_t i = 0; i < runs; ++i){
+    mean += result->mips[i];
+    if (result->mips[i] < min) min = result->mips[i];
+    if (result->mips[i] > max) max = result->mips[i];
+  }
+  mean /= runs;
+  for (uint32_t i = 0; i < runs; ++i) variance += (result->mips[i] - mean) * (result->mips[i] - mean);
+  double stddev = runs > 1 ? sqrt(variance / (runs - 1)) : 0.0;
+
+  double total = (double) result->instructions * runs;
+  double cpi = result->instructions ? (double) result->cycles / (double) result->instructions : 0.0;
+  double ns_per_instruction = total > 0.0 ? result->seconds * 1e9 / total : 0.0;
+  double cycles_per_instruction = total > 0.0 ? (double) result->host_cycles / total : 0.0;
+
+  if (options->format == FORMAT_CSV){
+    printf("%s,%s,%u,%lu,%lu,%.4f,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", kernel, simulator_mode_name(mode), runs,
+           result->instructions, result->cycles, cpi, result->exit_code, mean, stddev, min, max,
+           ns_per_instruction, cycles_per_instruction);
+  }
+  else {
+    printf("{\"kernel\": \"%s\", \"mode\": \"%s\", \"runs\": %u, \"instructions\": %lu, \"cycles\": %lu, "
+           "\"cpi\": %.4f, \"exit_code\": %u, \"mips_mean\": %.3f, \"mips_stddev\": %.3f, \"mips_min\": %.3f, "
+           "\"mips_max\": %.3f, \"host_ns_per_instruction\": %.3f, \"host_cycles_per_instruction\": %.3f}\n",
+           kernel, simulator_mode_name(mode), runs, result->instructions, result->cycles, cpi, result->exit_code,
+           mean, stddev, min, max, ns_per_instruction, cycles_per_instruction);
+  }
+  fflush(stdout);
+}
+
+//===========================================================================================
+//                                MAIN
+//===========================================================================================
+
+int main(int argc, char** argv){
+  bench_options_t options;
+  if (!parse_options(&options, argc - 1, argv + 1)){
+    fprintf(stderr, "Usage: %s [runs=N] [warmup=N] [scale=N] [kernel=name] [mode=name] [format=json|csv]\n", argv[0]);
+    return 2;
+  }
+
+  simulator_config_t config;
+  simulator_default_config(&config);
+  simulator_t* sim = (simulator_t *) malloc(sizeof(simulator_t));
+  bench_result_t* result = (bench_result_t *) malloc(sizeof(bench_result_t));
+  if (!sim || !result || !simulator_init(sim, &config)){ // Error Check
+    free(sim);
+    free(result);
+    return 1;
+  }
+
+  print_header(&options);
+  int status = 0;
+  for (size_t k = 0; k < bench_num_kernels; ++k){
+    const bench_kernel_t* kernel = &bench_kernels[k];
+    if (options.kernel && strcmp(options.kernel, kernel->name) != 0) continue;
+
+    uint32_t code[KERNEL_MAX_INSTRUCTIONS];
+    size_t length = kernel->build(code, KERNEL_MAX_INSTRUCTIONS, options.scale);
+    if (!length){
+      fprintf(stderr, "Error: Kernel %s does not fit in %d instructions.\n", kernel->name, KERNEL_MAX_INSTRUCTIONS);
+      status = 1;
+      continue;
+    }
+
+    bool have_checksum = false;
+    uint32_t checksum = 0;
+    for (int mode = EXEC_MODE_PIPELINE; mode <= EXEC_MODE_JIT; ++mode){
+      if (options.mode >= 0 && options.mode != mode) continue;
+
+      // Same simulator for every engine, only the mode changes
+      sim->config.execution_mode = (execution_mode_t) mode;
+      if (!measure(sim, code, length, &options, result)){
+        fprintf(stderr, "Error: Kernel %s failed in %s mode.\n", kernel->name, simulator_mode_name((execution_mode_t) mode));
+        status = 1;
+        continue;
+      }
+      if (have_checksum && result->exit_code != checksum){
+        fprintf(stderr, "Error: Kernel %s checksum 0x%08x in %s mode, expected 0x%08x.\n", kernel->name,
+                result->exit_code, simulator_mode_name((execution_mode_t) mode), checksum);
+        status = 1;
+      }
+      checksum = result->exit_code;
+      have_checksum = true;
+      print_result(kernel->name, (execution_mode_t) mode, &options, result);
+    }
+  }
+
+  simulator_destroy(sim);
+  free(sim);
+  free(result);
+  return status;
+}
@@ -12,7 +12,25 @@ typedef struct {
     bool overflow;                  // Signed overflow occurred
 } alu_result_t;
 
-// ALU operations
+// ALU operations: alu_compute() is the datapath (result only), alu_execute() adds the flags
+static inline uint32_t alu_compute(alu_operation_t operation, uint32_t a, uint32_t b){
+  switch (operation){
+    case ALU_ADD:    return a + b;
+    case ALU_SUB:    return a - b;
+    case ALU_AND:    return a & b;
+    case ALU_OR:     return a | b;
+    case ALU_XOR:    return a ^ b;
+    case ALU_SLL:    return a << (b & 0x1F);
+    case ALU_SRL:    return a >> (b & 0x1F);
+    case ALU_SRA:    return (uint32_t) ((int32_t) a >> (b & 0x1F));
+    case ALU_SLT:    return (int32_t) a < (int32_t) b;
+    case ALU_SLTU:   return a < b;
+    case ALU_COPY_A: return a;
+    case ALU_COPY_B: return b;
+  }
+  return 0;
+}
+
 alu_result_t alu_execute(alu_operation_t operation, uint32_t a, uint32_t b);
 
 // Branch condition evaluation
@@ -0,0 +1,125 @@
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include "utils/defs.h"
+
+/*
+ * Front end of the pipeline: a direct-mapped BTB says which fetch addresses hold
+ * control transfers and where they go, a direction predictor decides conditional
+ * branches and a return-address stack supplies return targets.
+ *
+ * branch_predict() runs in fetch and picks the next fetch address. What it saw
+ * (global history, return stack top) travels down the pipeline with the
+ * instruction in a branch_prediction_t, and branch_resolve() in execute trains
+ * the tables with it and repairs the return stack after a wrong guess.
+ *
+ * Direction predictors:
+ *   static   always fall through, no BTB (every taken transfer flushes)
+ *   bimodal  2-bit counters indexed by PC
+ *   gshare   2-bit counters indexed by PC xor global history
+ *   tage     bimodal base plus BP_TAGE_TABLES tagged tables with geometrically
+ *            longer histories, the longest matching one provides the prediction
+ *
+ * All tables are power-of-two arrays of small counters, the global history holds
+ * the outcomes of the last 64 conditional branches, updated at resolve.
+ */
+
+#define BP_TAGE_TABLES 4
+#define BP_TAGE_TAG_BITS 9
+#define BP_INVALID_PC UINT32_MAX       // Never a fetch address
+
+// Direction predictors
+typedef enum {
+  BP_STATIC,                      // Not taken
+  BP_BIMODAL,                     // Per-PC 2-bit counters
+  BP_GSHARE,                      // Global history xor PC
+  BP_TAGE                         // Tagged geometric history lengths
+} branch_predictor_type_t;
+
+// Control transfers as the BTB and the return stack see them
+typedef enum {
+  BRANCH_KIND_CONDITIONAL,        // Bxx
+  BRANCH_KIND_JUMP,               // JAL/JALR without link
+  BRANCH_KIND_CALL,               // JAL/JALR writing ra or t0, pushes the return address
+  BRANCH_KIND_RETURN              // JALR through ra or t0, pops it
+} branch_kind_t;
+
+// Predictor geometry
+typedef struct {
+  branch_predictor_type_t type;
+  uint32_t table_bits;            // log2 entries of the direction tables
+  uint32_t history_bits;          // gshare history length (<= table_bits)
+  uint32_t btb_bits;              // log2 BTB entries
+  uint32_t ras_size;              // Return stack entries, power of two
+} branch_predictor_config_t;
+
+// Fetch-time state carried with an instruction until it resolves
+typedef struct {
+  uint32_t next_pc;               // Where fetch went after it
+  uint32_t ras_value;             // Return stack top entry and index before it
+  uint16_t ras_top;
+  uint64_t history;               // Global history used for the prediction
+} branch_prediction_t;
+
+// Predictor state
+typedef struct {
+  branch_predictor_config_t config;
+  uint64_t history;               // Outcomes of resolved conditional branches, newest in bit 0
+
+  // Direction tables
+  uint8_t* counters;              // 2-bit counters, bimodal/gshare/TAGE base
+  uint16_t* tage_tags;            // BP_TAGE_TABLES tables of 2^(table_bits - 2) entries,
+  int8_t* tage_counters;          // table-major: 3-bit signed counters, taken if >= 0
+  uint8_t* tage_useful;           // 2-bit usefulness, 0 = may be replaced
+  uint32_t tage_bits;
+  uint32_t tage_updates;          // Usefulness ages every 2^18 updates
+
+  // Branch target buffer, structure of arrays
+  uint32_t* btb_pcs;              // BP_INVALID_PC = empty
+  uint32_t* btb_targets;
+  uint8_t* btb_kinds;             // branch_kind_t
+
+  // Return address stack, circular
+  uint32_t* ras;
+  uint16_t ras_top;
+
+  // Statistics
+  uint64_t btb_hits;
+  uint64_t btb_misses;
+  uint64_t target_mispredictions; // Jumps fetched down the wrong path
+} branch_predictor_t;
+
+// Lifecycle
+bool branch_predictor_init(branch_predictor_t* bp, const branch_predictor_config_t* config);
+void branch_predictor_destroy(branch_predictor_t* bp);
+void branch_predictor_reset(branch_predictor_t* bp);   // Untrained tables, statistics cleared
+bool branch_predictor_copy(branch_predictor_t* destination, const branch_predictor_t* source);
+
+// Next fetch address after pc, fills prediction for branch_resolve
+uint32_t branch_predict(branch_predictor_t* bp, uint32_t pc, branch_prediction_t* prediction);
+
+// Train on the outcome of the transfer at pc, true if fetch went the wrong way
+bool branch_resolve(branch_predictor_t* bp, uint32_t pc, const branch_prediction_t* prediction,
+                    branch_kind_t kind, bool taken, uint32_t target);
+
+// Undo the return stack effects of a squashed instruction and everything fetched after it
+void branch_squash(branch_predictor_t* bp, const branch_prediction_t* prediction);
+
+// The instruction at pc is no transfer after all (stale BTB entry): drop the entry, repair the return stack
+void branch_forget(branch_predictor_t* bp, uint32_t pc, const branch_prediction_t* prediction);
+
+// Kind of a JAL/JALR from its link and base registers (RISC-V calling convention hints)
+static inline branch_kind_t branch_jump_kind(uint8_t rd, uint8_t rs1, bool is_jump_register){
+  bool rd_link = rd == 1 || rd == 5;
+  bool rs1_link = rs1 == 1 || rs1 == 5;
+  if (rd_link) return BRANCH_KIND_CALL;
+  if (is_jump_register && rs1_link) return BRANCH_KIND_RETURN;
+  return BRANCH_KIND_JUMP;
+}
+
+// Configuration and statistics
+const char* branch_predictor_name(branch_predictor_type_t type);
+bool branch_predictor_find_type(const char* name, branch_predictor_type_t* type);
+void branch_predictor_print_stats(const branch_predictor_t* bp);
+
+#endif // BRANCH_PREDICTOR_H
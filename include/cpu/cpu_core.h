@@ -1,42 +1,61 @@
 #ifndef CPU_CORE_H
 #define CPU_CORE_H
 
+#include "cpu/branch_predictor.h"
+#include "cpu/debug.h"
 #include "decode/instruction.h"
+#include "decode/predecode.h"
+#include "memory/cache.h"
+#include "memory/sparse_memory.h"
+#include "utils/profile.h"
 
 // Register file
 typedef struct {
     uint32_t registers[NUM_REGISTERS];  // x0-x31, x0 is hardwired to 0
 } register_file_t;
 
-// Memory subsystem
+// Memory subsystem, pages written since the last reset are tracked (memory.h)
 typedef struct {
   uint8_t* data;
   size_t size;
   uint32_t base_address;
+  uint8_t* page_flags;            // MEMORY_PAGE_* per page, NULL = untracked (sparse views, shared banks)
+  uint32_t* dirty_pages;          // Pages flagged MEMORY_PAGE_DIRTY
+  size_t num_dirty_pages;
+  uint8_t* image;                 // Reset contents of MEMORY_PAGE_IMAGE pages, the others reset to zero
 } memory_bank_t;
 
-// Pipeline stage registers
+// Events raised by executing instructions, handled by the simulator
+typedef enum {
+  CPU_EVENT_NONE,                 // Nothing pending
+  CPU_EVENT_ECALL,                // ECALL retired
+  CPU_EVENT_EBREAK,               // EBREAK retired
+  CPU_EVENT_ILLEGAL_INSTRUCTION,  // Invalid instruction reached writeback
+  CPU_EVENT_MEMORY_FAULT,         // Load/store outside of mapped memory
+  CPU_EVENT_WATCHPOINT            // Store hit a debugger watchpoint, it has retired
+} cpu_event_t;
+
+// Pipeline stage registers: each stage reads its input latch and overwrites its
+// output latch in place, back to front, so only 16-byte micro-ops move along
 
 // IF/ID Pipeline Register
 typedef struct {
   uint32_t pc;                    // Program counter of fetched instruction
-  uint32_t instruction;           // Raw 32-bit instruction
+  uint32_t instruction;           // Raw 32-bit instruction, the decoded word once hazards are resolved
+  branch_prediction_t prediction; // Next fetch address chosen after it
   bool valid;                     // Pipeline stage contains valid data
   bool stalled;                   // Pipeline stage is stalled
 } if_id_register_t;
 
 // ID/EX Pipeline Register
 typedef struct {
-  uint32_t pc;                    // PC of instruction
-  instruction_t decoded_inst;     // Decoded instruction
-  control_signals_t control;      // Control signals
+  micro_op_t micro_op;            // Instruction and its control signals
 
   // Register file outputs
   uint32_t rs1_data;              // Contents of rs1
   uint32_t rs2_data;              // Contents of rs2
 
-  // Immediate value
-  int32_t immediate;              // Sign-extended immediate
+  branch_prediction_t prediction; // Checked when it resolves in execute
 
   // Pipeline control
   bool valid;
@@ -45,21 +64,12 @@ typedef struct {
 
 // EX/MEM Pipeline Register
 typedef struct {
-  uint32_t pc;                    // PC of instruction
-  instruction_t decoded_inst;     // Decoded instruction
-  control_signals_t control;      // Control signals
+  micro_op_t micro_op;            // Instruction and its control signals
 
   // Execution results
   uint32_t alu_result;            // ALU computation result
-  bool alu_zero;                  // ALU zero flag
-
-  // Branch/Jump results
-  uint32_t branch_target;         // Calculated branch target
-  bool branch_taken;              // Branch condition result
-  uint32_t jump_target;           // Calculated jump target
-
-  // Memory operation data
   uint32_t memory_write_data;     // Data to write to memory (rs2)
+  bool branch_taken;              // Branch condition result
 
   // Pipeline control
   bool valid;
@@ -67,18 +77,24 @@ typedef struct {
 
 // MEM/WB Pipeline Register
 typedef struct {
-  instruction_t decoded_inst;     // Decoded instruction
-  control_signals_t control;      // Control signals
+  micro_op_t micro_op;            // Instruction and its control signals
 
   // Results to write back
   uint32_t alu_result;            // ALU result
   uint32_t memory_data;           // Data loaded from memory
-  uint32_t pc_plus_4;             // PC+4 for link register
+  uint32_t memory_write_data;     // Data stored to memory (for tracing)
 
   // Pipeline control
   bool valid;
 } mem_wb_register_t;
 
+// Registers the instructions in EX/MEM and MEM/WB will write, bit n = xn (x0 never set)
+typedef struct {
+  uint32_t ex_mem_writes;         // One ahead of decode
+  uint32_t ex_mem_loads;          // Same, only if it is a load
+  uint32_t mem_wb_writes;         // Two ahead of decode
+} scoreboard_t;
+
 // Complete CPU state
 typedef struct {
   // Architectural state (visible to software)
@@ -88,6 +104,12 @@ typedef struct {
   // Memory system
   memory_bank_t instruction_memory;
   memory_bank_t data_memory;
+  sparse_memory_t sparse;         // Backs both banks when sparse.base is set
+  bool shared_memory;             // Banks belong to another CPU (cpu_memory_share)
+  predecode_cache_t predecode;    // Decoded instructions by PC
+  cache_t icache;                 // L1 timing models, pipeline only
+  cache_t dcache;
+  branch_predictor_t predictor;   // Front end of the pipeline
 
   // Pipeline registers
   if_id_register_t if_id;
@@ -98,22 +120,36 @@ typedef struct {
   // Pipeline control state
   bool pipeline_stalled;          // Pipeline is stalled due to hazard
   bool pipeline_flushed;          // Pipeline needs to be flushed
-  uint32_t stall_cycles;          // Number of cycles pipeline has been stalled
+  uint32_t stall_cycles;          // Whole-pipeline stall cycles owed (cache misses)
+  scoreboard_t scoreboard;        // Pending writes of the later latches
+  cpu_event_t pending_event;      // Event waiting for the simulator
 
   // Performance counters
   uint64_t total_cycles;          // Total clock cycles
   uint64_t total_instructions;    // Instructions completed (retired)
   uint64_t pipeline_stalls;       // Number of pipeline stalls
-  uint64_t branch_instructions;   // Branch instructions executed
-  uint64_t branch_mispredictions; // Mispredicted branches
+  uint64_t branch_instructions;   // Conditional branches executed
+  uint64_t branch_mispredictions; // Conditional branches fetched down the wrong path
+  profile_t* profile;             // Per-PC counters, NULL = not profiling
 
   // Debug and trace state
   bool single_step_mode;          // Execute one instruction at a time
   bool trace_enabled;             // Enable instruction tracing
-  uint32_t breakpoint_address;    // Debug breakpoint address
-  bool breakpoint_enabled;        // Breakpoint is active
+  debug_marks_t* debug;           // Debugger marks, NULL = none (kept by cpu_reset and cpu_restore)
+  const uint8_t* watch_pages;     // debug->page_flags while a watchpoint is set, else NULL
 } cpu_state_t;
 
+// Saved CPU state for cpu_restore()
+typedef struct {
+  cpu_state_t state;              // Registers, latches and counters (memory fields unused)
+  uint8_t* instruction_memory;    // Bank copies, banked memory only; sparse memory
+  uint8_t* data_memory;           // tracks its own snapshot
+  cache_t icache;                 // Cache and predictor contents at the snapshot
+  cache_t dcache;
+  branch_predictor_t predictor;
+  bool valid;
+} cpu_snapshot_t;
+
 // CPU lifecycle functions
 cpu_state_t* cpu_init(void);
 void cpu_reset(cpu_state_t* cpu);
@@ -126,6 +162,48 @@ void register_write(cpu_state_t* cpu, uint8_t reg_num, uint32_t value);
 // Memory operations
 bool memory_init(memory_bank_t* memory, size_t size, uint32_t base_addr);
 void memory_destroy(memory_bank_t* memory);
+bool cpu_memory_init(cpu_state_t* cpu);
+bool cpu_memory_init_sparse(cpu_state_t* cpu);
+void cpu_memory_destroy(cpu_state_t* cpu);
+bool cpu_memory_share(cpu_state_t* cpu, cpu_state_t* owner);   // Untracks the owner's banks
+bool cpu_cache_init(cpu_state_t* cpu, const cache_config_t* icache, const cache_config_t* dcache);
+void cpu_cache_destroy(cpu_state_t* cpu);
+
+// CPU view of memory: routes by address, keeps the predecode cache coherent
+memory_bank_t* cpu_select_memory_bank(cpu_state_t* cpu, uint32_t address);
+uint32_t cpu_memory_load(cpu_state_t* cpu, uint32_t address, memory_size_t size, bool unsigned_load);
+void cpu_memory_store(cpu_state_t* cpu, uint32_t address, uint32_t data, memory_size_t size);
+uint32_t cpu_fetch_instruction(cpu_state_t* cpu, uint32_t pc);
+const predecoded_instruction_t* cpu_fetch_decoded(cpu_state_t* cpu, uint32_t pc);
+
+// Host view of size bytes of guest memory for host I/O, NULL unless all of it is
+// mapped. write: the host stores there, decodes of the range are dropped.
+uint8_t* cpu_memory_span(cpu_state_t* cpu, uint32_t address, size_t size, bool write);
+
+// FENCE: orders this host thread's guest accesses and drops every decode, so code
+// stored by other harts sharing the memory is fetched again
+void cpu_fence(cpu_state_t* cpu);
+
+// Debugger marks (debug.h). Setting or clearing a breakpoint drops the decodes of
+// its page; cpu_breakpoint_hit() says whether an illegal instruction event is a
+// breakpoint at pc. cpu_watch_store() is the store check behind watch_pages.
+void cpu_debug_attach(cpu_state_t* cpu, debug_marks_t* marks);   // NULL detaches
+bool cpu_set_breakpoint(cpu_state_t* cpu, uint32_t address, bool enable);
+bool cpu_set_watchpoint(cpu_state_t* cpu, uint32_t address, uint32_t length, bool enable);
+bool cpu_breakpoint_hit(const cpu_state_t* cpu);
+void cpu_watch_store(cpu_state_t* cpu, uint32_t address, memory_size_t size);
+
+// Program image (owned banked memory): cpu_reset() brings memory back to its
+// contents at the last cpu_memory_keep_image(), rewriting only the pages written
+// since; false where it is not kept (sparse or shared memory, resets clear it).
+// cpu_memory_drop_image() zeroes memory again before loading another program.
+bool cpu_memory_keep_image(cpu_state_t* cpu);
+void cpu_memory_drop_image(cpu_state_t* cpu);
+
+// Snapshots: cheap to take, restoring rewrites only memory changed since
+bool cpu_snapshot(cpu_state_t* cpu, cpu_snapshot_t* snapshot);
+bool cpu_restore(cpu_state_t* cpu, const cpu_snapshot_t* snapshot);
+void cpu_snapshot_destroy(cpu_state_t* cpu, cpu_snapshot_t* snapshot);
 
 // Debug and inspection functions
 void print_cpu_state(const cpu_state_t* cpu);
@@ -0,0 +1,67 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include "utils/defs.h"
+
+/*
+ * Debugger breakpoints and write watchpoints, attached to a CPU with
+ * cpu_debug_attach(). Each guest page has a flag byte saying whether it holds
+ * any of them; only marked pages look at the lists of exact addresses.
+ *
+ * Breakpoints cost nothing while running: the decode of a marked PC is dropped
+ * and comes back as an illegal instruction, so every engine stops in front of
+ * it without retiring it (CPU_EVENT_ILLEGAL_INSTRUCTION, cpu_breakpoint_hit()
+ * tells the two apart). Stepping over one means lifting it for one instruction.
+ *
+ * Watchpoints are checked by the interpreter after each store, through the flag
+ * byte of the stored page and only while some watchpoint is set. A store that
+ * hits one completes and retires, then raises CPU_EVENT_WATCHPOINT. The JIT
+ * hands over to the interpreter while watchpoints are set; the pipeline model
+ * does not check them.
+ */
+
+#define DEBUG_PAGE_SHIFT 12
+#define DEBUG_NUM_PAGES (1u << (32 - DEBUG_PAGE_SHIFT))
+
+// Page flags
+#define DEBUG_PAGE_BREAKPOINT 0x1
+#define DEBUG_PAGE_WATCHPOINT 0x2
+
+typedef struct {
+  uint32_t address;
+  uint32_t length;
+} debug_range_t;
+
+typedef struct {
+  uint8_t* page_flags;            // DEBUG_NUM_PAGES bytes of DEBUG_PAGE_* bits
+  uint32_t* breakpoints;          // Exact addresses
+  size_t num_breakpoints;
+  size_t breakpoint_capacity;
+  debug_range_t* watchpoints;
+  size_t num_watchpoints;
+  size_t watchpoint_capacity;
+
+  // Last watchpoint hit
+  bool watch_hit;
+  uint32_t watch_address;         // Start of the watched range
+
+  // Statistics
+  uint64_t breakpoint_hits;
+  uint64_t watchpoint_hits;
+} debug_marks_t;
+
+// Lifecycle
+bool debug_marks_init(debug_marks_t* marks);
+void debug_marks_destroy(debug_marks_t* marks);
+
+// Marks only; cpu_set_breakpoint()/cpu_set_watchpoint() also update the CPU
+bool debug_add_breakpoint(debug_marks_t* marks, uint32_t address);
+bool debug_remove_breakpoint(debug_marks_t* marks, uint32_t address);
+bool debug_add_watchpoint(debug_marks_t* marks, uint32_t address, uint32_t length);
+bool debug_remove_watchpoint(debug_marks_t* marks, uint32_t address, uint32_t length);
+
+// Exact lookups behind the page flags
+bool debug_breakpoint_at(const debug_marks_t* marks, uint32_t pc);
+bool debug_watch_store(debug_marks_t* marks, uint32_t address, uint32_t size);   // Records the hit
+
+#endif // DEBUG_H
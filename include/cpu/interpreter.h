@@ -0,0 +1,22 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include "cpu/cpu_core.h"
+
+/*
+ * Functional (instruction-accurate) execution engine. Instructions run one at a
+ * time straight against cpu->reg_file and memory, without pipeline latches, so
+ * the architectural state matches the pipeline model after every retirement.
+ *
+ * Execution stops when max_instructions have retired (0 = unlimited) or when an
+ * instruction raises cpu->pending_event. ECALL/EBREAK retire before stopping;
+ * illegal instructions and faulting loads/stores do not, cpu->pc is left on them.
+ */
+
+// Run until the budget is used up or an event is raised, returns instructions retired
+uint64_t interpreter_run(cpu_state_t* cpu, uint64_t max_instructions);
+
+// Execute exactly one instruction
+bool interpreter_step(cpu_state_t* cpu);
+
+#endif // INTERPRETER_H
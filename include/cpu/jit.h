@@ -0,0 +1,75 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "cpu/cpu_core.h"
+
+/*
+ * Basic-block translator from RV32I to x86-64. Blocks end at branches, JAL/JALR,
+ * ECALL/EBREAK and FENCE and are translated once their start PC has been reached
+ * JIT_HOT_THRESHOLD times; colder code runs through the interpreter.
+ *
+ * Translated code reads and writes cpu_state_t directly, so the architectural
+ * state is exact at every block boundary and execution can be handed back to the
+ * pipeline model or the debugger there. Any predecode invalidation (store to an
+ * instruction page, FENCE, program load) flushes the whole code cache.
+ *
+ * On hosts other than x86-64 jit_run() falls back to the interpreter.
+ */
+
+// Code cache geometry
+#define JIT_CODE_CACHE_SIZE (16u * 1024 * 1024)  // 16MB of generated code
+#define JIT_BLOCK_TABLE_SIZE 16384               // Power of two
+#define JIT_MAX_EXITS 65536                      // Chainable block exits
+#define JIT_HOT_TABLE_SIZE 4096                  // Power of two
+#define JIT_HOT_THRESHOLD 8                      // Executions before a block is translated
+#define JIT_MAX_BLOCK_INSTRUCTIONS 64            // Longest translated block
+
+// Translated block
+typedef struct {
+  uint32_t pc;                    // Guest address of the first instruction
+  uint32_t length;                // Guest instructions in the block
+  uint8_t* code;                  // Host entry point, NULL = empty slot
+} jit_block_t;
+
+// Direct jump out of a block that can be patched to the next block
+typedef struct {
+  uint8_t* patch_site;            // jmp rel32 at the start of the exit
+  bool chained;                   // Already points at its target block
+} jit_exit_t;
+
+// JIT state, owned by the simulator
+typedef struct {
+  uint64_t remaining;             // Instruction budget, read by generated code (keep first)
+
+  // Code cache
+  uint8_t* code;                  // Executable buffer, NULL until first use
+  size_t code_size;               // Buffer size
+  size_t code_used;               // Bytes emitted since the last flush
+  uint8_t* enter;                 // Trampoline: (cpu, jit, entry) -> exit id
+  uint8_t* epilogue;              // Shared return path of every block
+
+  // Lookup structures
+  jit_block_t* blocks;            // Open-addressed table indexed by PC
+  size_t num_blocks;              // Occupied table slots
+  jit_exit_t* exits;              // Exit id - 1 indexes this array
+  size_t num_exits;               // Exits emitted since the last flush
+  uint8_t* hot_counters;          // Execution counts of untranslated block starts
+  uint64_t generation;            // cpu->predecode.invalidations the code is valid for
+  const uint8_t* page_flags;      // Data memory dirty flags baked into translated stores
+
+  // Statistics
+  uint64_t translated_blocks;     // Blocks translated since start
+  uint64_t chained_exits;         // Exits patched into direct jumps
+  uint64_t flushes;               // Whole-cache flushes
+  uint64_t native_instructions;   // Instructions retired in translated code
+} jit_state_t;
+
+// JIT lifecycle (jit_run initialises on first use)
+bool jit_init(jit_state_t* jit);
+void jit_destroy(jit_state_t* jit);
+void jit_flush(jit_state_t* jit);
+
+// Run until the budget is used up or an event is raised, returns instructions retired
+uint64_t jit_run(jit_state_t* jit, cpu_state_t* cpu, uint64_t max_instructions);
+
+#endif // JIT_H
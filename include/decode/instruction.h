@@ -64,10 +64,39 @@ typedef struct {
   bool flushes_pipeline;          // Instruction flushes pipeline
 } control_signals_t;
 
+// Compact form of an instruction for the pipeline latches: the immediate of its
+// format resolved once and the control signals packed into one word (16 bytes)
+typedef struct {
+  uint32_t pc;                    // PC of the instruction
+  uint32_t raw_instruction;       // For tracing and debug output
+  int32_t immediate;              // Sign-extended immediate of the format, 0 for R-type
+  uint32_t rd : 5;                // Destination register
+  uint32_t alu_op : 4;            // alu_operation_t
+  uint32_t funct3 : 3;            // Branch condition
+  uint32_t reg_write_enable : 1;
+  uint32_t reg_write_source : 2;  // 0=ALU, 1=memory, 2=PC+4
+  uint32_t alu_src_a_is_pc : 1;   // AUIPC
+  uint32_t alu_src_b_is_immediate : 1;
+  uint32_t mem_op : 2;            // memory_operation_t
+  uint32_t mem_size : 2;          // memory_size_t
+  uint32_t mem_load_unsigned : 1;
+  uint32_t is_branch : 1;
+  uint32_t is_jump : 1;
+  uint32_t is_jump_register : 1;
+  uint32_t is_system_call : 1;
+  uint32_t is_breakpoint : 1;
+  uint32_t is_fence : 1;
+  uint32_t is_valid : 1;          // Illegal instructions never retire
+} micro_op_t;
+
+_Static_assert(sizeof(micro_op_t) == 16, "micro_op_t is copied between latches every cycle");
+
 // Function declarations for instruction processing
 instruction_t decode_instruction(uint32_t raw_instruction, uint32_t pc);
 control_signals_t generate_control_signals(const instruction_t* instruction);
+micro_op_t generate_micro_op(const instruction_t* instruction, const control_signals_t* control);
 const char* instruction_to_string(const instruction_t* instruction);
+const char* instruction_type_name(instruction_type_t type);
 void print_instruction_detailed(const instruction_t* instruction);
 
 // Immediate extraction functions (used internally by decoder)
@@ -0,0 +1,87 @@
+#ifndef PREDECODE_H
+#define PREDECODE_H
+
+#include "decode/instruction.h"
+
+// Predecode cache geometry - one page covers 4KB of instruction memory
+#define PREDECODE_PAGE_SHIFT 12
+#define PREDECODE_PAGE_SIZE (1u << PREDECODE_PAGE_SHIFT)
+#define PREDECODE_ENTRIES_PER_PAGE (PREDECODE_PAGE_SIZE / 4)
+#define PREDECODE_TABLE_SHIFT 10        // Page slots per second-level table, 4MB of code
+#define PREDECODE_PAGES_PER_TABLE (1u << PREDECODE_TABLE_SHIFT)
+
+// Decoded instruction together with its control signals
+typedef struct {
+  instruction_t instruction;      // Decoded instruction
+  control_signals_t control;      // Control signals for it
+  micro_op_t micro_op;            // Both in pipeline latch form
+} predecoded_instruction_t;
+
+// One page worth of predecoded instructions
+typedef struct {
+  uint64_t valid[PREDECODE_ENTRIES_PER_PAGE / 64];        // Bit set = entry decoded
+  predecoded_instruction_t entries[PREDECODE_ENTRIES_PER_PAGE];
+} predecode_page_t;
+
+// PC-indexed decode-once cache in front of decode_instruction(). The page slots sit in
+// second-level tables, so even the whole 32-bit space of a sparse CPU costs one small
+// directory until code is decoded
+typedef struct {
+  predecode_page_t*** tables;     // Second-level tables of page slots, both allocated on first decode
+  size_t num_tables;
+  size_t num_pages;               // Number of page slots
+  uint32_t* populated;            // Indices of allocated pages, for full invalidation
+  size_t num_populated;
+  size_t populated_capacity;
+  uint32_t base_address;          // Address of first covered instruction
+
+  predecoded_instruction_t scratch; // Result slot for PCs outside the covered range, never invalidated
+
+  // Statistics
+  uint64_t hits;                  // Lookups served from the cache
+  uint64_t misses;                // Lookups that had to decode
+  uint64_t invalidations;         // Stores to decoded pages and full invalidations (FENCE)
+} predecode_cache_t;
+
+// Cache lifecycle
+bool predecode_init(predecode_cache_t* cache, uint32_t base_address, size_t size);
+void predecode_destroy(predecode_cache_t* cache);
+
+// Decode raw_instruction at pc, store it and return the cached entry
+const predecoded_instruction_t* predecode_insert(predecode_cache_t* cache, uint32_t pc, uint32_t raw_instruction);
+
+// Invalidation (store to an instruction page, FENCE)
+void predecode_invalidate(predecode_cache_t* cache, uint32_t address);
+void predecode_invalidate_all(predecode_cache_t* cache);
+
+// Whether decodes of pc are cached, and so dropped by stores and FENCE
+static inline bool predecode_covers(const predecode_cache_t* cache, uint32_t pc){
+  return ((pc - cache->base_address) >> PREDECODE_PAGE_SHIFT) < cache->num_pages && !(pc & 0x3);
+}
+
+
+// Fast path: returns the cached entry for pc or NULL on a miss
+static inline const predecoded_instruction_t* predecode_lookup(predecode_cache_t* cache, uint32_t pc){
+  uint32_t offset = pc - cache->base_address;
+  size_t page_index = offset >> PREDECODE_PAGE_SHIFT;
+  if (page_index >= cache->num_pages || (pc & 0x3)) return NULL;
+
+  predecode_page_t* const* table = cache->tables[page_index >> PREDECODE_TABLE_SHIFT];
+  if (!table) return NULL;
+  const predecode_page_t* page = table[page_index & (PREDECODE_PAGES_PER_TABLE - 1)];
+  if (!page) return NULL;
+
+  uint32_t slot = (offset & (PREDECODE_PAGE_SIZE - 1)) >> 2;
+  if (!((page->valid[slot >> 6] >> (slot & 63)) & 1)) return NULL;
+
+  cache->hits++;
+  return &page->entries[slot];
+}
+
+// Lookup that decodes and fills on a miss; never returns NULL
+static inline const predecoded_instruction_t* predecode_fetch(predecode_cache_t* cache, uint32_t pc, uint32_t raw_instruction){
+  const predecoded_instruction_t* entry = predecode_lookup(cache, pc);
+  return entry ? entry : predecode_insert(cache, pc, raw_instruction);
+}
+
+#endif // PREDECODE_H
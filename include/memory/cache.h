@@ -0,0 +1,73 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "utils/defs.h"
+
+/*
+ * Set-associative cache timing model. Only tags are kept, data always comes from
+ * guest memory. Tags and replacement stamps are separate arrays, set-major, so a
+ * lookup compares one contiguous run of tags. Stores allocate and dirty the line
+ * (write-back, write-allocate); evicting a dirty line counts a writeback.
+ *
+ * cache_access() returns the stall cycles the access adds on top of the one
+ * cycle of its pipeline stage: hit_latency - 1 on a hit, plus miss_penalty on
+ * a miss. A cache with size 0 is disabled and never stalls.
+ */
+
+#define CACHE_INVALID_TAG UINT32_MAX         // Never a line address
+
+// Victim selection
+typedef enum {
+  CACHE_REPLACE_LRU,              // Least recently used
+  CACHE_REPLACE_FIFO,             // Oldest fill
+  CACHE_REPLACE_RANDOM            // Pseudo-random way
+} cache_replacement_t;
+
+// Geometry and timing
+typedef struct {
+  uint32_t size;                  // Capacity in bytes, 0 = no cache
+  uint32_t ways;                  // Associativity
+  uint32_t line_size;             // Bytes per line, power of two
+  cache_replacement_t replacement;
+  uint32_t hit_latency;           // Cycles of a hit, 1 = no stall
+  uint32_t miss_penalty;          // Extra cycles of a miss
+} cache_config_t;
+
+// Cache state
+typedef struct {
+  cache_config_t config;
+  uint32_t num_sets;              // Power of two
+  uint32_t line_shift;            // log2(line_size)
+
+  // Structure of arrays, entry set * ways + way
+  uint32_t* tags;                 // Line address, CACHE_INVALID_TAG = empty
+  uint64_t* stamps;               // Last use (LRU) or fill (FIFO) time
+  uint8_t* dirty;                 // Written since the fill
+
+  uint64_t clock;                 // Access counter for the stamps
+  uint32_t random;                // Xorshift state for CACHE_REPLACE_RANDOM
+
+  // Statistics
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;             // Valid lines replaced
+  uint64_t writebacks;            // Dirty lines replaced
+} cache_t;
+
+// Lifecycle
+bool cache_init(cache_t* cache, const cache_config_t* config);
+void cache_destroy(cache_t* cache);
+void cache_reset(cache_t* cache);        // Invalidate all lines and clear statistics
+bool cache_copy(cache_t* destination, const cache_t* source);
+
+// Lookup and fill, returns the stall cycles of the access
+uint32_t cache_access(cache_t* cache, uint32_t address, bool write);
+
+static inline bool cache_enabled(const cache_t* cache){
+  return cache->tags != NULL;
+}
+
+// Statistics
+void cache_print_stats(const cache_t* cache, const char* name);
+
+#endif // CACHE_H
@@ -0,0 +1,58 @@
+#ifndef ELF_LOADER_H
+#define ELF_LOADER_H
+
+#include "cpu/cpu_core.h"
+
+/*
+ * ELF32 RISC-V executable loader. The file is mapped read-only once; headers and
+ * the symbol table are read in place. With sparse memory, PT_LOAD segments are
+ * mapped copy-on-write straight from the file and only the .bss tail of the last
+ * file page is zeroed, so loading costs page-table work. Banked memory has no
+ * host pages to map into, the segments are copied there instead.
+ */
+
+// Symbol types (STT_*)
+#define ELF_SYMBOL_OBJECT 1
+#define ELF_SYMBOL_FUNC   2
+
+// Entry of the symbol table
+typedef struct {
+  const char* name;               // Points into the mapped file
+  uint32_t address;               // st_value
+  uint32_t size;                  // st_size
+  uint8_t type;                   // ELF_SYMBOL_* or other STT_* value
+  uint8_t binding;                // STB_* (0 local, 1 global, 2 weak)
+} elf_symbol_t;
+
+// Opened executable
+typedef struct {
+  const uint8_t* image;           // Whole file, mapped read-only
+  size_t image_size;
+  int fd;                         // Kept open for copy-on-write segment mappings
+
+  uint32_t entry;                 // Entry point
+  uint32_t program_header_offset; // e_phoff
+  uint16_t program_header_size;   // e_phentsize
+  uint16_t num_program_headers;   // e_phnum
+
+  elf_symbol_t* symbols;          // Named symbols sorted by address
+  size_t num_symbols;
+} elf_file_t;
+
+// File handling
+bool elf_open(elf_file_t* elf, const char* filename);
+void elf_close(elf_file_t* elf);
+
+// Map or copy every PT_LOAD segment into guest memory
+bool elf_load(const elf_file_t* elf, cpu_state_t* cpu);
+
+// First address after the highest PT_LOAD segment (end of .bss), 0 if there is none
+uint32_t elf_end_address(const elf_file_t* elf);
+
+// load_program_from_file() (memory.h) copies the segments into a single bank
+
+// Symbol table
+const elf_symbol_t* elf_find_symbol(const elf_file_t* elf, const char* name);
+const elf_symbol_t* elf_symbol_at(const elf_file_t* elf, uint32_t address);
+
+#endif // ELF_LOADER_H
@@ -3,6 +3,24 @@
 
 #include "cpu/cpu_core.h"
 
+/*
+ * Banks remember which pages were written since the last reset: the first write
+ * to a page flags it and adds it to dirty_pages, later writes only test the flag.
+ * memory_reset() rewrites just those pages, with zeros or, for pages of the kept
+ * image, their contents when memory_keep_image() was called (the loaded
+ * program). Resetting a bank costs the pages a run wrote, not its size.
+ *
+ * Every write into data must go through memory_store*() or be followed by
+ * memory_mark_written(). A bank without page_flags is untracked and resets in full.
+ */
+
+#define MEMORY_PAGE_SHIFT 12
+#define MEMORY_PAGE_SIZE (1u << MEMORY_PAGE_SHIFT)
+
+// Page flags
+#define MEMORY_PAGE_DIRTY 0x1           // Written since the last reset
+#define MEMORY_PAGE_IMAGE 0x2           // Resets to the kept image rather than zeros
+
 // Memory access functions with proper alignment and size handling
 uint32_t memory_load_word(const memory_bank_t* memory, uint32_t address);
 uint16_t memory_load_halfword(const memory_bank_t* memory, uint32_t address);
@@ -16,6 +34,22 @@ void memory_store_byte(memory_bank_t* memory, uint32_t address, uint8_t data);
 uint32_t memory_load(const memory_bank_t* memory, uint32_t address, memory_size_t size, bool unsigned_load);
 void memory_store(memory_bank_t* memory, uint32_t address, uint32_t data, memory_size_t size);
 
+// Dirty-page tracking
+void memory_mark_pages(memory_bank_t* memory, size_t offset, size_t length);
+void memory_untrack(memory_bank_t* memory);           // Drops the flags and the image
+void memory_reset(memory_bank_t* memory);             // Written pages back to the image or zeros
+bool memory_keep_image(memory_bank_t* memory);        // Current contents become the reset state
+void memory_drop_image(memory_bank_t* memory);        // Back to all zeros, later resets too
+
+// After writing [offset, offset + length) of data directly; checks the flags of
+// the first and last page only, so length is at most MEMORY_PAGE_SIZE
+static inline void memory_mark_written(memory_bank_t* memory, size_t offset, size_t length){
+  const uint8_t* flags = memory->page_flags;
+  if (flags && !(flags[offset >> MEMORY_PAGE_SHIFT] & flags[(offset + length - 1) >> MEMORY_PAGE_SHIFT] & MEMORY_PAGE_DIRTY)){
+    memory_mark_pages(memory, offset, length);
+  }
+}
+
 // Memory management
 void memory_clear(memory_bank_t* memory);
 bool memory_address_valid(const memory_bank_t* memory, uint32_t address, memory_size_t access_size);
@@ -0,0 +1,126 @@
+#ifndef SPARSE_MEMORY_H
+#define SPARSE_MEMORY_H
+
+#include "utils/defs.h"
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+
+/*
+ * Sparse guest memory: the whole 32-bit guest space is reserved up front as one
+ * PROT_NONE host mapping, so a guest address is a plain offset from base and
+ * accesses need no bounds checks. Mapped ranges are made accessible, the host
+ * kernel commits their pages on first touch.
+ *
+ * An access to an unmapped page traps into a SIGSEGV handler. It opens the page
+ * as a scratch page, records the fault and returns, so the access completes
+ * with garbage; the caller checks sparse_memory_faulted() afterwards, raises
+ * the guest fault and drops the scratch pages again.
+ *
+ * A snapshot write-protects every mapped page. The first write to a page traps
+ * too: the handler copies the page into a shadow reservation, lists it as dirty
+ * and reopens it, so a restore only copies back the pages written since.
+ *
+ * Needs a 64-bit POSIX host; elsewhere sparse_memory_init() fails.
+ */
+
+#define GUEST_PAGE_SHIFT 12
+#define GUEST_PAGE_SIZE (1u << GUEST_PAGE_SHIFT)
+#define GUEST_NUM_PAGES (1u << (32 - GUEST_PAGE_SHIFT))
+#define SPARSE_MAX_FAULT_PAGES 4            // Scratch pages one access can open
+#define SPARSE_MAX_SPACES 256               // Sparse memories alive at the same time
+
+// Default layout of a sparse CPU memory, both regions committed lazily
+#define SPARSE_INSTRUCTION_MEMORY_SIZE (DATA_MEMORY_BASE - INSTRUCTION_MEMORY_BASE)
+#define SPARSE_DATA_MEMORY_SIZE (256u * 1024 * 1024)   // Heap and stack
+
+typedef struct {
+  uint8_t* base;                  // Host address of guest address 0, NULL = not in use
+  size_t reservation_size;        // Guest space plus a guard page
+  uint64_t* page_map;             // One bit per guest page, set = mapped
+  size_t mapped_pages;            // Pages currently mapped
+
+  // Fault state, written by the signal handler
+  volatile sig_atomic_t faulted;  // An access hit an unmapped page
+  volatile uint32_t fault_address; // Guest address of the first faulting byte
+  volatile sig_atomic_t num_fault_pages;
+  uint8_t* volatile fault_pages[SPARSE_MAX_FAULT_PAGES]; // Scratch pages to drop
+
+  // Snapshot state, dirty tracking works on host pages
+  size_t page_size;               // Host page size
+  volatile sig_atomic_t tracking; // Snapshot taken, unwritten mapped pages are read-only
+  uint8_t* shadow;                // Snapshot contents of written pages, same layout as base
+  uint64_t* snapshot_map;         // page_map at the snapshot
+  size_t snapshot_mapped_pages;
+  bool map_changed;               // Pages mapped or unmapped since the snapshot or restore
+  uint64_t* saved_map;            // One bit per host page, set = copy in shadow
+  uint32_t* saved_pages;          // Host page numbers of the saved_map bits
+  volatile size_t num_saved_pages;
+  uint64_t* dirty_map;            // One bit per host page, set = written since snapshot or restore
+  uint32_t* dirty_pages;          // Host page numbers of the dirty_map bits
+  volatile size_t num_dirty_pages;
+  size_t page_capacity;           // Entries of saved_pages and dirty_pages
+
+  // Statistics
+  uint64_t faults;                // Guest faults taken
+} sparse_memory_t;
+
+// Lifecycle
+bool sparse_memory_init(sparse_memory_t* memory);
+void sparse_memory_destroy(sparse_memory_t* memory);
+
+// Guest mappings (address and size are rounded out to whole pages)
+bool sparse_memory_map(sparse_memory_t* memory, uint32_t address, size_t size);
+void sparse_memory_unmap(sparse_memory_t* memory, uint32_t address, size_t size);
+bool sparse_memory_is_mapped(const sparse_memory_t* memory, uint32_t address, size_t size);
+
+// Open a mapped range for writes by the host kernel (system calls fail with EFAULT
+// instead of trapping on snapshot-protected pages); false if it is not all mapped
+bool sparse_memory_prepare_write(sparse_memory_t* memory, uint32_t address, size_t size);
+
+// Copy-on-write file mapping: file_size bytes from offset, zeros up to size.
+// Fails without side effects when address and offset differ modulo the host page size.
+bool sparse_memory_map_file(sparse_memory_t* memory, uint32_t address, size_t size, int fd, uint64_t offset, size_t file_size);
+
+// Zero every mapped page (file mappings included) and give the host memory back
+void sparse_memory_clear(sparse_memory_t* memory);
+
+// Snapshots: one per memory, taking a new one or clearing the memory drops it
+bool sparse_memory_snapshot(sparse_memory_t* memory);
+bool sparse_memory_restore(sparse_memory_t* memory);
+void sparse_memory_drop_snapshot(sparse_memory_t* memory);
+
+// Fault handling: returns the guest fault address and closes the scratch pages
+uint32_t sparse_memory_take_fault(sparse_memory_t* memory);
+
+static inline bool sparse_memory_faulted(const sparse_memory_t* memory){
+  atomic_signal_fence(memory_order_seq_cst);   // Order after the access that may have trapped
+  return memory->faulted;
+}
+
+// Unchecked accesses; unmapped pages trap into the fault handler
+static inline uint32_t sparse_memory_load(const sparse_memory_t* memory, uint32_t address, memory_size_t size, bool unsigned_load){
+  const uint8_t* p = memory->base + address;
+  switch (size){
+    case MEM_SIZE_BYTE:
+      return unsigned_load ? p[0] : (uint32_t) (int32_t) (int8_t) p[0];
+    case MEM_SIZE_HALFWORD: {
+      uint16_t value;
+      memcpy(&value, p, sizeof(value));
+      return unsigned_load ? value : (uint32_t) (int32_t) (int16_t) value;
+    }
+    case MEM_SIZE_WORD: {
+      uint32_t value;
+      memcpy(&value, p, sizeof(value));
+      return value;
+    }
+  }
+  return 0;
+}
+
+
+static inline void sparse_memory_store(sparse_memory_t* memory, uint32_t address, uint32_t data, memory_size_t size){
+  memcpy(memory->base + address, &data, 1u << size);   // Little-endian host
+}
+
+#endif // SPARSE_MEMORY_H
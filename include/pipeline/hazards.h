@@ -18,10 +18,12 @@ typedef struct {
   uint32_t forward_rs2_data;       // Actual forwarded data for rs2
 } forwarding_unit_t;
 
-// Hazard detection functions
+// Hazard detection functions, AND the sources of IF/ID with the scoreboard masks
+uint32_t source_register_mask(uint32_t raw);
 bool has_raw_hazard(const cpu_state_t* cpu, uint8_t source_reg);
 bool has_load_use_hazard(const cpu_state_t* cpu);
 bool has_control_hazard(const cpu_state_t* cpu);
+bool has_serializing_hazard(const cpu_state_t* cpu);
 
 // Forwarding unit
 forwarding_unit_t compute_forwarding_signals(const cpu_state_t* cpu);
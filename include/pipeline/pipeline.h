@@ -13,12 +13,14 @@ void pipeline_stage_writeback(cpu_state_t* cpu);
 // Main pipeline control
 void pipeline_clock_cycle(cpu_state_t* cpu);
 void pipeline_flush(cpu_state_t* cpu);
-void pipeline_stall(cpu_state_t* cpu, uint32_t cycles);
+void pipeline_stall(cpu_state_t* cpu, uint32_t cycles);   // Freezes everything, charged in one step
+                                                           // by the next pipeline_clock_cycle
 
 // Hazard detection and resolution
 bool detect_data_hazard(const cpu_state_t* cpu);
 bool detect_load_use_hazard(const cpu_state_t* cpu);
 bool detect_control_hazard(const cpu_state_t* cpu);
+bool detect_serializing_hazard(const cpu_state_t* cpu);
 void resolve_hazards(cpu_state_t* cpu);
 
 #endif // PIPELINE_H
@@ -0,0 +1,91 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "cpu/branch_predictor.h"
+#include "memory/cache.h"
+#include "utils/simulator.h"
+#include "utils/trace.h"
+
+/*
+ * Trace-driven timing model: the five-stage pipeline replayed from a stream of
+ * retired instructions (trace_record_t) instead of executing them. Its latches
+ * hold positions in the stream; fetch, the load-use interlock, branch prediction
+ * and resolution, the caches, the FENCE refetch and the ECALL/EBREAK drain run
+ * cycle for cycle as in pipeline_clock_cycle, with real cache_access and
+ * branch_predict/branch_resolve calls. A stream recorded in any execution mode therefore gives the cycle,
+ * stall, cache and predictor counts a pipeline run of the same program with the
+ * same configuration would have, without the ALU, register file or guest memory.
+ * Counts are exact for runs that end in an exit ECALL; a run stopped by a fault
+ * or a limit loses the few cycles it spent on instructions that never retired.
+ *
+ * Wrong-path instructions are not in the stream: fetch looks up the icache and
+ * predictor for them and they are squashed before decode, as in the pipeline.
+ * Where the stream jumps without a control transfer (dropped records, a stale
+ * BTB entry) fetch is redirected without counting a misprediction. A branch
+ * whose target is the next instruction counts as not taken.
+ *
+ * Records are pushed one at a time and only a small window of them is kept, so
+ * replaying a trace takes constant memory however long it is.
+ */
+
+#define TIMING_WINDOW 16                  // Records kept, power of two
+
+// Pipeline latch: a record of the stream or a wrong-path fetch
+typedef struct {
+  uint64_t record;                // Stream position
+  uint32_t raw;                   // Instruction word, 0 for wrong-path fetches
+  branch_prediction_t prediction;
+  bool valid;
+  bool on_path;                   // False: fetched past a misprediction or the end of the stream
+} timing_latch_t;
+
+typedef struct {
+  // Timing structures, configured as in the simulator
+  cache_t icache;
+  cache_t dcache;
+  branch_predictor_t predictor;
+
+  // Stream window: records [window_end - TIMING_WINDOW, window_end) are available
+  trace_record_t window[TIMING_WINDOW];
+  uint64_t window_end;            // Records pushed
+  uint64_t fetch_record;          // Next record on the correct path
+  uint32_t pc;                    // Fetch address
+
+  // Pipeline state
+  timing_latch_t if_id;
+  timing_latch_t id_ex;
+  timing_latch_t ex_mem;
+  timing_latch_t mem_wb;
+  scoreboard_t scoreboard;
+  bool stalled;                   // Load-use interlock, held behind FENCE/ECALL/EBREAK
+  bool flushed;                   // Redirected by execute this cycle
+  uint32_t stall_cycles;          // Cache miss cycles owed
+
+  // Statistics, as in cpu_state_t
+  uint64_t total_cycles;
+  uint64_t total_instructions;
+  uint64_t pipeline_stalls;
+  uint64_t branch_instructions;
+  uint64_t branch_mispredictions;
+  uint64_t redirects;             // Stream jumps without a control transfer
+
+  // Last timing_replay
+  double replay_time_seconds;
+} timing_model_t;
+
+// Lifecycle: caches and predictor from the simulator configuration
+bool timing_model_init(timing_model_t* model, const simulator_config_t* config);
+void timing_model_destroy(timing_model_t* model);
+void timing_model_reset(timing_model_t* model);   // Cold caches and predictor, counters cleared
+
+// Feed the next retired instruction; the model runs as far as it can see.
+// finish runs the pipeline until every pushed record has retired.
+void timing_model_push(timing_model_t* model, const trace_record_t* record);
+void timing_model_finish(timing_model_t* model);
+
+// Replay a whole trace file through the model, streaming it from disk
+bool timing_replay(timing_model_t* model, const char* filename);
+
+void timing_model_print_stats(const timing_model_t* model);
+
+#endif // TIMING_H
@@ -0,0 +1,61 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "utils/simulator.h"
+#include <stdio.h>
+
+/*
+ * In-process batch runner. Jobs are independent simulator_t runs spread over a
+ * work-stealing pool: every worker owns a slice of the manifest, takes jobs from
+ * its own end and steals from the other end of a random victim once its slice
+ * is empty. Workers keep their simulator between jobs and only reset it, so a
+ * job costs a reset and a program load.
+ *
+ * Manifest: one job per line, the program path followed by simulator options
+ * (see simulator_parse_option), '#' starts a comment:
+ *   build/sort.elf mode=jit memory=sparse max_instructions=1000000
+ */
+
+#define BATCH_MAX_LINE 1024
+
+// One simulation to run
+typedef struct {
+  char* program;                  // ELF executable
+  simulator_config_t config;      // Engine, memory backend and limits
+} batch_job_t;
+
+// Outcome of a job
+typedef struct {
+  size_t job;                     // Index in the manifest
+  bool loaded;                    // Program was loaded and run
+  stop_reason_t stop_reason;      // Why the run ended
+  uint32_t exit_code;             // Program exit code
+  uint64_t cycles;                // Cycles simulated
+  uint64_t instructions;          // Instructions retired
+  double seconds;                 // Wall time of the run
+  double instructions_per_second;
+} batch_result_t;
+
+// Called once per finished job, calls are serialised
+typedef void (*batch_result_callback_t)(const batch_job_t* job, const batch_result_t* result, void* context);
+
+// Job list
+typedef struct {
+  batch_job_t* jobs;
+  size_t num_jobs;
+  size_t capacity;
+} batch_manifest_t;
+
+// Manifest handling
+bool batch_manifest_load(batch_manifest_t* manifest, const char* filename);
+bool batch_manifest_add(batch_manifest_t* manifest, const char* program, const simulator_config_t* config);
+void batch_manifest_destroy(batch_manifest_t* manifest);
+
+// Run every job on num_threads workers (0 = one per host core)
+bool batch_run(const batch_manifest_t* manifest, size_t num_threads, batch_result_callback_t callback, void* context);
+size_t batch_default_threads(void);
+
+// Result callback printing one line per job to the FILE* in context
+void batch_print_result(const batch_job_t* job, const batch_result_t* result, void* context);
+
+#endif // BATCH_H
@@ -9,6 +9,8 @@
 #define NUM_REGISTERS 32
 #define INSTRUCTION_MEMORY_SIZE (64 * 1024)  // 64KB instruction memory
 #define DATA_MEMORY_SIZE (64 * 1024)         // 64KB data memory
+#define INSTRUCTION_MEMORY_BASE 0x00000000   // Instruction memory base address
+#define DATA_MEMORY_BASE 0x10000000          // Data memory base address
 // #define REGISTER_WIDTH 32
 // #define INSTRUCTION_WIDTH 32
 
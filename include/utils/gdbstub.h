@@ -0,0 +1,63 @@
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include "cpu/debug.h"
+#include "utils/simulator.h"
+#include <stdio.h>
+
+/*
+ * GDB remote serial protocol server, so the guest can be debugged with
+ * riscv*-gdb: "target remote :1234" (or "target remote /path" for a Unix
+ * socket) against "risc program.elf gdb=1234". One debugger at a time, all-stop.
+ *
+ * Supported: registers (g/G/p/P, x0-x31 then pc), memory (m/M), step and
+ * continue (s/c/vCont), software and hardware breakpoints (Z0/Z1) and write
+ * watchpoints (Z2), interrupt (Ctrl-C), kill and detach. The target description
+ * is sent through qXfer:features:read. Read and access watchpoints are refused.
+ *
+ * Breakpoints and watchpoints are debug.h marks, so continuing runs at full
+ * speed: the JIT when mode=jit, otherwise the interpreter (the pipeline model
+ * is not used under the debugger). Between chunks of GDBSTUB_CHUNK instructions
+ * the socket is polled for an interrupt.
+ */
+
+#define GDBSTUB_MAX_PACKET 4096
+#define GDBSTUB_CHUNK (1u << 20)          // Instructions between interrupt checks
+
+typedef struct {
+  simulator_t* sim;
+  debug_marks_t marks;            // Attached to sim->cpu while serving
+  execution_mode_t mode;          // Engine used to continue
+  int listen_fd;
+  int fd;                         // Debugger connection, -1 = none
+  char unix_path[108];            // Socket file removed on destroy, "" = TCP
+
+  // Connection state
+  bool no_ack;                    // QStartNoAckMode accepted
+  bool interrupted;               // Ctrl-C while running
+  bool exited;                    // The program ended, nothing left to run
+  uint8_t input[GDBSTUB_MAX_PACKET];
+  size_t input_start;
+  size_t input_end;
+  char packet[GDBSTUB_MAX_PACKET + 1];
+  size_t packet_length;
+  char reply[2 * GDBSTUB_MAX_PACKET];
+  char* target_xml;
+
+  // Statistics
+  uint64_t packets;
+  uint64_t resumes;
+  uint64_t interrupts;
+} gdbstub_t;
+
+// Listen on "PORT" (127.0.0.1), "host:port" or "unix:PATH"
+bool gdbstub_init(gdbstub_t* stub, simulator_t* sim, const char* address);
+void gdbstub_destroy(gdbstub_t* stub);
+
+// Wait for a debugger and serve it until it kills the program, detaches or
+// disconnects. Returns true on a detach from a program that can run on.
+bool gdbstub_serve(gdbstub_t* stub);
+
+void gdbstub_print_stats(const gdbstub_t* stub, FILE* out);
+
+#endif // GDBSTUB_H
@@ -0,0 +1,64 @@
+#ifndef MULTIHART_H
+#define MULTIHART_H
+
+#include "utils/simulator.h"
+#include <stdio.h>
+
+/*
+ * Multi-hart simulation: N simulators whose CPUs share the guest memory of hart
+ * 0 (banked memory only, cpu_memory_share). Each hart keeps its own registers,
+ * decode cache, timing models, JIT code cache and emulated process state. Harts
+ * run in quanta of a fixed number of instructions with a barrier after every
+ * quantum, so no hart gets more than one quantum ahead of another.
+ *
+ * Threaded (default): one host thread per hart, the calling thread runs hart 0.
+ * Guest stores reach other harts' loads in host memory order; a guest FENCE is
+ * a full host fence and drops the hart's decodes, so code written by another
+ * hart is fetched again after it.
+ *
+ * Deterministic: the calling thread runs the quanta round-robin, hart 0 first.
+ * Runs are repeatable instruction for instruction.
+ *
+ * Every hart starts at the program entry with a0 = hart id, a1 = number of harts
+ * and sp = top of data memory - id * stack_size. Trace files and profile output
+ * belong to hart 0. The run ends once every hart has stopped.
+ */
+
+#define MULTIHART_MAX_HARTS 64
+
+typedef struct {
+  uint32_t num_harts;             // 1 = plain single simulator
+  uint64_t quantum;               // Instructions per hart between barriers
+  bool deterministic;             // Round-robin on the calling thread
+  uint32_t stack_size;            // Bytes of data memory per hart stack
+} multihart_config_t;
+
+typedef struct {
+  simulator_t* harts;             // num_harts simulators, hart 0 owns the memory
+  multihart_config_t config;
+
+  // Last run
+  uint32_t num_threads;           // Host threads that ran harts
+  uint64_t quanta;                // Barrier rounds
+  double simulation_time_seconds;
+} multihart_t;
+
+// Configuration: defaults plus "key=value" options (harts, hart_quantum,
+// hart_deterministic, hart_stack)
+void multihart_default_config(multihart_config_t* config);
+bool multihart_parse_option(multihart_config_t* config, const char* option);
+
+// Lifecycle: every hart gets sim_config (memory must be banked)
+bool multihart_init(multihart_t* mh, const multihart_config_t* config, const simulator_config_t* sim_config);
+void multihart_destroy(multihart_t* mh);
+
+// Loads into the shared memory and points every hart at the entry
+bool multihart_load_program(multihart_t* mh, const char* filename);
+bool multihart_load_binary(multihart_t* mh, const uint32_t* program, size_t size);
+
+// Runs every hart in the configured engine until all have stopped
+void multihart_run(multihart_t* mh);
+
+void multihart_print_stats(const multihart_t* mh, FILE* out);
+
+#endif // MULTIHART_H
@@ -0,0 +1,107 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "utils/defs.h"
+#include <stdio.h>
+
+/*
+ * Per-PC and per-instruction-class performance counters. Counts live in flat
+ * arrays indexed by (pc - base) / 4 over the instruction memory; the arrays are
+ * zero-filled on demand by the host, so only pages of code that ran cost memory.
+ *
+ *   executions     instructions retired at each PC
+ *   branch sites   conditional branches resolved at each PC, taken and
+ *                  mispredicted (the interpreter never mispredicts)
+ *   classes        instructions retired per instruction_type_t
+ *   stall cycles   pipeline cycles lost to load-use bubbles, control flushes
+ *                  and L1I/L1D accesses
+ *
+ * The pipeline and the interpreter update the counters; translated JIT code has
+ * no hooks, so the JIT engine interprets while a profile is attached. Builds with
+ * PROFILE_COUNTERS=0 (cmake -DRISC_PROFILE=OFF) compile every hook out.
+ */
+
+#ifndef PROFILE_COUNTERS
+#define PROFILE_COUNTERS 1
+#endif
+
+#define PROFILE_CONTROL_PENALTY 1      // Fetch of a flush cycle, the target is fetched in the same cycle
+
+// Why the pipeline lost cycles
+typedef enum {
+  PROFILE_STALL_LOAD_USE,         // Bubble behind a load
+  PROFILE_STALL_CONTROL,          // Wrong-path fetches squashed
+  PROFILE_STALL_ICACHE,           // L1I latency and misses
+  PROFILE_STALL_DCACHE,           // L1D latency and misses
+  PROFILE_STALL_SERIALIZE,        // Held in decode behind a FENCE
+  PROFILE_STALL_COUNT
+} profile_stall_t;
+
+// Export formats
+typedef enum {
+  PROFILE_FORMAT_JSON,
+  PROFILE_FORMAT_CSV
+} profile_format_t;
+
+// Counter arrays and totals
+typedef struct {
+  uint32_t base_address;          // PC of slot 0
+  size_t num_slots;               // Instructions covered
+
+  // Structure of arrays, one slot per instruction
+  uint64_t* executions;
+  uint64_t* branch_executions;    // Non-zero marks a conditional branch site
+  uint64_t* branch_taken;
+  uint64_t* branch_mispredictions;
+  size_t first_slot;              // Slots touched so far, exports scan only these
+  size_t last_slot;
+
+  uint64_t outside;               // Retired outside the covered range
+  uint64_t classes[INST_INVALID + 1];
+  uint64_t stall_cycles[PROFILE_STALL_COUNT];
+} profile_t;
+
+// Lifecycle
+bool profile_init(profile_t* profile, uint32_t base_address, size_t size);
+void profile_destroy(profile_t* profile);
+void profile_reset(profile_t* profile);   // Zero every counter
+
+// Export, the files are rewritten on every call
+bool profile_export(const profile_t* profile, const char* filename, profile_format_t format);
+void profile_write_json(const profile_t* profile, FILE* out);
+void profile_write_csv(const profile_t* profile, FILE* out);
+void profile_print_stats(const profile_t* profile);
+
+// Hooks: callers test profile_enabled() first so disabled builds drop the whole call
+static inline bool profile_enabled(const profile_t* profile){
+  return PROFILE_COUNTERS && profile != NULL;
+}
+
+static inline size_t profile_slot(profile_t* profile, uint32_t pc){
+  size_t slot = (pc - profile->base_address) >> 2;
+  if (slot >= profile->num_slots) return SIZE_MAX;
+  if (slot < profile->first_slot) profile->first_slot = slot;
+  if (slot > profile->last_slot) profile->last_slot = slot;
+  return slot;
+}
+
+static inline void profile_retire(profile_t* profile, uint32_t pc, instruction_type_t type){
+  size_t slot = profile_slot(profile, pc);
+  if (slot != SIZE_MAX) profile->executions[slot]++;
+  else profile->outside++;
+  profile->classes[type]++;
+}
+
+static inline void profile_branch(profile_t* profile, uint32_t pc, bool taken, bool mispredicted){
+  size_t slot = profile_slot(profile, pc);
+  if (slot == SIZE_MAX) return;
+  profile->branch_executions[slot]++;
+  profile->branch_taken[slot] += taken;
+  profile->branch_mispredictions[slot] += mispredicted;
+}
+
+static inline void profile_stall(profile_t* profile, profile_stall_t cause, uint32_t cycles){
+  profile->stall_cycles[cause] += cycles;
+}
+
+#endif // PROFILE_H
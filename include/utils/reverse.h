@@ -0,0 +1,147 @@
+#ifndef REVERSE_H
+#define REVERSE_H
+
+#include "cpu/cpu_core.h"
+#include "utils/syscall.h"
+#include <stdio.h>
+
+/*
+ * Reverse execution for the interactive debugger. Instructions run one at a
+ * time in the interpreter under a recorder that keeps two things:
+ *
+ * Undo log: a ring of the last log_size instructions, each with the register or
+ * memory bytes it overwrote (16 bytes per instruction). Stepping back pops
+ * entries, so going back n instructions costs n undos.
+ *
+ * Checkpoints: every interval instructions the registers, pc, counters and
+ * program break are saved, and the first write to each guest page in the
+ * following interval copies the page beforehand. Older than the log, a point is
+ * reached by rolling memory back to the checkpoint before it (page copies,
+ * newest first) and running forward again, at most interval instructions, which
+ * also fills the log for the steps after it. The oldest checkpoint is dropped
+ * once there are max_checkpoints; it marks the start of the history.
+ *
+ * System calls are recorded with the guest memory and a0 they wrote. Running
+ * forward inside the recorded history replays them instead of calling the host,
+ * so a read() is not repeated and the program sees the same clock. What a call
+ * did outside the guest (console or file output, open files) is not undone, and
+ * statistics other than the instruction and cycle counts keep counting.
+ */
+
+#define REVERSE_DEFAULT_LOG_SIZE (1u << 20)       // Undo entries, power of two
+#define REVERSE_DEFAULT_INTERVAL 65536            // Instructions between checkpoints
+#define REVERSE_DEFAULT_CHECKPOINTS 1024
+
+// Recorder configuration (log_size 0 = no reverse execution)
+typedef struct {
+  uint32_t log_size;              // Undo entries, rounded up to a power of two
+  uint32_t interval;              // Instructions between checkpoints, at most log_size
+  uint32_t max_checkpoints;       // History kept, in intervals
+} reverse_config_t;
+
+#define REVERSE_ENTRY_SYSCALL 0x1 // ECALL serviced as a system call, see reverse_syscall_t
+
+// What one retired instruction overwrote
+typedef struct {
+  uint32_t pc;                    // Address of the instruction
+  uint32_t address;               // Store address
+  uint32_t old_value;             // Register or memory contents before it
+  uint8_t rd;                     // Register written, 0 = none
+  uint8_t size;                   // Bytes stored, 0 = none
+  uint8_t flags;
+} reverse_entry_t;
+
+// A recorded system call
+typedef struct {
+  uint64_t instret;               // Position of the ECALL
+  uint32_t result;                // a0 after the call
+  uint32_t old_break;             // Program break before and after
+  uint32_t new_break;
+  uint32_t address;               // Guest memory the call may have written
+  uint32_t length;
+  uint8_t* old_bytes;             // Its contents before and after, length bytes each
+  uint8_t* new_bytes;
+  bool exited;                    // exit/exit_group, code in result
+} reverse_syscall_t;
+
+// Pre-image of a guest page
+typedef struct {
+  uint32_t address;
+  uint8_t* data;                  // GUEST_PAGE_SIZE bytes
+} reverse_page_t;
+
+typedef struct {
+  uint64_t instret;               // Position of the checkpoint
+  uint64_t cycles;
+  uint32_t pc;
+  register_file_t reg_file;
+  uint32_t program_break;
+  uint32_t serial;                // Page generation, never reused
+  reverse_page_t* pages;          // Pages first written after it, as they were at it
+  size_t num_pages;
+  size_t capacity;
+} reverse_checkpoint_t;
+
+typedef struct {
+  cpu_state_t* cpu;
+  syscall_state_t* syscalls;      // NULL = ECALLs are not system calls
+  reverse_config_t config;
+
+  // Undo log: entry of position i at i & log_mask, positions [log_start, instret)
+  reverse_entry_t* log;
+  uint64_t log_mask;
+  uint64_t log_start;
+  reverse_entry_t pending;        // Captured before the instruction runs
+
+  // Checkpoints, oldest first
+  reverse_checkpoint_t* checkpoints;
+  size_t num_checkpoints;
+  uint32_t* page_serial;          // Per guest page: serial of the checkpoint that copied it
+  uint32_t next_serial;
+  uint64_t frontier;              // Furthest position executed, recorded before it
+
+  // System calls in the history, by position
+  reverse_syscall_t* syscall_log;
+  size_t num_syscalls;
+  size_t syscall_capacity;
+
+  // Last reverse_step
+  bool exited;                    // A system call ended the program
+  uint32_t exit_code;
+
+  // Statistics
+  uint64_t undone;                // Instructions stepped back
+  uint64_t replayed;              // Instructions run again from checkpoints
+  uint64_t page_copies;
+} reverse_t;
+
+// Stop test for reverse_back, called after each entry is undone (state is just
+// before the instruction)
+typedef bool (*reverse_stop_t)(const reverse_t* rev, const reverse_entry_t* entry, void* context);
+
+// Configuration: defaults plus the fields of "reverse_<field>=value" options
+void reverse_default_config(reverse_config_t* config);
+bool reverse_parse_option(reverse_config_t* config, const char* field, const char* value);
+
+// Lifecycle: the history starts at the current state of cpu
+bool reverse_init(reverse_t* rev, const reverse_config_t* config, cpu_state_t* cpu, syscall_state_t* syscalls);
+void reverse_destroy(reverse_t* rev);
+
+// Run one instruction forward in the interpreter and record it, returns the
+// instructions retired (0 on a fault). ECALLs are serviced or replayed here when
+// syscalls is set (exited/exit_code), other events are left pending.
+uint64_t reverse_step(reverse_t* rev);
+
+// Step back until max_steps are undone, stop returns true or the history starts,
+// returns the instructions stepped back
+uint64_t reverse_back(reverse_t* rev, uint64_t max_steps, reverse_stop_t stop, void* context);
+
+// True if the undone entry wrote any of [address, address + size)
+bool reverse_entry_writes(const reverse_t* rev, const reverse_entry_t* entry, uint32_t address, uint32_t size);
+
+// Oldest position reverse_back can reach
+uint64_t reverse_history_start(const reverse_t* rev);
+
+void reverse_print_stats(const reverse_t* rev, FILE* out);
+
+#endif // REVERSE_H
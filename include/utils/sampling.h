@@ -0,0 +1,72 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "utils/simulator.h"
+#include <stdio.h>
+
+/*
+ * Sampled simulation. The program runs functionally (interpreter or JIT) and only
+ * short intervals go through the cycle-level pipeline:
+ *
+ *   periodic   fast-forward, warm up, measure, repeat until the program ends
+ *   points     measure the listed interval numbers (SimPoint .simpoints file),
+ *              each weighted by its cluster weight (.weights file)
+ *
+ * Warm-up instructions run in the pipeline but are not counted. The pipeline is
+ * drained with pipeline_flush() after every sample, the squashed instructions
+ * re-run functionally. The CPI estimate is cycles over instructions of all
+ * samples, or the weighted mean of the sample CPIs with SimPoint points.
+ *
+ * sampling_profile_bbv() runs the whole program functionally and writes one
+ * SimPoint basic-block vector per interval ("T:id:count :id:count ..."), where
+ * count is the number of instructions executed in the block.
+ */
+
+// Sampling parameters
+typedef struct {
+  uint64_t fast_forward;          // Functional instructions before each sample (periodic)
+  uint64_t warmup;                // Pipeline instructions run before measuring
+  uint64_t interval;              // Measured instructions per sample, BBV interval length
+  uint64_t max_samples;           // 0 = until the program ends
+  execution_mode_t fast_forward_mode; // EXEC_MODE_FUNCTIONAL or EXEC_MODE_JIT
+  const char* points_file;        // SimPoint intervals to measure, NULL = periodic
+  const char* weights_file;       // SimPoint weights of the points, NULL = equal
+  const char* bbv_file;           // Output of sampling_profile_bbv
+} sampling_config_t;
+
+// One measured interval
+typedef struct {
+  uint64_t start;                 // Instructions retired before it
+  uint64_t instructions;          // Instructions measured
+  uint64_t cycles;
+  uint64_t pipeline_stalls;
+  uint64_t branch_instructions;
+  uint64_t branch_mispredictions;
+  double weight;                  // SimPoint weight, 1 for periodic samples
+} sample_t;
+
+// Outcome of a sampled run
+typedef struct {
+  sample_t* samples;
+  size_t num_samples;
+  size_t capacity;
+  uint64_t fast_forwarded;        // Instructions run functionally
+  uint64_t warmed;                // Instructions run in the pipeline but not measured
+  double cpi;                     // Estimated CPI of the whole program
+  double seconds;                 // Wall time
+} sampling_result_t;
+
+// Configuration: defaults plus "key=value" options (sample_fast_forward, sample_warmup,
+// sample_interval, sample_max, sample_mode, sample_points, sample_weights, sample_bbv)
+void sampling_default_config(sampling_config_t* config);
+bool sampling_parse_option(sampling_config_t* config, const char* option);
+
+// Runs from the current state of a loaded program
+bool sampling_run(simulator_t* sim, const sampling_config_t* config, sampling_result_t* result);
+bool sampling_profile_bbv(simulator_t* sim, const sampling_config_t* config);
+
+// Results
+void sampling_result_destroy(sampling_result_t* result);
+void sampling_print_result(const sampling_result_t* result, FILE* out);
+
+#endif // SAMPLING_H
@@ -2,28 +2,77 @@
 #define SIMULATOR_H
 
 #include "cpu/cpu_core.h"
+#include "cpu/jit.h"
+#include "memory/elf_loader.h"
+#include "utils/reverse.h"
+#include "utils/syscall.h"
 #include "trace.h"
 
+// Execution engines
+typedef enum {
+    EXEC_MODE_PIPELINE,             // Cycle-level 5-stage pipeline (default)
+    EXEC_MODE_FUNCTIONAL,           // Instruction-accurate interpreter
+    EXEC_MODE_JIT                   // Interpreter plus translated hot blocks
+} execution_mode_t;
+
+// Guest memory backends
+typedef enum {
+    MEMORY_BACKEND_BANKED,          // Fixed 64KB instruction and data banks (default)
+    MEMORY_BACKEND_SPARSE           // Full 32-bit space, committed on first touch
+} memory_backend_t;
+
+// Why the simulator last stopped
+typedef enum {
+    STOP_NONE,                      // Not run yet, or still running
+    STOP_EXIT,                      // exit system call or ECALL with break_on_ecall, exit code from a0
+    STOP_LIMIT,                     // max_cycles or max_instructions reached
+    STOP_BREAK,                     // EBREAK, single step or simulator_pause
+    STOP_FAULT                      // Illegal instruction or memory fault
+} stop_reason_t;
+
 // Simulator configuration
 typedef struct {
+    execution_mode_t execution_mode; // Execution engine used by simulator_run
+    memory_backend_t memory_backend; // Guest memory layout and access checking
     uint64_t max_cycles;            // Maximum cycles to simulate (0 = unlimited)
     uint32_t max_instructions;      // Maximum instructions (0 = unlimited)
     bool enable_tracing;            // Enable instruction tracing
+    const char* trace_file;         // Binary trace output (NULL = memory only)
+    uint32_t trace_ring_size;       // Records queued for the trace writer thread (0 = write inline)
+    trace_full_policy_t trace_full; // What a full queue does to the simulation
     bool enable_pipeline_debug;     // Enable pipeline state debugging
     bool single_step;               // Single-step execution mode
     bool break_on_ecall;            // Break execution on ECALL
+    bool syscalls;                  // ECALL is a Linux system call (overrides break_on_ecall)
     bool break_on_ebreak;           // Break execution on EBREAK
+    cache_config_t icache;          // L1 instruction cache (size 0 = none)
+    cache_config_t dcache;          // L1 data cache (size 0 = none)
+    branch_predictor_config_t predictor; // Pipeline front end (BP_STATIC = not taken)
+    const char* profile_json;       // Per-PC counters written by simulator_export_profile,
+    const char* profile_csv;        // either one enables profiling (NULL = off)
+    reverse_config_t reverse;       // History kept by simulator_interactive_mode
+    const char* gdb_listen;         // GDB server address (gdbstub.h), NULL = none
 } simulator_config_t;
 
 // Complete simulator state
 typedef struct {
     cpu_state_t cpu;                // CPU core
     execution_tracer_t tracer;      // Execution tracer
+    jit_state_t jit;                // Code cache for EXEC_MODE_JIT
+    elf_file_t program;             // Loaded executable and its symbols
+    cpu_snapshot_t snapshot;        // State saved by simulator_snapshot
+    uint32_t snapshot_break;        // Program break at the snapshot
+    bool image_kept;                // Memory as loaded is restored by simulator_reset
+    uint32_t image_entry;           // pc and program break right after the load
+    uint32_t image_break;
+    syscall_state_t syscalls;       // Emulated process, config.syscalls only
+    profile_t profile;              // Attached to the CPU when profiling
     simulator_config_t config;      // Configuration
 
     // Execution control
     bool running;                   // Simulator is running
     bool paused;                    // Execution is paused
+    stop_reason_t stop_reason;      // Why running last became false
     uint32_t exit_code;             // Program exit code
 
     // Performance metrics
@@ -32,6 +81,17 @@ typedef struct {
     double instructions_per_second; // IPS performance metric
 } simulator_t;
 
+// Configuration: defaults plus "key=value" options (mode, memory, max_cycles,
+// max_instructions, break_on_ecall, break_on_ebreak, syscalls, single_step, pipeline_debug,
+// trace_file, trace_ring, trace_full,
+// l1i_/l1d_ + size, ways, line, policy, hit_latency, miss_penalty, predictor,
+// bp_table_bits, bp_history_bits, bp_btb_bits, bp_ras_size, profile_json,
+// profile_csv, reverse_log, reverse_interval, reverse_checkpoints, and gdb)
+void simulator_default_config(simulator_config_t* config);
+bool simulator_parse_option(simulator_config_t* config, const char* option);
+const char* simulator_mode_name(execution_mode_t mode);
+const char* simulator_stop_reason_name(stop_reason_t reason);
+
 // Simulator lifecycle
 bool simulator_init(simulator_t* sim, const simulator_config_t* config);
 void simulator_destroy(simulator_t* sim);
@@ -40,17 +100,34 @@ void simulator_destroy(simulator_t* sim);
 bool simulator_load_program(simulator_t* sim, const char* filename);
 bool simulator_load_binary(simulator_t* sim, const uint32_t* program, size_t size);
 
-// Execution control
+// Execution control. simulator_reset goes back to the program as loaded: with
+// banked memory only the pages written since are rewritten and the program need
+// not be loaded again; sparse memory is cleared and needs a new load.
 void simulator_run(simulator_t* sim);
 void simulator_step(simulator_t* sim);
 void simulator_pause(simulator_t* sim);
 void simulator_reset(simulator_t* sim);
 
+// Run one engine until count more instructions retire or the program stops
+// (sim->running turns false), returns the instructions retired. The pipeline is
+// left full; pipeline_flush() drains it before switching engines.
+uint64_t simulator_advance(simulator_t* sim, execution_mode_t mode, uint64_t count);
+
+// Snapshots: save the CPU and guest memory once, e.g. after initialisation, then
+// restore it before each variant run. Taking a new snapshot or resetting drops it.
+bool simulator_snapshot(simulator_t* sim);
+bool simulator_restore(simulator_t* sim);
+
+// Write the per-PC counters to the configured files, callable at any point of a run
+bool simulator_export_profile(const simulator_t* sim);
+
 // Status and debugging
 void simulator_print_status(const simulator_t* sim);
 void simulator_print_performance_stats(const simulator_t* sim);
 
-// Interactive debugging
+// Interactive debugging: a command loop on stdin that steps the program in the
+// interpreter, whatever the execution mode, forward and, unless reverse_log=0,
+// backward (reverse.h). "help" lists the commands. Returns on quit or end of input.
 void simulator_interactive_mode(simulator_t* sim);
 
 #endif // SIMULATOR_H
@@ -0,0 +1,65 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "pipeline/timing.h"
+#include "utils/simulator.h"
+#include <stdio.h>
+
+/*
+ * Single-pass design-space sweep: one run of a program feeds its retired
+ * instructions to many timing models (timing.h) at once, each with its own
+ * caches, predictor and miss penalties. A 50-point sweep costs one execution
+ * plus 50 replays instead of 50 pipeline simulations.
+ *
+ * The simulation thread appends records to one broadcast ring through the
+ * tracer's sink. Worker threads own interleaved slices of the points; each takes
+ * a chunk of the ring at a time and runs it through every one of its models
+ * while the chunk is in cache, then releases it. The simulation only waits when
+ * the slowest worker is a whole ring behind.
+ *
+ * Points file: one configuration per line of simulator options applied over the
+ * base configuration (l1i_*, l1d_*, predictor, bp_*), '#' starts a comment:
+ *   l1d_size=8192 l1d_ways=4 predictor=gshare bp_table_bits=12
+ */
+
+#define SWEEP_MAX_LINE 1024
+#define SWEEP_DEFAULT_RING_SIZE 65536     // Records between the simulation and the workers
+
+// One configuration and its results
+typedef struct {
+  char* options;                  // Line of the points file, names the point
+  simulator_config_t config;
+  timing_model_t model;           // Results once sweep_run returns
+} sweep_point_t;
+
+typedef struct {
+  sweep_point_t* points;
+  size_t num_points;
+  size_t capacity;
+  const char* points_file;        // sweep_points option, loaded by the caller
+  size_t num_threads;             // Workers, 0 = one per host core
+  size_t ring_size;               // Records, power of two
+
+  // Last run
+  uint64_t records;               // Instructions fed to every model
+  uint64_t producer_waits;        // Times the simulation waited for the workers
+  double simulation_time_seconds;
+} sweep_t;
+
+// Lifecycle and "key=value" options (sweep_points, sweep_threads, sweep_ring)
+bool sweep_init(sweep_t* sweep);
+void sweep_destroy(sweep_t* sweep);
+bool sweep_parse_option(sweep_t* sweep, const char* option);
+
+// Points: from a file or one at a time, config starts from base and takes options
+bool sweep_add_point(sweep_t* sweep, const simulator_config_t* base, const char* options);
+bool sweep_load_points(sweep_t* sweep, const simulator_config_t* base, const char* filename);
+
+// Run the loaded program to the end and replay it in every point; sim must have
+// been initialised with enable_tracing
+bool sweep_run(sweep_t* sweep, simulator_t* sim);
+
+// One line per point: cycles, instructions, CPI, stalls and mispredictions
+void sweep_print_results(const sweep_t* sweep, FILE* out);
+
+#endif // SWEEP_H
@@ -0,0 +1,69 @@
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#include "cpu/cpu_core.h"
+
+/*
+ * Linux system call emulation for ECALL, RV32 ABI: number in a7, arguments in
+ * a0-a5, result or -errno in a0. Guest buffers are passed to the host calls in
+ * place (cpu_memory_span), never copied byte by byte. Console output (guest fds
+ * 1 and 2) collects in one buffer that is written out when it fills, when the
+ * other console fd or stdin is used, and when the simulator stops.
+ *
+ * The calls follow what newlib and picolibc expect from a proxy kernel: lseek
+ * takes (fd, offset, whence), fstat fills the 128-byte kernel_stat of libgloss
+ * and clock_gettime a timespec with 64-bit seconds. Other calls return -ENOSYS.
+ */
+
+// System call numbers (a7)
+#define SYS_OPENAT          56
+#define SYS_CLOSE           57
+#define SYS_LSEEK           62
+#define SYS_READ            63
+#define SYS_WRITE           64
+#define SYS_FSTAT           80
+#define SYS_EXIT            93
+#define SYS_EXIT_GROUP      94
+#define SYS_CLOCK_GETTIME   113
+#define SYS_BRK             214
+#define SYS_CLOCK_GETTIME64 403
+
+#define SYSCALL_MAX_FILES 64              // Guest file descriptors
+#define SYSCALL_OUTPUT_SIZE (64 * 1024)   // Console buffer
+
+// Emulated process state
+typedef struct {
+  int host_fds[SYSCALL_MAX_FILES]; // Guest fd -> host fd, -1 = closed; 0-2 start as the host's
+  uint32_t program_break;          // Current brk
+  uint32_t initial_break;          // brk never goes below it
+
+  // Console output not yet written
+  char* output;                    // SYSCALL_OUTPUT_SIZE bytes
+  size_t output_length;
+  int output_fd;                   // Host fd the buffered bytes go to
+
+  // Statistics
+  uint64_t calls;                  // ECALLs serviced
+  uint64_t bytes_read;
+  uint64_t bytes_written;          // Console and files
+  uint64_t console_writes;         // Host write() calls for the console
+} syscall_state_t;
+
+// Lifecycle: reset flushes the console, closes the guest's files and sets brk
+bool syscall_init(syscall_state_t* sys);
+void syscall_destroy(syscall_state_t* sys);
+void syscall_reset(syscall_state_t* sys, uint32_t program_break);
+
+// Service the ECALL that just retired, true if the program exited (code in exit_code)
+bool syscall_handle(syscall_state_t* sys, cpu_state_t* cpu, uint32_t* exit_code);
+
+// Guest memory the pending ECALL may write (read, fstat and clock_gettime
+// buffers), false if it writes none
+bool syscall_output_range(const cpu_state_t* cpu, uint32_t* address, uint32_t* length);
+
+// Write out buffered console output
+void syscall_flush(syscall_state_t* sys);
+
+void syscall_print_stats(const syscall_state_t* sys);
+
+#endif // SYSCALL_H
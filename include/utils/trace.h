@@ -4,7 +4,52 @@
 #include "cpu/cpu_core.h"
 #include <stdio.h>
 
-// Single trace entry
+/*
+ * Binary trace format (little-endian):
+ *   header    "RV32TRC1", uint32 version, uint32 keyframe interval
+ *   record    flags byte, raw instruction word, then the optional fields named by
+ *             the flags: PC delta from pc+4, cycle delta, rd + value, memory address
+ *             delta + data. Deltas are zigzag varints, values plain varints.
+ *   keyframe  TRACE_KEYFRAME_MARKER, record index, cycle, PC, last memory address and
+ *             the full register file as it is before the next record executes.
+ *   index     TRACE_INDEX_MARKER, keyframe count, keyframe file offsets, then the
+ *             index offset and "RV32TIDX". Written on close, rebuilt by scanning
+ *             when a trace was cut short.
+ * A typical record takes 6-12 bytes against more than 200 for a trace_entry_t.
+ *
+ * With a writer thread (tracer_start_writer) the simulation thread only copies
+ * each record into a single-producer/single-consumer ring; encoding and file
+ * writes happen on the writer. When the ring is full the policy decides: block
+ * until there is room, drop records while it is full, or sample (drop until
+ * it has drained to half). Dropped stretches leave gaps in the file that a
+ * keyframe closes, so record indices then count written records only.
+ */
+
+#define TRACE_FORMAT_VERSION 1
+#define TRACE_DEFAULT_CAPACITY 1024         // In-memory records for print_recent_trace
+#define TRACE_DEFAULT_KEYFRAME_INTERVAL 65536
+
+// Record flags
+#define TRACE_FLAG_PC_JUMP      0x01        // PC is not previous PC + 4
+#define TRACE_FLAG_CYCLES       0x02        // Cycle delta is not 1
+#define TRACE_FLAG_REG_WRITE    0x04        // rd and its new value follow
+#define TRACE_FLAG_MEM_ACCESS   0x08        // Memory address and data follow
+#define TRACE_FLAG_MEM_WRITE    0x10        // Access was a store
+#define TRACE_KEYFRAME_MARKER   0x80
+#define TRACE_INDEX_MARKER      0x81
+
+#define TRACE_DEFAULT_RING_SIZE 65536       // Records between the simulation and writer threads
+
+// What the simulation thread does when the writer falls behind
+typedef enum {
+  TRACE_FULL_BLOCK,               // Wait for room, the file is complete
+  TRACE_FULL_DROP,                // Drop records while the ring is full
+  TRACE_FULL_SAMPLE               // Drop until the ring is half empty, keeps long unbroken runs
+} trace_full_policy_t;
+
+typedef struct trace_ring trace_ring_t;
+
+// Single trace entry, reconstructed by trace_reader_next
 typedef struct {
   uint64_t cycle_number;          // Clock cycle when instruction completed
   uint32_t pc;                    // PC of instruction
@@ -30,9 +75,25 @@ typedef struct {
   uint32_t next_pc;               // Next PC after this instruction
 } trace_entry_t;
 
+// What one retired instruction did, the tracer's input
+typedef struct {
+  uint64_t cycle_number;          // Clock cycle when instruction completed
+  uint32_t pc;                    // PC of instruction
+  uint32_t instruction;           // Raw instruction word
+  uint32_t rd_value;              // Value written to rd
+  uint8_t rd;                     // Register written, 0 = none
+  bool memory_access;             // Load or store
+  bool memory_write;              // true=write, false=read
+  uint32_t memory_address;        // Effective address
+  uint32_t memory_data;           // Data loaded or stored
+} trace_record_t;
+
+// Consumer of every record, called on the simulation thread (e.g. timing models)
+typedef void (*trace_sink_t)(void* context, const trace_record_t* record);
+
 // Execution tracer
 typedef struct {
-  trace_entry_t* entries;         // Circular buffer of trace entries
+  trace_record_t* entries;        // Circular buffer of recent records
   size_t capacity;                // Maximum number of entries
   size_t count;                   // Current number of entries
   size_t write_index;             // Next write position
@@ -47,18 +108,74 @@ typedef struct {
   bool trace_memory_only;         // Only trace memory instructions
   uint32_t trace_start_pc;        // Start tracing from this PC
   uint32_t trace_end_pc;          // Stop tracing at this PC
+
+  // Binary writer state
+  uint32_t keyframe_interval;     // Records between keyframes
+  uint32_t registers[NUM_REGISTERS]; // Register file as of the last record
+  uint32_t last_pc;               // PC of the last record
+  uint32_t last_memory_address;   // Base of the next memory address delta
+  uint64_t last_cycle;            // Cycle of the last record
+  uint64_t* keyframe_offsets;     // File offset of every keyframe
+  size_t num_keyframes;
+  size_t keyframe_capacity;
+  uint64_t next_keyframe;         // Record index that gets the next keyframe
+  uint64_t records_written;       // Records in the file
+  uint64_t bytes_written;         // File size so far
+  uint64_t records_seen;          // Records passed to the tracer
+  bool keyframe_pending;          // The file has no keyframe yet
+
+  // Asynchronous output, NULL = records are written on the simulation thread
+  trace_ring_t* ring;
+
+  // Optional record consumer, NULL = none
+  trace_sink_t sink;
+  void* sink_context;
 } execution_tracer_t;
 
+// Sequential / random-access trace reader
+typedef struct {
+  FILE* file;
+  uint32_t keyframe_interval;
+  uint64_t* keyframe_offsets;     // From the index, or rebuilt by scanning
+  size_t num_keyframes;
+
+  // Decode state
+  uint64_t record_index;          // Index of the next record
+  uint64_t cycle_number;
+  uint32_t pc;
+  uint32_t memory_address;
+  uint32_t registers[NUM_REGISTERS];
+
+  // One record of lookahead, it supplies next_pc
+  trace_entry_t lookahead;
+  bool has_lookahead;
+} trace_reader_t;
+
 // Tracer management
 bool tracer_init(execution_tracer_t* tracer, size_t capacity);
 void tracer_destroy(execution_tracer_t* tracer);
 void tracer_set_file_output(execution_tracer_t* tracer, const char* filename);
+void tracer_sync(execution_tracer_t* tracer, const cpu_state_t* cpu);
+void tracer_set_sink(execution_tracer_t* tracer, trace_sink_t sink, void* context);
+
+// Move file output to a writer thread fed by a ring of ring_size records (power of
+// two); flush waits until the writer has caught up, so the file and counters are current
+bool tracer_start_writer(execution_tracer_t* tracer, size_t ring_size, trace_full_policy_t policy);
+void tracer_flush(execution_tracer_t* tracer);
 
 // Tracing functions
-void trace_instruction_execution(execution_tracer_t* tracer, const cpu_state_t* cpu, const instruction_t* instruction, uint32_t result_data);
+void trace_instruction_execution(execution_tracer_t* tracer, const trace_record_t* record);
 void print_trace_summary(const execution_tracer_t* tracer);
 void print_recent_trace(const execution_tracer_t* tracer, size_t num_entries);
 
+// Trace reading
+bool trace_reader_open(trace_reader_t* reader, const char* filename);
+void trace_reader_close(trace_reader_t* reader);
+bool trace_reader_next(trace_reader_t* reader, trace_entry_t* entry);
+bool trace_reader_next_record(trace_reader_t* reader, trace_record_t* record);   // No decode, registers
+                                                                                 // or next_pc: for replay
+bool trace_reader_seek(trace_reader_t* reader, uint64_t record_index);
+
 // Debug support
 void debug_print_pipeline_contents(const cpu_state_t* cpu);
 void debug_print_hazard_status(const cpu_state_t* cpu);
@@ -1 +1,64 @@
+#include "cpu/alu.h"
+#include <stdint.h>
+#include <stdio.h>
 
+//===========================================================================================
+//                                ALU OPERATIONS
+//===========================================================================================
+
+alu_result_t alu_execute(alu_operation_t operation, uint32_t a, uint32_t b){
+  alu_result_t res = {0};
+  if ((unsigned) operation > ALU_COPY_B){
+    fprintf(stderr, "Error: Unknown ALU operation %d in alu_execute.\n", operation);
+  }
+
+  res.result = alu_compute(operation, a, b);
+  res.zero = res.result == 0;
+  res.negative = res.result >> 31;
+
+  // Carry and overflow only exist for the adder
+  if (operation == ALU_ADD){
+    res.carry_out = res.result < a;
+    res.overflow = (~(a ^ b) & (a ^ res.result)) >> 31;
+  }
+  else if (operation == ALU_SUB){
+    res.carry_out = a >= b;   // No borrow
+    res.overflow = ((a ^ b) & (a ^ res.result)) >> 31;
+  }
+  return res;
+}
+
+//===========================================================================================
+//                                BRANCH EVALUATION
+//===========================================================================================
+
+bool evaluate_branch_condition(uint8_t funct3, uint32_t rs1_data, uint32_t rs2_data){
+  switch (funct3){
+    case FUNCT3_BEQ:  return rs1_data == rs2_data;
+    case FUNCT3_BNE:  return rs1_data != rs2_data;
+    case FUNCT3_BLT:  return (int32_t) rs1_data < (int32_t) rs2_data;
+    case FUNCT3_BGE:  return (int32_t) rs1_data >= (int32_t) rs2_data;
+    case FUNCT3_BLTU: return rs1_data < rs2_data;
+    case FUNCT3_BGEU: return rs1_data >= rs2_data;
+  }
+  return false;
+}
+
+//===========================================================================================
+//                                ADDRESS CALCULATIONS
+//===========================================================================================
+
+uint32_t calculate_branch_target(uint32_t pc, int32_t immediate){
+  return pc + (uint32_t) immediate;
+}
+
+
+uint32_t calculate_jump_target(uint32_t pc, int32_t immediate){
+  return pc + (uint32_t) immediate;
+}
+
+
+uint32_t calculate_jump_register_target(uint32_t rs1_data, int32_t immediate){
+  // Least significant bit is cleared (RV32I spec)
+  return (rs1_data + (uint32_t) immediate) & ~1u;
+}
@@ -0,0 +1,417 @@
+#include "cpu/branch_predictor.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const predictor_names[] = {
+  [BP_STATIC] = "static",
+  [BP_BIMODAL] = "bimodal",
+  [BP_GSHARE] = "gshare",
+  [BP_TAGE] = "tage"
+};
+
+// History lengths of the tagged tables, shortest first
+static const uint32_t tage_history_lengths[BP_TAGE_TABLES] = { 5, 12, 28, 64 };
+
+#define TAGE_AGING_PERIOD (1u << 18)
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static inline bool is_power_of_two(uint32_t value){
+  return value && !(value & (value - 1));
+}
+
+
+static inline uint32_t low_mask(uint32_t bits){
+  return bits >= 32 ? UINT32_MAX : (1u << bits) - 1;
+}
+
+
+// XOR of the newest length history bits, in chunks of bits
+static inline uint32_t fold_history(uint64_t history, uint32_t length, uint32_t bits){
+  if (length < 64) history &= (1ull << length) - 1;
+  uint32_t folded = 0;
+  for (; history; history >>= bits) folded ^= (uint32_t) history;
+  return folded & low_mask(bits);
+}
+
+
+static inline void train_counter(uint8_t* counter, bool taken){
+  if (taken && *counter < 3) (*counter)++;
+  else if (!taken && *counter > 0) (*counter)--;
+}
+
+
+static inline uint32_t tage_index(const branch_predictor_t* bp, uint32_t table, uint32_t pc, uint64_t history){
+  uint32_t bits = bp->tage_bits;
+  uint32_t word = pc >> 2;
+  uint32_t index = word ^ (word >> bits) ^ fold_history(history, tage_history_lengths[table], bits);
+  return (table << bits) | (index & low_mask(bits));
+}
+
+
+static inline uint16_t tage_tag(uint32_t table, uint32_t pc, uint64_t history){
+  uint32_t length = tage_history_lengths[table];
+  uint32_t tag = (pc >> 2) ^ fold_history(history, length, BP_TAGE_TAG_BITS)
+               ^ (fold_history(history, length, BP_TAGE_TAG_BITS - 1) << 1);
+  return (uint16_t) (tag & low_mask(BP_TAGE_TAG_BITS));
+}
+
+
+// Longest tagged table matching pc, -1 if none; entries of all tables in index
+static int tage_provider(const branch_predictor_t* bp, uint32_t pc, uint64_t history, uint32_t index[BP_TAGE_TABLES]){
+  int provider = -1;
+  for (uint32_t table = 0; table < BP_TAGE_TABLES; ++table){
+    index[table] = tage_index(bp, table, pc, history);
+    if (bp->tage_tags[index[table]] == tage_tag(table, pc, history)) provider = (int) table;
+  }
+  return provider;
+}
+
+
+static inline uint32_t base_index(const branch_predictor_t* bp, uint32_t pc, uint64_t history){
+  uint32_t index = pc >> 2;
+  if (bp->config.type == BP_GSHARE) index ^= (uint32_t) history & low_mask(bp->config.history_bits);
+  return index & low_mask(bp->config.table_bits);
+}
+
+
+static bool predict_direction(const branch_predictor_t* bp, uint32_t pc, uint64_t history){
+  if (bp->config.type == BP_TAGE){
+    uint32_t index[BP_TAGE_TABLES];
+    int provider = tage_provider(bp, pc, history, index);
+    if (provider >= 0) return bp->tage_counters[index[provider]] >= 0;
+  }
+  return bp->counters[base_index(bp, pc, history)] >= 2;
+}
+
+
+static void train_tage(branch_predictor_t* bp, uint32_t pc, uint64_t history, bool taken){
+  uint32_t index[BP_TAGE_TABLES];
+  int provider = tage_provider(bp, pc, history, index);
+  uint8_t* base = &bp->counters[base_index(bp, pc, history)];
+
+  // Alternate prediction: next shorter match, else the base counter
+  bool alternate = *base >= 2;
+  for (int table = provider - 1; table >= 0; --table){
+    if (bp->tage_tags[index[table]] == tage_tag((uint32_t) table, pc, history)){
+      alternate = bp->tage_counters[index[table]] >= 0;
+      break;
+    }
+  }
+
+  bool predicted = alternate;
+  if (provider >= 0){
+    int8_t* counter = &bp->tage_counters[index[provider]];
+    uint8_t* useful = &bp->tage_useful[index[provider]];
+    predicted = *counter >= 0;
+    if (predicted != alternate){
+      if (predicted == taken && *useful < 3) (*useful)++;
+      else if (predicted != taken && *useful > 0) (*useful)--;
+    }
+    if (taken && *counter < 3) (*counter)++;
+    else if (!taken && *counter > -4) (*counter)--;
+  }
+  else {
+    train_counter(base, taken);
+  }
+
+  // Wrong: claim an entry with a longer history, or age the candidates
+  if (predicted != taken && provider < BP_TAGE_TABLES - 1){
+    bool allocated = false;
+    for (uint32_t table = (uint32_t) (provider + 1); table < BP_TAGE_TABLES && !allocated; ++table){
+      if (bp->tage_useful[index[table]] != 0) continue;
+      bp->tage_tags[index[table]] = tage_tag(table, pc, history);
+      bp->tage_counters[index[table]] = taken ? 0 : -1;
+      allocated = true;
+    }
+    for (uint32_t table = (uint32_t) (provider + 1); table < BP_TAGE_TABLES && !allocated; ++table){
+      bp->tage_useful[index[table]]--;
+    }
+  }
+
+  // Periodic aging so stale entries become replaceable
+  if (++bp->tage_updates == TAGE_AGING_PERIOD){
+    bp->tage_updates = 0;
+    size_t entries = (size_t) BP_TAGE_TABLES << bp->tage_bits;
+    for (size_t i = 0; i < entries; ++i) bp->tage_useful[i] >>= 1;
+  }
+}
+
+
+static inline void ras_push(branch_predictor_t* bp, uint32_t address){
+  bp->ras_top = (uint16_t) ((bp->ras_top + 1) & (bp->config.ras_size - 1));
+  bp->ras[bp->ras_top] = address;
+}
+
+
+static inline uint32_t ras_pop(branch_predictor_t* bp){
+  uint32_t address = bp->ras[bp->ras_top];
+  bp->ras_top = (uint16_t) ((bp->ras_top - 1) & (bp->config.ras_size - 1));
+  return address;
+}
+
+//===========================================================================================
+//                                PREDICTOR LIFECYCLE
+//===========================================================================================
+
+bool branch_predictor_init(branch_predictor_t* bp, const branch_predictor_config_t* config){
+  if (!bp || !config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in branch_predictor_init.\n");
+    return false;
+  }
+
+  memset(bp, 0, sizeof(branch_predictor_t));
+  bp->config = *config;
+  if (config->type == BP_STATIC) return true;   // Nothing to look up
+
+  if (config->table_bits < 4 || config->table_bits > 24 || config->history_bits > config->table_bits ||
+      config->btb_bits > 20 || !is_power_of_two(config->ras_size) || config->ras_size > UINT16_MAX){
+    fprintf(stderr, "Error: Invalid geometry %u table bits / %u history bits / %u BTB bits / %u RAS entries in branch_predictor_init.\n",
+            config->table_bits, config->history_bits, config->btb_bits, config->ras_size);
+    return false;
+  }
+
+  size_t btb_entries = (size_t) 1 << config->btb_bits;
+  bp->counters = (uint8_t *) malloc((size_t) 1 << config->table_bits);
+  bp->btb_pcs = (uint32_t *) malloc(btb_entries * sizeof(uint32_t));
+  bp->btb_targets = (uint32_t *) malloc(btb_entries * sizeof(uint32_t));
+  bp->btb_kinds = (uint8_t *) malloc(btb_entries * sizeof(uint8_t));
+  bp->ras = (uint32_t *) malloc(config->ras_size * sizeof(uint32_t));
+  bool allocated = bp->counters && bp->btb_pcs && bp->btb_targets && bp->btb_kinds && bp->ras;
+
+  if (allocated && config->type == BP_TAGE){
+    bp->tage_bits = config->table_bits - 2;
+    size_t entries = (size_t) BP_TAGE_TABLES << bp->tage_bits;
+    bp->tage_tags = (uint16_t *) malloc(entries * sizeof(uint16_t));
+    bp->tage_counters = (int8_t *) malloc(entries * sizeof(int8_t));
+    bp->tage_useful = (uint8_t *) malloc(entries * sizeof(uint8_t));
+    allocated = bp->tage_tags && bp->tage_counters && bp->tage_useful;
+  }
+  if (!allocated){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in branch_predictor_init.\n");
+    branch_predictor_destroy(bp);
+    return false;
+  }
+
+  branch_predictor_reset(bp);
+  return true;
+}
+
+
+void branch_predictor_destroy(branch_predictor_t* bp){
+  if (!bp){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in branch_predictor_destroy.\n");
+    return;
+  }
+
+  free(bp->counters);
+  free(bp->tage_tags);
+  free(bp->tage_counters);
+  free(bp->tage_useful);
+  free(bp->btb_pcs);
+  free(bp->btb_targets);
+  free(bp->btb_kinds);
+  free(bp->ras);
+  bp->counters = NULL;
+  bp->tage_tags = NULL;
+  bp->tage_counters = NULL;
+  bp->tage_useful = NULL;
+  bp->btb_pcs = NULL;
+  bp->btb_targets = NULL;
+  bp->btb_kinds = NULL;
+  bp->ras = NULL;
+}
+
+
+void branch_predictor_reset(branch_predictor_t* bp){
+  if (!bp){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in branch_predictor_reset.\n");
+    return;
+  }
+
+  if (bp->counters){
+    size_t btb_entries = (size_t) 1 << bp->config.btb_bits;
+    memset(bp->counters, 1, (size_t) 1 << bp->config.table_bits);   // Weakly not taken
+    memset(bp->btb_pcs, 0xFF, btb_entries * sizeof(uint32_t));     // BP_INVALID_PC
+    memset(bp->btb_targets, 0, btb_entries * sizeof(uint32_t));
+    memset(bp->btb_kinds, 0, btb_entries * sizeof(uint8_t));
+    memset(bp->ras, 0, bp->config.ras_size * sizeof(uint32_t));
+  }
+  if (bp->tage_tags){
+    size_t entries = (size_t) BP_TAGE_TABLES << bp->tage_bits;
+    memset(bp->tage_tags, 0xFF, entries * sizeof(uint16_t));       // Wider than any tag
+    memset(bp->tage_counters, 0, entries * sizeof(int8_t));
+    memset(bp->tage_useful, 0, entries * sizeof(uint8_t));
+  }
+  bp->history = 0;
+  bp->tage_updates = 0;
+  bp->ras_top = 0;
+  bp->btb_hits = 0;
+  bp->btb_misses = 0;
+  bp->target_mispredictions = 0;
+}
+
+
+// Tables and statistics, the destination is reallocated if the geometry differs
+bool branch_predictor_copy(branch_predictor_t* destination, const branch_predictor_t* source){
+  if (!destination || !source){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in branch_predictor_copy.\n");
+    return false;
+  }
+
+  if (memcmp(&destination->config, &source->config, sizeof(branch_predictor_config_t)) != 0 ||
+      !destination->counters != !source->counters){
+    branch_predictor_destroy(destination);
+    if (!branch_predictor_init(destination, &source->config)) return false;
+  }
+
+  branch_predictor_t tables = *destination;
+  *destination = *source;
+  destination->counters = tables.counters;
+  destination->tage_tags = tables.tage_tags;
+  destination->tage_counters = tables.tage_counters;
+  destination->tage_useful = tables.tage_useful;
+  destination->btb_pcs = tables.btb_pcs;
+  destination->btb_targets = tables.btb_targets;
+  destination->btb_kinds = tables.btb_kinds;
+  destination->ras = tables.ras;
+
+  if (source->counters){
+    size_t btb_entries = (size_t) 1 << source->config.btb_bits;
+    memcpy(destination->counters, source->counters, (size_t) 1 << source->config.table_bits);
+    memcpy(destination->btb_pcs, source->btb_pcs, btb_entries * sizeof(uint32_t));
+    memcpy(destination->btb_targets, source->btb_targets, btb_entries * sizeof(uint32_t));
+    memcpy(destination->btb_kinds, source->btb_kinds, btb_entries * sizeof(uint8_t));
+    memcpy(destination->ras, source->ras, source->config.ras_size * sizeof(uint32_t));
+  }
+  if (source->tage_tags){
+    size_t entries = (size_t) BP_TAGE_TABLES << source->tage_bits;
+    memcpy(destination->tage_tags, source->tage_tags, entries * sizeof(uint16_t));
+    memcpy(destination->tage_counters, source->tage_counters, entries * sizeof(int8_t));
+    memcpy(destination->tage_useful, source->tage_useful, entries * sizeof(uint8_t));
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                PREDICTION
+//===========================================================================================
+
+uint32_t branch_predict(branch_predictor_t* bp, uint32_t pc, branch_prediction_t* prediction){
+  uint32_t next_pc = pc + 4;
+
+  if (bp->counters){
+    prediction->history = bp->history;
+    prediction->ras_top = bp->ras_top;
+    prediction->ras_value = bp->ras[bp->ras_top];
+
+    uint32_t entry = (pc >> 2) & low_mask(bp->config.btb_bits);
+    if (bp->btb_pcs[entry] != pc){
+      bp->btb_misses++;
+    }
+    else {
+      bp->btb_hits++;
+      switch ((branch_kind_t) bp->btb_kinds[entry]){
+        case BRANCH_KIND_CONDITIONAL:
+          if (predict_direction(bp, pc, bp->history)) next_pc = bp->btb_targets[entry];
+          break;
+        case BRANCH_KIND_JUMP:
+          next_pc = bp->btb_targets[entry];
+          break;
+        case BRANCH_KIND_CALL:
+          ras_push(bp, pc + 4);
+          next_pc = bp->btb_targets[entry];
+          break;
+        case BRANCH_KIND_RETURN:
+          next_pc = ras_pop(bp);
+          break;
+      }
+    }
+  }
+
+  prediction->next_pc = next_pc;
+  return next_pc;
+}
+
+
+bool branch_resolve(branch_predictor_t* bp, uint32_t pc, const branch_prediction_t* prediction,
+                    branch_kind_t kind, bool taken, uint32_t target){
+  uint32_t next_pc = taken ? target : pc + 4;
+  bool mispredicted = next_pc != prediction->next_pc;
+  if (mispredicted && kind != BRANCH_KIND_CONDITIONAL) bp->target_mispredictions++;
+  if (!bp->counters) return mispredicted;
+
+  if (kind == BRANCH_KIND_CONDITIONAL){
+    if (bp->config.type == BP_TAGE) train_tage(bp, pc, prediction->history, taken);
+    else train_counter(&bp->counters[base_index(bp, pc, prediction->history)], taken);
+    bp->history = (bp->history << 1) | taken;
+  }
+
+  // Taken transfers enter the BTB, a return takes its target from the stack
+  if (taken){
+    uint32_t entry = (pc >> 2) & low_mask(bp->config.btb_bits);
+    bp->btb_pcs[entry] = pc;
+    bp->btb_targets[entry] = target;
+    bp->btb_kinds[entry] = (uint8_t) kind;
+  }
+
+  // Wrong path may have pushed or popped: back to the state at this fetch, then its own effect
+  if (mispredicted){
+    branch_squash(bp, prediction);
+    if (kind == BRANCH_KIND_CALL) ras_push(bp, pc + 4);
+    else if (kind == BRANCH_KIND_RETURN) ras_pop(bp);
+  }
+  return mispredicted;
+}
+
+
+void branch_squash(branch_predictor_t* bp, const branch_prediction_t* prediction){
+  if (!bp->counters) return;
+  bp->ras_top = prediction->ras_top;
+  bp->ras[bp->ras_top] = prediction->ras_value;
+}
+
+
+void branch_forget(branch_predictor_t* bp, uint32_t pc, const branch_prediction_t* prediction){
+  if (!bp->counters) return;
+  uint32_t entry = (pc >> 2) & low_mask(bp->config.btb_bits);
+  if (bp->btb_pcs[entry] == pc) bp->btb_pcs[entry] = BP_INVALID_PC;
+  branch_squash(bp, prediction);
+}
+
+//===========================================================================================
+//                                CONFIGURATION AND STATISTICS
+//===========================================================================================
+
+const char* branch_predictor_name(branch_predictor_type_t type){
+  return (size_t) type < sizeof(predictor_names) / sizeof(predictor_names[0]) ? predictor_names[type] : "unknown";
+}
+
+
+bool branch_predictor_find_type(const char* name, branch_predictor_type_t* type){
+  for (size_t i = 0; i < sizeof(predictor_names) / sizeof(predictor_names[0]); ++i){
+    if (strcmp(predictor_names[i], name) == 0){
+      *type = (branch_predictor_type_t) i;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void branch_predictor_print_stats(const branch_predictor_t* bp){
+  if (!bp){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in branch_predictor_print_stats.\n");
+    return;
+  }
+
+  uint64_t lookups = bp->btb_hits + bp->btb_misses;
+  double hit_rate = lookups ? 100.0 * (double) bp->btb_hits / (double) lookups : 0.0;
+  printf("BRANCH PREDICTOR       --- %s\n", branch_predictor_name(bp->config.type));
+  printf("BTB HIT RATE           --- %.2f%%\n", hit_rate);
+  printf("JUMP MISPREDICTIONS    --- %lu\n", bp->target_mispredictions);
+}
@@ -1,5 +1,7 @@
 #include "cpu/cpu_core.h"
+#include "memory/memory.h"
 #include "utils/defs.h"
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,10 +21,16 @@ bool memory_init(memory_bank_t *memory, size_t size, uint32_t base_addr){
   memory->size = size;
   memory->base_address = base_addr;
 
-  // Memory allocation
+  // Memory allocation, each page can be dirty once between resets
+  size_t num_pages = (size + MEMORY_PAGE_SIZE - 1) >> MEMORY_PAGE_SHIFT;
   memory->data = (uint8_t *) calloc(size, sizeof(uint8_t));
-  if(!memory->data){ // Error Check
+  memory->page_flags = (uint8_t *) calloc(num_pages, sizeof(uint8_t));
+  memory->dirty_pages = (uint32_t *) malloc(num_pages * sizeof(uint32_t));
+  memory->num_dirty_pages = 0;
+  memory->image = NULL;
+  if(!memory->data || !memory->page_flags || !memory->dirty_pages){ // Error Check
     fprintf(stderr, "Error: Memory allocation error in memory_init.\n");
+    memory_destroy(memory);
     return false;
   }
 
@@ -37,10 +45,319 @@ void memory_destroy(memory_bank_t *memory){
   }
 
   // Free allocated memory
+  memory_untrack(memory);
   free(memory->data);
   memory->data = NULL; // Set memory to null
 }
 
+
+bool cpu_memory_init(cpu_state_t *cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_memory_init.\n");
+    return false;
+  }
+
+  if (!memory_init(&cpu->instruction_memory, INSTRUCTION_MEMORY_SIZE, INSTRUCTION_MEMORY_BASE) ||
+      !memory_init(&cpu->data_memory, DATA_MEMORY_SIZE, DATA_MEMORY_BASE) ||
+      !predecode_init(&cpu->predecode, INSTRUCTION_MEMORY_BASE, INSTRUCTION_MEMORY_SIZE)){
+    cpu_memory_destroy(cpu);
+    return false;
+  }
+
+  return true;
+}
+
+
+// Whole 32-bit space reserved, the banks become views of its default regions
+bool cpu_memory_init_sparse(cpu_state_t *cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_memory_init_sparse.\n");
+    return false;
+  }
+
+  if (!sparse_memory_init(&cpu->sparse)) return false;
+  cpu->instruction_memory = (memory_bank_t) {
+    .data = cpu->sparse.base + INSTRUCTION_MEMORY_BASE,
+    .size = SPARSE_INSTRUCTION_MEMORY_SIZE,
+    .base_address = INSTRUCTION_MEMORY_BASE
+  };
+  cpu->data_memory = (memory_bank_t) {
+    .data = cpu->sparse.base + DATA_MEMORY_BASE,
+    .size = SPARSE_DATA_MEMORY_SIZE,
+    .base_address = DATA_MEMORY_BASE
+  };
+
+  // Code may be mapped anywhere, the predecode cache covers the whole space
+  if (!sparse_memory_map(&cpu->sparse, INSTRUCTION_MEMORY_BASE, SPARSE_INSTRUCTION_MEMORY_SIZE) ||
+      !sparse_memory_map(&cpu->sparse, DATA_MEMORY_BASE, SPARSE_DATA_MEMORY_SIZE) ||
+      !predecode_init(&cpu->predecode, 0, (size_t) GUEST_NUM_PAGES << GUEST_PAGE_SHIFT)){
+    cpu_memory_destroy(cpu);
+    return false;
+  }
+
+  return true;
+}
+
+
+void cpu_memory_destroy(cpu_state_t *cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_memory_destroy.\n");
+    return;
+  }
+
+  predecode_destroy(&cpu->predecode);
+  if (cpu->shared_memory){
+    // The owner frees the banks
+    memset(&cpu->instruction_memory, 0, sizeof(memory_bank_t));
+    memset(&cpu->data_memory, 0, sizeof(memory_bank_t));
+    cpu->shared_memory = false;
+    return;
+  }
+  if (cpu->sparse.base){
+    // Banks are views into the reservation
+    sparse_memory_destroy(&cpu->sparse);
+    memset(&cpu->instruction_memory, 0, sizeof(memory_bank_t));
+    memset(&cpu->data_memory, 0, sizeof(memory_bank_t));
+    return;
+  }
+  memory_destroy(&cpu->data_memory);
+  memory_destroy(&cpu->instruction_memory);
+}
+
+
+// Banked memory only: the sparse fault handler tracks one reservation per CPU
+bool cpu_memory_share(cpu_state_t *cpu, cpu_state_t* owner){
+  if (!cpu || !owner){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_memory_share.\n");
+    return false;
+  }
+  if (cpu->sparse.base || owner->sparse.base || !owner->instruction_memory.data){
+    fprintf(stderr, "Error: Only banked memory can be shared in cpu_memory_share.\n");
+    return false;
+  }
+
+  // Own banks go, the predecode cache stays private. Writes of the other CPUs
+  // are not tracked, the owner resets its banks in full from now on.
+  if (!cpu->shared_memory){
+    memory_destroy(&cpu->data_memory);
+    memory_destroy(&cpu->instruction_memory);
+  }
+  memory_untrack(&owner->instruction_memory);
+  memory_untrack(&owner->data_memory);
+  cpu->instruction_memory = owner->instruction_memory;
+  cpu->data_memory = owner->data_memory;
+  cpu->shared_memory = true;
+  predecode_invalidate_all(&cpu->predecode);
+  return true;
+}
+
+
+// Replaces both caches, a size 0 configuration disables one
+bool cpu_cache_init(cpu_state_t *cpu, const cache_config_t* icache, const cache_config_t* dcache){
+  if (!cpu || !icache || !dcache){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_cache_init.\n");
+    return false;
+  }
+
+  cpu_cache_destroy(cpu);
+  if (!cache_init(&cpu->icache, icache) || !cache_init(&cpu->dcache, dcache)){
+    cpu_cache_destroy(cpu);
+    return false;
+  }
+  return true;
+}
+
+
+void cpu_cache_destroy(cpu_state_t *cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_cache_destroy.\n");
+    return;
+  }
+
+  cache_destroy(&cpu->icache);
+  cache_destroy(&cpu->dcache);
+}
+
+//===========================================================================================
+//                                CPU MEMORY ACCESS
+//===========================================================================================
+
+memory_bank_t* cpu_select_memory_bank(cpu_state_t *cpu, uint32_t address){
+  // Data memory first, it serves nearly all loads and stores
+  if (address - cpu->data_memory.base_address < cpu->data_memory.size) return &cpu->data_memory;
+  if (address - cpu->instruction_memory.base_address < cpu->instruction_memory.size) return &cpu->instruction_memory;
+  return NULL;
+}
+
+
+// Sparse memory: access first, unmapped pages are caught by the fault handler
+static uint32_t cpu_sparse_fault(cpu_state_t *cpu, const char* access){
+  uint32_t address = sparse_memory_take_fault(&cpu->sparse);
+  fprintf(stderr, "Error: %s unmapped address 0x%08x.\n", access, address);
+  cpu->pending_event = CPU_EVENT_MEMORY_FAULT;
+  return 0;
+}
+
+
+uint32_t cpu_memory_load(cpu_state_t *cpu, uint32_t address, memory_size_t size, bool unsigned_load){
+  if (cpu->sparse.base){
+    uint32_t value = sparse_memory_load(&cpu->sparse, address, size, unsigned_load);
+    return sparse_memory_faulted(&cpu->sparse) ? cpu_sparse_fault(cpu, "Load from") : value;
+  }
+
+  memory_bank_t* bank = cpu_select_memory_bank(cpu, address);
+  if (!bank || !memory_address_valid(bank, address, size)){
+    fprintf(stderr, "Error: Load from unmapped address 0x%08x.\n", address);
+    cpu->pending_event = CPU_EVENT_MEMORY_FAULT;
+    return 0;
+  }
+  return memory_load(bank, address, size, unsigned_load);
+}
+
+
+void cpu_memory_store(cpu_state_t *cpu, uint32_t address, uint32_t data, memory_size_t size){
+  if (cpu->sparse.base){
+    sparse_memory_store(&cpu->sparse, address, data, size);
+    if (sparse_memory_faulted(&cpu->sparse)){
+      cpu_sparse_fault(cpu, "Store to");
+      return;
+    }
+    predecode_invalidate(&cpu->predecode, address);   // No-op outside cached code pages
+    return;
+  }
+
+  memory_bank_t* bank = cpu_select_memory_bank(cpu, address);
+  if (!bank || !memory_address_valid(bank, address, size)){
+    fprintf(stderr, "Error: Store to unmapped address 0x%08x.\n", address);
+    cpu->pending_event = CPU_EVENT_MEMORY_FAULT;
+    return;
+  }
+  memory_store(bank, address, data, size);
+
+  // Self-modifying code: drop stale decodes of the written page
+  if (bank == &cpu->instruction_memory) predecode_invalidate(&cpu->predecode, address);
+}
+
+
+// Raw instruction word at pc, 0 (an illegal instruction) outside executable memory
+uint32_t cpu_fetch_instruction(cpu_state_t* cpu, uint32_t pc){
+  if (cpu->sparse.base){
+    if (!sparse_memory_is_mapped(&cpu->sparse, pc, 4)) return 0;
+    return sparse_memory_load(&cpu->sparse, pc, MEM_SIZE_WORD, true);
+  }
+  return memory_address_valid(&cpu->instruction_memory, pc, MEM_SIZE_WORD)
+       ? memory_load_word(&cpu->instruction_memory, pc)
+       : 0;
+}
+
+
+const predecoded_instruction_t* cpu_fetch_decoded(cpu_state_t* cpu, uint32_t pc){
+  const predecoded_instruction_t* entry = predecode_lookup(&cpu->predecode, pc);
+  if (entry) return entry;
+
+  // A breakpoint decodes as an illegal instruction: every engine stops in front of it
+  bool breakpoint = cpu->debug && debug_breakpoint_at(cpu->debug, pc);
+  return predecode_insert(&cpu->predecode, pc, breakpoint ? 0 : cpu_fetch_instruction(cpu, pc));
+}
+
+// Stale decodes of a range written behind the CPU's back
+static void cpu_invalidate_range(cpu_state_t* cpu, uint32_t address, size_t size){
+  uint64_t end = (uint64_t) address + size;
+  for (uint64_t page = address & ~(uint64_t) (PREDECODE_PAGE_SIZE - 1); page < end; page += PREDECODE_PAGE_SIZE){
+    predecode_invalidate(&cpu->predecode, (uint32_t) page);
+  }
+}
+
+
+void cpu_fence(cpu_state_t* cpu){
+  atomic_thread_fence(memory_order_seq_cst);
+  predecode_invalidate_all(&cpu->predecode);
+}
+
+//===========================================================================================
+//                                DEBUGGER MARKS
+//===========================================================================================
+
+void cpu_debug_attach(cpu_state_t* cpu, debug_marks_t* marks){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_debug_attach.\n");
+    return;
+  }
+
+  // Breakpoints of the old marks may be cached as illegal instructions and the
+  // new ones may not be
+  predecode_invalidate_all(&cpu->predecode);
+  cpu->debug = marks;
+  cpu->watch_pages = marks && marks->num_watchpoints ? marks->page_flags : NULL;
+}
+
+
+bool cpu_set_breakpoint(cpu_state_t* cpu, uint32_t address, bool enable){
+  if (!cpu || !cpu->debug){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_set_breakpoint.\n");
+    return false;
+  }
+
+  bool changed = enable ? debug_add_breakpoint(cpu->debug, address) : debug_remove_breakpoint(cpu->debug, address);
+  if (changed) predecode_invalidate(&cpu->predecode, address);
+  return changed;
+}
+
+
+bool cpu_set_watchpoint(cpu_state_t* cpu, uint32_t address, uint32_t length, bool enable){
+  if (!cpu || !cpu->debug){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_set_watchpoint.\n");
+    return false;
+  }
+
+  bool changed = enable ? debug_add_watchpoint(cpu->debug, address, length)
+                        : debug_remove_watchpoint(cpu->debug, address, length);
+  cpu->watch_pages = cpu->debug->num_watchpoints ? cpu->debug->page_flags : NULL;
+  return changed;
+}
+
+
+bool cpu_breakpoint_hit(const cpu_state_t* cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_breakpoint_hit.\n");
+    return false;
+  }
+  return cpu->debug && debug_breakpoint_at(cpu->debug, cpu->pc);
+}
+
+
+void cpu_watch_store(cpu_state_t* cpu, uint32_t address, memory_size_t size){
+  uint32_t bytes = 1u << size;
+  uint8_t flags = cpu->watch_pages[address >> DEBUG_PAGE_SHIFT] | cpu->watch_pages[(address + bytes - 1) >> DEBUG_PAGE_SHIFT];
+  if ((flags & DEBUG_PAGE_WATCHPOINT) && debug_watch_store(cpu->debug, address, bytes)){
+    cpu->pending_event = CPU_EVENT_WATCHPOINT;
+  }
+}
+
+
+uint8_t* cpu_memory_span(cpu_state_t* cpu, uint32_t address, size_t size, bool write){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_memory_span.\n");
+    return NULL;
+  }
+
+  if (cpu->sparse.base){
+    bool mapped = write ? sparse_memory_prepare_write(&cpu->sparse, address, size)
+                        : sparse_memory_is_mapped(&cpu->sparse, address, size);
+    if (!mapped) return NULL;
+    if (write) cpu_invalidate_range(cpu, address, size);
+    return cpu->sparse.base + address;
+  }
+
+  memory_bank_t* bank = cpu_select_memory_bank(cpu, address);
+  if (!bank || (uint64_t) (address - bank->base_address) + size > bank->size) return NULL;
+  if (write){
+    memory_mark_pages(bank, address - bank->base_address, size);
+    if (bank == &cpu->instruction_memory) cpu_invalidate_range(cpu, address, size);
+  }
+  return bank->data + (address - bank->base_address);
+}
+
 //===========================================================================================
 //                                CPU LIFECYCLE
 //===========================================================================================
@@ -55,6 +372,12 @@ cpu_state_t* cpu_init(void) {
     return NULL;
   }
 
+  // Instruction/data memory banks and predecode cache
+  if (!cpu_memory_init(cpu)){
+    free(cpu);
+    return NULL;
+  }
+
   return cpu;
 }
 
@@ -81,6 +404,8 @@ void cpu_reset(cpu_state_t *cpu) {
   cpu->pipeline_stalled = false;
   cpu->pipeline_flushed = false;
   cpu->stall_cycles = 0;
+  memset(&cpu->scoreboard, 0, sizeof(scoreboard_t));
+  cpu->pending_event = CPU_EVENT_NONE;
 
   // Reset performance counters
   cpu->total_cycles = 0;
@@ -92,17 +417,30 @@ void cpu_reset(cpu_state_t *cpu) {
   // Reset debug state
   cpu->single_step_mode = false;
   cpu->trace_enabled = false;
-  cpu->breakpoint_address = 0;
-  cpu->breakpoint_enabled = false;
 
-  // Clear memory contents but preserve allocation
-  if (cpu->instruction_memory.data) {
-    memset(cpu->instruction_memory.data, 0, cpu->instruction_memory.size);
+  // Cold caches and untrained predictor
+  cache_reset(&cpu->icache);
+  cache_reset(&cpu->dcache);
+  branch_predictor_reset(&cpu->predictor);
+
+  // Memory back to the kept image or zeros, preserving allocation; shared banks are the owner's
+  if (cpu->sparse.base) {
+    sparse_memory_clear(&cpu->sparse);   // Banks are views of it
+    predecode_invalidate_all(&cpu->predecode);
   }
-  if (cpu->data_memory.data) {
-    memset(cpu->data_memory.data, 0, cpu->data_memory.size);
+  else if (cpu->shared_memory) {
+    predecode_invalidate_all(&cpu->predecode);
+  }
+  else {
+    // Only pages written since the last reset change, decodes of the others stay valid
+    const memory_bank_t* code = &cpu->instruction_memory;
+    if (!code->page_flags) predecode_invalidate_all(&cpu->predecode);
+    for (size_t i = 0; i < code->num_dirty_pages; ++i){
+      predecode_invalidate(&cpu->predecode, code->base_address + (code->dirty_pages[i] << MEMORY_PAGE_SHIFT));
+    }
+    memory_reset(&cpu->instruction_memory);
+    memory_reset(&cpu->data_memory);
   }
-
 }
 
 
@@ -112,11 +450,157 @@ void cpu_destroy(cpu_state_t *cpu){
     return;
   }
 
-  memory_destroy(&cpu->data_memory);
-  memory_destroy(&cpu->instruction_memory);
+  cpu_cache_destroy(cpu);
+  branch_predictor_destroy(&cpu->predictor);
+  cpu_memory_destroy(cpu);
   free(cpu);
 }
 
+//===========================================================================================
+//                                PROGRAM IMAGE
+//===========================================================================================
+
+bool cpu_memory_keep_image(cpu_state_t* cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_memory_keep_image.\n");
+    return false;
+  }
+  if (cpu->sparse.base || cpu->shared_memory) return false;
+  return memory_keep_image(&cpu->instruction_memory) && memory_keep_image(&cpu->data_memory);
+}
+
+
+void cpu_memory_drop_image(cpu_state_t* cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_memory_drop_image.\n");
+    return;
+  }
+  if (cpu->sparse.base || cpu->shared_memory) return;
+  memory_drop_image(&cpu->instruction_memory);
+  memory_drop_image(&cpu->data_memory);
+  predecode_invalidate_all(&cpu->predecode);
+}
+
+//===========================================================================================
+//                                SNAPSHOTS
+//===========================================================================================
+
+// Copy of a bank, reusing the buffer of an earlier snapshot
+static bool snapshot_bank(uint8_t** copy, const memory_bank_t* bank){
+  if (!*copy) *copy = (uint8_t *) malloc(bank->size);
+  if (!*copy){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in cpu_snapshot.\n");
+    return false;
+  }
+  memcpy(*copy, bank->data, bank->size);
+  return true;
+}
+
+
+// Copy back the pages of a bank that differ from the snapshot
+static void restore_bank(cpu_state_t* cpu, memory_bank_t* bank, const uint8_t* copy){
+  for (size_t offset = 0; offset < bank->size; offset += PREDECODE_PAGE_SIZE){
+    size_t length = bank->size - offset < PREDECODE_PAGE_SIZE ? bank->size - offset : PREDECODE_PAGE_SIZE;
+    if (memcmp(bank->data + offset, copy + offset, length) == 0) continue;
+    memcpy(bank->data + offset, copy + offset, length);
+    memory_mark_pages(bank, offset, length);
+    if (bank == &cpu->instruction_memory) predecode_invalidate(&cpu->predecode, bank->base_address + (uint32_t) offset);
+  }
+}
+
+
+bool cpu_snapshot(cpu_state_t* cpu, cpu_snapshot_t* snapshot){
+  if (!cpu || !snapshot){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_snapshot.\n");
+    return false;
+  }
+
+  snapshot->valid = false;
+  if (cpu->sparse.base){
+    if (!sparse_memory_snapshot(&cpu->sparse)) return false;
+  }
+  else if (!snapshot_bank(&snapshot->instruction_memory, &cpu->instruction_memory) ||
+           !snapshot_bank(&snapshot->data_memory, &cpu->data_memory)){
+    return false;
+  }
+  if (!cache_copy(&snapshot->icache, &cpu->icache) || !cache_copy(&snapshot->dcache, &cpu->dcache) ||
+      !branch_predictor_copy(&snapshot->predictor, &cpu->predictor)){
+    return false;
+  }
+
+  snapshot->state = *cpu;
+  snapshot->valid = true;
+  return true;
+}
+
+
+bool cpu_restore(cpu_state_t* cpu, const cpu_snapshot_t* snapshot){
+  if (!cpu || !snapshot){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_restore.\n");
+    return false;
+  }
+  if (!snapshot->valid){
+    fprintf(stderr, "Error: No snapshot to restore in cpu_restore.\n");
+    return false;
+  }
+
+  if (cpu->sparse.base){
+    // Stale decodes of the restored pages
+    for (size_t i = 0; i < cpu->sparse.num_dirty_pages; ++i){
+      uint32_t address = (uint32_t) ((size_t) cpu->sparse.dirty_pages[i] * cpu->sparse.page_size);
+      for (size_t offset = 0; offset < cpu->sparse.page_size; offset += PREDECODE_PAGE_SIZE){
+        predecode_invalidate(&cpu->predecode, address + (uint32_t) offset);
+      }
+    }
+    if (!sparse_memory_restore(&cpu->sparse)) return false;
+  }
+  else {
+    restore_bank(cpu, &cpu->instruction_memory, snapshot->instruction_memory);
+    restore_bank(cpu, &cpu->data_memory, snapshot->data_memory);
+  }
+
+  // Everything but the memory system comes from the snapshot, cache and predictor contents are copied
+  memory_bank_t instruction_memory = cpu->instruction_memory;
+  memory_bank_t data_memory = cpu->data_memory;
+  sparse_memory_t sparse = cpu->sparse;
+  predecode_cache_t predecode = cpu->predecode;
+  cache_t icache = cpu->icache;
+  cache_t dcache = cpu->dcache;
+  branch_predictor_t predictor = cpu->predictor;
+  profile_t* profile = cpu->profile;      // Counters keep running across restores
+  debug_marks_t* debug = cpu->debug;      // The debugger attached now, as predecode holds its breakpoints
+  const uint8_t* watch_pages = cpu->watch_pages;
+  *cpu = snapshot->state;
+  cpu->instruction_memory = instruction_memory;
+  cpu->data_memory = data_memory;
+  cpu->sparse = sparse;
+  cpu->predecode = predecode;
+  cpu->icache = icache;
+  cpu->dcache = dcache;
+  cpu->predictor = predictor;
+  cpu->profile = profile;
+  cpu->debug = debug;
+  cpu->watch_pages = watch_pages;
+  return cache_copy(&cpu->icache, &snapshot->icache) && cache_copy(&cpu->dcache, &snapshot->dcache) &&
+         branch_predictor_copy(&cpu->predictor, &snapshot->predictor);
+}
+
+
+void cpu_snapshot_destroy(cpu_state_t* cpu, cpu_snapshot_t* snapshot){
+  if (!cpu || !snapshot){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cpu_snapshot_destroy.\n");
+    return;
+  }
+
+  if (snapshot->valid && cpu->sparse.base) sparse_memory_drop_snapshot(&cpu->sparse);
+  free(snapshot->instruction_memory);
+  free(snapshot->data_memory);
+  cache_destroy(&snapshot->icache);
+  cache_destroy(&snapshot->dcache);
+  branch_predictor_destroy(&snapshot->predictor);
+  memset(snapshot, 0, sizeof(cpu_snapshot_t));
+}
+
 //===========================================================================================
 //                                REGISTER FILE OPERATIONS
 //===========================================================================================
@@ -203,18 +687,17 @@ void print_pipeline_state(const cpu_state_t* cpu) {
 
   // ID/EX
   printf("ID/EX  : PC = 0x%08x | Valid = %d | Stalled = %d | Imm = 0x%08x\n",
-    cpu->id_ex.pc,
+    cpu->id_ex.micro_op.pc,
     cpu->id_ex.valid,
     cpu->id_ex.stalled,
-    cpu->id_ex.immediate
+    (uint32_t) cpu->id_ex.micro_op.immediate
   );
 
   // EX/MEM
-  printf("EX/MEM : PC = 0x%08x | Valid = %d | ALU = 0x%08x | Zero = %d | BranchTaken = %d\n",
-    cpu->ex_mem.pc,
+  printf("EX/MEM : PC = 0x%08x | Valid = %d | ALU = 0x%08x | BranchTaken = %d\n",
+    cpu->ex_mem.micro_op.pc,
     cpu->ex_mem.valid,
     cpu->ex_mem.alu_result,
-    cpu->ex_mem.alu_zero,
     cpu->ex_mem.branch_taken
   );
 
@@ -223,7 +706,7 @@ void print_pipeline_state(const cpu_state_t* cpu) {
     cpu->mem_wb.valid,
     cpu->mem_wb.alu_result,
     cpu->mem_wb.memory_data,
-    cpu->mem_wb.pc_plus_4
+    cpu->mem_wb.micro_op.pc + 4
   );
 
   printf("--------------\n");
@@ -0,0 +1,189 @@
+#include "cpu/debug.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static inline uint32_t page_of(uint32_t address){
+  return address >> DEBUG_PAGE_SHIFT;
+}
+
+
+static inline uint32_t last_page_of(uint32_t address, uint32_t length){
+  uint64_t last = (uint64_t) address + (length ? length : 1) - 1;
+  return last > UINT32_MAX ? page_of(UINT32_MAX) : page_of((uint32_t) last);
+}
+
+
+// Grow an array of element_size entries to hold one more, false on allocation failure
+static bool reserve_one(void** array, size_t count, size_t* capacity, size_t element_size){
+  if (count < *capacity) return true;
+  size_t new_capacity = *capacity ? *capacity * 2 : 16;
+  void* grown = realloc(*array, new_capacity * element_size);
+  if (!grown) return false;
+  *array = grown;
+  *capacity = new_capacity;
+  return true;
+}
+
+
+// Recompute the flag of the pages of [address, address + length) from the lists
+static void refresh_pages(debug_marks_t* marks, uint32_t address, uint32_t length, uint8_t flag){
+  uint32_t first = page_of(address), last = last_page_of(address, length);
+
+  for (uint32_t page = first; ; ++page){
+    bool marked = false;
+    if (flag == DEBUG_PAGE_BREAKPOINT){
+      for (size_t i = 0; i < marks->num_breakpoints && !marked; ++i) marked = page_of(marks->breakpoints[i]) == page;
+    }
+    else {
+      for (size_t i = 0; i < marks->num_watchpoints && !marked; ++i){
+        const debug_range_t* range = &marks->watchpoints[i];
+        marked = page_of(range->address) <= page && page <= last_page_of(range->address, range->length);
+      }
+    }
+    if (marked) marks->page_flags[page] |= flag;
+    else marks->page_flags[page] &= (uint8_t) ~flag;
+    if (page == last) break;
+  }
+}
+
+//===========================================================================================
+//                                MARKS
+//===========================================================================================
+
+bool debug_marks_init(debug_marks_t* marks){
+  if (!marks){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_marks_init.\n");
+    return false;
+  }
+
+  memset(marks, 0, sizeof(debug_marks_t));
+  marks->page_flags = (uint8_t *) calloc(DEBUG_NUM_PAGES, sizeof(uint8_t));
+  if (!marks->page_flags){ // Error Check
+    fprintf(stderr, "Error: Allocating memory error in debug_marks_init.\n");
+    return false;
+  }
+  return true;
+}
+
+
+void debug_marks_destroy(debug_marks_t* marks){
+  if (!marks){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_marks_destroy.\n");
+    return;
+  }
+
+  free(marks->page_flags);
+  free(marks->breakpoints);
+  free(marks->watchpoints);
+  memset(marks, 0, sizeof(debug_marks_t));
+}
+
+
+bool debug_add_breakpoint(debug_marks_t* marks, uint32_t address){
+  if (!marks){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_add_breakpoint.\n");
+    return false;
+  }
+
+  if (debug_breakpoint_at(marks, address)) return true;
+  if (!reserve_one((void **) &marks->breakpoints, marks->num_breakpoints, &marks->breakpoint_capacity, sizeof(uint32_t))){
+    fprintf(stderr, "Error: Allocating memory error in debug_add_breakpoint.\n");
+    return false;
+  }
+  marks->breakpoints[marks->num_breakpoints++] = address;
+  marks->page_flags[page_of(address)] |= DEBUG_PAGE_BREAKPOINT;
+  return true;
+}
+
+
+bool debug_remove_breakpoint(debug_marks_t* marks, uint32_t address){
+  if (!marks){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_remove_breakpoint.\n");
+    return false;
+  }
+
+  for (size_t i = 0; i < marks->num_breakpoints; ++i){
+    if (marks->breakpoints[i] != address) continue;
+    marks->breakpoints[i] = marks->breakpoints[--marks->num_breakpoints];
+    refresh_pages(marks, address, 4, DEBUG_PAGE_BREAKPOINT);
+    return true;
+  }
+  return false;
+}
+
+
+bool debug_add_watchpoint(debug_marks_t* marks, uint32_t address, uint32_t length){
+  if (!marks){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_add_watchpoint.\n");
+    return false;
+  }
+  if (length == 0) return false;
+
+  if (!reserve_one((void **) &marks->watchpoints, marks->num_watchpoints, &marks->watchpoint_capacity,
+                   sizeof(debug_range_t))){
+    fprintf(stderr, "Error: Allocating memory error in debug_add_watchpoint.\n");
+    return false;
+  }
+  marks->watchpoints[marks->num_watchpoints++] = (debug_range_t) { .address = address, .length = length };
+  refresh_pages(marks, address, length, DEBUG_PAGE_WATCHPOINT);
+  return true;
+}
+
+
+bool debug_remove_watchpoint(debug_marks_t* marks, uint32_t address, uint32_t length){
+  if (!marks){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_remove_watchpoint.\n");
+    return false;
+  }
+
+  for (size_t i = 0; i < marks->num_watchpoints; ++i){
+    if (marks->watchpoints[i].address != address || marks->watchpoints[i].length != length) continue;
+    marks->watchpoints[i] = marks->watchpoints[--marks->num_watchpoints];
+    refresh_pages(marks, address, length, DEBUG_PAGE_WATCHPOINT);
+    return true;
+  }
+  return false;
+}
+
+//===========================================================================================
+//                                LOOKUPS
+//===========================================================================================
+
+bool debug_breakpoint_at(const debug_marks_t* marks, uint32_t pc){
+  if (!marks){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_breakpoint_at.\n");
+    return false;
+  }
+
+  if (!(marks->page_flags[page_of(pc)] & DEBUG_PAGE_BREAKPOINT)) return false;
+  for (size_t i = 0; i < marks->num_breakpoints; ++i){
+    if (marks->breakpoints[i] == pc) return true;
+  }
+  return false;
+}
+
+
+bool debug_watch_store(debug_marks_t* marks, uint32_t address, uint32_t size){
+  if (!marks){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_watch_store.\n");
+    return false;
+  }
+
+  uint64_t end = (uint64_t) address + size;
+  for (size_t i = 0; i < marks->num_watchpoints; ++i){
+    const debug_range_t* range = &marks->watchpoints[i];
+    if (range->address < end && address < (uint64_t) range->address + range->length){
+      marks->watch_hit = true;
+      marks->watch_address = range->address;
+      marks->watchpoint_hits++;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,285 @@
+#include "cpu/interpreter.h"
+#include "memory/memory.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Threaded dispatch through computed goto where the compiler supports it
+#if defined(__GNUC__)
+#define INTERPRETER_THREADED 1
+#else
+#define INTERPRETER_THREADED 0
+#endif
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+// Data memory is accessed directly, everything else takes the routed path
+static inline uint32_t load(cpu_state_t* cpu, uint32_t address, memory_size_t size, bool unsigned_load){
+  const memory_bank_t* dmem = &cpu->data_memory;
+  uint32_t offset = address - dmem->base_address;
+
+  if (offset < dmem->size && dmem->size - offset >= (1u << size)){
+    const uint8_t* p = dmem->data + offset;
+    switch (size){
+      case MEM_SIZE_BYTE:
+        return unsigned_load ? p[0] : (uint32_t) (int32_t) (int8_t) p[0];
+      case MEM_SIZE_HALFWORD: {
+        uint16_t value;
+        memcpy(&value, p, sizeof(value));
+        return unsigned_load ? value : (uint32_t) (int32_t) (int16_t) value;
+      }
+      case MEM_SIZE_WORD: {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+      }
+    }
+  }
+  return cpu_memory_load(cpu, address, size, unsigned_load);
+}
+
+
+static inline void store(cpu_state_t* cpu, uint32_t address, uint32_t data, memory_size_t size){
+  memory_bank_t* dmem = &cpu->data_memory;
+  uint32_t offset = address - dmem->base_address;
+
+  if (offset < dmem->size && dmem->size - offset >= (1u << size)){
+    memcpy(dmem->data + offset, &data, 1u << size);   // Little-endian host
+    memory_mark_written(dmem, offset, 1u << size);
+  }
+  else {
+    cpu_memory_store(cpu, address, data, size);
+    if (cpu->pending_event != CPU_EVENT_NONE) return;
+  }
+  if (cpu->watch_pages) cpu_watch_store(cpu, address, size);   // Debugger attached with watchpoints
+}
+
+//===========================================================================================
+//                                EXECUTION LOOP
+//===========================================================================================
+
+uint64_t interpreter_run(cpu_state_t* cpu, uint64_t max_instructions){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in interpreter_run.\n");
+    return 0;
+  }
+
+  uint32_t* x = cpu->reg_file.registers;
+  predecode_cache_t* cache = &cpu->predecode;
+  uint64_t limit = max_instructions ? max_instructions : UINT64_MAX;
+  uint64_t retired = 0;
+  uint64_t branches = 0;
+  profile_t* profile = cpu->profile;
+  uint32_t pc = cpu->pc;
+  const predecoded_instruction_t* pre;
+  const instruction_t* inst;
+
+#if INTERPRETER_THREADED
+  static const void* const dispatch_table[] = {
+    [INST_ADD] = &&target_INST_ADD,       [INST_SUB] = &&target_INST_SUB,
+    [INST_SLL] = &&target_INST_SLL,       [INST_SLT] = &&target_INST_SLT,
+    [INST_SLTU] = &&target_INST_SLTU,     [INST_XOR] = &&target_INST_XOR,
+    [INST_SRL] = &&target_INST_SRL,       [INST_SRA] = &&target_INST_SRA,
+    [INST_OR] = &&target_INST_OR,         [INST_AND] = &&target_INST_AND,
+    [INST_ADDI] = &&target_INST_ADDI,     [INST_SLTI] = &&target_INST_SLTI,
+    [INST_SLTIU] = &&target_INST_SLTIU,   [INST_XORI] = &&target_INST_XORI,
+    [INST_ORI] = &&target_INST_ORI,       [INST_ANDI] = &&target_INST_ANDI,
+    [INST_SLLI] = &&target_INST_SLLI,     [INST_SRLI] = &&target_INST_SRLI,
+    [INST_SRAI] = &&target_INST_SRAI,     [INST_LB] = &&target_INST_LB,
+    [INST_LH] = &&target_INST_LH,         [INST_LW] = &&target_INST_LW,
+    [INST_LBU] = &&target_INST_LBU,       [INST_LHU] = &&target_INST_LHU,
+    [INST_JALR] = &&target_INST_JALR,     [INST_SB] = &&target_INST_SB,
+    [INST_SH] = &&target_INST_SH,         [INST_SW] = &&target_INST_SW,
+    [INST_BEQ] = &&target_INST_BEQ,       [INST_BNE] = &&target_INST_BNE,
+    [INST_BLT] = &&target_INST_BLT,       [INST_BGE] = &&target_INST_BGE,
+    [INST_BLTU] = &&target_INST_BLTU,     [INST_BGEU] = &&target_INST_BGEU,
+    [INST_LUI] = &&target_INST_LUI,       [INST_AUIPC] = &&target_INST_AUIPC,
+    [INST_JAL] = &&target_INST_JAL,       [INST_ECALL] = &&target_INST_ECALL,
+    [INST_EBREAK] = &&target_INST_EBREAK, [INST_FENCE] = &&target_INST_FENCE,
+    [INST_NOP] = &&target_INST_NOP,       [INST_INVALID] = &&target_INST_INVALID
+  };
+  #define TARGET(type) target_##type
+  #define JUMP() goto *dispatch_table[inst->type]
+#else
+  #define TARGET(type) case type
+  #define JUMP() goto dispatch
+#endif
+
+  // Fetch through the predecode cache and jump to the handler
+  #define DISPATCH()                                      \
+    do {                                                  \
+      if (retired >= limit) goto done;                    \
+      pre = predecode_lookup(cache, pc);                  \
+      if (!pre) pre = cpu_fetch_decoded(cpu, pc);         \
+      inst = &pre->instruction;                           \
+      JUMP();                                             \
+    } while (0)
+
+  // Retire and continue with the next instruction
+  #define NEXT(next_pc)                                   \
+    do {                                                  \
+      if (profile_enabled(profile)) profile_retire(profile, pc, inst->type); \
+      pc = (next_pc);                                     \
+      retired++;                                          \
+      DISPATCH();                                         \
+    } while (0)
+
+  // x0 is rewritten after every write instead of testing rd
+  #define WRITE_RD(value)                                 \
+    do {                                                  \
+      x[inst->rd] = (value);                              \
+      x[0] = 0;                                           \
+    } while (0)
+
+  #define RS1 x[inst->rs1]
+  #define RS2 x[inst->rs2]
+
+  // Loads and stores stop on a fault without retiring
+  #define LOAD(size, unsigned_load)                                         \
+    do {                                                                    \
+      uint32_t value = load(cpu, RS1 + (uint32_t) inst->imm_i, size, unsigned_load); \
+      if (cpu->pending_event != CPU_EVENT_NONE) goto done;                  \
+      WRITE_RD(value);                                                      \
+      NEXT(pc + 4);                                                         \
+    } while (0)
+
+  #define STORE(size)                                                       \
+    do {                                                                    \
+      store(cpu, RS1 + (uint32_t) inst->imm_s, RS2, size);                  \
+      if (cpu->pending_event != CPU_EVENT_NONE){                            \
+        if (cpu->pending_event != CPU_EVENT_WATCHPOINT) goto done;          \
+        if (profile_enabled(profile)) profile_retire(profile, pc, inst->type); \
+        pc += 4;                          /* Stored, retires before stopping */ \
+        retired++;                                                          \
+        goto done;                                                          \
+      }                                                                     \
+      NEXT(pc + 4);                                                         \
+    } while (0)
+
+  #define BRANCH(condition)                                                 \
+    do {                                                                    \
+      bool taken = (condition);                                             \
+      branches++;                                                           \
+      if (profile_enabled(profile)) profile_branch(profile, pc, taken, false); \
+      NEXT(taken ? pc + (uint32_t) inst->imm_b : pc + 4);                   \
+    } while (0)
+
+  DISPATCH();
+
+#if !INTERPRETER_THREADED
+dispatch:
+  switch (inst->type){
+#endif
+
+  // R-type arithmetic
+  TARGET(INST_ADD):  WRITE_RD(RS1 + RS2);  NEXT(pc + 4);
+  TARGET(INST_SUB):  WRITE_RD(RS1 - RS2);  NEXT(pc + 4);
+  TARGET(INST_SLL):  WRITE_RD(RS1 << (RS2 & 0x1F)); NEXT(pc + 4);
+  TARGET(INST_SLT):  WRITE_RD((int32_t) RS1 < (int32_t) RS2); NEXT(pc + 4);
+  TARGET(INST_SLTU): WRITE_RD(RS1 < RS2);  NEXT(pc + 4);
+  TARGET(INST_XOR):  WRITE_RD(RS1 ^ RS2);  NEXT(pc + 4);
+  TARGET(INST_SRL):  WRITE_RD(RS1 >> (RS2 & 0x1F)); NEXT(pc + 4);
+  TARGET(INST_SRA):  WRITE_RD((uint32_t) ((int32_t) RS1 >> (RS2 & 0x1F))); NEXT(pc + 4);
+  TARGET(INST_OR):   WRITE_RD(RS1 | RS2);  NEXT(pc + 4);
+  TARGET(INST_AND):  WRITE_RD(RS1 & RS2);  NEXT(pc + 4);
+
+  // I-type arithmetic
+  TARGET(INST_ADDI):  WRITE_RD(RS1 + (uint32_t) inst->imm_i); NEXT(pc + 4);
+  TARGET(INST_SLTI):  WRITE_RD((int32_t) RS1 < inst->imm_i);  NEXT(pc + 4);
+  TARGET(INST_SLTIU): WRITE_RD(RS1 < (uint32_t) inst->imm_i); NEXT(pc + 4);
+  TARGET(INST_XORI):  WRITE_RD(RS1 ^ (uint32_t) inst->imm_i); NEXT(pc + 4);
+  TARGET(INST_ORI):   WRITE_RD(RS1 | (uint32_t) inst->imm_i); NEXT(pc + 4);
+  TARGET(INST_ANDI):  WRITE_RD(RS1 & (uint32_t) inst->imm_i); NEXT(pc + 4);
+  TARGET(INST_SLLI):  WRITE_RD(RS1 << (inst->imm_i & 0x1F));  NEXT(pc + 4);
+  TARGET(INST_SRLI):  WRITE_RD(RS1 >> (inst->imm_i & 0x1F));  NEXT(pc + 4);
+  TARGET(INST_SRAI):  WRITE_RD((uint32_t) ((int32_t) RS1 >> (inst->imm_i & 0x1F))); NEXT(pc + 4);
+
+  // Loads
+  TARGET(INST_LB):  LOAD(MEM_SIZE_BYTE, false);
+  TARGET(INST_LH):  LOAD(MEM_SIZE_HALFWORD, false);
+  TARGET(INST_LW):  LOAD(MEM_SIZE_WORD, false);
+  TARGET(INST_LBU): LOAD(MEM_SIZE_BYTE, true);
+  TARGET(INST_LHU): LOAD(MEM_SIZE_HALFWORD, true);
+
+  // Stores
+  TARGET(INST_SB): STORE(MEM_SIZE_BYTE);
+  TARGET(INST_SH): STORE(MEM_SIZE_HALFWORD);
+  TARGET(INST_SW): STORE(MEM_SIZE_WORD);
+
+  // Branches
+  TARGET(INST_BEQ):  BRANCH(RS1 == RS2);
+  TARGET(INST_BNE):  BRANCH(RS1 != RS2);
+  TARGET(INST_BLT):  BRANCH((int32_t) RS1 < (int32_t) RS2);
+  TARGET(INST_BGE):  BRANCH((int32_t) RS1 >= (int32_t) RS2);
+  TARGET(INST_BLTU): BRANCH(RS1 < RS2);
+  TARGET(INST_BGEU): BRANCH(RS1 >= RS2);
+
+  // Jumps (target computed before rd is written, rd may equal rs1)
+  TARGET(INST_JAL): {
+    WRITE_RD(pc + 4);
+    NEXT(pc + (uint32_t) inst->imm_j);
+  }
+  TARGET(INST_JALR): {
+    uint32_t target = (RS1 + (uint32_t) inst->imm_i) & ~1u;
+    WRITE_RD(pc + 4);
+    NEXT(target);
+  }
+
+  // Upper immediates
+  TARGET(INST_LUI):   WRITE_RD(inst->imm_u);      NEXT(pc + 4);
+  TARGET(INST_AUIPC): WRITE_RD(pc + inst->imm_u); NEXT(pc + 4);
+
+  // System: retire, then hand the event to the simulator
+  TARGET(INST_ECALL):
+    if (profile_enabled(profile)) profile_retire(profile, pc, inst->type);
+    cpu->pending_event = CPU_EVENT_ECALL;
+    pc += 4;
+    retired++;
+    goto done;
+  TARGET(INST_EBREAK):
+    if (profile_enabled(profile)) profile_retire(profile, pc, inst->type);
+    cpu->pending_event = CPU_EVENT_EBREAK;
+    pc += 4;
+    retired++;
+    goto done;
+
+  TARGET(INST_FENCE):
+    cpu_fence(cpu);
+    NEXT(pc + 4);
+
+  TARGET(INST_NOP):
+    NEXT(pc + 4);
+
+  TARGET(INST_INVALID):
+    cpu->pending_event = CPU_EVENT_ILLEGAL_INSTRUCTION;
+    goto done;
+
+#if !INTERPRETER_THREADED
+  }
+#endif
+
+done:
+  cpu->pc = pc;
+  cpu->total_instructions += retired;
+  cpu->total_cycles += retired;           // One instruction per cycle in this model
+  cpu->branch_instructions += branches;
+  return retired;
+
+  #undef TARGET
+  #undef JUMP
+  #undef DISPATCH
+  #undef NEXT
+  #undef WRITE_RD
+  #undef RS1
+  #undef RS2
+  #undef LOAD
+  #undef STORE
+  #undef BRANCH
+}
+
+
+bool interpreter_step(cpu_state_t* cpu){
+  return interpreter_run(cpu, 1) == 1;
+}
@@ -0,0 +1,740 @@
+#include "cpu/jit.h"
+#include "cpu/interpreter.h"
+#include "memory/memory.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+/*
+ * Generated code conventions:
+ *   rbx = cpu_state_t*, r12 = jit_state_t* (remaining budget at offset 0)
+ *   rbp = jit->page_flags, the data memory dirty flags the code was translated for
+ *   eax/ecx/edx/esi/edi are scratch, guest registers always live in cpu->reg_file
+ *
+ * Block layout:
+ *   entry:  if (remaining < n) goto budget_exit; remaining -= n;
+ *   body:   one template per instruction, loads/stores inline the data memory case
+ *   exits:  jmp rel32 (patched for chaining) ; cpu->pc = target ; eax = exit id ; jmp epilogue
+ *
+ * A faulting load/store gives back the budget of itself and the instructions after
+ * it, so retired counts stay exact. Exit id 0 means "not chainable".
+ * Stores test the dirty flag of their data memory page inline (memory.h) and
+ * leave the first write to a clean page to the slow path.
+ */
+
+#define JIT_CODE_HEADER_SIZE 64         // Trampoline + epilogue at the start of the cache
+#define JIT_MAX_INSTRUCTION_BYTES 224   // Worst case template size
+#define JIT_MAX_BLOCK_BYTES (JIT_MAX_BLOCK_INSTRUCTIONS * JIT_MAX_INSTRUCTION_BYTES + 128)
+
+// Generated code entry: (cpu, jit, block entry) -> exit id
+typedef uint32_t (*jit_enter_fn)(cpu_state_t* cpu, jit_state_t* jit, const uint8_t* entry);
+
+#if JIT_SUPPORTED
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static bool ends_block(instruction_type_t type){
+  switch (type){
+    case INST_BEQ: case INST_BNE: case INST_BLT:
+    case INST_BGE: case INST_BLTU: case INST_BGEU:
+    case INST_JAL: case INST_JALR:
+    case INST_ECALL: case INST_EBREAK: case INST_FENCE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+// Collect the basic block starting at pc, returns its length (0 = starts with an illegal instruction
+// or outside the predecode cache)
+static uint32_t scan_block(cpu_state_t* cpu, uint32_t pc, instruction_t* out){
+  uint32_t n = 0;
+  while (n < JIT_MAX_BLOCK_INSTRUCTIONS){
+    if (!predecode_covers(&cpu->predecode, pc + 4 * n)) break;   // Stores there would not flush the code
+    const instruction_t* inst = &cpu_fetch_decoded(cpu, pc + 4 * n)->instruction;
+    if (!inst->is_valid) break;   // Left to the interpreter to raise
+    if (out) out[n] = *inst;      // Copy, the decode may live in the predecode scratch slot
+    n++;
+    if (ends_block(inst->type)) break;
+  }
+  return n;
+}
+
+//===========================================================================================
+//                                BLOCK TABLE
+//===========================================================================================
+
+static jit_block_t* block_lookup(jit_state_t* jit, uint32_t pc){
+  size_t mask = JIT_BLOCK_TABLE_SIZE - 1;
+  for (size_t i = (pc >> 2) & mask;; i = (i + 1) & mask){
+    jit_block_t* block = &jit->blocks[i];
+    if (!block->code) return NULL;
+    if (block->pc == pc) return block;
+  }
+}
+
+
+static jit_block_t* block_insert(jit_state_t* jit, uint32_t pc){
+  size_t mask = JIT_BLOCK_TABLE_SIZE - 1;
+  size_t i = (pc >> 2) & mask;
+  while (jit->blocks[i].code) i = (i + 1) & mask;
+
+  jit->num_blocks++;
+  jit->blocks[i].pc = pc;
+  return &jit->blocks[i];
+}
+
+
+static bool block_is_hot(jit_state_t* jit, uint32_t pc){
+  uint8_t* counter = &jit->hot_counters[(pc >> 2) & (JIT_HOT_TABLE_SIZE - 1)];
+  if (*counter >= JIT_HOT_THRESHOLD) return true;
+  (*counter)++;
+  return false;
+}
+
+//===========================================================================================
+//                                X86-64 EMITTER
+//===========================================================================================
+
+#define CPU_PC_OFFSET ((uint32_t) offsetof(cpu_state_t, pc))
+#define CPU_REG_OFFSET(r) ((uint32_t) (offsetof(cpu_state_t, reg_file.registers) + 4 * (r)))
+#define CPU_EVENT_OFFSET ((uint32_t) offsetof(cpu_state_t, pending_event))
+#define CPU_BRANCHES_OFFSET ((uint32_t) offsetof(cpu_state_t, branch_instructions))
+#define DMEM_DATA_OFFSET ((uint32_t) offsetof(cpu_state_t, data_memory.data))
+#define DMEM_SIZE_OFFSET ((uint32_t) offsetof(cpu_state_t, data_memory.size))
+#define DMEM_BASE_OFFSET ((uint32_t) offsetof(cpu_state_t, data_memory.base_address))
+
+// Host registers used by the templates (ModRM encoding)
+#define HOST_EAX 0
+#define HOST_ECX 1
+#define HOST_EDX 2
+
+typedef struct {
+  uint8_t* cursor;                // Next byte to emit
+} emitter_t;
+
+
+static void emit8(emitter_t* e, uint8_t byte){
+  *e->cursor++ = byte;
+}
+
+
+static void emit_bytes(emitter_t* e, const uint8_t* bytes, size_t count){
+  memcpy(e->cursor, bytes, count);
+  e->cursor += count;
+}
+
+
+static void emit32(emitter_t* e, uint32_t value){
+  memcpy(e->cursor, &value, sizeof(value));
+  e->cursor += sizeof(value);
+}
+
+
+static void emit64(emitter_t* e, uint64_t value){
+  memcpy(e->cursor, &value, sizeof(value));
+  e->cursor += sizeof(value);
+}
+
+
+static void patch_rel32(uint8_t* rel, const uint8_t* target){
+  int32_t displacement = (int32_t) (target - (rel + 4));
+  memcpy(rel, &displacement, sizeof(displacement));
+}
+
+
+// jmp/jcc rel32 with the displacement left open, returns where to patch it
+static uint8_t* emit_jump(emitter_t* e, const uint8_t* opcode, size_t opcode_size){
+  emit_bytes(e, opcode, opcode_size);
+  uint8_t* rel = e->cursor;
+  emit32(e, 0);
+  return rel;
+}
+
+
+static uint8_t* emit_jmp(emitter_t* e){
+  return emit_jump(e, (const uint8_t[]) {0xE9}, 1);
+}
+
+
+static uint8_t* emit_jcc(emitter_t* e, uint8_t condition){
+  return emit_jump(e, (const uint8_t[]) {0x0F, condition}, 2);
+}
+
+
+// mov host, guest x[reg]
+static void emit_load_reg(emitter_t* e, uint8_t host, uint8_t reg){
+  if (reg == 0){
+    emit8(e, 0x31);                       // xor host, host
+    emit8(e, 0xC0 | host << 3 | host);
+    return;
+  }
+  emit8(e, 0x8B);                         // mov host, [rbx + disp32]
+  emit8(e, 0x83 | host << 3);
+  emit32(e, CPU_REG_OFFSET(reg));
+}
+
+
+// mov guest x[reg], eax (callers skip x0)
+static void emit_store_reg(emitter_t* e, uint8_t reg){
+  emit8(e, 0x89);                         // mov [rbx + disp32], eax
+  emit8(e, 0x83);
+  emit32(e, CPU_REG_OFFSET(reg));
+}
+
+
+// mov dword [rbx + offset], imm32
+static void emit_store_imm(emitter_t* e, uint32_t offset, uint32_t value){
+  emit8(e, 0xC7);
+  emit8(e, 0x83);
+  emit32(e, offset);
+  emit32(e, value);
+}
+
+
+// op qword [r12], imm32 (budget bookkeeping)
+static void emit_budget_op(emitter_t* e, uint8_t modrm, uint32_t value){
+  emit_bytes(e, (const uint8_t[]) {0x49, 0x81, modrm, 0x24}, 4);
+  emit32(e, value);
+}
+
+
+static void emit_call(emitter_t* e, const void* function){
+  emit_bytes(e, (const uint8_t[]) {0x48, 0xB8}, 2);    // mov rax, imm64
+  emit64(e, (uint64_t) (uintptr_t) function);
+  emit_bytes(e, (const uint8_t[]) {0xFF, 0xD0}, 2);    // call rax
+}
+
+
+// Leave the block without chaining: cpu->pc = pc, eax = 0
+static void emit_exit(jit_state_t* jit, emitter_t* e, uint32_t pc){
+  emit_store_imm(e, CPU_PC_OFFSET, pc);
+  emit_bytes(e, (const uint8_t[]) {0x31, 0xC0}, 2);    // xor eax, eax
+  patch_rel32(emit_jmp(e), jit->epilogue);
+}
+
+
+// Leave the block towards a known PC through a patchable jump
+static void emit_chainable_exit(jit_state_t* jit, emitter_t* e, uint32_t pc){
+  if (jit->num_exits >= JIT_MAX_EXITS){
+    emit_exit(jit, e, pc);
+    return;
+  }
+
+  jit_exit_t* exit = &jit->exits[jit->num_exits++];
+  exit->patch_site = e->cursor;
+  exit->chained = false;
+
+  emit_bytes(e, (const uint8_t[]) {0xE9, 0, 0, 0, 0}, 5);   // jmp +0 until chained
+  emit_store_imm(e, CPU_PC_OFFSET, pc);
+  emit8(e, 0xB8);                                            // mov eax, exit id
+  emit32(e, (uint32_t) jit->num_exits);
+  patch_rel32(emit_jmp(e), jit->epilogue);
+}
+
+
+// Stop at instruction index of a block of length n without retiring it
+static void emit_fault_exit(jit_state_t* jit, emitter_t* e, uint32_t pc, uint32_t index, uint32_t n){
+  emit_budget_op(e, 0x04, n - index);                       // add qword [r12], n - index
+  emit_exit(jit, e, pc);
+}
+
+//===========================================================================================
+//                                MEMORY ACCESS HELPERS
+//===========================================================================================
+
+// Slow path for loads outside data memory: value, or -1 on a fault
+static int64_t jit_helper_load(cpu_state_t* cpu, uint32_t address, uint32_t kind){
+  uint32_t value = cpu_memory_load(cpu, address, (memory_size_t) (kind & 0x3), kind & 0x4);
+  return cpu->pending_event != CPU_EVENT_NONE ? -1 : (int64_t) value;
+}
+
+
+// Slow path for stores outside data memory: 0 = continue, 1 = fault, 2 = code was modified
+static uint32_t jit_helper_store(cpu_state_t* cpu, uint32_t address, uint32_t data, uint32_t size){
+  uint64_t generation = cpu->predecode.invalidations;
+  cpu_memory_store(cpu, address, data, (memory_size_t) size);
+  if (cpu->pending_event != CPU_EVENT_NONE) return 1;
+  return cpu->predecode.invalidations != generation ? 2 : 0;
+}
+
+
+// ecx = address - data base, jumps to the returned site if outside data memory
+static uint8_t* emit_data_range_check(emitter_t* e, memory_size_t size){
+  emit_bytes(e, (const uint8_t[]) {0x89, 0xC1}, 2);          // mov ecx, eax
+  emit_bytes(e, (const uint8_t[]) {0x2B, 0x8B}, 2);          // sub ecx, [rbx + base]
+  emit32(e, DMEM_BASE_OFFSET);
+  emit_bytes(e, (const uint8_t[]) {0x48, 0x8B, 0x93}, 3);    // mov rdx, [rbx + size]
+  emit32(e, DMEM_SIZE_OFFSET);
+  emit_bytes(e, (const uint8_t[]) {0x48, 0x83, 0xEA, (uint8_t) (1u << size)}, 4);  // sub rdx, bytes
+  emit_bytes(e, (const uint8_t[]) {0x48, 0x39, 0xD1}, 3);    // cmp rcx, rdx
+  uint8_t* slow = emit_jcc(e, 0x87);                         // ja slow
+  emit_bytes(e, (const uint8_t[]) {0x48, 0x8B, 0x93}, 3);    // mov rdx, [rbx + data]
+  emit32(e, DMEM_DATA_OFFSET);
+  return slow;
+}
+
+
+// eax = x[rs1] + imm
+static void emit_effective_address(emitter_t* e, const instruction_t* inst, int32_t imm){
+  emit_load_reg(e, HOST_EAX, inst->rs1);
+  if (imm){
+    emit8(e, 0x05);                                          // add eax, imm32
+    emit32(e, (uint32_t) imm);
+  }
+}
+
+
+static void emit_load(jit_state_t* jit, emitter_t* e, const instruction_t* inst, uint32_t index, uint32_t n){
+  static const uint8_t load_ops[][4] = {
+    [INST_LB]  = {0x0F, 0xBE, 0x04, 0x0A},   // movsx eax, byte [rdx + rcx]
+    [INST_LH]  = {0x0F, 0xBF, 0x04, 0x0A},   // movsx eax, word [rdx + rcx]
+    [INST_LBU] = {0x0F, 0xB6, 0x04, 0x0A},   // movzx eax, byte [rdx + rcx]
+    [INST_LHU] = {0x0F, 0xB7, 0x04, 0x0A},   // movzx eax, word [rdx + rcx]
+  };
+  memory_size_t size = inst->funct3 & 0x3;
+  bool unsigned_load = inst->funct3 & 0x4;
+
+  emit_effective_address(e, inst, inst->imm_i);
+  uint8_t* slow = emit_data_range_check(e, size);
+  if (inst->type == INST_LW) emit_bytes(e, (const uint8_t[]) {0x8B, 0x04, 0x0A}, 3);  // mov eax, [rdx + rcx]
+  else emit_bytes(e, load_ops[inst->type], 4);
+  uint8_t* done_fast = emit_jmp(e);
+
+  // Slow path through the routed memory access
+  patch_rel32(slow, e->cursor);
+  emit_bytes(e, (const uint8_t[]) {0x48, 0x89, 0xDF}, 3);    // mov rdi, rbx
+  emit_bytes(e, (const uint8_t[]) {0x89, 0xC6}, 2);          // mov esi, eax
+  emit8(e, 0xBA);                                            // mov edx, kind
+  emit32(e, (uint32_t) size | (unsigned_load ? 0x4 : 0));
+  emit_call(e, jit_helper_load);
+  emit_bytes(e, (const uint8_t[]) {0x48, 0x85, 0xC0}, 3);    // test rax, rax
+  uint8_t* done_slow = emit_jcc(e, 0x89);                    // jns done
+  emit_fault_exit(jit, e, inst->pc, index, n);
+
+  patch_rel32(done_fast, e->cursor);
+  patch_rel32(done_slow, e->cursor);
+  if (inst->rd != 0) emit_store_reg(e, inst->rd);
+}
+
+
+static void emit_store(jit_state_t* jit, emitter_t* e, const instruction_t* inst, uint32_t index, uint32_t n){
+  memory_size_t size = inst->funct3 & 0x3;
+
+  emit_effective_address(e, inst, inst->imm_s);
+  uint8_t* slow = emit_data_range_check(e, size);
+
+  // The first store to a clean page takes the slow path, which marks it dirty.
+  // So do misaligned stores, the only ones that can end on the next page
+  uint8_t* clean[2] = {NULL, NULL};
+  if (jit->page_flags){
+    if (size != MEM_SIZE_BYTE){
+      emit_bytes(e, (const uint8_t[]) {0xF6, 0xC1, (uint8_t) ((1u << size) - 1)}, 3);  // test cl, bytes - 1
+      clean[1] = emit_jcc(e, 0x85);                          // jnz slow
+    }
+    emit_bytes(e, (const uint8_t[]) {0x89, 0xCF}, 2);        // mov edi, ecx
+    emit_bytes(e, (const uint8_t[]) {0xC1, 0xEF, MEMORY_PAGE_SHIFT}, 3);  // shr edi, shift
+    emit_bytes(e, (const uint8_t[]) {0xF6, 0x44, 0x3D, 0x00, MEMORY_PAGE_DIRTY}, 5);  // test byte [rbp + rdi], dirty
+    clean[0] = emit_jcc(e, 0x84);                            // jz slow
+  }
+
+  emit_load_reg(e, HOST_EAX, inst->rs2);
+  switch (size){
+    case MEM_SIZE_BYTE:     emit_bytes(e, (const uint8_t[]) {0x88, 0x04, 0x0A}, 3);       break;
+    case MEM_SIZE_HALFWORD: emit_bytes(e, (const uint8_t[]) {0x66, 0x89, 0x04, 0x0A}, 4); break;
+    case MEM_SIZE_WORD:     emit_bytes(e, (const uint8_t[]) {0x89, 0x04, 0x0A}, 3);       break;
+  }
+
+  uint8_t* done_fast = emit_jmp(e);
+
+  // Slow path: may fault, hit an instruction page or dirty a clean one
+  patch_rel32(slow, e->cursor);
+  for (int i = 0; i < 2; ++i) if (clean[i]) patch_rel32(clean[i], e->cursor);
+  emit_bytes(e, (const uint8_t[]) {0x48, 0x89, 0xDF}, 3);    // mov rdi, rbx
+  emit_bytes(e, (const uint8_t[]) {0x89, 0xC6}, 2);          // mov esi, eax
+  emit_load_reg(e, HOST_EDX, inst->rs2);
+  emit8(e, 0xB9);                                            // mov ecx, size
+  emit32(e, (uint32_t) size);
+  emit_call(e, jit_helper_store);
+  emit_bytes(e, (const uint8_t[]) {0x85, 0xC0}, 2);          // test eax, eax
+  uint8_t* done_slow = emit_jcc(e, 0x84);                    // jz done
+  emit_bytes(e, (const uint8_t[]) {0x83, 0xF8, 0x01}, 3);    // cmp eax, 1
+  uint8_t* modified = emit_jcc(e, 0x85);                     // jne modified
+  emit_fault_exit(jit, e, inst->pc, index, n);
+
+  // Store retired but this block may be stale now
+  patch_rel32(modified, e->cursor);
+  emit_fault_exit(jit, e, inst->pc + 4, index + 1, n);
+
+  patch_rel32(done_fast, e->cursor);
+  patch_rel32(done_slow, e->cursor);
+}
+
+
+//===========================================================================================
+//                                INSTRUCTION TEMPLATES
+//===========================================================================================
+
+static void emit_alu_register(emitter_t* e, const instruction_t* inst){
+  if (inst->rd == 0) return;
+
+  emit_load_reg(e, HOST_EAX, inst->rs1);
+  emit_load_reg(e, HOST_ECX, inst->rs2);
+  switch (inst->type){
+    case INST_ADD:  emit_bytes(e, (const uint8_t[]) {0x01, 0xC8}, 2); break;   // add eax, ecx
+    case INST_SUB:  emit_bytes(e, (const uint8_t[]) {0x29, 0xC8}, 2); break;   // sub eax, ecx
+    case INST_AND:  emit_bytes(e, (const uint8_t[]) {0x21, 0xC8}, 2); break;   // and eax, ecx
+    case INST_OR:   emit_bytes(e, (const uint8_t[]) {0x09, 0xC8}, 2); break;   // or eax, ecx
+    case INST_XOR:  emit_bytes(e, (const uint8_t[]) {0x31, 0xC8}, 2); break;   // xor eax, ecx
+    case INST_SLL:  emit_bytes(e, (const uint8_t[]) {0xD3, 0xE0}, 2); break;   // shl eax, cl
+    case INST_SRL:  emit_bytes(e, (const uint8_t[]) {0xD3, 0xE8}, 2); break;   // shr eax, cl
+    case INST_SRA:  emit_bytes(e, (const uint8_t[]) {0xD3, 0xF8}, 2); break;   // sar eax, cl
+    case INST_SLT:                                                             // cmp ; setl ; movzx
+      emit_bytes(e, (const uint8_t[]) {0x39, 0xC8, 0x0F, 0x9C, 0xC0, 0x0F, 0xB6, 0xC0}, 8);
+      break;
+    case INST_SLTU:                                                            // cmp ; setb ; movzx
+      emit_bytes(e, (const uint8_t[]) {0x39, 0xC8, 0x0F, 0x92, 0xC0, 0x0F, 0xB6, 0xC0}, 8);
+      break;
+    default:
+      break;
+  }
+  emit_store_reg(e, inst->rd);
+}
+
+
+static void emit_alu_immediate(emitter_t* e, const instruction_t* inst){
+  if (inst->rd == 0) return;
+
+  uint32_t imm = (uint32_t) inst->imm_i;
+  uint8_t shamt = imm & 0x1F;
+
+  emit_load_reg(e, HOST_EAX, inst->rs1);
+  switch (inst->type){
+    case INST_ADDI: emit8(e, 0x05); emit32(e, imm); break;                     // add eax, imm32
+    case INST_XORI: emit8(e, 0x35); emit32(e, imm); break;                     // xor eax, imm32
+    case INST_ORI:  emit8(e, 0x0D); emit32(e, imm); break;                     // or eax, imm32
+    case INST_ANDI: emit8(e, 0x25); emit32(e, imm); break;                     // and eax, imm32
+    case INST_SLLI: emit_bytes(e, (const uint8_t[]) {0xC1, 0xE0, shamt}, 3); break;
+    case INST_SRLI: emit_bytes(e, (const uint8_t[]) {0xC1, 0xE8, shamt}, 3); break;
+    case INST_SRAI: emit_bytes(e, (const uint8_t[]) {0xC1, 0xF8, shamt}, 3); break;
+    case INST_SLTI:                                                            // cmp eax, imm ; setl
+      emit8(e, 0x3D); emit32(e, imm);
+      emit_bytes(e, (const uint8_t[]) {0x0F, 0x9C, 0xC0, 0x0F, 0xB6, 0xC0}, 6);
+      break;
+    case INST_SLTIU:                                                           // cmp eax, imm ; setb
+      emit8(e, 0x3D); emit32(e, imm);
+      emit_bytes(e, (const uint8_t[]) {0x0F, 0x92, 0xC0, 0x0F, 0xB6, 0xC0}, 6);
+      break;
+    default:
+      break;
+  }
+  emit_store_reg(e, inst->rd);
+}
+
+
+static void emit_branch(jit_state_t* jit, emitter_t* e, const instruction_t* inst){
+  static const uint8_t conditions[] = {
+    [INST_BEQ] = 0x84, [INST_BNE] = 0x85,      // je, jne
+    [INST_BLT] = 0x8C, [INST_BGE] = 0x8D,      // jl, jge
+    [INST_BLTU] = 0x82, [INST_BGEU] = 0x83     // jb, jae
+  };
+
+  emit_bytes(e, (const uint8_t[]) {0x48, 0xFF, 0x83}, 3);    // inc qword [rbx + branches]
+  emit32(e, CPU_BRANCHES_OFFSET);
+  emit_load_reg(e, HOST_EAX, inst->rs1);
+  emit_load_reg(e, HOST_ECX, inst->rs2);
+  emit_bytes(e, (const uint8_t[]) {0x39, 0xC8}, 2);          // cmp eax, ecx
+  uint8_t* taken = emit_jcc(e, conditions[inst->type]);
+
+  emit_chainable_exit(jit, e, inst->pc + 4);
+  patch_rel32(taken, e->cursor);
+  emit_chainable_exit(jit, e, inst->pc + (uint32_t) inst->imm_b);
+}
+
+
+static void emit_jalr(jit_state_t* jit, emitter_t* e, const instruction_t* inst){
+  // Target first, rd may equal rs1
+  emit_effective_address(e, inst, inst->imm_i);
+  emit_bytes(e, (const uint8_t[]) {0x83, 0xE0, 0xFE}, 3);    // and eax, ~1
+  emit_bytes(e, (const uint8_t[]) {0x89, 0x83}, 2);          // mov [rbx + pc], eax
+  emit32(e, CPU_PC_OFFSET);
+  if (inst->rd != 0) emit_store_imm(e, CPU_REG_OFFSET(inst->rd), inst->pc + 4);
+  emit_bytes(e, (const uint8_t[]) {0x31, 0xC0}, 2);          // xor eax, eax
+  patch_rel32(emit_jmp(e), jit->epilogue);
+}
+
+
+static void emit_instruction(jit_state_t* jit, emitter_t* e, const instruction_t* inst, uint32_t index, uint32_t n){
+  switch (inst->type){
+    case INST_ADD: case INST_SUB: case INST_SLL: case INST_SLT: case INST_SLTU:
+    case INST_XOR: case INST_SRL: case INST_SRA: case INST_OR: case INST_AND:
+      emit_alu_register(e, inst);
+      break;
+
+    case INST_ADDI: case INST_SLTI: case INST_SLTIU: case INST_XORI: case INST_ORI:
+    case INST_ANDI: case INST_SLLI: case INST_SRLI: case INST_SRAI:
+      emit_alu_immediate(e, inst);
+      break;
+
+    case INST_LB: case INST_LH: case INST_LW: case INST_LBU: case INST_LHU:
+      emit_load(jit, e, inst, index, n);
+      break;
+
+    case INST_SB: case INST_SH: case INST_SW:
+      emit_store(jit, e, inst, index, n);
+      break;
+
+    case INST_LUI:
+      if (inst->rd != 0) emit_store_imm(e, CPU_REG_OFFSET(inst->rd), inst->imm_u);
+      break;
+    case INST_AUIPC:
+      if (inst->rd != 0) emit_store_imm(e, CPU_REG_OFFSET(inst->rd), inst->pc + inst->imm_u);
+      break;
+
+    case INST_BEQ: case INST_BNE: case INST_BLT:
+    case INST_BGE: case INST_BLTU: case INST_BGEU:
+      emit_branch(jit, e, inst);
+      break;
+
+    case INST_JAL:
+      if (inst->rd != 0) emit_store_imm(e, CPU_REG_OFFSET(inst->rd), inst->pc + 4);
+      emit_chainable_exit(jit, e, inst->pc + (uint32_t) inst->imm_j);
+      break;
+    case INST_JALR:
+      emit_jalr(jit, e, inst);
+      break;
+
+    // Retire, then hand the event to the simulator
+    case INST_ECALL:
+    case INST_EBREAK:
+      emit_store_imm(e, CPU_EVENT_OFFSET, inst->type == INST_ECALL ? CPU_EVENT_ECALL : CPU_EVENT_EBREAK);
+      emit_exit(jit, e, inst->pc + 4);
+      break;
+
+    // Drops every decode, the dispatcher flushes the code cache on return
+    case INST_FENCE:
+      emit_bytes(e, (const uint8_t[]) {0x48, 0x89, 0xDF}, 3);  // mov rdi, rbx
+      emit_call(e, cpu_fence);
+      emit_exit(jit, e, inst->pc + 4);
+      break;
+
+    default:
+      break;
+  }
+}
+
+//===========================================================================================
+//                                TRANSLATION
+//===========================================================================================
+
+static jit_block_t* translate_block(jit_state_t* jit, cpu_state_t* cpu, uint32_t pc){
+  instruction_t insts[JIT_MAX_BLOCK_INSTRUCTIONS];
+  uint32_t n = scan_block(cpu, pc, insts);
+  if (n == 0) return NULL;
+
+  // Out of room: start over with an empty cache
+  if (jit->code_used + JIT_MAX_BLOCK_BYTES > jit->code_size ||
+      jit->num_blocks >= JIT_BLOCK_TABLE_SIZE * 3 / 4 ||
+      jit->num_exits + 2 > JIT_MAX_EXITS){
+    jit_flush(jit);
+  }
+
+  emitter_t e = { .cursor = jit->code + jit->code_used };
+  uint8_t* entry = e.cursor;
+
+  // Budget check, the whole block is charged up front
+  emit_budget_op(&e, 0x3C, n);                               // cmp qword [r12], n
+  uint8_t* budget_exit = emit_jcc(&e, 0x82);                 // jb budget_exit
+  emit_budget_op(&e, 0x2C, n);                               // sub qword [r12], n
+
+  for (uint32_t i = 0; i < n; ++i){
+    emit_instruction(jit, &e, &insts[i], i, n);
+  }
+  if (!ends_block(insts[n - 1].type)) emit_chainable_exit(jit, &e, pc + 4 * n);
+
+  patch_rel32(budget_exit, e.cursor);
+  emit_exit(jit, &e, pc);
+
+  jit->code_used = (size_t) (e.cursor - jit->code);
+  jit->translated_blocks++;
+
+  jit_block_t* block = block_insert(jit, pc);
+  block->length = n;
+  block->code = entry;
+  return block;
+}
+
+
+// Point a previously taken exit straight at the block it led to
+static void chain_exit(jit_state_t* jit, uint32_t exit_id, const jit_block_t* block){
+  if (exit_id == 0 || exit_id > jit->num_exits) return;
+
+  jit_exit_t* exit = &jit->exits[exit_id - 1];
+  if (exit->chained) return;
+
+  patch_rel32(exit->patch_site + 1, block->code);
+  exit->chained = true;
+  jit->chained_exits++;
+}
+
+#endif // JIT_SUPPORTED
+
+//===========================================================================================
+//                                JIT LIFECYCLE
+//===========================================================================================
+
+bool jit_init(jit_state_t* jit){
+  if (!jit){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in jit_init.\n");
+    return false;
+  }
+
+#if JIT_SUPPORTED
+  memset(jit, 0, sizeof(jit_state_t));
+
+  void* code = mmap(NULL, JIT_CODE_CACHE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  jit->blocks = (jit_block_t *) calloc(JIT_BLOCK_TABLE_SIZE, sizeof(jit_block_t));
+  jit->exits = (jit_exit_t *) calloc(JIT_MAX_EXITS, sizeof(jit_exit_t));
+  jit->hot_counters = (uint8_t *) calloc(JIT_HOT_TABLE_SIZE, sizeof(uint8_t));
+
+  if (code == MAP_FAILED || !jit->blocks || !jit->exits || !jit->hot_counters){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in jit_init.\n");
+    if (code != MAP_FAILED) munmap(code, JIT_CODE_CACHE_SIZE);
+    free(jit->blocks);
+    free(jit->exits);
+    free(jit->hot_counters);
+    memset(jit, 0, sizeof(jit_state_t));
+    return false;
+  }
+
+  jit->code = (uint8_t *) code;
+  jit->code_size = JIT_CODE_CACHE_SIZE;
+
+  // Trampoline: save callee-saved registers, rbx = cpu, r12 = jit, rbp = page flags, jump to the block
+  emitter_t e = { .cursor = jit->code };
+  jit->enter = e.cursor;
+  emit_bytes(&e, (const uint8_t[]) {0x53, 0x41, 0x54, 0x55}, 4);          // push rbx ; push r12 ; push rbp
+  emit_bytes(&e, (const uint8_t[]) {0x48, 0x89, 0xFB}, 3);                // mov rbx, rdi
+  emit_bytes(&e, (const uint8_t[]) {0x49, 0x89, 0xF4}, 3);                // mov r12, rsi
+  _Static_assert(offsetof(jit_state_t, page_flags) < 128, "disp8 load of jit->page_flags");
+  emit_bytes(&e, (const uint8_t[]) {0x49, 0x8B, 0x6C, 0x24, (uint8_t) offsetof(jit_state_t, page_flags)}, 5);  // mov rbp, [r12 + page_flags]
+  emit_bytes(&e, (const uint8_t[]) {0xFF, 0xE2}, 2);                      // jmp rdx
+
+  jit->epilogue = e.cursor;
+  emit_bytes(&e, (const uint8_t[]) {0x5D, 0x41, 0x5C, 0x5B, 0xC3}, 5);    // pop rbp ; pop r12 ; pop rbx ; ret
+
+  jit->code_used = JIT_CODE_HEADER_SIZE;
+  return true;
+#else
+  fprintf(stderr, "Error: JIT is not supported on this host in jit_init.\n");
+  return false;
+#endif
+}
+
+
+void jit_destroy(jit_state_t* jit){
+  if (!jit){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in jit_destroy.\n");
+    return;
+  }
+
+#if JIT_SUPPORTED
+  if (jit->code) munmap(jit->code, jit->code_size);
+#endif
+  free(jit->blocks);
+  free(jit->exits);
+  free(jit->hot_counters);
+  memset(jit, 0, sizeof(jit_state_t));
+}
+
+
+void jit_flush(jit_state_t* jit){
+  if (!jit || !jit->code) return;
+
+  // Trampoline and epilogue survive, every block and exit goes
+  jit->code_used = JIT_CODE_HEADER_SIZE;
+  memset(jit->blocks, 0, JIT_BLOCK_TABLE_SIZE * sizeof(jit_block_t));
+  jit->num_blocks = 0;
+  jit->num_exits = 0;
+  jit->flushes++;
+}
+
+//===========================================================================================
+//                                EXECUTION LOOP
+//===========================================================================================
+
+uint64_t jit_run(jit_state_t* jit, cpu_state_t* cpu, uint64_t max_instructions){
+  if (!jit || !cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in jit_run.\n");
+    return 0;
+  }
+
+#if JIT_SUPPORTED
+  if (cpu->watch_pages) return interpreter_run(cpu, max_instructions);   // Translated stores skip watchpoints
+  if (!jit->code){
+    if (!jit_init(jit)) return interpreter_run(cpu, max_instructions);
+    jit->generation = cpu->predecode.invalidations;
+    jit->page_flags = cpu->data_memory.page_flags;
+  }
+
+  jit_enter_fn enter = (jit_enter_fn) (void *) jit->enter;
+  uint64_t budget = max_instructions ? max_instructions : UINT64_MAX;
+  uint32_t last_exit = 0;
+  jit->remaining = budget;
+
+  while (jit->remaining && cpu->pending_event == CPU_EVENT_NONE){
+    // Instruction memory or the data memory flags changed since translation
+    if (cpu->predecode.invalidations != jit->generation || cpu->data_memory.page_flags != jit->page_flags){
+      jit_flush(jit);
+      jit->generation = cpu->predecode.invalidations;
+      jit->page_flags = cpu->data_memory.page_flags;
+      last_exit = 0;
+    }
+
+    uint32_t pc = cpu->pc;
+    jit_block_t* block = block_lookup(jit, pc);
+    if (!block && block_is_hot(jit, pc)){
+      uint64_t flushes = jit->flushes;
+      block = translate_block(jit, cpu, pc);
+      if (jit->flushes != flushes) last_exit = 0;   // Exit ids were reused
+    }
+
+    // Cold, untranslatable or longer than the budget left: interpret one block
+    if (!block || block->length > jit->remaining){
+      uint64_t length = block ? block->length : scan_block(cpu, pc, NULL);
+      if (length == 0) length = 1;                   // Lets the interpreter raise the fault
+      if (length > jit->remaining) length = jit->remaining;
+      jit->remaining -= interpreter_run(cpu, length);
+      last_exit = 0;
+      continue;
+    }
+
+    chain_exit(jit, last_exit, block);
+
+    uint64_t before = jit->remaining;
+    last_exit = enter(cpu, jit, block->code);
+    uint64_t retired = before - jit->remaining;
+
+    cpu->total_instructions += retired;
+    cpu->total_cycles += retired;       // One instruction per cycle, as in the interpreter
+    jit->native_instructions += retired;
+  }
+
+  return budget - jit->remaining;
+#else
+  return interpreter_run(cpu, max_instructions);
+#endif
+}
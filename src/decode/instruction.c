@@ -1,87 +1,365 @@
-#include "decode/instructions.h"
+#include "decode/instruction.h"
 #include <stdint.h>
-#include <stdlib.h>
 #include <stdio.h>
 
+//===========================================================================================
+//                                IMMEDIATE EXTRACTION
+//===========================================================================================
 
-instruction_t* create_instruction(uint32_t word){
-  instruction_t* instr = (instruction_t *) calloc(1, sizeof(instruction_t));
+int32_t extract_i_immediate(uint32_t instruction){
+  // imm[11:0] = inst[31:20]
+  return (int32_t) instruction >> 20;
+}
+
+
+int32_t extract_s_immediate(uint32_t instruction){
+  // imm[11:5] = inst[31:25], imm[4:0] = inst[11:7]
+  uint32_t imm = ((instruction >> 20) & 0xFE0) | ((instruction >> 7) & 0x1F);
+  return ((int32_t) (imm << 20)) >> 20;
+}
+
+
+int32_t extract_b_immediate(uint32_t instruction){
+  // imm[12] = inst[31], imm[11] = inst[7], imm[10:5] = inst[30:25], imm[4:1] = inst[11:8]
+  uint32_t imm = ((instruction >> 19) & 0x1000)
+               | ((instruction << 4) & 0x800)
+               | ((instruction >> 20) & 0x7E0)
+               | ((instruction >> 7) & 0x1E);
+  return ((int32_t) (imm << 19)) >> 19;
+}
+
+
+uint32_t extract_u_immediate(uint32_t instruction){
+  // imm[31:12] = inst[31:12]
+  return instruction & 0xFFFFF000;
+}
+
+
+int32_t extract_j_immediate(uint32_t instruction){
+  // imm[20] = inst[31], imm[19:12] = inst[19:12], imm[11] = inst[20], imm[10:1] = inst[30:21]
+  uint32_t imm = ((instruction >> 11) & 0x100000)
+               | (instruction & 0xFF000)
+               | ((instruction >> 9) & 0x800)
+               | ((instruction >> 20) & 0x7FE);
+  return ((int32_t) (imm << 11)) >> 11;
+}
+
+//===========================================================================================
+//                                INSTRUCTION DECODING
+//===========================================================================================
+
+// Decode table key: opcode[6:2], funct3 and funct7 bit 5 (SUB, SRA, SRAI), 512 entries
+#define DECODE_KEY(opcode, funct3, alt) ((((opcode) >> 2) << 4) | ((funct3) << 1) | (alt))
+#define DECODE_TABLE_SIZE 512
+
+// Decode table entry flags
+#define DECODE_VALID  0x1   // Entry holds an instruction
+#define DECODE_FUNCT7 0x2   // funct7 bits other than bit 5 must be zero (R-type, shift immediates)
+#define DECODE_SYSTEM 0x4   // rd, rs1 and imm select ECALL/EBREAK
+
+typedef struct {
+  uint8_t type;       // instruction_type_t
+  uint8_t flags;
+} decode_entry_t;
+
+#define ENTRY(type, flags) {(type), DECODE_VALID | (flags)}
+
+// One funct3, both values of funct7 bit 5 (it is immediate bits for everything but R-type and shifts)
+#define ANY_ALT(opcode, funct3, type) \
+  [DECODE_KEY(opcode, funct3, 0)] = ENTRY(type, 0), [DECODE_KEY(opcode, funct3, 1)] = ENTRY(type, 0)
+
+// Every funct3 (U-type and J-type have no funct3)
+#define ANY_FUNCT3(opcode, type)                                            \
+  ANY_ALT(opcode, 0, type), ANY_ALT(opcode, 1, type), ANY_ALT(opcode, 2, type), \
+  ANY_ALT(opcode, 3, type), ANY_ALT(opcode, 4, type), ANY_ALT(opcode, 5, type), \
+  ANY_ALT(opcode, 6, type), ANY_ALT(opcode, 7, type)
+
+// opcode, funct3, funct7 -> instruction type; zero entries are illegal encodings
+static const decode_entry_t decode_table[DECODE_TABLE_SIZE] = {
+  ANY_FUNCT3(OPCODE_LUI, INST_LUI),
+  ANY_FUNCT3(OPCODE_AUIPC, INST_AUIPC),
+  ANY_FUNCT3(OPCODE_JAL, INST_JAL),
+  ANY_ALT(OPCODE_JALR, 0, INST_JALR),
+
+  ANY_ALT(OPCODE_BRANCH, FUNCT3_BEQ, INST_BEQ),
+  ANY_ALT(OPCODE_BRANCH, FUNCT3_BNE, INST_BNE),
+  ANY_ALT(OPCODE_BRANCH, FUNCT3_BLT, INST_BLT),
+  ANY_ALT(OPCODE_BRANCH, FUNCT3_BGE, INST_BGE),
+  ANY_ALT(OPCODE_BRANCH, FUNCT3_BLTU, INST_BLTU),
+  ANY_ALT(OPCODE_BRANCH, FUNCT3_BGEU, INST_BGEU),
+
+  ANY_ALT(OPCODE_LOAD, FUNCT3_BYTE, INST_LB),
+  ANY_ALT(OPCODE_LOAD, FUNCT3_HALF, INST_LH),
+  ANY_ALT(OPCODE_LOAD, FUNCT3_WORD, INST_LW),
+  ANY_ALT(OPCODE_LOAD, FUNCT3_BYTE_U, INST_LBU),
+  ANY_ALT(OPCODE_LOAD, FUNCT3_HALF_U, INST_LHU),
+
+  ANY_ALT(OPCODE_STORE, FUNCT3_BYTE, INST_SB),
+  ANY_ALT(OPCODE_STORE, FUNCT3_HALF, INST_SH),
+  ANY_ALT(OPCODE_STORE, FUNCT3_WORD, INST_SW),
+
+  ANY_ALT(OPCODE_OP_IMM, FUNCT3_ADD_SUB, INST_ADDI),
+  ANY_ALT(OPCODE_OP_IMM, FUNCT3_SLT, INST_SLTI),
+  ANY_ALT(OPCODE_OP_IMM, FUNCT3_SLTU, INST_SLTIU),
+  ANY_ALT(OPCODE_OP_IMM, FUNCT3_XOR, INST_XORI),
+  ANY_ALT(OPCODE_OP_IMM, FUNCT3_OR, INST_ORI),
+  ANY_ALT(OPCODE_OP_IMM, FUNCT3_AND, INST_ANDI),
+  [DECODE_KEY(OPCODE_OP_IMM, FUNCT3_SLL, 0)] = ENTRY(INST_SLLI, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP_IMM, FUNCT3_SRL_SRA, 0)] = ENTRY(INST_SRLI, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP_IMM, FUNCT3_SRL_SRA, 1)] = ENTRY(INST_SRAI, DECODE_FUNCT7),
+
+  [DECODE_KEY(OPCODE_OP, FUNCT3_ADD_SUB, 0)] = ENTRY(INST_ADD, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_ADD_SUB, 1)] = ENTRY(INST_SUB, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_SLL, 0)] = ENTRY(INST_SLL, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_SLT, 0)] = ENTRY(INST_SLT, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_SLTU, 0)] = ENTRY(INST_SLTU, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_XOR, 0)] = ENTRY(INST_XOR, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_SRL_SRA, 0)] = ENTRY(INST_SRL, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_SRL_SRA, 1)] = ENTRY(INST_SRA, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_OR, 0)] = ENTRY(INST_OR, DECODE_FUNCT7),
+  [DECODE_KEY(OPCODE_OP, FUNCT3_AND, 0)] = ENTRY(INST_AND, DECODE_FUNCT7),
+
+  ANY_ALT(OPCODE_MISC_MEM, 0, INST_FENCE),
+  [DECODE_KEY(OPCODE_SYSTEM, 0, 0)] = ENTRY(INST_ECALL, DECODE_SYSTEM)
+};
+
+// opcode[6:2] -> format; unused opcodes stay FORMAT_R
+static const uint8_t format_table[32] = {
+  [OPCODE_LUI >> 2] = FORMAT_U,    [OPCODE_AUIPC >> 2] = FORMAT_U,  [OPCODE_JAL >> 2] = FORMAT_J,
+  [OPCODE_JALR >> 2] = FORMAT_I,   [OPCODE_BRANCH >> 2] = FORMAT_B, [OPCODE_LOAD >> 2] = FORMAT_I,
+  [OPCODE_STORE >> 2] = FORMAT_S,  [OPCODE_OP_IMM >> 2] = FORMAT_I, [OPCODE_OP >> 2] = FORMAT_R,
+  [OPCODE_MISC_MEM >> 2] = FORMAT_I, [OPCODE_SYSTEM >> 2] = FORMAT_I
+};
+
+#undef ANY_FUNCT3
+#undef ANY_ALT
+#undef ENTRY
+
+
+instruction_t decode_instruction(uint32_t raw_instruction, uint32_t pc){
+  instruction_t inst = {0};
+
+  // Raw fields
+  inst.raw_instruction = raw_instruction;
+  inst.pc = pc;
+  inst.opcode = raw_instruction & 0x7F;
+  inst.rd     = (raw_instruction >> 7) & 0x1F;
+  inst.funct3 = (raw_instruction >> 12) & 0x07;
+  inst.rs1    = (raw_instruction >> 15) & 0x1F;
+  inst.rs2    = (raw_instruction >> 20) & 0x1F;
+  inst.funct7 = (raw_instruction >> 25) & 0x7F;
+
+  // Immediates for every format (only the one matching the format is meaningful)
+  inst.imm_i = extract_i_immediate(raw_instruction);
+  inst.imm_s = extract_s_immediate(raw_instruction);
+  inst.imm_b = extract_b_immediate(raw_instruction);
+  inst.imm_u = extract_u_immediate(raw_instruction);
+  inst.imm_j = extract_j_immediate(raw_instruction);
 
-  // Error check
-  if(!instr){
-    fprintf(stderr, "Error memory allocation\n");
-    return NULL;
+  // One lookup; 32-bit encodings have opcode[1:0] = 11
+  bool full_length = (inst.opcode & 0x3) == 0x3;
+  uint32_t key = (((raw_instruction >> 2) & 0x1F) << 4) | (((raw_instruction >> 12) & 0x7) << 1) |
+                 ((raw_instruction >> 30) & 0x1);
+  decode_entry_t entry = decode_table[key];
+  bool funct7_ok = !(entry.flags & DECODE_FUNCT7) | !(inst.funct7 & ~FUNCT7_ALT);
+  bool valid = full_length & (entry.flags & DECODE_VALID) & funct7_ok;
+  inst.format = full_length ? (instruction_format_t) format_table[(raw_instruction >> 2) & 0x1F] : FORMAT_R;
+  inst.type = valid ? (instruction_type_t) entry.type : INST_INVALID;
+
+  // ECALL and EBREAK differ only in the immediate, everything else must be zero
+  if (valid && (entry.flags & DECODE_SYSTEM)){
+    if (inst.rd != 0 || inst.rs1 != 0 || (inst.imm_i != SYSTEM_ECALL && inst.imm_i != SYSTEM_EBREAK)){
+      inst.type = INST_INVALID;
+    }
+    else if (inst.imm_i == SYSTEM_EBREAK){
+      inst.type = INST_EBREAK;
+    }
   }
 
-  instr->word = word;
-  return instr;
+  inst.is_valid = inst.type != INST_INVALID;
+  return inst;
 }
 
+//===========================================================================================
+//                                CONTROL SIGNALS
+//===========================================================================================
+
+// Control signal templates, rows by kind of instruction
+#define ALU_REG(op) {.reg_write_enable = true, .alu_op = (op)}
+#define ALU_IMM(op) {.reg_write_enable = true, .alu_op = (op), .alu_src_b_is_immediate = true}
+#define LOAD(size, unsigned_load)                                                           \
+  {.reg_write_enable = true, .reg_write_source = 1, .alu_op = ALU_ADD, .alu_src_b_is_immediate = true, \
+   .mem_op = MEM_READ, .mem_size = (size), .mem_load_unsigned = (unsigned_load), .causes_stall = true}
+#define STORE(size) {.alu_op = ALU_ADD, .alu_src_b_is_immediate = true, .mem_op = MEM_WRITE, .mem_size = (size)}
+#define BRANCH {.alu_op = ALU_SUB, .is_branch = true, .pc_source = 1}
+#define JUMP(jump_register)                                                                 \
+  {.reg_write_enable = true, .reg_write_source = 2, .alu_op = ALU_ADD, .alu_src_b_is_immediate = true, \
+   .is_jump = true, .is_jump_register = (jump_register), .pc_source = 2, .flushes_pipeline = true}
+
+// Instruction type -> control signals, except that x0 is never written
+static const control_signals_t control_table[INST_INVALID + 1] = {
+  // R-type arithmetic: rd = rs1 op rs2
+  [INST_ADD] = ALU_REG(ALU_ADD),   [INST_SUB] = ALU_REG(ALU_SUB),   [INST_SLL] = ALU_REG(ALU_SLL),
+  [INST_SLT] = ALU_REG(ALU_SLT),   [INST_SLTU] = ALU_REG(ALU_SLTU), [INST_XOR] = ALU_REG(ALU_XOR),
+  [INST_SRL] = ALU_REG(ALU_SRL),   [INST_SRA] = ALU_REG(ALU_SRA),   [INST_OR] = ALU_REG(ALU_OR),
+  [INST_AND] = ALU_REG(ALU_AND),
+
+  // I-type arithmetic: rd = rs1 op imm
+  [INST_ADDI] = ALU_IMM(ALU_ADD),  [INST_SLTI] = ALU_IMM(ALU_SLT),  [INST_SLTIU] = ALU_IMM(ALU_SLTU),
+  [INST_XORI] = ALU_IMM(ALU_XOR),  [INST_ORI] = ALU_IMM(ALU_OR),    [INST_ANDI] = ALU_IMM(ALU_AND),
+  [INST_SLLI] = ALU_IMM(ALU_SLL),  [INST_SRLI] = ALU_IMM(ALU_SRL),  [INST_SRAI] = ALU_IMM(ALU_SRA),
+
+  // Upper immediates (AUIPC adds the PC in execute)
+  [INST_LUI] = ALU_IMM(ALU_COPY_B), [INST_AUIPC] = ALU_IMM(ALU_ADD),
+
+  // Loads: rd = mem[rs1 + imm]
+  [INST_LB] = LOAD(MEM_SIZE_BYTE, false),      [INST_LBU] = LOAD(MEM_SIZE_BYTE, true),
+  [INST_LH] = LOAD(MEM_SIZE_HALFWORD, false),  [INST_LHU] = LOAD(MEM_SIZE_HALFWORD, true),
+  [INST_LW] = LOAD(MEM_SIZE_WORD, false),
+
+  // Stores: mem[rs1 + imm] = rs2
+  [INST_SB] = STORE(MEM_SIZE_BYTE), [INST_SH] = STORE(MEM_SIZE_HALFWORD), [INST_SW] = STORE(MEM_SIZE_WORD),
+
+  // Branches compare rs1 and rs2, target = PC + imm
+  [INST_BEQ] = BRANCH, [INST_BNE] = BRANCH,  [INST_BLT] = BRANCH,
+  [INST_BGE] = BRANCH, [INST_BLTU] = BRANCH, [INST_BGEU] = BRANCH,
+
+  // Jumps write PC+4 to rd
+  [INST_JAL] = JUMP(false), [INST_JALR] = JUMP(true),
 
-void destroy_instruction(instruction_t* instr){
-  if (!instr) return;
-  free(instr);
+  // System and memory ordering
+  [INST_ECALL] = {.is_system_call = true},
+  [INST_EBREAK] = {.is_breakpoint = true},
+  [INST_FENCE] = {.is_fence = true}
+};
+
+#undef ALU_REG
+#undef ALU_IMM
+#undef LOAD
+#undef STORE
+#undef BRANCH
+#undef JUMP
+
+
+control_signals_t generate_control_signals(const instruction_t* instruction){
+  if (!instruction){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in generate_control_signals.\n");
+    return (control_signals_t) {0};
+  }
+
+  unsigned type = (unsigned) instruction->type <= INST_INVALID ? (unsigned) instruction->type : INST_INVALID;
+  control_signals_t ctrl = control_table[type];
+  ctrl.reg_write_enable = ctrl.reg_write_enable && instruction->rd != 0;
+  return ctrl;
 }
 
+//===========================================================================================
+//                                MICRO-OPS
+//===========================================================================================
+
+micro_op_t generate_micro_op(const instruction_t* instruction, const control_signals_t* control){
+  micro_op_t op = {0};
+  if (!instruction || !control){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in generate_micro_op.\n");
+    return op;
+  }
 
-void print_instruction(instruction_t* instr){
-  if(!instr){
-    fprintf(stderr, "Error Invalid input\n");
+  op.pc = instruction->pc;
+  op.raw_instruction = instruction->raw_instruction;
+  switch (instruction->format){
+    case FORMAT_I: op.immediate = instruction->imm_i; break;
+    case FORMAT_S: op.immediate = instruction->imm_s; break;
+    case FORMAT_B: op.immediate = instruction->imm_b; break;
+    case FORMAT_U: op.immediate = (int32_t) instruction->imm_u; break;
+    case FORMAT_J: op.immediate = instruction->imm_j; break;
+    case FORMAT_R: op.immediate = 0; break;
+  }
+
+  op.rd = instruction->rd;
+  op.alu_op = control->alu_op;
+  op.funct3 = instruction->funct3;
+  op.reg_write_enable = control->reg_write_enable;
+  op.reg_write_source = control->reg_write_source;
+  op.alu_src_a_is_pc = instruction->type == INST_AUIPC;
+  op.alu_src_b_is_immediate = control->alu_src_b_is_immediate;
+  op.mem_op = control->mem_op;
+  op.mem_size = control->mem_size;
+  op.mem_load_unsigned = control->mem_load_unsigned;
+  op.is_branch = control->is_branch;
+  op.is_jump = control->is_jump;
+  op.is_jump_register = control->is_jump_register;
+  op.is_system_call = control->is_system_call;
+  op.is_breakpoint = control->is_breakpoint;
+  op.is_fence = control->is_fence;
+  op.is_valid = instruction->is_valid;
+  return op;
+}
+
+//===========================================================================================
+//                                DEBUG FUNCTIONS
+//===========================================================================================
+
+const char* instruction_type_name(instruction_type_t type){
+  static const char* names[] = {
+    [INST_ADD] = "ADD",     [INST_SUB] = "SUB",     [INST_SLL] = "SLL",
+    [INST_SLT] = "SLT",     [INST_SLTU] = "SLTU",   [INST_XOR] = "XOR",
+    [INST_SRL] = "SRL",     [INST_SRA] = "SRA",     [INST_OR] = "OR",
+    [INST_AND] = "AND",     [INST_ADDI] = "ADDI",   [INST_SLTI] = "SLTI",
+    [INST_SLTIU] = "SLTIU", [INST_XORI] = "XORI",   [INST_ORI] = "ORI",
+    [INST_ANDI] = "ANDI",   [INST_SLLI] = "SLLI",   [INST_SRLI] = "SRLI",
+    [INST_SRAI] = "SRAI",   [INST_LB] = "LB",       [INST_LH] = "LH",
+    [INST_LW] = "LW",       [INST_LBU] = "LBU",     [INST_LHU] = "LHU",
+    [INST_JALR] = "JALR",   [INST_SB] = "SB",       [INST_SH] = "SH",
+    [INST_SW] = "SW",       [INST_BEQ] = "BEQ",     [INST_BNE] = "BNE",
+    [INST_BLT] = "BLT",     [INST_BGE] = "BGE",     [INST_BLTU] = "BLTU",
+    [INST_BGEU] = "BGEU",   [INST_LUI] = "LUI",     [INST_AUIPC] = "AUIPC",
+    [INST_JAL] = "JAL",     [INST_ECALL] = "ECALL", [INST_EBREAK] = "EBREAK",
+    [INST_FENCE] = "FENCE", [INST_NOP] = "NOP",     [INST_INVALID] = "INVALID"
+  };
+
+  if ((unsigned) type > INST_INVALID) return "INVALID";
+  return names[type];
+}
+
+
+const char* instruction_to_string(const instruction_t* instruction){
+  if (!instruction) return "NULL";
+  return instruction_type_name(instruction->type);
+}
+
+
+void print_instruction_detailed(const instruction_t* instruction){
+  if (!instruction){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in print_instruction_detailed.\n");
     return;
   }
 
-  //Getting opcode
-  uint32_t opcode = instr->r_type.opcode;
-
-  switch(opcode){
-    case OP_RTYPE:
-      // Check function code for R-type
-      switch(instr->r_type.funct){
-        case FUNCT_ADD:
-          // Format: ADD $rd, $rs, $rt
-          printf("ADD $%d, $%d, $%d", instr->r_type.rd, instr->r_type.rs, instr->r_type.rt);
-          break;
-        case FUNCT_SUB:
-          // Format: SUB $rd, $rs, $rt
-          printf("SUB $%d, $%d, $%d", instr->r_type.rd, instr->r_type.rs, instr->r_type.rt);
-          break;
-        case FUNCT_AND:
-          // Format: AND $rd, $rs, $rt
-          printf("AND $%d, $%d, $%d", instr->r_type.rd, instr->r_type.rs, instr->r_type.rt);
-          break;
-        case FUNCT_OR:
-          // Format: OR $rd, $rs, $rt
-          printf("OR $%d, $%d, $%d", instr->r_type.rd, instr->r_type.rs, instr->r_type.rt);
-          break;
-        // add more funct
-      }
+  printf("0x%08x: 0x%08x  %-6s ", instruction->pc, instruction->raw_instruction,
+         instruction_to_string(instruction));
+
+  switch (instruction->format){
+    case FORMAT_R:
+      printf("x%d, x%d, x%d\n", instruction->rd, instruction->rs1, instruction->rs2);
       break;
-    case OP_ADDI:
-      // Format: ADDI $rt, $rs, immediate
-      int16_t signed_imm = (int16_t)instr->i_type.immediate;
-      printf("ADDI $%d, $%d, %d", instr->i_type.rt, instr->i_type.rs, signed_imm);
+    case FORMAT_I:
+      if (instruction->opcode == OPCODE_LOAD || instruction->opcode == OPCODE_JALR){
+        printf("x%d, %d(x%d)\n", instruction->rd, instruction->imm_i, instruction->rs1);
+      }
+      else {
+        printf("x%d, x%d, %d\n", instruction->rd, instruction->rs1, instruction->imm_i);
+      }
       break;
-    case OP_LW:
-      // Format: LOAD WORD $rt, $rs, immediate
-      printf("LW $%d, $%d($%d)", instr->i_type.rt, instr->i_type.rs, instr->i_type.immediate);
+    case FORMAT_S:
+      printf("x%d, %d(x%d)\n", instruction->rs2, instruction->imm_s, instruction->rs1);
       break;
-    case OP_SW:
-      // Format: STORE WORD $rt, $rs, immediate
-      printf("SW $%d, $%d($%d)", instr->i_type.rt, instr->i_type.rs, instr->i_type.immediate);
+    case FORMAT_B:
+      printf("x%d, x%d, %d\n", instruction->rs1, instruction->rs2, instruction->imm_b);
       break;
-    case OP_BEQ:
-      // Format: BRANCH IF EQUAL $rt, $rs, immediate
-      printf("BEQ $%d, $%d, $%d", instr->i_type.rt, instr->i_type.rs, instr->i_type.immediate);
+    case FORMAT_U:
+      printf("x%d, 0x%05x\n", instruction->rd, instruction->imm_u >> 12);
       break;
-    case OP_J:
-      // Format: JUMP $address
-      printf("J %d", instr->j_type.address);
+    case FORMAT_J:
+      printf("x%d, %d\n", instruction->rd, instruction->imm_j);
       break;
-    // add more opcodes
-    default:
-      printf("UNKNOWN");
-      return;
   }
-
-  printf("\n");
 }
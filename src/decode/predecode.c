@@ -0,0 +1,157 @@
+#include "decode/predecode.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+// Slot of an allocated page
+static inline predecode_page_t** predecode_slot(const predecode_cache_t* cache, size_t page_index){
+  return &cache->tables[page_index >> PREDECODE_TABLE_SHIFT][page_index & (PREDECODE_PAGES_PER_TABLE - 1)];
+}
+
+
+// Slot of a page about to be allocated, NULL if its table cannot be
+static predecode_page_t** predecode_new_slot(predecode_cache_t* cache, size_t page_index){
+  predecode_page_t*** table = &cache->tables[page_index >> PREDECODE_TABLE_SHIFT];
+  if (!*table) *table = (predecode_page_t **) calloc(PREDECODE_PAGES_PER_TABLE, sizeof(predecode_page_t *));
+  if (!*table) return NULL;
+
+  if (cache->num_populated == cache->populated_capacity){
+    size_t capacity = cache->populated_capacity ? cache->populated_capacity * 2 : 16;
+    uint32_t* populated = (uint32_t *) realloc(cache->populated, capacity * sizeof(uint32_t));
+    if (!populated) return NULL;
+    cache->populated = populated;
+    cache->populated_capacity = capacity;
+  }
+  return &(*table)[page_index & (PREDECODE_PAGES_PER_TABLE - 1)];
+}
+
+
+// Decode into the slot for PCs without a cache page
+static const predecoded_instruction_t* predecode_scratch(predecode_cache_t* cache, uint32_t pc, uint32_t raw_instruction){
+  cache->scratch.instruction = decode_instruction(raw_instruction, pc);
+  cache->scratch.control = generate_control_signals(&cache->scratch.instruction);
+  cache->scratch.micro_op = generate_micro_op(&cache->scratch.instruction, &cache->scratch.control);
+  return &cache->scratch;
+}
+
+//===========================================================================================
+//                                CACHE LIFECYCLE
+//===========================================================================================
+
+bool predecode_init(predecode_cache_t* cache, uint32_t base_address, size_t size){
+  if (!cache){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in predecode_init.\n");
+    return false;
+  }
+
+  memset(cache, 0, sizeof(predecode_cache_t));
+  cache->base_address = base_address;
+  cache->num_pages = (size + PREDECODE_PAGE_SIZE - 1) >> PREDECODE_PAGE_SHIFT;
+  cache->num_tables = (cache->num_pages + PREDECODE_PAGES_PER_TABLE - 1) >> PREDECODE_TABLE_SHIFT;
+
+  // Only the directory is allocated up front, tables and pages come in on first decode
+  cache->tables = (predecode_page_t ***) calloc(cache->num_tables, sizeof(predecode_page_t **));
+  if (!cache->tables){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in predecode_init.\n");
+    cache->num_tables = 0;
+    cache->num_pages = 0;
+    return false;
+  }
+
+  return true;
+}
+
+
+void predecode_destroy(predecode_cache_t* cache){
+  if (!cache){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in predecode_destroy.\n");
+    return;
+  }
+
+  for (size_t i = 0; i < cache->num_populated; ++i){
+    free(*predecode_slot(cache, cache->populated[i]));
+  }
+  for (size_t i = 0; i < cache->num_tables; ++i){
+    free(cache->tables[i]);
+  }
+  free(cache->tables);
+  free(cache->populated);
+  cache->tables = NULL;
+  cache->populated = NULL;
+  cache->num_tables = 0;
+  cache->num_pages = 0;
+  cache->num_populated = 0;
+  cache->populated_capacity = 0;
+}
+
+//===========================================================================================
+//                                CACHE FILL
+//===========================================================================================
+
+const predecoded_instruction_t* predecode_insert(predecode_cache_t* cache, uint32_t pc, uint32_t raw_instruction){
+  cache->misses++;
+
+  uint32_t offset = pc - cache->base_address;
+  size_t page_index = offset >> PREDECODE_PAGE_SHIFT;
+
+  // Outside the covered range (or misaligned): decode without caching
+  if (page_index >= cache->num_pages || (pc & 0x3)) return predecode_scratch(cache, pc, raw_instruction);
+
+  predecode_page_t* page = cache->tables[page_index >> PREDECODE_TABLE_SHIFT] ? *predecode_slot(cache, page_index) : NULL;
+  if (!page){
+    predecode_page_t** slot = predecode_new_slot(cache, page_index);
+    page = slot ? (predecode_page_t *) malloc(sizeof(predecode_page_t)) : NULL;
+    if (!page){ // Error Check, fall back to uncached decode
+      fprintf(stderr, "Error: Memory allocation error in predecode_insert.\n");
+      return predecode_scratch(cache, pc, raw_instruction);
+    }
+    memset(page->valid, 0, sizeof(page->valid));
+    *slot = page;
+    cache->populated[cache->num_populated++] = (uint32_t) page_index;
+  }
+
+  uint32_t slot = (offset & (PREDECODE_PAGE_SIZE - 1)) >> 2;
+  predecoded_instruction_t* entry = &page->entries[slot];
+  entry->instruction = decode_instruction(raw_instruction, pc);
+  entry->control = generate_control_signals(&entry->instruction);
+  entry->micro_op = generate_micro_op(&entry->instruction, &entry->control);
+  page->valid[slot >> 6] |= 1ull << (slot & 63);
+
+  return entry;
+}
+
+//===========================================================================================
+//                                INVALIDATION
+//===========================================================================================
+
+void predecode_invalidate(predecode_cache_t* cache, uint32_t address){
+  if (!cache) return;
+
+  size_t page_index = (address - cache->base_address) >> PREDECODE_PAGE_SHIFT;
+  if (page_index >= cache->num_pages || !cache->tables[page_index >> PREDECODE_TABLE_SHIFT]) return;
+  predecode_page_t* page = *predecode_slot(cache, page_index);
+  if (!page) return;
+
+  // Drop the whole page, it gets re-decoded lazily
+  memset(page->valid, 0, sizeof(page->valid));
+  cache->invalidations++;
+}
+
+
+void predecode_invalidate_all(predecode_cache_t* cache){
+  if (!cache) return;
+
+  // Only allocated pages, a sparse address space has far more slots than code
+  for (size_t i = 0; i < cache->num_populated; ++i){
+    predecode_page_t* page = *predecode_slot(cache, cache->populated[i]);
+    memset(page->valid, 0, sizeof(page->valid));
+  }
+
+  // Counted even with no page decoded, the JIT translation cache follows this count
+  cache->invalidations++;
+}
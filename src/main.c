@@ -1,5 +1,211 @@
-#include <assert.h>
+#include "pipeline/timing.h"
+#include "utils/batch.h"
+#include "utils/gdbstub.h"
+#include "utils/multihart.h"
+#include "utils/sampling.h"
+#include "utils/simulator.h"
+#include "utils/sweep.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-int main(void){
-  return 0;
+/*
+ * risc program.elf [key=value ...]        run one program, print status and stats
+ * risc --batch manifest [threads=N]       run every job of a manifest in parallel
+ * risc --replay trace.bin [key=value ...] pipeline timing of a recorded trace, no execution
+ *
+ * sample_* options switch a single run to sampled simulation (sample_interval=N),
+ * or to writing basic-block vectors (sample_bbv=file), see sampling.h.
+ * profile_json=file / profile_csv=file write per-PC counters after the run.
+ * trace_file=file writes a binary trace from a writer thread (trace_ring=N records
+ * in flight, 0 = write inline; trace_full=block|drop|sample when it falls behind).
+ * syscalls=1 services ECALL as a Linux system call (newlib/picolibc programs).
+ * single_step=1 starts the interactive debugger instead, which also steps backward
+ * (reverse_log, reverse_interval, reverse_checkpoints), see reverse.h.
+ * gdb=PORT|host:port|unix:PATH waits for a GDB connection instead, see gdbstub.h;
+ * after a detach the program runs on to the end.
+ * harts=N runs N harts on one shared memory (hart_quantum, hart_deterministic,
+ * hart_stack), see multihart.h.
+ * sweep_points=file runs the program once in functional mode and replays it in every
+ * cache/predictor configuration of the file (sweep_threads, sweep_ring), see sweep.h.
+ * --replay takes the cache and predictor options (l1i_*, l1d_*, predictor, bp_*),
+ * see timing.h; a trace recorded in functional mode replays in pipeline timing.
+ */
+
+static void print_usage(const char* name){
+  fprintf(stderr, "Usage: %s program.elf [key=value ...]\n", name);
+  fprintf(stderr, "       %s --batch manifest [threads=N]\n", name);
+  fprintf(stderr, "       %s --replay trace.bin [key=value ...]\n", name);
+}
+
+
+static int run_batch(const char* filename, int argc, char** argv){
+  size_t threads = 0;
+  for (int i = 0; i < argc; ++i){
+    char* end;
+    if (strncmp(argv[i], "threads=", 8) != 0 || (threads = strtoul(argv[i] + 8, &end, 0), *end != '\0')){
+      fprintf(stderr, "Error: Invalid batch option '%s'.\n", argv[i]);
+      return 2;
+    }
+  }
+
+  batch_manifest_t manifest = {0};
+  if (!batch_manifest_load(&manifest, filename)){
+    batch_manifest_destroy(&manifest);
+    return 1;
+  }
+  bool ran = batch_run(&manifest, threads, batch_print_result, stdout);
+  batch_manifest_destroy(&manifest);
+  return ran ? 0 : 1;
+}
+
+
+static int run_replay(const char* filename, int argc, char** argv){
+  simulator_config_t config;
+  simulator_default_config(&config);
+  for (int i = 0; i < argc; ++i){
+    if (!simulator_parse_option(&config, argv[i])) return 2;
+  }
+
+  timing_model_t model;
+  if (!timing_model_init(&model, &config)) return 1;
+  bool replayed = timing_replay(&model, filename);
+  if (replayed) timing_model_print_stats(&model);
+  timing_model_destroy(&model);
+  return replayed ? 0 : 1;
+}
+
+
+static void run_gdb(simulator_t* sim, const char* address){
+  gdbstub_t* stub = (gdbstub_t *) malloc(sizeof(gdbstub_t));
+  if (!stub || !gdbstub_init(stub, sim, address)){ // Error Check
+    free(stub);
+    return;
+  }
+
+  bool detached = gdbstub_serve(stub);
+  gdbstub_print_stats(stub, stdout);
+  gdbstub_destroy(stub);
+  free(stub);
+  if (detached) simulator_run(sim);
+}
+
+
+static int run_harts(const char* filename, const simulator_config_t* config, const multihart_config_t* harts){
+  multihart_t mh;
+  if (!multihart_init(&mh, harts, config)) return 1;
+
+  int status = 1;
+  if (multihart_load_program(&mh, filename)){
+    multihart_run(&mh);
+    simulator_t* hart0 = &mh.harts[0];
+    simulator_print_status(hart0);
+    multihart_print_stats(&mh, stdout);
+    if (config->profile_json || config->profile_csv) simulator_export_profile(hart0);
+    status = hart0->stop_reason == STOP_EXIT ? (int) (hart0->exit_code & 0xFF) : 1;
+  }
+
+  multihart_destroy(&mh);
+  return status;
+}
+
+
+static int run_sweep(const char* filename, simulator_config_t* config, sweep_t* sweep){
+  if (!sweep_load_points(sweep, config, sweep->points_file)) return 2;
+
+  // One functional run feeds every timing model
+  config->execution_mode = EXEC_MODE_FUNCTIONAL;
+  config->enable_tracing = true;
+  simulator_t* sim = (simulator_t *) malloc(sizeof(simulator_t));
+  if (!sim || !simulator_init(sim, config)){ // Error Check
+    free(sim);
+    return 1;
+  }
+
+  int status = 1;
+  if (simulator_load_program(sim, filename) && sweep_run(sweep, sim)){
+    simulator_print_status(sim);
+    sweep_print_results(sweep, stdout);
+    status = sim->stop_reason == STOP_EXIT ? (int) (sim->exit_code & 0xFF) : 1;
+  }
+
+  simulator_destroy(sim);
+  free(sim);
+  return status;
+}
+
+
+static int run_program(const char* filename, int argc, char** argv){
+  simulator_config_t config;
+  sampling_config_t sampling;
+  multihart_config_t harts;
+  sweep_t sweep;
+  simulator_default_config(&config);
+  sampling_default_config(&sampling);
+  multihart_default_config(&harts);
+  sweep_init(&sweep);
+  for (int i = 0; i < argc; ++i){
+    bool parsed = strncmp(argv[i], "sample_", 7) == 0 ? sampling_parse_option(&sampling, argv[i])
+                : strncmp(argv[i], "hart", 4) == 0    ? multihart_parse_option(&harts, argv[i])
+                : strncmp(argv[i], "sweep_", 6) == 0  ? sweep_parse_option(&sweep, argv[i])
+                : simulator_parse_option(&config, argv[i]);
+    if (!parsed) return 2;
+  }
+  if (harts.num_harts > 1) return run_harts(filename, &config, &harts);
+  if (sweep.points_file){
+    int status = run_sweep(filename, &config, &sweep);
+    sweep_destroy(&sweep);
+    return status;
+  }
+
+  simulator_t* sim = (simulator_t *) malloc(sizeof(simulator_t));
+  if (!sim || !simulator_init(sim, &config)){ // Error Check
+    free(sim);
+    return 1;
+  }
+
+  int status = 1;
+  if (simulator_load_program(sim, filename)){
+    sampling_result_t result = {0};
+    bool sampled = false;
+    if (sampling.bbv_file) sampling_profile_bbv(sim, &sampling);
+    else if (sampling.interval) sampled = sampling_run(sim, &sampling, &result);
+    else if (config.gdb_listen) run_gdb(sim, config.gdb_listen);
+    else if (config.single_step) simulator_interactive_mode(sim);
+    else simulator_run(sim);
+
+    simulator_print_status(sim);
+    if (sampled) sampling_print_result(&result, stdout);
+    else if (!sampling.bbv_file) simulator_print_performance_stats(sim);
+    sampling_result_destroy(&result);
+    if (config.profile_json || config.profile_csv) simulator_export_profile(sim);
+    status = sim->stop_reason == STOP_EXIT ? (int) (sim->exit_code & 0xFF) : 1;
+  }
+
+  simulator_destroy(sim);
+  free(sim);
+  return status;
+}
+
+
+int main(int argc, char** argv){
+  if (argc < 2){
+    print_usage(argv[0]);
+    return 2;
+  }
+  if (strcmp(argv[1], "--batch") == 0){
+    if (argc < 3){
+      print_usage(argv[0]);
+      return 2;
+    }
+    return run_batch(argv[2], argc - 3, argv + 3);
+  }
+  if (strcmp(argv[1], "--replay") == 0){
+    if (argc < 3){
+      print_usage(argv[0]);
+      return 2;
+    }
+    return run_replay(argv[2], argc - 3, argv + 3);
+  }
+  return run_program(argv[1], argc - 2, argv + 2);
 }
@@ -0,0 +1,214 @@
+#include "memory/cache.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static inline bool is_power_of_two(uint32_t value){
+  return value && !(value & (value - 1));
+}
+
+
+static inline uint32_t log2_u32(uint32_t value){
+  return 31u - (uint32_t) __builtin_clz(value);
+}
+
+
+static inline uint32_t next_random(cache_t* cache){
+  uint32_t x = cache->random;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  cache->random = x;
+  return x;
+}
+
+//===========================================================================================
+//                                CACHE LIFECYCLE
+//===========================================================================================
+
+bool cache_init(cache_t* cache, const cache_config_t* config){
+  if (!cache || !config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cache_init.\n");
+    return false;
+  }
+
+  memset(cache, 0, sizeof(cache_t));
+  cache->config = *config;
+  if (!config->size) return true;   // Disabled
+
+  if (!config->ways || !is_power_of_two(config->line_size) ||
+      config->size % (config->ways * config->line_size) != 0 ||
+      !is_power_of_two(config->size / (config->ways * config->line_size))){
+    fprintf(stderr, "Error: Invalid geometry %u B / %u ways / %u B lines in cache_init.\n",
+            config->size, config->ways, config->line_size);
+    return false;
+  }
+
+  cache->num_sets = config->size / (config->ways * config->line_size);
+  cache->line_shift = log2_u32(config->line_size);
+
+  size_t entries = (size_t) cache->num_sets * config->ways;
+  cache->tags = (uint32_t *) malloc(entries * sizeof(uint32_t));
+  cache->stamps = (uint64_t *) malloc(entries * sizeof(uint64_t));
+  cache->dirty = (uint8_t *) malloc(entries * sizeof(uint8_t));
+  if (!cache->tags || !cache->stamps || !cache->dirty){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in cache_init.\n");
+    cache_destroy(cache);
+    return false;
+  }
+
+  cache_reset(cache);
+  return true;
+}
+
+
+void cache_destroy(cache_t* cache){
+  if (!cache){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cache_destroy.\n");
+    return;
+  }
+
+  free(cache->tags);
+  free(cache->stamps);
+  free(cache->dirty);
+  cache->tags = NULL;
+  cache->stamps = NULL;
+  cache->dirty = NULL;
+}
+
+
+void cache_reset(cache_t* cache){
+  if (!cache){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cache_reset.\n");
+    return;
+  }
+
+  if (cache->tags){
+    size_t entries = (size_t) cache->num_sets * cache->config.ways;
+    memset(cache->tags, 0xFF, entries * sizeof(uint32_t));   // CACHE_INVALID_TAG
+    memset(cache->stamps, 0, entries * sizeof(uint64_t));
+    memset(cache->dirty, 0, entries * sizeof(uint8_t));
+  }
+  cache->clock = 0;
+  cache->random = 0x9E3779B9u;
+  cache->hits = 0;
+  cache->misses = 0;
+  cache->evictions = 0;
+  cache->writebacks = 0;
+}
+
+
+// Contents and statistics, the destination arrays are reallocated if the geometry differs
+bool cache_copy(cache_t* destination, const cache_t* source){
+  if (!destination || !source){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cache_copy.\n");
+    return false;
+  }
+
+  if (destination->num_sets != source->num_sets || destination->config.ways != source->config.ways ||
+      !destination->tags != !source->tags){
+    cache_destroy(destination);
+    if (!cache_init(destination, &source->config)) return false;
+  }
+
+  uint32_t* tags = destination->tags;
+  uint64_t* stamps = destination->stamps;
+  uint8_t* dirty = destination->dirty;
+  *destination = *source;
+  destination->tags = tags;
+  destination->stamps = stamps;
+  destination->dirty = dirty;
+
+  if (source->tags){
+    size_t entries = (size_t) source->num_sets * source->config.ways;
+    memcpy(tags, source->tags, entries * sizeof(uint32_t));
+    memcpy(stamps, source->stamps, entries * sizeof(uint64_t));
+    memcpy(dirty, source->dirty, entries * sizeof(uint8_t));
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                CACHE ACCESS
+//===========================================================================================
+
+uint32_t cache_access(cache_t* cache, uint32_t address, bool write){
+  if (!cache->tags) return 0;   // Disabled
+
+  uint32_t line = address >> cache->line_shift;
+  uint32_t ways = cache->config.ways;
+  size_t first = (size_t) (line & (cache->num_sets - 1)) * ways;
+  uint32_t* tags = cache->tags + first;
+  uint64_t* stamps = cache->stamps + first;
+  uint64_t now = ++cache->clock;
+
+  // Hit: one pass over the tags of the set
+  for (uint32_t way = 0; way < ways; ++way){
+    if (tags[way] != line) continue;
+    cache->hits++;
+    if (cache->config.replacement == CACHE_REPLACE_LRU) stamps[way] = now;
+    if (write) cache->dirty[first + way] = 1;
+    return cache->config.hit_latency ? cache->config.hit_latency - 1 : 0;
+  }
+
+  // Miss: an empty way, otherwise the victim of the policy
+  cache->misses++;
+  uint32_t victim = 0;
+  bool empty = false;
+  for (uint32_t way = 0; way < ways; ++way){
+    if (tags[way] == CACHE_INVALID_TAG){
+      victim = way;
+      empty = true;
+      break;
+    }
+  }
+  if (!empty){
+    if (cache->config.replacement == CACHE_REPLACE_RANDOM){
+      victim = next_random(cache) % ways;
+    }
+    else {
+      // LRU stamps the last use, FIFO the fill, either way the smallest goes
+      for (uint32_t way = 1; way < ways; ++way){
+        if (stamps[way] < stamps[victim]) victim = way;
+      }
+    }
+    cache->evictions++;
+    if (cache->dirty[first + victim]) cache->writebacks++;
+  }
+
+  tags[victim] = line;
+  stamps[victim] = now;
+  cache->dirty[first + victim] = write;
+  return (cache->config.hit_latency ? cache->config.hit_latency - 1 : 0) + cache->config.miss_penalty;
+}
+
+//===========================================================================================
+//                                STATISTICS
+//===========================================================================================
+
+void cache_print_stats(const cache_t* cache, const char* name){
+  if (!cache || !name){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in cache_print_stats.\n");
+    return;
+  }
+
+  uint64_t accesses = cache->hits + cache->misses;
+  double miss_rate = accesses ? 100.0 * (double) cache->misses / (double) accesses : 0.0;
+  char label[24];
+
+  snprintf(label, sizeof(label), "%s HITS", name);
+  printf("%-23s--- %lu\n", label, cache->hits);
+  snprintf(label, sizeof(label), "%s MISSES", name);
+  printf("%-23s--- %lu\n", label, cache->misses);
+  snprintf(label, sizeof(label), "%s MISS RATE", name);
+  printf("%-23s--- %.2f%%\n", label, miss_rate);
+  snprintf(label, sizeof(label), "%s EVICTIONS", name);
+  printf("%-23s--- %lu\n", label, cache->evictions);
+  snprintf(label, sizeof(label), "%s WRITEBACKS", name);
+  printf("%-23s--- %lu\n", label, cache->writebacks);
+}
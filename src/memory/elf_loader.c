@@ -0,0 +1,339 @@
+#include "memory/elf_loader.h"
+#include "memory/memory.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//===========================================================================================
+//                                ELF32 LAYOUT
+//===========================================================================================
+
+#define ELF_CLASS_32       1
+#define ELF_DATA_LSB       1
+#define ELF_TYPE_EXEC      2
+#define ELF_MACHINE_RISCV  243
+#define ELF_PT_LOAD        1
+#define ELF_SHT_SYMTAB     2
+
+typedef struct {
+  uint8_t  ident[16];
+  uint16_t type;
+  uint16_t machine;
+  uint32_t version;
+  uint32_t entry;
+  uint32_t phoff;
+  uint32_t shoff;
+  uint32_t flags;
+  uint16_t ehsize;
+  uint16_t phentsize;
+  uint16_t phnum;
+  uint16_t shentsize;
+  uint16_t shnum;
+  uint16_t shstrndx;
+} elf32_header_t;
+
+typedef struct {
+  uint32_t type;
+  uint32_t offset;
+  uint32_t vaddr;
+  uint32_t paddr;
+  uint32_t filesz;
+  uint32_t memsz;
+  uint32_t flags;
+  uint32_t align;
+} elf32_program_header_t;
+
+typedef struct {
+  uint32_t name;
+  uint32_t type;
+  uint32_t flags;
+  uint32_t addr;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t link;
+  uint32_t info;
+  uint32_t addralign;
+  uint32_t entsize;
+} elf32_section_header_t;
+
+typedef struct {
+  uint32_t name;
+  uint32_t value;
+  uint32_t size;
+  uint8_t  info;
+  uint8_t  other;
+  uint16_t shndx;
+} elf32_symbol_t;
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+// Table entry copied out of the image, false if it lies outside the file
+static bool read_entry(const elf_file_t* elf, uint64_t offset, void* entry, size_t size){
+  if (offset + size > elf->image_size) return false;
+  memcpy(entry, elf->image + offset, size);
+  return true;
+}
+
+
+static int compare_symbols(const void* a, const void* b){
+  const elf_symbol_t* x = (const elf_symbol_t *) a;
+  const elf_symbol_t* y = (const elf_symbol_t *) b;
+  return (x->address > y->address) - (x->address < y->address);
+}
+
+
+// Collect the named entries of the first SHT_SYMTAB section, if any
+static bool load_symbols(elf_file_t* elf, const elf32_header_t* header){
+  elf32_section_header_t section, strings;
+
+  for (uint32_t i = 0; i < header->shnum; ++i){
+    if (!read_entry(elf, (uint64_t) header->shoff + (uint64_t) i * header->shentsize, &section, sizeof(section))) return false;
+    if (section.type != ELF_SHT_SYMTAB || section.entsize < sizeof(elf32_symbol_t)) continue;
+
+    if (!read_entry(elf, (uint64_t) header->shoff + (uint64_t) section.link * header->shentsize, &strings, sizeof(strings)) ||
+        (uint64_t) section.offset + section.size > elf->image_size ||
+        (uint64_t) strings.offset + strings.size > elf->image_size) return false;
+
+    size_t count = section.size / section.entsize;
+    elf->symbols = (elf_symbol_t *) malloc((count ? count : 1) * sizeof(elf_symbol_t));
+    if (!elf->symbols){ // Error Check
+      fprintf(stderr, "Error: Memory allocation error in elf_open.\n");
+      return false;
+    }
+
+    const char* names = (const char *) elf->image + strings.offset;
+    for (size_t j = 0; j < count; ++j){
+      elf32_symbol_t symbol;
+      memcpy(&symbol, elf->image + section.offset + j * section.entsize, sizeof(symbol));
+      if (symbol.name == 0 || symbol.name >= strings.size) continue;
+      // Names must end inside the string table
+      if (!memchr(names + symbol.name, '\0', strings.size - symbol.name)) continue;
+
+      elf->symbols[elf->num_symbols++] = (elf_symbol_t) {
+        .name = names + symbol.name,
+        .address = symbol.value,
+        .size = symbol.size,
+        .type = symbol.info & 0xF,
+        .binding = symbol.info >> 4
+      };
+    }
+    qsort(elf->symbols, elf->num_symbols, sizeof(elf_symbol_t), compare_symbols);
+    return true;
+  }
+  return true;   // Stripped binary
+}
+
+
+// Program header i, false if it is malformed
+static bool read_segment(const elf_file_t* elf, uint16_t i, elf32_program_header_t* segment){
+  if (!read_entry(elf, (uint64_t) elf->program_header_offset + (uint64_t) i * elf->program_header_size, segment, sizeof(*segment))) return false;
+  if (segment->type != ELF_PT_LOAD) return true;
+
+  if (segment->filesz > segment->memsz || (uint64_t) segment->offset + segment->filesz > elf->image_size ||
+      (uint64_t) segment->vaddr + segment->memsz > ((uint64_t) 1 << 32)){
+    fprintf(stderr, "Error: Malformed segment %u in ELF file.\n", i);
+    return false;
+  }
+  return true;
+}
+
+
+// Segment into a bank, for memory without host pages to map into
+static bool copy_segment(const elf_file_t* elf, memory_bank_t* bank, const elf32_program_header_t* segment){
+  if (!bank || segment->vaddr < bank->base_address ||
+      (uint64_t) segment->vaddr - bank->base_address + segment->memsz > bank->size){
+    fprintf(stderr, "Error: Segment 0x%08x+0x%x does not fit in memory.\n", segment->vaddr, segment->memsz);
+    return false;
+  }
+
+  uint8_t* destination = bank->data + (segment->vaddr - bank->base_address);
+  memcpy(destination, elf->image + segment->offset, segment->filesz);
+  memset(destination + segment->filesz, 0, segment->memsz - segment->filesz);
+  memory_mark_pages(bank, segment->vaddr - bank->base_address, segment->memsz);
+  return true;
+}
+
+//===========================================================================================
+//                                FILE HANDLING
+//===========================================================================================
+
+bool elf_open(elf_file_t* elf, const char* filename){
+  if (!elf || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in elf_open.\n");
+    return false;
+  }
+
+  memset(elf, 0, sizeof(elf_file_t));
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0){ // Error Check
+    fprintf(stderr, "Error: Cannot open %s in elf_open.\n", filename);
+    return false;
+  }
+
+  struct stat info;
+  void* image = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(elf32_header_t)){
+    image = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  if (image == MAP_FAILED){ // Error Check
+    fprintf(stderr, "Error: Cannot map %s in elf_open.\n", filename);
+    close(fd);
+    return false;
+  }
+  elf->fd = fd;
+  elf->image = (const uint8_t *) image;
+  elf->image_size = (size_t) info.st_size;
+
+  // Only little-endian 32-bit RISC-V executables
+  elf32_header_t header;
+  memcpy(&header, elf->image, sizeof(header));
+  if (memcmp(header.ident, "\x7F" "ELF", 4) != 0 || header.ident[4] != ELF_CLASS_32 ||
+      header.ident[5] != ELF_DATA_LSB || header.type != ELF_TYPE_EXEC ||
+      header.machine != ELF_MACHINE_RISCV || header.phentsize < sizeof(elf32_program_header_t) ||
+      (header.shnum && header.shentsize < sizeof(elf32_section_header_t)) ||
+      (uint64_t) header.phoff + (uint64_t) header.phnum * header.phentsize > elf->image_size){
+    fprintf(stderr, "Error: %s is not an ELF32 RISC-V executable in elf_open.\n", filename);
+    elf_close(elf);
+    return false;
+  }
+
+  elf->entry = header.entry;
+  elf->program_header_offset = header.phoff;
+  elf->program_header_size = header.phentsize;
+  elf->num_program_headers = header.phnum;
+
+  if (!load_symbols(elf, &header)){
+    fprintf(stderr, "Error: Malformed symbol table in %s in elf_open.\n", filename);
+    elf_close(elf);
+    return false;
+  }
+  return true;
+}
+
+
+void elf_close(elf_file_t* elf){
+  if (!elf){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in elf_close.\n");
+    return;
+  }
+
+  free(elf->symbols);
+  if (elf->image){
+    munmap((void *) elf->image, elf->image_size);
+    close(elf->fd);
+  }
+  memset(elf, 0, sizeof(elf_file_t));
+}
+
+//===========================================================================================
+//                                SEGMENT LOADING
+//===========================================================================================
+
+bool elf_load(const elf_file_t* elf, cpu_state_t* cpu){
+  if (!elf || !elf->image || !cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in elf_load.\n");
+    return false;
+  }
+
+  for (uint16_t i = 0; i < elf->num_program_headers; ++i){
+    elf32_program_header_t segment;
+    if (!read_segment(elf, i, &segment)) return false;
+    if (segment.type != ELF_PT_LOAD || segment.memsz == 0) continue;
+
+    if (!cpu->sparse.base){
+      if (!copy_segment(elf, cpu_select_memory_bank(cpu, segment.vaddr), &segment)) return false;
+      continue;
+    }
+
+    // Sparse memory: map the file pages, copy only when the offsets do not line up
+    if (!sparse_memory_map_file(&cpu->sparse, segment.vaddr, segment.memsz, elf->fd, segment.offset, segment.filesz)){
+      if (!sparse_memory_map(&cpu->sparse, segment.vaddr, segment.memsz)) return false;
+      memcpy(cpu->sparse.base + segment.vaddr, elf->image + segment.offset, segment.filesz);
+      memset(cpu->sparse.base + segment.vaddr + segment.filesz, 0, segment.memsz - segment.filesz);
+    }
+  }
+
+  predecode_invalidate_all(&cpu->predecode);
+  return true;
+}
+
+
+uint32_t elf_end_address(const elf_file_t* elf){
+  if (!elf || !elf->image) return 0;
+
+  uint64_t end = 0;
+  for (uint16_t i = 0; i < elf->num_program_headers; ++i){
+    elf32_program_header_t segment;
+    if (!read_segment(elf, i, &segment)) return 0;
+    if (segment.type == ELF_PT_LOAD && (uint64_t) segment.vaddr + segment.memsz > end){
+      end = (uint64_t) segment.vaddr + segment.memsz;
+    }
+  }
+  return end > UINT32_MAX ? UINT32_MAX : (uint32_t) end;
+}
+
+
+bool load_program_from_file(memory_bank_t* memory, const char* filename){
+  if (!memory || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in load_program_from_file.\n");
+    return false;
+  }
+
+  elf_file_t elf;
+  if (!elf_open(&elf, filename)) return false;
+
+  bool loaded = true;
+  for (uint16_t i = 0; loaded && i < elf.num_program_headers; ++i){
+    elf32_program_header_t segment;
+    loaded = read_segment(&elf, i, &segment);
+    if (loaded && segment.type == ELF_PT_LOAD && segment.memsz) loaded = copy_segment(&elf, memory, &segment);
+  }
+
+  elf_close(&elf);
+  return loaded;
+}
+
+//===========================================================================================
+//                                SYMBOL TABLE
+//===========================================================================================
+
+const elf_symbol_t* elf_find_symbol(const elf_file_t* elf, const char* name){
+  if (!elf || !name) return NULL;
+
+  // Globals win over locals of the same name
+  const elf_symbol_t* found = NULL;
+  for (size_t i = 0; i < elf->num_symbols; ++i){
+    if (strcmp(elf->symbols[i].name, name) != 0) continue;
+    if (elf->symbols[i].binding != 0) return &elf->symbols[i];
+    if (!found) found = &elf->symbols[i];
+  }
+  return found;
+}
+
+
+// Function or object containing address, the nearest symbol below it otherwise
+const elf_symbol_t* elf_symbol_at(const elf_file_t* elf, uint32_t address){
+  if (!elf || elf->num_symbols == 0) return NULL;
+
+  // Last symbol starting at or below address
+  size_t low = 0, high = elf->num_symbols;
+  while (low < high){
+    size_t mid = (low + high) / 2;
+    if (elf->symbols[mid].address <= address) low = mid + 1;
+    else high = mid;
+  }
+  if (low == 0) return NULL;
+
+  const elf_symbol_t* best = &elf->symbols[low - 1];
+  for (size_t i = low; i-- > 0 && elf->symbols[i].address == best->address;){
+    if (elf->symbols[i].type == ELF_SYMBOL_FUNC || elf->symbols[i].type == ELF_SYMBOL_OBJECT) return &elf->symbols[i];
+  }
+  return best;
+}
@@ -1,17 +1,289 @@
 #include "memory/memory.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-/* Just for reference
-// Memory subsystem
-typedef struct {
-  uint8_t* data;
-  size_t size;
-  uint32_t base_address;
-} memory_bank_t;
-
-// Memory access sizes
-typedef enum {
-  MEM_SIZE_BYTE,
-  MEM_SIZE_HALFWORD,
-  MEM_SIZE_WORD
-} memory_size_t
-*/
+//===========================================================================================
+//                                ADDRESS VALIDATION
+//===========================================================================================
+
+static inline uint32_t access_size_bytes(memory_size_t size){
+  return 1u << size;   // BYTE=1, HALFWORD=2, WORD=4
+}
+
+
+bool memory_address_valid(const memory_bank_t* memory, uint32_t address, memory_size_t access_size){
+  if (!memory || !memory->data) return false;
+  if (address < memory->base_address) return false;
+
+  uint64_t offset = (uint64_t) address - memory->base_address;
+  return offset + access_size_bytes(access_size) <= memory->size;
+}
+
+//===========================================================================================
+//                                LOAD OPERATIONS
+//===========================================================================================
+
+uint32_t memory_load_word(const memory_bank_t* memory, uint32_t address){
+  if (!memory_address_valid(memory, address, MEM_SIZE_WORD)){
+    fprintf(stderr, "Error: Invalid address 0x%08x in memory_load_word.\n", address);
+    return 0;
+  }
+  uint32_t value;
+  memcpy(&value, memory->data + (address - memory->base_address), sizeof(value));
+  return value;
+}
+
+
+uint16_t memory_load_halfword(const memory_bank_t* memory, uint32_t address){
+  if (!memory_address_valid(memory, address, MEM_SIZE_HALFWORD)){
+    fprintf(stderr, "Error: Invalid address 0x%08x in memory_load_halfword.\n", address);
+    return 0;
+  }
+  uint16_t value;
+  memcpy(&value, memory->data + (address - memory->base_address), sizeof(value));
+  return value;
+}
+
+
+uint8_t memory_load_byte(const memory_bank_t* memory, uint32_t address){
+  if (!memory_address_valid(memory, address, MEM_SIZE_BYTE)){
+    fprintf(stderr, "Error: Invalid address 0x%08x in memory_load_byte.\n", address);
+    return 0;
+  }
+  return memory->data[address - memory->base_address];
+}
+
+
+uint32_t memory_load(const memory_bank_t* memory, uint32_t address, memory_size_t size, bool unsigned_load){
+  switch (size){
+    case MEM_SIZE_BYTE: {
+      uint8_t value = memory_load_byte(memory, address);
+      return unsigned_load ? value : (uint32_t) (int32_t) (int8_t) value;
+    }
+    case MEM_SIZE_HALFWORD: {
+      uint16_t value = memory_load_halfword(memory, address);
+      return unsigned_load ? value : (uint32_t) (int32_t) (int16_t) value;
+    }
+    case MEM_SIZE_WORD:
+      return memory_load_word(memory, address);
+  }
+  return 0;
+}
+
+//===========================================================================================
+//                                STORE OPERATIONS
+//===========================================================================================
+
+void memory_store_word(memory_bank_t* memory, uint32_t address, uint32_t data){
+  if (!memory_address_valid(memory, address, MEM_SIZE_WORD)){
+    fprintf(stderr, "Error: Invalid address 0x%08x in memory_store_word.\n", address);
+    return;
+  }
+  memcpy(memory->data + (address - memory->base_address), &data, sizeof(data));
+  memory_mark_written(memory, address - memory->base_address, sizeof(data));
+}
+
+
+void memory_store_halfword(memory_bank_t* memory, uint32_t address, uint16_t data){
+  if (!memory_address_valid(memory, address, MEM_SIZE_HALFWORD)){
+    fprintf(stderr, "Error: Invalid address 0x%08x in memory_store_halfword.\n", address);
+    return;
+  }
+  memcpy(memory->data + (address - memory->base_address), &data, sizeof(data));
+  memory_mark_written(memory, address - memory->base_address, sizeof(data));
+}
+
+
+void memory_store_byte(memory_bank_t* memory, uint32_t address, uint8_t data){
+  if (!memory_address_valid(memory, address, MEM_SIZE_BYTE)){
+    fprintf(stderr, "Error: Invalid address 0x%08x in memory_store_byte.\n", address);
+    return;
+  }
+  memory->data[address - memory->base_address] = data;
+  memory_mark_written(memory, address - memory->base_address, 1);
+}
+
+
+void memory_store(memory_bank_t* memory, uint32_t address, uint32_t data, memory_size_t size){
+  switch (size){
+    case MEM_SIZE_BYTE:     memory_store_byte(memory, address, (uint8_t) data);      break;
+    case MEM_SIZE_HALFWORD: memory_store_halfword(memory, address, (uint16_t) data); break;
+    case MEM_SIZE_WORD:     memory_store_word(memory, address, data);                break;
+  }
+}
+
+//===========================================================================================
+//                                DIRTY PAGE TRACKING
+//===========================================================================================
+
+// Bytes of a page, MEMORY_PAGE_SIZE except at the end of an odd-sized bank
+static inline size_t page_length(const memory_bank_t* memory, size_t page){
+  size_t offset = page << MEMORY_PAGE_SHIFT;
+  return memory->size - offset < MEMORY_PAGE_SIZE ? memory->size - offset : MEMORY_PAGE_SIZE;
+}
+
+
+void memory_mark_pages(memory_bank_t* memory, size_t offset, size_t length){
+  if (!memory || !memory->page_flags || length == 0) return;
+
+  size_t last = (offset + length - 1) >> MEMORY_PAGE_SHIFT;
+  for (size_t page = offset >> MEMORY_PAGE_SHIFT; page <= last; ++page){
+    if (memory->page_flags[page] & MEMORY_PAGE_DIRTY) continue;
+    memory->page_flags[page] |= MEMORY_PAGE_DIRTY;
+    memory->dirty_pages[memory->num_dirty_pages++] = (uint32_t) page;
+  }
+}
+
+
+void memory_untrack(memory_bank_t* memory){
+  if (!memory){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in memory_untrack.\n");
+    return;
+  }
+
+  free(memory->page_flags);
+  free(memory->dirty_pages);
+  free(memory->image);
+  memory->page_flags = NULL;
+  memory->dirty_pages = NULL;
+  memory->num_dirty_pages = 0;
+  memory->image = NULL;
+}
+
+
+void memory_reset(memory_bank_t* memory){
+  if (!memory){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in memory_reset.\n");
+    return;
+  }
+  if (!memory->data) return;
+  if (!memory->page_flags){
+    memset(memory->data, 0, memory->size);
+    return;
+  }
+
+  for (size_t i = 0; i < memory->num_dirty_pages; ++i){
+    size_t page = memory->dirty_pages[i];
+    size_t offset = page << MEMORY_PAGE_SHIFT;
+    if (memory->page_flags[page] & MEMORY_PAGE_IMAGE) memcpy(memory->data + offset, memory->image + offset, page_length(memory, page));
+    else memset(memory->data + offset, 0, page_length(memory, page));
+    memory->page_flags[page] &= (uint8_t) ~MEMORY_PAGE_DIRTY;
+  }
+  memory->num_dirty_pages = 0;
+}
+
+
+bool memory_keep_image(memory_bank_t* memory){
+  if (!memory){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in memory_keep_image.\n");
+    return false;
+  }
+  if (!memory->page_flags) return false;
+
+  if (!memory->image) memory->image = (uint8_t *) malloc(memory->size);
+  if (!memory->image){ // Error Check
+    fprintf(stderr, "Error: Allocating memory error in memory_keep_image.\n");
+    return false;
+  }
+
+  // Pages not written since the last reset already match the image or are zero
+  for (size_t i = 0; i < memory->num_dirty_pages; ++i){
+    size_t page = memory->dirty_pages[i];
+    size_t offset = page << MEMORY_PAGE_SHIFT;
+    memcpy(memory->image + offset, memory->data + offset, page_length(memory, page));
+    memory->page_flags[page] = MEMORY_PAGE_IMAGE;
+  }
+  memory->num_dirty_pages = 0;
+  return true;
+}
+
+
+void memory_drop_image(memory_bank_t* memory){
+  if (!memory){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in memory_drop_image.\n");
+    return;
+  }
+
+  if (memory->page_flags){
+    size_t num_pages = (memory->size + MEMORY_PAGE_SIZE - 1) >> MEMORY_PAGE_SHIFT;
+    for (size_t page = 0; page < num_pages; ++page){
+      if (!(memory->page_flags[page] & MEMORY_PAGE_IMAGE)) continue;
+      memory->page_flags[page] &= (uint8_t) ~MEMORY_PAGE_IMAGE;
+      memory_mark_pages(memory, page << MEMORY_PAGE_SHIFT, 1);
+    }
+  }
+  memory_reset(memory);
+}
+
+//===========================================================================================
+//                                MEMORY MANAGEMENT
+//===========================================================================================
+
+void memory_clear(memory_bank_t* memory){
+  if (!memory || !memory->data){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in memory_clear.\n");
+    return;
+  }
+  memset(memory->data, 0, memory->size);
+  memory_mark_pages(memory, 0, memory->size);
+}
+
+
+bool load_program_from_array(memory_bank_t* memory, const uint32_t* program, size_t instruction_count){
+  if (!memory || !program){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in load_program_from_array.\n");
+    return false;
+  }
+  if (instruction_count * sizeof(uint32_t) > memory->size){
+    fprintf(stderr, "Error: Program does not fit in memory in load_program_from_array.\n");
+    return false;
+  }
+
+  for (size_t i = 0; i < instruction_count; ++i){
+    memory_store_word(memory, memory->base_address + (uint32_t) (i * 4), program[i]);
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                MEMORY INSPECTION
+//===========================================================================================
+
+void memory_dump(const memory_bank_t* memory, uint32_t start_addr, uint32_t length){
+  if (!memory || !memory->data){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in memory_dump.\n");
+    return;
+  }
+
+  for (uint32_t offset = 0; offset < length; offset += 16){
+    printf("0x%08x: ", start_addr + offset);
+    for (uint32_t i = 0; i < 16 && offset + i < length; ++i){
+      uint32_t address = start_addr + offset + i;
+      if (memory_address_valid(memory, address, MEM_SIZE_BYTE)){
+        printf("%02x ", memory->data[address - memory->base_address]);
+      }
+      else {
+        printf("?? ");
+      }
+    }
+    printf("\n");
+  }
+}
+
+
+void memory_dump_instructions(const memory_bank_t* memory, uint32_t start_addr, uint32_t instruction_count){
+  if (!memory || !memory->data){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in memory_dump_instructions.\n");
+    return;
+  }
+
+  for (uint32_t i = 0; i < instruction_count; ++i){
+    uint32_t address = start_addr + i * 4;
+    if (!memory_address_valid(memory, address, MEM_SIZE_WORD)) break;
+
+    instruction_t inst = decode_instruction(memory_load_word(memory, address), address);
+    print_instruction_detailed(&inst);
+  }
+}
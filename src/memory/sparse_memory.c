@@ -0,0 +1,570 @@
+#include "memory/sparse_memory.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reserving the guest space needs 64-bit host pointers and mmap
+#if (defined(__linux__) || defined(__APPLE__)) && UINTPTR_MAX > 0xFFFFFFFFu
+#define SPARSE_MEMORY_SUPPORTED 1
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#else
+#define SPARSE_MEMORY_SUPPORTED 0
+#endif
+
+#if SPARSE_MEMORY_SUPPORTED
+
+//===========================================================================================
+//                                FAULT HANDLER
+//===========================================================================================
+
+// Live sparse memories, searched by the handler
+static sparse_memory_t* _Atomic sparse_spaces[SPARSE_MAX_SPACES];
+static struct sigaction previous_action;
+static pthread_once_t handler_once = PTHREAD_ONCE_INIT;
+static bool handler_installed;
+static size_t host_page_size;
+static unsigned host_page_shift;
+
+
+static inline bool test_bit(const uint64_t* map, size_t bit){
+  return (map[bit >> 6] >> (bit & 63)) & 1;
+}
+
+
+// Snapshot contents of a host page into the shadow, once per snapshot, and list it as dirty
+static void snapshot_save_page(sparse_memory_t* memory, size_t page){
+  size_t offset = page << host_page_shift;
+  if (!test_bit(memory->saved_map, page) && memory->num_saved_pages < memory->page_capacity){
+    memcpy(memory->shadow + offset, memory->base + offset, host_page_size);
+    memory->saved_map[page >> 6] |= 1ull << (page & 63);
+    memory->saved_pages[memory->num_saved_pages] = (uint32_t) page;
+    memory->num_saved_pages = memory->num_saved_pages + 1;
+  }
+  if (memory->num_dirty_pages < memory->page_capacity){
+    memory->dirty_pages[memory->num_dirty_pages] = (uint32_t) page;
+    memory->num_dirty_pages = memory->num_dirty_pages + 1;
+  }
+  memory->dirty_map[page >> 6] |= 1ull << (page & 63);
+}
+
+
+static void sparse_fault_handler(int signal_number, siginfo_t* info, void* context){
+  uint8_t* address = (uint8_t *) info->si_addr;
+
+  for (size_t i = 0; i < SPARSE_MAX_SPACES; ++i){
+    sparse_memory_t* memory = atomic_load_explicit(&sparse_spaces[i], memory_order_acquire);
+    if (!memory || address < memory->base || address >= memory->base + memory->reservation_size) continue;
+
+    // Write to a page protected by the snapshot: save it and let the write go through
+    size_t offset = (size_t) (address - memory->base);
+    if (memory->tracking && offset < ((size_t) 1 << 32) && test_bit(memory->page_map, offset >> GUEST_PAGE_SHIFT)){
+      size_t page = offset >> host_page_shift;
+      if (test_bit(memory->snapshot_map, offset >> GUEST_PAGE_SHIFT) && !test_bit(memory->dirty_map, page)){
+        snapshot_save_page(memory, page);
+      }
+      if (mprotect(memory->base + (page << host_page_shift), host_page_size, PROT_READ | PROT_WRITE) != 0) break;
+      return;
+    }
+
+    // Guest access to an unmapped page: let it complete on a scratch page
+    int n = memory->num_fault_pages;
+    uint8_t* page = (uint8_t *) ((uintptr_t) address & ~(uintptr_t) (host_page_size - 1));
+    if (n >= SPARSE_MAX_FAULT_PAGES || mprotect(page, host_page_size, PROT_READ | PROT_WRITE) != 0) break;
+
+    memory->fault_pages[n] = page;
+    memory->num_fault_pages = n + 1;
+    if (!memory->faulted) memory->fault_address = (uint32_t) (address - memory->base);
+    memory->faulted = 1;
+    return;
+  }
+
+  // Not ours: restore the previous disposition, the access faults again under it
+  (void) signal_number;
+  (void) context;
+  sigaction(SIGSEGV, &previous_action, NULL);
+}
+
+
+// Once per process, simulators on other threads may be starting at the same time
+static void sparse_install_handler(void){
+  host_page_size = (size_t) sysconf(_SC_PAGESIZE);
+  host_page_shift = (unsigned) __builtin_ctzll(host_page_size);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = sparse_fault_handler;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  handler_installed = sigaction(SIGSEGV, &action, &previous_action) == 0;
+}
+
+
+static bool sparse_register(sparse_memory_t* memory){
+  for (size_t i = 0; i < SPARSE_MAX_SPACES; ++i){
+    sparse_memory_t* expected = NULL;
+    if (atomic_compare_exchange_strong(&sparse_spaces[i], &expected, memory)) return true;
+  }
+  return false;
+}
+
+
+static void sparse_unregister(sparse_memory_t* memory){
+  for (size_t i = 0; i < SPARSE_MAX_SPACES; ++i){
+    sparse_memory_t* expected = memory;
+    if (atomic_compare_exchange_strong(&sparse_spaces[i], &expected, NULL)) return;
+  }
+}
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+// Guest range [address, address + size) as whole host pages
+static void host_range(const sparse_memory_t* memory, uint32_t address, size_t size, uint8_t** start, size_t* length){
+  uintptr_t first = (uintptr_t) (memory->base + address) & ~(uintptr_t) (host_page_size - 1);
+  uintptr_t last = ((uintptr_t) (memory->base + address) + size + host_page_size - 1) & ~(uintptr_t) (host_page_size - 1);
+  *start = (uint8_t *) first;
+  *length = last - first;
+}
+
+
+// Set or clear the page map bits of a host range
+static void update_page_map(sparse_memory_t* memory, const uint8_t* start, size_t length, bool mapped){
+  size_t first = (size_t) (start - memory->base) >> GUEST_PAGE_SHIFT;
+  size_t last = (size_t) (start + length - memory->base) >> GUEST_PAGE_SHIFT;
+  if (last > GUEST_NUM_PAGES) last = GUEST_NUM_PAGES;   // Guard page
+
+  if (memory->tracking) memory->map_changed = true;   // Restore has to bring the old map back
+  for (size_t page = first; page < last; ++page){
+    uint64_t bit = 1ull << (page & 63);
+    bool was_mapped = memory->page_map[page >> 6] & bit;
+    if (mapped && !was_mapped){
+      memory->page_map[page >> 6] |= bit;
+      memory->mapped_pages++;
+    }
+    else if (!mapped && was_mapped){
+      memory->page_map[page >> 6] &= ~bit;
+      memory->mapped_pages--;
+    }
+  }
+}
+
+
+// First page at or after page whose bit in map equals mapped, GUEST_NUM_PAGES if none
+static size_t next_page(const uint64_t* map, size_t page, bool mapped){
+  while (page < GUEST_NUM_PAGES){
+    uint64_t word = map[page >> 6];
+    if (!mapped) word = ~word;
+    word &= ~0ull << (page & 63);
+    if (word) return (page & ~(size_t) 63) + (size_t) __builtin_ctzll(word);
+    page = (page | 63) + 1;
+  }
+  return GUEST_NUM_PAGES;
+}
+
+
+
+// Set the protection of every run of pages in map, one mprotect per run
+static void protect_pages(sparse_memory_t* memory, const uint64_t* map, int protection){
+  size_t page = 0;
+  while (page < GUEST_NUM_PAGES){
+    page = next_page(map, page, true);
+    if (page >= GUEST_NUM_PAGES) break;
+    size_t first = page;
+    page = next_page(map, page, false);
+    mprotect(memory->base + ((size_t) first << GUEST_PAGE_SHIFT), (page - first) << GUEST_PAGE_SHIFT, protection);
+  }
+}
+
+
+// Save the snapshot pages of a host range that are about to be remapped or dropped
+static void snapshot_save_range(sparse_memory_t* memory, const uint8_t* start, size_t length){
+  if (!memory->tracking) return;
+
+  for (const uint8_t* page = start; page < start + length; page += host_page_size){
+    size_t offset = (size_t) (page - memory->base);
+    if (offset >= ((size_t) 1 << 32)) break;   // Guard page
+    if (test_bit(memory->snapshot_map, offset >> GUEST_PAGE_SHIFT) && !test_bit(memory->dirty_map, offset >> host_page_shift)){
+      snapshot_save_page(memory, offset >> host_page_shift);
+    }
+  }
+}
+
+
+// Stop tracking and drop the shadow copies, the page protections are left to the caller
+static void snapshot_forget(sparse_memory_t* memory){
+  if (!memory->tracking) return;
+
+  memory->tracking = 0;
+  for (size_t i = 0; i < memory->num_dirty_pages; ++i){
+    size_t page = memory->dirty_pages[i];
+    memory->dirty_map[page >> 6] &= ~(1ull << (page & 63));
+  }
+  memory->num_dirty_pages = 0;
+
+  for (size_t i = 0; i < memory->num_saved_pages; ++i){
+    size_t page = memory->saved_pages[i];
+    memory->saved_map[page >> 6] &= ~(1ull << (page & 63));
+    madvise(memory->shadow + (page << host_page_shift), host_page_size, MADV_DONTNEED);
+  }
+  memory->num_saved_pages = 0;
+}
+
+
+// Drop mapped pages and their contents
+static void unmap_pages(sparse_memory_t* memory, uint8_t* start, size_t length){
+  snapshot_save_range(memory, start, length);
+  madvise(start, length, MADV_DONTNEED);    // Contents are gone, as after munmap
+  mprotect(start, length, PROT_NONE);
+  update_page_map(memory, start, length, false);
+}
+
+#endif // SPARSE_MEMORY_SUPPORTED
+
+//===========================================================================================
+//                                LIFECYCLE
+//===========================================================================================
+
+bool sparse_memory_init(sparse_memory_t* memory){
+  if (!memory){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_init.\n");
+    return false;
+  }
+
+  memset(memory, 0, sizeof(sparse_memory_t));
+#if SPARSE_MEMORY_SUPPORTED
+  pthread_once(&handler_once, sparse_install_handler);
+  if (!handler_installed){
+    fprintf(stderr, "Error: Cannot install fault handler in sparse_memory_init.\n");
+    return false;
+  }
+
+  // Guest space plus one guard page catching accesses that wrap past the top
+  memory->page_size = host_page_size;
+  memory->reservation_size = ((size_t) 1 << 32) + host_page_size;
+  void* base = mmap(NULL, memory->reservation_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED){ // Error Check
+    fprintf(stderr, "Error: Cannot reserve guest address space in sparse_memory_init.\n");
+    return false;
+  }
+  memory->base = (uint8_t *) base;
+
+  memory->page_map = (uint64_t *) calloc(GUEST_NUM_PAGES / 64, sizeof(uint64_t));
+  if (!memory->page_map || !sparse_register(memory)){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in sparse_memory_init.\n");
+    sparse_memory_destroy(memory);
+    return false;
+  }
+  return true;
+#else
+  fprintf(stderr, "Error: Sparse memory needs a 64-bit POSIX host in sparse_memory_init.\n");
+  return false;
+#endif
+}
+
+
+void sparse_memory_destroy(sparse_memory_t* memory){
+  if (!memory){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_destroy.\n");
+    return;
+  }
+
+#if SPARSE_MEMORY_SUPPORTED
+  sparse_unregister(memory);
+  if (memory->base) munmap(memory->base, memory->reservation_size);
+  if (memory->shadow) munmap(memory->shadow, (size_t) 1 << 32);
+#endif
+  free(memory->page_map);
+  free(memory->snapshot_map);
+  free(memory->saved_map);
+  free(memory->saved_pages);
+  free(memory->dirty_map);
+  free(memory->dirty_pages);
+  memset(memory, 0, sizeof(sparse_memory_t));
+}
+
+//===========================================================================================
+//                                GUEST MAPPINGS
+//===========================================================================================
+
+bool sparse_memory_map(sparse_memory_t* memory, uint32_t address, size_t size){
+  if (!memory || !memory->base){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_map.\n");
+    return false;
+  }
+  if (size == 0) return true;
+  if ((uint64_t) address + size > ((uint64_t) 1 << 32)){
+    fprintf(stderr, "Error: Mapping 0x%08x+0x%zx leaves the guest space in sparse_memory_map.\n", address, size);
+    return false;
+  }
+
+#if SPARSE_MEMORY_SUPPORTED
+  uint8_t* start;
+  size_t length;
+  host_range(memory, address, size, &start, &length);
+  snapshot_save_range(memory, start, length);   // Reopened pages are no longer write-protected
+  if (mprotect(start, length, PROT_READ | PROT_WRITE) != 0){ // Error Check
+    fprintf(stderr, "Error: Cannot map guest range 0x%08x+0x%zx in sparse_memory_map.\n", address, size);
+    return false;
+  }
+  update_page_map(memory, start, length, true);
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+void sparse_memory_unmap(sparse_memory_t* memory, uint32_t address, size_t size){
+  if (!memory || !memory->base){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_unmap.\n");
+    return;
+  }
+  if (size == 0) return;
+  if ((uint64_t) address + size > ((uint64_t) 1 << 32)) size = ((uint64_t) 1 << 32) - address;
+
+#if SPARSE_MEMORY_SUPPORTED
+  uint8_t* start;
+  size_t length;
+  host_range(memory, address, size, &start, &length);
+  unmap_pages(memory, start, length);
+#endif
+}
+
+
+bool sparse_memory_is_mapped(const sparse_memory_t* memory, uint32_t address, size_t size){
+  if (!memory || !memory->page_map) return false;
+  if ((uint64_t) address + size > ((uint64_t) 1 << 32)) return false;
+
+  uint64_t last = ((uint64_t) address + (size ? size : 1) - 1) >> GUEST_PAGE_SHIFT;
+  for (uint64_t page = address >> GUEST_PAGE_SHIFT; page <= last; ++page){
+    if (!((memory->page_map[page >> 6] >> (page & 63)) & 1)) return false;
+  }
+  return true;
+}
+
+
+bool sparse_memory_prepare_write(sparse_memory_t* memory, uint32_t address, size_t size){
+  if (!sparse_memory_is_mapped(memory, address, size)) return false;
+
+#if SPARSE_MEMORY_SUPPORTED
+  if (!memory->tracking || size == 0) return true;
+
+  // What the write fault handler would do for each page
+  uint8_t* start;
+  size_t length;
+  host_range(memory, address, size, &start, &length);
+  snapshot_save_range(memory, start, length);
+  return mprotect(start, length, PROT_READ | PROT_WRITE) == 0;
+#else
+  return true;
+#endif
+}
+
+
+bool sparse_memory_map_file(sparse_memory_t* memory, uint32_t address, size_t size, int fd, uint64_t offset, size_t file_size){
+  if (!memory || !memory->base){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_map_file.\n");
+    return false;
+  }
+  if (file_size > size){
+    fprintf(stderr, "Error: File part larger than the mapping in sparse_memory_map_file.\n");
+    return false;
+  }
+
+#if SPARSE_MEMORY_SUPPORTED
+  uintptr_t page_mask = (uintptr_t) host_page_size - 1;
+  if (((uintptr_t) address - (uintptr_t) offset) & page_mask) return false;
+  if (!sparse_memory_map(memory, address, size)) return false;
+
+  uint8_t* start = memory->base + address;
+  uint8_t* file_end = start + file_size;
+  uint8_t* end = start + size;
+  uint8_t* first_page = (uint8_t *) ((uintptr_t) start & ~page_mask);
+  uint8_t* zero_pages = (uint8_t *) (((uintptr_t) file_end + page_mask) & ~page_mask);
+
+  // File pages: private, the first guest write to each copies it
+  if (file_size){
+    off_t file_offset = (off_t) (offset - (uint64_t) (start - first_page));
+    if (mmap(first_page, (size_t) (zero_pages - first_page), PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, fd, file_offset) == MAP_FAILED){
+      fprintf(stderr, "Error: Cannot map file into 0x%08x in sparse_memory_map_file.\n", address);
+      return false;
+    }
+  }
+
+  // Zero-fill: the rest of the last file page by hand, whole pages as fresh anonymous memory
+  memset(file_end, 0, (size_t) ((zero_pages < end ? zero_pages : end) - file_end));
+  if (zero_pages < end){
+    size_t length = (((uintptr_t) end + page_mask) & ~page_mask) - (uintptr_t) zero_pages;
+    if (mmap(zero_pages, length, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED){
+      fprintf(stderr, "Error: Cannot map zero pages into 0x%08x in sparse_memory_map_file.\n", address);
+      return false;
+    }
+  }
+  return true;
+#else
+  (void) fd;
+  (void) offset;
+  return false;
+#endif
+}
+
+
+void sparse_memory_clear(sparse_memory_t* memory){
+  if (!memory || !memory->base){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_clear.\n");
+    return;
+  }
+
+#if SPARSE_MEMORY_SUPPORTED
+  snapshot_forget(memory);
+
+  // A fresh reservation drops dirty pages and file mappings alike
+  if (mmap(memory->base, memory->reservation_size, PROT_NONE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED){
+    fprintf(stderr, "Error: Cannot clear guest address space in sparse_memory_clear.\n");
+    return;
+  }
+
+  protect_pages(memory, memory->page_map, PROT_READ | PROT_WRITE);   // Reopen the mapped ranges
+#endif
+}
+
+//===========================================================================================
+//                                SNAPSHOTS
+//===========================================================================================
+
+bool sparse_memory_snapshot(sparse_memory_t* memory){
+  if (!memory || !memory->base){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_snapshot.\n");
+    return false;
+  }
+
+#if SPARSE_MEMORY_SUPPORTED
+  // Shadow and bitmaps are allocated by the first snapshot and kept
+  if (!memory->shadow){
+    void* shadow = mmap(NULL, (size_t) 1 << 32, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    memory->snapshot_map = (uint64_t *) calloc(GUEST_NUM_PAGES / 64, sizeof(uint64_t));
+    memory->saved_map = (uint64_t *) calloc(GUEST_NUM_PAGES / 64, sizeof(uint64_t));
+    memory->dirty_map = (uint64_t *) calloc(GUEST_NUM_PAGES / 64, sizeof(uint64_t));
+    if (shadow != MAP_FAILED) memory->shadow = (uint8_t *) shadow;
+    if (!memory->shadow || !memory->snapshot_map || !memory->saved_map || !memory->dirty_map){ // Error Check
+      fprintf(stderr, "Error: Memory allocation error in sparse_memory_snapshot.\n");
+      return false;
+    }
+  }
+
+  snapshot_forget(memory);   // Replaces the previous snapshot
+
+  // Every page of the snapshot can be saved and become dirty once
+  if (memory->page_capacity < memory->mapped_pages){
+    uint32_t* saved_pages = (uint32_t *) realloc(memory->saved_pages, memory->mapped_pages * sizeof(uint32_t));
+    if (saved_pages) memory->saved_pages = saved_pages;
+    uint32_t* dirty_pages = (uint32_t *) realloc(memory->dirty_pages, memory->mapped_pages * sizeof(uint32_t));
+    if (dirty_pages) memory->dirty_pages = dirty_pages;
+    if (!saved_pages || !dirty_pages){ // Error Check
+      fprintf(stderr, "Error: Memory allocation error in sparse_memory_snapshot.\n");
+      return false;
+    }
+    memory->page_capacity = memory->mapped_pages;
+  }
+
+  memcpy(memory->snapshot_map, memory->page_map, (GUEST_NUM_PAGES / 64) * sizeof(uint64_t));
+  memory->snapshot_mapped_pages = memory->mapped_pages;
+  memory->map_changed = false;
+  memory->tracking = 1;
+  protect_pages(memory, memory->page_map, PROT_READ);
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+bool sparse_memory_restore(sparse_memory_t* memory){
+  if (!memory || !memory->base){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_restore.\n");
+    return false;
+  }
+  if (!memory->tracking){
+    fprintf(stderr, "Error: No snapshot to restore in sparse_memory_restore.\n");
+    return false;
+  }
+
+#if SPARSE_MEMORY_SUPPORTED
+  // Pages mapped after the snapshot go away again
+  for (size_t word = 0; memory->map_changed && word < GUEST_NUM_PAGES / 64; ++word){
+    uint64_t added = memory->page_map[word] & ~memory->snapshot_map[word];
+    while (added){
+      size_t page = word * 64 + (size_t) __builtin_ctzll(added);
+      added &= added - 1;
+      uint8_t* start;
+      size_t length;
+      host_range(memory, (uint32_t) (page << GUEST_PAGE_SHIFT), GUEST_PAGE_SIZE, &start, &length);
+      unmap_pages(memory, start, length);
+    }
+  }
+
+  // Written pages get their snapshot contents back and become read-only again
+  for (size_t i = 0; i < memory->num_dirty_pages; ++i){
+    size_t page = memory->dirty_pages[i];
+    uint8_t* address = memory->base + (page << host_page_shift);
+    if (!test_bit(memory->page_map, (page << host_page_shift) >> GUEST_PAGE_SHIFT)){
+      mprotect(address, host_page_size, PROT_READ | PROT_WRITE);   // Unmapped since the snapshot
+    }
+    memcpy(address, memory->shadow + (page << host_page_shift), host_page_size);
+    mprotect(address, host_page_size, PROT_READ);
+    memory->dirty_map[page >> 6] &= ~(1ull << (page & 63));
+  }
+  memory->num_dirty_pages = 0;
+
+  if (memory->map_changed){
+    memcpy(memory->page_map, memory->snapshot_map, (GUEST_NUM_PAGES / 64) * sizeof(uint64_t));
+    memory->mapped_pages = memory->snapshot_mapped_pages;
+    memory->map_changed = false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+void sparse_memory_drop_snapshot(sparse_memory_t* memory){
+  if (!memory || !memory->base){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sparse_memory_drop_snapshot.\n");
+    return;
+  }
+  if (!memory->tracking) return;
+
+#if SPARSE_MEMORY_SUPPORTED
+  snapshot_forget(memory);
+  protect_pages(memory, memory->page_map, PROT_READ | PROT_WRITE);
+#endif
+}
+
+//===========================================================================================
+//                                FAULT HANDLING
+//===========================================================================================
+
+uint32_t sparse_memory_take_fault(sparse_memory_t* memory){
+  uint32_t address = memory->fault_address;
+
+#if SPARSE_MEMORY_SUPPORTED
+  // Close the scratch pages, whatever was stored there is dropped
+  for (int i = 0; i < memory->num_fault_pages; ++i){
+    madvise(memory->fault_pages[i], host_page_size, MADV_DONTNEED);
+    mprotect(memory->fault_pages[i], host_page_size, PROT_NONE);
+  }
+#endif
+  memory->num_fault_pages = 0;
+  memory->faulted = 0;
+  memory->faults++;
+  return address;
+}
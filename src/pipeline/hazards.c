@@ -0,0 +1,124 @@
+#include "pipeline/hazards.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Stages are evaluated back to front (WB, MEM, EX, ID, IF), so by the time the
+ * decode stage asks these questions EX/MEM already holds the instruction one
+ * ahead of it and MEM/WB the instruction two ahead. Everything older has been
+ * written to the register file earlier in the same cycle.
+ *
+ * The execute and memory stages keep cpu->scoreboard, one pending-write mask
+ * per latch, so each question is an AND with the source mask of IF/ID.
+ */
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+// Value the instruction in a latch will write back
+static uint32_t ex_mem_result(const ex_mem_register_t* ex_mem){
+  return ex_mem->micro_op.reg_write_source == 2 ? ex_mem->micro_op.pc + 4 : ex_mem->alu_result;
+}
+
+
+static uint32_t mem_wb_result(const mem_wb_register_t* mem_wb){
+  switch (mem_wb->micro_op.reg_write_source){
+    case 1:  return mem_wb->memory_data;
+    case 2:  return mem_wb->micro_op.pc + 4;
+    default: return mem_wb->alu_result;
+  }
+}
+
+
+// Instructions that act at writeback, before anything younger may execute
+static bool serializes(const micro_op_t* op){
+  return op->is_fence || op->is_system_call || op->is_breakpoint || !op->is_valid;
+}
+
+
+// Newest latch about to write the registers in mask
+static forwarding_source_t forwarding_source(const scoreboard_t* scoreboard, uint32_t mask){
+  if (scoreboard->ex_mem_writes & mask) return FORWARD_FROM_EX_MEM;
+  if (scoreboard->mem_wb_writes & mask) return FORWARD_FROM_MEM_WB;
+  return FORWARD_NONE;
+}
+
+//===========================================================================================
+//                                HAZARD DETECTION
+//===========================================================================================
+
+// Registers the raw instruction reads, bit n = xn, x0 left out
+uint32_t source_register_mask(uint32_t raw){
+  uint8_t opcode = raw & 0x7F;
+  uint32_t mask = 0;
+  if (opcode != OPCODE_LUI && opcode != OPCODE_AUIPC && opcode != OPCODE_JAL) mask |= 1u << ((raw >> 15) & 0x1F);
+  if (opcode == OPCODE_OP || opcode == OPCODE_STORE || opcode == OPCODE_BRANCH) mask |= 1u << ((raw >> 20) & 0x1F);
+  return mask & ~1u;
+}
+
+
+bool has_raw_hazard(const cpu_state_t* cpu, uint8_t source_reg){
+  if (!cpu) return false;
+  return ((cpu->scoreboard.ex_mem_writes | cpu->scoreboard.mem_wb_writes) & (1u << source_reg) & ~1u) != 0;
+}
+
+
+bool has_load_use_hazard(const cpu_state_t* cpu){
+  if (!cpu || !cpu->if_id.valid) return false;
+
+  // Load one ahead: its data only exists after the memory stage of the next cycle
+  return (source_register_mask(cpu->if_id.instruction) & cpu->scoreboard.ex_mem_loads) != 0;
+}
+
+
+bool has_control_hazard(const cpu_state_t* cpu){
+  if (!cpu) return false;
+  return cpu->pipeline_flushed;
+}
+
+
+bool has_serializing_hazard(const cpu_state_t* cpu){
+  if (!cpu || !cpu->if_id.valid) return false;
+
+  // FENCE, ECALL, EBREAK or illegal instruction ahead: the instruction behind it waits
+  // in IF/ID, so nothing younger has executed when writeback refetches it or raises an event
+  return (cpu->ex_mem.valid && serializes(&cpu->ex_mem.micro_op)) || (cpu->mem_wb.valid && serializes(&cpu->mem_wb.micro_op));
+}
+
+//===========================================================================================
+//                                FORWARDING UNIT
+//===========================================================================================
+
+forwarding_unit_t compute_forwarding_signals(const cpu_state_t* cpu){
+  forwarding_unit_t fwd = {0};
+  if (!cpu || !cpu->if_id.valid) return fwd;
+
+  uint32_t raw = cpu->if_id.instruction;
+  uint8_t rs1 = (raw >> 15) & 0x1F;
+  uint8_t rs2 = (raw >> 20) & 0x1F;
+  uint32_t sources = source_register_mask(raw);
+
+  // Newest producer wins
+  fwd.forward_rs1 = forwarding_source(&cpu->scoreboard, sources & (1u << rs1));
+  fwd.forward_rs2 = forwarding_source(&cpu->scoreboard, sources & (1u << rs2));
+
+  fwd.forward_rs1_data = get_forwarded_register_data(cpu, rs1, fwd.forward_rs1);
+  fwd.forward_rs2_data = get_forwarded_register_data(cpu, rs2, fwd.forward_rs2);
+  return fwd;
+}
+
+
+uint32_t get_forwarded_register_data(const cpu_state_t* cpu, uint8_t reg_num, forwarding_source_t forward_source){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in get_forwarded_register_data.\n");
+    return 0;
+  }
+
+  switch (forward_source){
+    case FORWARD_FROM_EX_MEM: return ex_mem_result(&cpu->ex_mem);
+    case FORWARD_FROM_MEM_WB: return mem_wb_result(&cpu->mem_wb);
+    case FORWARD_NONE:        break;
+  }
+  return register_read(cpu, reg_num);
+}
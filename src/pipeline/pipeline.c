@@ -0,0 +1,351 @@
+#include "pipeline/pipeline.h"
+#include "pipeline/hazards.h"
+#include "cpu/alu.h"
+#include "memory/memory.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//===========================================================================================
+//                                PIPELINE STAGES
+//===========================================================================================
+
+void pipeline_stage_fetch(cpu_state_t* cpu){
+  if_id_register_t* if_id = &cpu->if_id;
+
+  // Hold the fetched instruction while decode is stalled
+  if (cpu->pipeline_stalled) return;
+
+  if_id->pc = cpu->pc;
+  // Wrong-path fetches may leave instruction memory, they decode as invalid
+  if_id->instruction = cpu_fetch_instruction(cpu, cpu->pc);
+  if_id->valid = true;
+  if_id->stalled = false;
+
+  // Blocking L1I: a miss freezes the whole pipeline until the line is filled
+  uint32_t cycles = cache_access(&cpu->icache, cpu->pc, false);
+  pipeline_stall(cpu, cycles);
+  if (profile_enabled(cpu->profile)) profile_stall(cpu->profile, PROFILE_STALL_ICACHE, cycles);
+
+  cpu->pc = branch_predict(&cpu->predictor, cpu->pc, &if_id->prediction);
+}
+
+
+void pipeline_stage_decode(cpu_state_t* cpu){
+  if_id_register_t* if_id = &cpu->if_id;
+  id_ex_register_t* id_ex = &cpu->id_ex;
+
+  // Squashed by a taken branch/jump in execute
+  if (cpu->pipeline_flushed){
+    if_id->valid = false;
+    id_ex->valid = false;
+    return;
+  }
+
+  // Load-use: insert a bubble and keep IF/ID
+  if (cpu->pipeline_stalled){
+    if_id->stalled = true;
+    id_ex->valid = false;
+    return;
+  }
+
+  if (!if_id->valid){
+    id_ex->valid = false;
+    return;
+  }
+
+  // Decode once per PC, later fetches reuse the cached micro-op. Misses go through
+  // the CPU so a debugger breakpoint decodes as illegal and stops at writeback
+  const predecoded_instruction_t* pre = predecode_lookup(&cpu->predecode, if_id->pc);
+  if (!pre) pre = cpu_fetch_decoded(cpu, if_id->pc);
+  id_ex->micro_op = pre->micro_op;
+  id_ex->prediction = if_id->prediction;
+
+  // Register read with forwarding from the two instructions ahead, fields of the decoded word
+  forwarding_unit_t fwd = compute_forwarding_signals(cpu);
+  uint32_t raw = id_ex->micro_op.raw_instruction;
+  id_ex->rs1_data = fwd.forward_rs1 != FORWARD_NONE ? fwd.forward_rs1_data : register_read(cpu, (raw >> 15) & 0x1F);
+  id_ex->rs2_data = fwd.forward_rs2 != FORWARD_NONE ? fwd.forward_rs2_data : register_read(cpu, (raw >> 20) & 0x1F);
+
+  id_ex->valid = true;
+  id_ex->stalled = false;
+  if_id->stalled = false;
+}
+
+
+void pipeline_stage_execute(cpu_state_t* cpu){
+  id_ex_register_t* id_ex = &cpu->id_ex;
+  ex_mem_register_t* ex_mem = &cpu->ex_mem;
+
+  if (!id_ex->valid){
+    ex_mem->valid = false;
+    cpu->scoreboard.ex_mem_writes = 0;
+    cpu->scoreboard.ex_mem_loads = 0;
+    return;
+  }
+
+  const micro_op_t* op = &id_ex->micro_op;
+  ex_mem->micro_op = *op;
+
+  // ALU
+  uint32_t a = op->alu_src_a_is_pc ? op->pc : id_ex->rs1_data;
+  uint32_t b = op->alu_src_b_is_immediate ? (uint32_t) op->immediate : id_ex->rs2_data;
+  ex_mem->alu_result = alu_compute((alu_operation_t) op->alu_op, a, b);
+  ex_mem->memory_write_data = id_ex->rs2_data;
+
+  // Branch resolution: squash the younger instructions if fetch guessed the wrong next PC
+  ex_mem->branch_taken = false;
+
+  if (op->is_branch){
+    cpu->branch_instructions++;
+    uint32_t target = calculate_branch_target(op->pc, op->immediate);
+    ex_mem->branch_taken = evaluate_branch_condition(op->funct3, id_ex->rs1_data, id_ex->rs2_data);
+    bool mispredicted = branch_resolve(&cpu->predictor, op->pc, &id_ex->prediction, BRANCH_KIND_CONDITIONAL,
+                                       ex_mem->branch_taken, target);
+    if (mispredicted){
+      cpu->branch_mispredictions++;
+      cpu->pc = ex_mem->branch_taken ? target : op->pc + 4;
+      cpu->pipeline_flushed = true;
+    }
+    if (profile_enabled(cpu->profile)) profile_branch(cpu->profile, op->pc, ex_mem->branch_taken, mispredicted);
+  }
+  else if (op->is_jump){
+    uint32_t target = op->is_jump_register
+                    ? calculate_jump_register_target(id_ex->rs1_data, op->immediate)
+                    : calculate_jump_target(op->pc, op->immediate);
+    branch_kind_t kind = branch_jump_kind(op->rd, (op->raw_instruction >> 15) & 0x1F, op->is_jump_register);
+    if (branch_resolve(&cpu->predictor, op->pc, &id_ex->prediction, kind, true, target)){
+      cpu->pc = target;
+      cpu->pipeline_flushed = true;
+    }
+  }
+  else if (id_ex->prediction.next_pc != op->pc + 4){
+    // Stale BTB entry, the code at this PC was rewritten: fall through after all
+    branch_forget(&cpu->predictor, op->pc, &id_ex->prediction);
+    cpu->pc = op->pc + 4;
+    cpu->pipeline_flushed = true;
+  }
+
+  if (cpu->pipeline_flushed && profile_enabled(cpu->profile)){
+    profile_stall(cpu->profile, PROFILE_STALL_CONTROL, PROFILE_CONTROL_PENALTY);
+  }
+
+  // Scoreboard: the destination is pending until writeback
+  uint32_t writes = op->reg_write_enable ? (1u << op->rd) & ~1u : 0;
+  cpu->scoreboard.ex_mem_writes = writes;
+  cpu->scoreboard.ex_mem_loads = op->mem_op == MEM_READ ? writes : 0;
+
+  ex_mem->valid = true;
+}
+
+
+void pipeline_stage_memory(cpu_state_t* cpu){
+  ex_mem_register_t* ex_mem = &cpu->ex_mem;
+  mem_wb_register_t* mem_wb = &cpu->mem_wb;
+
+  if (!ex_mem->valid){
+    mem_wb->valid = false;
+    cpu->scoreboard.mem_wb_writes = 0;
+    return;
+  }
+
+  const micro_op_t* op = &ex_mem->micro_op;
+  mem_wb->memory_data = 0;
+
+  if (op->mem_op == MEM_READ){
+    mem_wb->memory_data = cpu_memory_load(cpu, ex_mem->alu_result, (memory_size_t) op->mem_size, op->mem_load_unsigned);
+  }
+  else if (op->mem_op == MEM_WRITE){
+    cpu_memory_store(cpu, ex_mem->alu_result, ex_mem->memory_write_data, (memory_size_t) op->mem_size);
+  }
+
+  // Faulting access stays in EX/MEM so the simulator can report its PC
+  if (cpu->pending_event == CPU_EVENT_MEMORY_FAULT){
+    mem_wb->valid = false;
+    cpu->scoreboard.mem_wb_writes = 0;
+    return;
+  }
+
+  // Blocking L1D, stores allocate
+  if (op->mem_op != MEM_NOP){
+    uint32_t cycles = cache_access(&cpu->dcache, ex_mem->alu_result, op->mem_op == MEM_WRITE);
+    pipeline_stall(cpu, cycles);
+    if (profile_enabled(cpu->profile)) profile_stall(cpu->profile, PROFILE_STALL_DCACHE, cycles);
+  }
+
+  mem_wb->micro_op = *op;
+  mem_wb->alu_result = ex_mem->alu_result;
+  mem_wb->memory_write_data = ex_mem->memory_write_data;
+  mem_wb->valid = true;
+  cpu->scoreboard.mem_wb_writes = cpu->scoreboard.ex_mem_writes;
+}
+
+
+void pipeline_stage_writeback(cpu_state_t* cpu){
+  mem_wb_register_t* mem_wb = &cpu->mem_wb;
+  if (!mem_wb->valid) return;
+
+  const micro_op_t* op = &mem_wb->micro_op;
+
+  // Illegal instructions never retire
+  if (!op->is_valid){
+    cpu->pending_event = CPU_EVENT_ILLEGAL_INSTRUCTION;
+    return;
+  }
+
+  if (op->reg_write_enable){
+    uint32_t value;
+    switch (op->reg_write_source){
+      case 1:  value = mem_wb->memory_data; break;
+      case 2:  value = op->pc + 4;          break;
+      default: value = mem_wb->alu_result;  break;
+    }
+    register_write(cpu, op->rd, value);
+  }
+
+  if (op->is_system_call) cpu->pending_event = CPU_EVENT_ECALL;
+  if (op->is_breakpoint) cpu->pending_event = CPU_EVENT_EBREAK;
+
+  // FENCE orders instruction fetch: the one fetched behind it may be stale, fetch it again
+  if (op->is_fence){
+    cpu_fence(cpu);
+    if (cpu->if_id.valid){
+      branch_squash(&cpu->predictor, &cpu->if_id.prediction);
+      cpu->pc = op->pc + 4;
+      cpu->pipeline_flushed = true;
+      if (profile_enabled(cpu->profile)) profile_stall(cpu->profile, PROFILE_STALL_CONTROL, PROFILE_CONTROL_PENALTY);
+    }
+  }
+
+  // The micro-op has no instruction type, the decode cache does
+  if (profile_enabled(cpu->profile)){
+    const predecoded_instruction_t* pre = predecode_fetch(&cpu->predecode, op->pc, op->raw_instruction);
+    profile_retire(cpu->profile, op->pc, pre->instruction.type);
+  }
+
+  cpu->total_instructions++;
+  mem_wb->valid = false;
+  cpu->scoreboard.mem_wb_writes = 0;
+}
+
+//===========================================================================================
+//                                PIPELINE CONTROL
+//===========================================================================================
+
+void pipeline_clock_cycle(cpu_state_t* cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in pipeline_clock_cycle.\n");
+    return;
+  }
+
+  // Owed stall cycles change no state: charge them all at once, then run the cycle after them
+  if (cpu->stall_cycles > 0){
+    cpu->total_cycles += cpu->stall_cycles;
+    cpu->pipeline_stalls += cpu->stall_cycles;
+    cpu->stall_cycles = 0;
+  }
+  cpu->total_cycles++;
+
+  // Back to front so every stage consumes its input latch before it is overwritten
+  pipeline_stage_writeback(cpu);
+  if (cpu->pending_event != CPU_EVENT_NONE) return;   // Freeze younger instructions
+
+  pipeline_stage_memory(cpu);
+  if (cpu->pending_event != CPU_EVENT_NONE) return;
+
+  pipeline_stage_execute(cpu);
+  resolve_hazards(cpu);
+  pipeline_stage_decode(cpu);
+  pipeline_stage_fetch(cpu);
+
+  cpu->pipeline_flushed = false;
+}
+
+
+void pipeline_flush(cpu_state_t* cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in pipeline_flush.\n");
+    return;
+  }
+
+  // Resume at the oldest instruction that has not retired yet
+  uint32_t resume_pc = cpu->pc;
+  if (cpu->if_id.valid)  resume_pc = cpu->if_id.pc;
+  if (cpu->id_ex.valid)  resume_pc = cpu->id_ex.micro_op.pc;
+  if (cpu->ex_mem.valid) resume_pc = cpu->ex_mem.micro_op.pc;
+  if (cpu->mem_wb.valid) resume_pc = cpu->mem_wb.micro_op.pc;
+
+  // Fetches that never reached execute may have moved the return stack
+  if (cpu->id_ex.valid) branch_squash(&cpu->predictor, &cpu->id_ex.prediction);
+  else if (cpu->if_id.valid) branch_squash(&cpu->predictor, &cpu->if_id.prediction);
+
+  memset(&cpu->if_id, 0, sizeof(if_id_register_t));
+  memset(&cpu->id_ex, 0, sizeof(id_ex_register_t));
+  memset(&cpu->ex_mem, 0, sizeof(ex_mem_register_t));
+  memset(&cpu->mem_wb, 0, sizeof(mem_wb_register_t));
+  memset(&cpu->scoreboard, 0, sizeof(scoreboard_t));
+
+  cpu->pc = resume_pc;
+  cpu->pipeline_stalled = false;
+  cpu->pipeline_flushed = false;
+}
+
+
+void pipeline_stall(cpu_state_t* cpu, uint32_t cycles){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in pipeline_stall.\n");
+    return;
+  }
+  cpu->stall_cycles += cycles;
+}
+
+//===========================================================================================
+//                                HAZARD HANDLING
+//===========================================================================================
+
+bool detect_data_hazard(const cpu_state_t* cpu){
+  if (!cpu || !cpu->if_id.valid) return false;
+
+  return (source_register_mask(cpu->if_id.instruction) & (cpu->scoreboard.ex_mem_writes | cpu->scoreboard.mem_wb_writes)) != 0;
+}
+
+
+bool detect_load_use_hazard(const cpu_state_t* cpu){
+  return has_load_use_hazard(cpu);
+}
+
+
+bool detect_control_hazard(const cpu_state_t* cpu){
+  return has_control_hazard(cpu);
+}
+
+
+bool detect_serializing_hazard(const cpu_state_t* cpu){
+  return has_serializing_hazard(cpu);
+}
+
+
+void resolve_hazards(cpu_state_t* cpu){
+  // Control hazards win, the stalled instruction is on the wrong path anyway
+  cpu->pipeline_stalled = false;
+  if (detect_control_hazard(cpu)) return;
+
+  // Decode runs on the cached decode of IF/ID, which a store since fetch may have replaced:
+  // hazards, forwarding and the register read all take their fields from that word
+  if (cpu->if_id.valid) cpu->if_id.instruction = cpu_fetch_decoded(cpu, cpu->if_id.pc)->micro_op.raw_instruction;
+
+  if (detect_load_use_hazard(cpu)){
+    cpu->pipeline_stalled = true;
+    cpu->pipeline_stalls++;
+    if (profile_enabled(cpu->profile)) profile_stall(cpu->profile, PROFILE_STALL_LOAD_USE, 1);
+  }
+  else if (detect_serializing_hazard(cpu)){
+    cpu->pipeline_stalled = true;
+
+    // Behind an event the simulator restarts an empty pipeline, only a FENCE loses these cycles
+    if ((cpu->ex_mem.valid && cpu->ex_mem.micro_op.is_fence) || (cpu->mem_wb.valid && cpu->mem_wb.micro_op.is_fence)){
+      cpu->pipeline_stalls++;
+      if (profile_enabled(cpu->profile)) profile_stall(cpu->profile, PROFILE_STALL_SERIALIZE, 1);
+    }
+  }
+}
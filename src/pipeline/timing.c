@@ -0,0 +1,360 @@
+#include "pipeline/timing.h"
+#include "pipeline/hazards.h"
+#include "decode/instruction.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define OPCODE_BRANCH 0x63
+#define OPCODE_JAL    0x6F
+#define OPCODE_JALR   0x67
+#define RAW_ECALL     0x00000073u
+#define RAW_EBREAK    0x00100073u
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static double now_seconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+static inline const trace_record_t* window_record(const timing_model_t* model, uint64_t index){
+  return &model->window[index & (TIMING_WINDOW - 1)];
+}
+
+
+static inline bool is_fence(uint32_t raw){
+  return (raw & 0x707F) == OPCODE_MISC_MEM;
+}
+
+
+static inline bool serializes(uint32_t raw){
+  return raw == RAW_ECALL || raw == RAW_EBREAK || is_fence(raw);
+}
+
+
+// The instruction behind a FENCE, ECALL or EBREAK waits in decode until it retires
+static bool timing_serialized(const timing_model_t* model, bool (*test)(uint32_t)){
+  return (model->ex_mem.valid && model->ex_mem.on_path && test(model->ex_mem.raw)) ||
+         (model->mem_wb.valid && model->mem_wb.on_path && test(model->mem_wb.raw));
+}
+
+
+// Fetch resumes at a record of the stream, younger latches are squashed by the caller
+static void timing_redirect(timing_model_t* model, uint64_t record){
+  model->fetch_record = record;
+  if (record < model->window_end) model->pc = window_record(model, record)->pc;
+}
+
+
+// ECALL/EBREAK retired: drain as pipeline_flush does, the next record follows it
+static void timing_flush(timing_model_t* model, uint64_t retired){
+  if (model->id_ex.valid) branch_squash(&model->predictor, &model->id_ex.prediction);
+  else if (model->if_id.valid) branch_squash(&model->predictor, &model->if_id.prediction);
+
+  memset(&model->if_id, 0, sizeof(timing_latch_t));
+  memset(&model->id_ex, 0, sizeof(timing_latch_t));
+  memset(&model->ex_mem, 0, sizeof(timing_latch_t));
+  memset(&model->mem_wb, 0, sizeof(timing_latch_t));
+  memset(&model->scoreboard, 0, sizeof(scoreboard_t));
+  model->stalled = false;
+  model->flushed = false;
+  timing_redirect(model, retired + 1);
+}
+
+//===========================================================================================
+//                                PIPELINE STAGES
+//===========================================================================================
+
+// True if the retired instruction drains the pipeline
+static bool timing_writeback(timing_model_t* model){
+  timing_latch_t* mem_wb = &model->mem_wb;
+  if (!mem_wb->valid) return false;
+
+  mem_wb->valid = false;
+  model->scoreboard.mem_wb_writes = 0;
+  if (!mem_wb->on_path) return false;   // Fetched past the end of the stream
+
+  model->total_instructions++;
+  if (mem_wb->raw == RAW_ECALL || mem_wb->raw == RAW_EBREAK){
+    timing_flush(model, mem_wb->record);
+    return true;
+  }
+
+  // FENCE: the held instruction is fetched again
+  if (is_fence(mem_wb->raw) && model->if_id.valid){
+    branch_squash(&model->predictor, &model->if_id.prediction);
+    timing_redirect(model, mem_wb->record + 1);
+    model->flushed = true;
+  }
+  return false;
+}
+
+
+static void timing_memory(timing_model_t* model){
+  if (!model->ex_mem.valid){
+    model->mem_wb.valid = false;
+    model->scoreboard.mem_wb_writes = 0;
+    return;
+  }
+
+  if (model->ex_mem.on_path){
+    const trace_record_t* record = window_record(model, model->ex_mem.record);
+    if (record->memory_access){
+      model->stall_cycles += cache_access(&model->dcache, record->memory_address, record->memory_write);
+    }
+  }
+  model->mem_wb = model->ex_mem;
+  model->scoreboard.mem_wb_writes = model->scoreboard.ex_mem_writes;
+}
+
+
+static void timing_execute(timing_model_t* model){
+  timing_latch_t* id_ex = &model->id_ex;
+
+  if (!id_ex->valid){
+    model->ex_mem.valid = false;
+    model->scoreboard.ex_mem_writes = 0;
+    model->scoreboard.ex_mem_loads = 0;
+    return;
+  }
+  model->ex_mem = *id_ex;
+  model->scoreboard.ex_mem_writes = 0;
+  model->scoreboard.ex_mem_loads = 0;
+  if (!id_ex->on_path) return;
+
+  // Where the instruction went is the PC of the record after it
+  const trace_record_t* record = window_record(model, id_ex->record);
+  bool known = id_ex->record + 1 < model->window_end;
+  uint32_t next_pc = known ? window_record(model, id_ex->record + 1)->pc : record->pc + 4;
+  uint32_t raw = record->instruction;
+  uint32_t opcode = raw & 0x7F;
+  bool redirect = false;
+
+  if (opcode == OPCODE_BRANCH){
+    model->branch_instructions++;
+    uint32_t target = record->pc + (uint32_t) extract_b_immediate(raw);
+    bool taken = next_pc != record->pc + 4;
+    if (known && branch_resolve(&model->predictor, record->pc, &id_ex->prediction, BRANCH_KIND_CONDITIONAL,
+                                taken, target)){
+      model->branch_mispredictions++;
+      redirect = true;
+    }
+  }
+  else if (opcode == OPCODE_JAL || opcode == OPCODE_JALR){
+    branch_kind_t kind = branch_jump_kind((raw >> 7) & 0x1F, (raw >> 15) & 0x1F, opcode == OPCODE_JALR);
+    redirect = known && branch_resolve(&model->predictor, record->pc, &id_ex->prediction, kind, true, next_pc);
+  }
+  else {
+    if (id_ex->prediction.next_pc != record->pc + 4) branch_forget(&model->predictor, record->pc, &id_ex->prediction);
+    if (known && id_ex->prediction.next_pc != next_pc){
+      model->redirects++;
+      redirect = true;
+    }
+  }
+
+  if (redirect){
+    timing_redirect(model, id_ex->record + 1);
+    model->flushed = true;
+  }
+
+  // Scoreboard: the destination is pending until writeback
+  uint32_t writes = (1u << record->rd) & ~1u;
+  model->scoreboard.ex_mem_writes = writes;
+  model->scoreboard.ex_mem_loads = record->memory_access && !record->memory_write ? writes : 0;
+}
+
+
+static void timing_resolve_hazards(timing_model_t* model){
+  model->stalled = false;
+  if (model->flushed || !model->if_id.valid) return;
+
+  if (source_register_mask(model->if_id.raw) & model->scoreboard.ex_mem_loads){
+    model->stalled = true;
+    model->pipeline_stalls++;
+  }
+  else if (timing_serialized(model, serializes)){
+    model->stalled = true;
+    if (timing_serialized(model, is_fence)) model->pipeline_stalls++;   // Free behind a drain
+  }
+}
+
+
+static void timing_decode(timing_model_t* model){
+  if (model->flushed){
+    model->if_id.valid = false;
+    model->id_ex.valid = false;
+    return;
+  }
+  if (model->stalled || !model->if_id.valid){
+    model->id_ex.valid = false;
+    return;
+  }
+  model->id_ex = model->if_id;
+}
+
+
+static void timing_fetch(timing_model_t* model){
+  timing_latch_t* if_id = &model->if_id;
+  if (model->stalled) return;
+
+  // Off the stream the fetched word is unknown, it is squashed or never matters
+  uint64_t index = model->fetch_record;
+  if_id->on_path = index < model->window_end && window_record(model, index)->pc == model->pc;
+  if_id->record = index;
+  if_id->raw = if_id->on_path ? window_record(model, index)->instruction : 0;
+  if_id->valid = true;
+  if (if_id->on_path) model->fetch_record++;
+
+  model->stall_cycles += cache_access(&model->icache, model->pc, false);
+  model->pc = branch_predict(&model->predictor, model->pc, &if_id->prediction);
+}
+
+
+// One cycle, in the order of pipeline_clock_cycle
+static void timing_clock_cycle(timing_model_t* model){
+  if (model->stall_cycles > 0){
+    model->total_cycles += model->stall_cycles;
+    model->pipeline_stalls += model->stall_cycles;
+    model->stall_cycles = 0;
+  }
+  model->total_cycles++;
+
+  if (timing_writeback(model)) return;
+  timing_memory(model);
+  timing_execute(model);
+  timing_resolve_hazards(model);
+  timing_decode(model);
+  timing_fetch(model);
+
+  model->flushed = false;
+}
+
+//===========================================================================================
+//                                MODEL MANAGEMENT
+//===========================================================================================
+
+bool timing_model_init(timing_model_t* model, const simulator_config_t* config){
+  if (!model || !config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in timing_model_init.\n");
+    return false;
+  }
+
+  memset(model, 0, sizeof(timing_model_t));
+  if (!cache_init(&model->icache, &config->icache) || !cache_init(&model->dcache, &config->dcache) ||
+      !branch_predictor_init(&model->predictor, &config->predictor)){
+    timing_model_destroy(model);
+    return false;
+  }
+  return true;
+}
+
+
+void timing_model_destroy(timing_model_t* model){
+  if (!model){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in timing_model_destroy.\n");
+    return;
+  }
+
+  cache_destroy(&model->icache);
+  cache_destroy(&model->dcache);
+  branch_predictor_destroy(&model->predictor);
+  memset(model, 0, sizeof(timing_model_t));
+}
+
+
+void timing_model_reset(timing_model_t* model){
+  if (!model){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in timing_model_reset.\n");
+    return;
+  }
+
+  cache_reset(&model->icache);
+  cache_reset(&model->dcache);
+  branch_predictor_reset(&model->predictor);
+
+  // Everything after the timing structures is pipeline state or statistics
+  size_t offset = offsetof(timing_model_t, window);
+  memset((char *) model + offset, 0, sizeof(timing_model_t) - offset);
+}
+
+//===========================================================================================
+//                                REPLAY
+//===========================================================================================
+
+void timing_model_push(timing_model_t* model, const trace_record_t* record){
+  if (!model || !record){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in timing_model_push.\n");
+    return;
+  }
+
+  model->window[model->window_end & (TIMING_WINDOW - 1)] = *record;
+  if (model->window_end++ == 0) model->pc = record->pc;
+
+  // Execute needs the record after an instruction, fetch stays one record behind the stream
+  while (model->fetch_record + 1 < model->window_end) timing_clock_cycle(model);
+}
+
+
+void timing_model_finish(timing_model_t* model){
+  if (!model){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in timing_model_finish.\n");
+    return;
+  }
+
+  while (model->total_instructions < model->window_end) timing_clock_cycle(model);
+}
+
+
+bool timing_replay(timing_model_t* model, const char* filename){
+  if (!model || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in timing_replay.\n");
+    return false;
+  }
+
+  trace_reader_t reader;
+  if (!trace_reader_open(&reader, filename)) return false;
+
+  double start = now_seconds();
+  trace_record_t record;
+  while (trace_reader_next_record(&reader, &record)) timing_model_push(model, &record);
+  timing_model_finish(model);
+  model->replay_time_seconds = now_seconds() - start;
+
+  trace_reader_close(&reader);
+  return true;
+}
+
+
+void timing_model_print_stats(const timing_model_t* model){
+  if (!model){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in timing_model_print_stats.\n");
+    return;
+  }
+
+  double cpi = model->total_instructions ? (double) model->total_cycles / (double) model->total_instructions : 0.0;
+  double rate = model->replay_time_seconds > 0.0 ? (double) model->total_instructions / model->replay_time_seconds : 0.0;
+
+  printf("TIMING REPLAY\n");
+  printf("=============\n");
+  printf("TOTAL CYCLES           --- %lu\n", model->total_cycles);
+  printf("TOTAL INSTRUCTIONS     --- %lu\n", model->total_instructions);
+  printf("CPI                    --- %.3f\n", cpi);
+  printf("PIPELINE STALLS        --- %lu\n", model->pipeline_stalls);
+  printf("BRANCH INSTRUCTIONS    --- %lu\n", model->branch_instructions);
+  printf("BRANCH MISPREDICTIONS  --- %lu\n", model->branch_mispredictions);
+  if (model->redirects) printf("STREAM REDIRECTS       --- %lu\n", model->redirects);
+  if (model->predictor.config.type != BP_STATIC) branch_predictor_print_stats(&model->predictor);
+  if (cache_enabled(&model->icache)) cache_print_stats(&model->icache, "L1I");
+  if (cache_enabled(&model->dcache)) cache_print_stats(&model->dcache, "L1D");
+  if (model->replay_time_seconds > 0.0){
+    printf("REPLAY TIME            --- %.6f s\n", model->replay_time_seconds);
+    printf("RECORDS / SECOND       --- %.0f\n", rate);
+  }
+}
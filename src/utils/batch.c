@@ -0,0 +1,347 @@
+#include "utils/batch.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//===========================================================================================
+//                                WORK-STEALING POOL
+//===========================================================================================
+
+/*
+ * Each worker's queue is the index range [top, bottom) of the manifest. All
+ * jobs are known up front, so the Chase-Lev deque reduces to its take and steal
+ * halves: the owner pops from bottom, thieves advance top with a CAS, and
+ * only the last job of a range needs the CAS on both sides.
+ */
+typedef struct {
+  _Alignas(64) _Atomic int64_t top;       // Next job a thief takes
+  _Atomic int64_t bottom;                 // One past the owner's next job
+} batch_queue_t;
+
+typedef struct batch_pool batch_pool_t;
+
+typedef struct {
+  batch_queue_t queue;
+  batch_pool_t* pool;
+  size_t index;                   // Worker number
+  uint64_t random;                // Victim selection state
+  simulator_t* sim;               // Reused across jobs, NULL until the first one
+  pthread_t thread;
+} batch_worker_t;
+
+struct batch_pool {
+  const batch_manifest_t* manifest;
+  batch_worker_t* workers;
+  size_t num_workers;
+  batch_result_callback_t callback;
+  void* context;
+  pthread_mutex_t output_lock;    // Serialises the callback
+};
+
+
+// Owner side: job from the bottom of its own range, -1 when empty
+static int64_t queue_take(batch_queue_t* queue){
+  int64_t bottom = atomic_load_explicit(&queue->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&queue->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t top = atomic_load_explicit(&queue->top, memory_order_relaxed);
+
+  if (top > bottom){   // Empty
+    atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+    return -1;
+  }
+  if (top == bottom){  // Last job, race the thieves for it
+    bool won = atomic_compare_exchange_strong_explicit(&queue->top, &top, top + 1,
+                                                       memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+    return won ? bottom : -1;
+  }
+  return bottom;
+}
+
+
+// Thief side: job from the top of a victim's range, -1 when empty
+static int64_t queue_steal(batch_queue_t* queue){
+  for (;;){
+    int64_t top = atomic_load_explicit(&queue->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&queue->bottom, memory_order_acquire);
+    if (top >= bottom) return -1;
+    if (atomic_compare_exchange_strong_explicit(&queue->top, &top, top + 1,
+                                                memory_order_seq_cst, memory_order_relaxed)) return top;
+  }
+}
+
+
+static int64_t steal_job(batch_worker_t* worker){
+  batch_pool_t* pool = worker->pool;
+
+  // Random starting victim, then every other worker once
+  worker->random ^= worker->random << 13;
+  worker->random ^= worker->random >> 7;
+  worker->random ^= worker->random << 17;
+  size_t start = (size_t) (worker->random % pool->num_workers);
+
+  for (size_t i = 0; i < pool->num_workers; ++i){
+    batch_worker_t* victim = &pool->workers[(start + i) % pool->num_workers];
+    if (victim == worker) continue;
+    int64_t job = queue_steal(&victim->queue);
+    if (job >= 0) return job;
+  }
+  return -1;   // No job is ever added, so every queue is drained
+}
+
+//===========================================================================================
+//                                JOB EXECUTION
+//===========================================================================================
+
+// Simulator for the job: the worker's previous one after a reset when the memory layout matches
+static simulator_t* prepare_simulator(batch_worker_t* worker, const batch_job_t* job){
+  simulator_t* sim = worker->sim;
+
+  if (sim && sim->config.memory_backend == job->config.memory_backend){
+    sim->config = job->config;
+    simulator_reset(sim);
+    return sim;
+  }
+
+  if (sim) simulator_destroy(sim);
+  else sim = (simulator_t *) malloc(sizeof(simulator_t));
+  worker->sim = NULL;
+  if (!sim){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in batch_run.\n");
+    return NULL;
+  }
+  if (!simulator_init(sim, &job->config)){
+    free(sim);
+    return NULL;
+  }
+  worker->sim = sim;
+  return sim;
+}
+
+
+static void run_job(batch_worker_t* worker, size_t index){
+  batch_pool_t* pool = worker->pool;
+  const batch_job_t* job = &pool->manifest->jobs[index];
+  batch_result_t result = { .job = index, .stop_reason = STOP_NONE };
+
+  simulator_t* sim = prepare_simulator(worker, job);
+  if (sim && simulator_load_program(sim, job->program)){
+    simulator_run(sim);
+    result.loaded = true;
+    result.stop_reason = sim->stop_reason;
+    result.exit_code = sim->exit_code;
+    result.cycles = sim->cpu.total_cycles;
+    result.instructions = sim->cpu.total_instructions;
+    result.seconds = sim->simulation_time_seconds;
+    result.instructions_per_second = sim->instructions_per_second;
+  }
+
+  if (!pool->callback) return;
+  pthread_mutex_lock(&pool->output_lock);
+  pool->callback(job, &result, pool->context);
+  pthread_mutex_unlock(&pool->output_lock);
+}
+
+
+static void* worker_main(void* argument){
+  batch_worker_t* worker = (batch_worker_t *) argument;
+
+  for (;;){
+    int64_t job = queue_take(&worker->queue);
+    if (job < 0) job = steal_job(worker);
+    if (job < 0) break;
+    run_job(worker, (size_t) job);
+  }
+
+  if (worker->sim){
+    simulator_destroy(worker->sim);
+    free(worker->sim);
+    worker->sim = NULL;
+  }
+  return NULL;
+}
+
+
+size_t batch_default_threads(void){
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (size_t) cores : 1;
+}
+
+
+bool batch_run(const batch_manifest_t* manifest, size_t num_threads, batch_result_callback_t callback, void* context){
+  if (!manifest){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in batch_run.\n");
+    return false;
+  }
+  if (manifest->num_jobs == 0) return true;
+
+  if (num_threads == 0) num_threads = batch_default_threads();
+  if (num_threads > manifest->num_jobs) num_threads = manifest->num_jobs;
+
+  batch_pool_t pool = {
+    .manifest = manifest,
+    .num_workers = num_threads,
+    .callback = callback,
+    .context = context
+  };
+  pool.workers = (batch_worker_t *) aligned_alloc(64, ((num_threads * sizeof(batch_worker_t) + 63) / 64) * 64);
+  if (!pool.workers){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in batch_run.\n");
+    return false;
+  }
+  pthread_mutex_init(&pool.output_lock, NULL);
+
+  // Contiguous slices of the manifest, stealing evens out the differences
+  for (size_t i = 0; i < num_threads; ++i){
+    batch_worker_t* worker = &pool.workers[i];
+    memset(worker, 0, sizeof(batch_worker_t));
+    worker->pool = &pool;
+    worker->index = i;
+    worker->random = 0x9E3779B97F4A7C15ull * (i + 1);
+    atomic_init(&worker->queue.top, (int64_t) (manifest->num_jobs * i / num_threads));
+    atomic_init(&worker->queue.bottom, (int64_t) (manifest->num_jobs * (i + 1) / num_threads));
+  }
+
+  // The calling thread is worker 0
+  size_t started = 1;
+  for (; started < num_threads; ++started){
+    if (pthread_create(&pool.workers[started].thread, NULL, worker_main, &pool.workers[started]) != 0){
+      fprintf(stderr, "Error: Cannot start worker thread in batch_run.\n");
+      break;   // The running workers steal the orphaned slices
+    }
+  }
+  worker_main(&pool.workers[0]);
+
+  for (size_t i = 1; i < started; ++i){
+    pthread_join(pool.workers[i].thread, NULL);
+  }
+
+  // Slices of workers that failed to start and were not fully stolen
+  for (size_t i = started; i < num_threads; ++i){
+    int64_t job;
+    while ((job = queue_steal(&pool.workers[i].queue)) >= 0) run_job(&pool.workers[0], (size_t) job);
+  }
+  if (pool.workers[0].sim){
+    simulator_destroy(pool.workers[0].sim);
+    free(pool.workers[0].sim);
+  }
+
+  pthread_mutex_destroy(&pool.output_lock);
+  free(pool.workers);
+  return true;
+}
+
+//===========================================================================================
+//                                MANIFEST
+//===========================================================================================
+
+bool batch_manifest_add(batch_manifest_t* manifest, const char* program, const simulator_config_t* config){
+  if (!manifest || !program || !config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in batch_manifest_add.\n");
+    return false;
+  }
+
+  if (manifest->num_jobs == manifest->capacity){
+    size_t capacity = manifest->capacity ? manifest->capacity * 2 : 64;
+    batch_job_t* jobs = (batch_job_t *) realloc(manifest->jobs, capacity * sizeof(batch_job_t));
+    if (!jobs){ // Error Check
+      fprintf(stderr, "Error: Memory allocation error in batch_manifest_add.\n");
+      return false;
+    }
+    manifest->jobs = jobs;
+    manifest->capacity = capacity;
+  }
+
+  batch_job_t* job = &manifest->jobs[manifest->num_jobs];
+  job->program = strdup(program);
+  if (!job->program){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in batch_manifest_add.\n");
+    return false;
+  }
+  job->config = *config;
+  job->config.enable_tracing = false;   // Jobs would share the trace state
+  job->config.trace_file = NULL;
+  job->config.profile_json = NULL;      // Point into the manifest line
+  job->config.profile_csv = NULL;
+  manifest->num_jobs++;
+  return true;
+}
+
+
+bool batch_manifest_load(batch_manifest_t* manifest, const char* filename){
+  if (!manifest || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in batch_manifest_load.\n");
+    return false;
+  }
+
+  FILE* file = fopen(filename, "r");
+  if (!file){ // Error Check
+    fprintf(stderr, "Error: Cannot open manifest %s in batch_manifest_load.\n", filename);
+    return false;
+  }
+
+  char line[BATCH_MAX_LINE];
+  size_t line_number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file)){
+    line_number++;
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    char* save;
+    char* program = strtok_r(line, " \t\r\n", &save);
+    if (!program) continue;   // Blank line
+
+    simulator_config_t config;
+    simulator_default_config(&config);
+    for (char* option = strtok_r(NULL, " \t\r\n", &save); ok && option; option = strtok_r(NULL, " \t\r\n", &save)){
+      ok = simulator_parse_option(&config, option);
+    }
+    if (!ok){
+      fprintf(stderr, "Error: %s:%zu: bad job options in batch_manifest_load.\n", filename, line_number);
+      break;
+    }
+    ok = batch_manifest_add(manifest, program, &config);
+  }
+
+  fclose(file);
+  return ok;
+}
+
+
+void batch_manifest_destroy(batch_manifest_t* manifest){
+  if (!manifest){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in batch_manifest_destroy.\n");
+    return;
+  }
+
+  for (size_t i = 0; i < manifest->num_jobs; ++i){
+    free(manifest->jobs[i].program);
+  }
+  free(manifest->jobs);
+  memset(manifest, 0, sizeof(batch_manifest_t));
+}
+
+//===========================================================================================
+//                                RESULT OUTPUT
+//===========================================================================================
+
+void batch_print_result(const batch_job_t* job, const batch_result_t* result, void* context){
+  FILE* out = context ? (FILE *) context : stdout;
+
+  if (!result->loaded){
+    fprintf(out, "%zu %s status=load-error\n", result->job, job->program);
+  }
+  else {
+    fprintf(out, "%zu %s status=%s exit=%u cycles=%lu instret=%lu ips=%.0f\n",
+            result->job, job->program, simulator_stop_reason_name(result->stop_reason), result->exit_code,
+            result->cycles, result->instructions, result->instructions_per_second);
+  }
+  fflush(out);   // Stream results as jobs finish
+}
@@ -0,0 +1,615 @@
+#include "utils/gdbstub.h"
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define GDBSTUB_PC_REGNUM 32
+
+static const char* const register_names[NUM_REGISTERS] = {
+  "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "fp", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+  "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static int hex_digit(char c){
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+
+// Hex number at *text, advanced past it; false if there is none or it overflows
+static bool parse_hex(const char** text, uint32_t* value){
+  uint64_t result = 0;
+  const char* start = *text;
+  for (int digit; (digit = hex_digit(**text)) >= 0; ++*text){
+    result = result << 4 | (uint64_t) digit;
+    if (result > UINT32_MAX) return false;
+  }
+  *value = (uint32_t) result;
+  return *text != start;
+}
+
+
+// "addr,length" of m, M and Z packets
+static bool parse_range(const char** text, uint32_t* address, uint32_t* length){
+  if (!parse_hex(text, address) || **text != ',') return false;
+  ++*text;
+  return parse_hex(text, length);
+}
+
+
+// Target register as GDB lays it out: 8 hex digits, lowest byte first
+static char* put_register(char* out, uint32_t value){
+  for (int i = 0; i < 4; ++i, value >>= 8) out += sprintf(out, "%02x", value & 0xFF);
+  return out;
+}
+
+
+static bool get_register(const char** text, uint32_t* value){
+  *value = 0;
+  for (int i = 0; i < 4; ++i){
+    int high = hex_digit((*text)[0]), low = high < 0 ? -1 : hex_digit((*text)[1]);
+    if (low < 0) return false;
+    *value |= (uint32_t) (high << 4 | low) << (8 * i);
+    *text += 2;
+  }
+  return true;
+}
+
+
+// riscv:rv32 description, general registers then pc
+static char* build_target_xml(void){
+  size_t capacity = 4096;
+  char* xml = (char *) malloc(capacity);
+  if (!xml) return NULL;
+
+  size_t length = (size_t) snprintf(xml, capacity,
+    "<?xml version=\"1.0\"?>\n<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n<target version=\"1.0\">\n"
+    "<architecture>riscv:rv32</architecture>\n<feature name=\"org.gnu.gdb.riscv.cpu\">\n");
+  for (int i = 0; i < NUM_REGISTERS; ++i){
+    const char* type = i == 1 ? "code_ptr" : i == 2 ? "data_ptr" : "int";
+    length += (size_t) snprintf(xml + length, capacity - length,
+                                "<reg name=\"%s\" bitsize=\"32\" type=\"%s\" regnum=\"%d\"/>\n", register_names[i], type, i);
+  }
+  snprintf(xml + length, capacity - length,
+           "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\" regnum=\"%d\"/>\n</feature>\n</target>\n",
+           GDBSTUB_PC_REGNUM);
+  return xml;
+}
+
+//===========================================================================================
+//                                CONNECTION
+//===========================================================================================
+
+// Next byte from the debugger, -1 when the connection closes
+static int stub_read(gdbstub_t* stub){
+  if (stub->input_start == stub->input_end){
+    ssize_t received;
+    do received = recv(stub->fd, stub->input, sizeof(stub->input), 0); while (received < 0 && errno == EINTR);
+    if (received <= 0) return -1;
+    stub->input_start = 0;
+    stub->input_end = (size_t) received;
+  }
+  return stub->input[stub->input_start++];
+}
+
+
+static bool stub_write(gdbstub_t* stub, const char* data, size_t length){
+  while (length){
+    ssize_t sent = send(stub->fd, data, length, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    data += sent;
+    length -= (size_t) sent;
+  }
+  return true;
+}
+
+
+// Frame and send one packet, resent until acknowledged unless acks are off
+static bool stub_send(gdbstub_t* stub, const char* payload){
+  char frame[2 * sizeof(stub->reply) + 8];
+  size_t length = 0;
+  uint8_t checksum = 0;
+
+  frame[length++] = '$';
+  for (const char* c = payload; *c; ++c){
+    char byte = *c;
+    if (byte == '$' || byte == '#' || byte == '}' || byte == '*'){   // Escaped
+      frame[length++] = '}';
+      checksum += '}';
+      byte ^= 0x20;
+    }
+    frame[length++] = byte;
+    checksum += (uint8_t) byte;
+  }
+  length += (size_t) sprintf(frame + length, "#%02x", checksum);
+
+  for (;;){
+    if (!stub_write(stub, frame, length)) return false;
+    if (stub->no_ack) return true;
+    int ack;
+    while ((ack = stub_read(stub)) >= 0 && ack != '+' && ack != '-');
+    if (ack < 0) return false;
+    if (ack == '+') return true;
+  }
+}
+
+
+// Next packet into stub->packet, false when the connection closes
+static bool stub_receive(gdbstub_t* stub){
+  for (;;){
+    int c;
+    while ((c = stub_read(stub)) >= 0 && c != '$');   // Acks and late interrupts between packets
+    if (c < 0) return false;
+
+    size_t length = 0;
+    uint8_t checksum = 0;
+    while ((c = stub_read(stub)) >= 0 && c != '#'){
+      checksum += (uint8_t) c;
+      if (c == '}'){
+        if ((c = stub_read(stub)) < 0) return false;
+        checksum += (uint8_t) c;
+        c ^= 0x20;
+      }
+      if (length < GDBSTUB_MAX_PACKET) stub->packet[length++] = (char) c;
+    }
+    int high = c < 0 ? -1 : stub_read(stub);
+    int low = high < 0 ? -1 : stub_read(stub);
+    if (low < 0) return false;
+
+    bool valid = hex_digit((char) high) >= 0 && hex_digit((char) low) >= 0 &&
+                 (uint8_t) (hex_digit((char) high) << 4 | hex_digit((char) low)) == checksum;
+    if (!stub->no_ack && !stub_write(stub, valid ? "+" : "-", 1)) return false;
+    if (!valid && !stub->no_ack) continue;
+
+    stub->packet[length] = '\0';
+    stub->packet_length = length;
+    stub->packets++;
+    return true;
+  }
+}
+
+
+// Look for Ctrl-C without blocking while the program runs
+static bool stub_poll_interrupt(gdbstub_t* stub){
+  struct pollfd pfd = { .fd = stub->fd, .events = POLLIN };
+  if (stub->input_start == stub->input_end){
+    if (poll(&pfd, 1, 0) <= 0) return false;
+    ssize_t received = recv(stub->fd, stub->input, sizeof(stub->input), 0);
+    if (received <= 0) return true;   // Gone: stop and let the next receive see it
+    stub->input_start = 0;
+    stub->input_end = (size_t) received;
+  }
+  while (stub->input_start < stub->input_end &&
+         (stub->input[stub->input_start] == '+' || stub->input[stub->input_start] == '-')) stub->input_start++;
+  if (stub->input_start < stub->input_end && stub->input[stub->input_start] == 0x03){
+    stub->input_start++;
+    return true;
+  }
+  return false;
+}
+
+
+static bool open_listener(gdbstub_t* stub, const char* address){
+  if (strncmp(address, "unix:", 5) == 0){
+    struct sockaddr_un local = { .sun_family = AF_UNIX };
+    if (!address[5] || strlen(address + 5) >= sizeof(local.sun_path)) return false;
+    strcpy(local.sun_path, address + 5);
+    stub->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (stub->listen_fd < 0 || bind(stub->listen_fd, (struct sockaddr *) &local, sizeof(local)) != 0) return false;
+    strcpy(stub->unix_path, local.sun_path);
+    return listen(stub->listen_fd, 1) == 0;
+  }
+
+  // "PORT" or "host:port"
+  char host[256] = "127.0.0.1";
+  const char* port = strrchr(address, ':');
+  if (port){
+    size_t length = (size_t) (port - address);
+    if (length >= sizeof(host)) return false;
+    memcpy(host, address, length);
+    host[length] = '\0';
+    port++;
+  }
+  else port = address;
+
+  struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE };
+  struct addrinfo* found;
+  if (getaddrinfo(host[0] ? host : NULL, port, &hints, &found) != 0) return false;
+  bool bound = false;
+  for (struct addrinfo* ai = found; ai && !bound; ai = ai->ai_next){
+    stub->listen_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (stub->listen_fd < 0) continue;
+    int on = 1;
+    setsockopt(stub->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    bound = bind(stub->listen_fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(stub->listen_fd, 1) == 0;
+    if (!bound){
+      close(stub->listen_fd);
+      stub->listen_fd = -1;
+    }
+  }
+  freeaddrinfo(found);
+  return bound;
+}
+
+//===========================================================================================
+//                                EXECUTION
+//===========================================================================================
+
+// Stop reply for the state the program stopped in
+static void stub_stop_reply(gdbstub_t* stub){
+  simulator_t* sim = stub->sim;
+  cpu_state_t* cpu = &sim->cpu;
+
+  switch (sim->stop_reason){
+    case STOP_EXIT:
+      stub->exited = true;
+      sprintf(stub->reply, "W%02x", sim->exit_code & 0xFF);
+      break;
+    case STOP_FAULT:   // SIGILL or SIGSEGV
+      sprintf(stub->reply, "S%02x", cpu_fetch_decoded(cpu, cpu->pc)->instruction.type == INST_INVALID ? 4 : 11);
+      break;
+    case STOP_LIMIT:   // SIGXCPU
+      strcpy(stub->reply, "S18");
+      break;
+    default:
+      if (stub->marks.watch_hit) sprintf(stub->reply, "T05watch:%x;", stub->marks.watch_address);
+      else strcpy(stub->reply, stub->interrupted ? "S02" : "S05");
+      break;
+  }
+}
+
+
+// Step one instruction or continue until a stop, then fill the stop reply
+static void stub_resume(gdbstub_t* stub, bool step){
+  simulator_t* sim = stub->sim;
+  cpu_state_t* cpu = &sim->cpu;
+  if (stub->exited){
+    stub_stop_reply(stub);
+    return;
+  }
+
+  stub->resumes++;
+  stub->interrupted = false;
+  stub->marks.watch_hit = false;
+
+  // A breakpoint at pc decodes as illegal: lift it for the first instruction
+  uint32_t pc = cpu->pc;
+  bool lifted = cpu_breakpoint_hit(cpu) && cpu_set_breakpoint(cpu, pc, false);
+  if (step || lifted) simulator_advance(sim, EXEC_MODE_FUNCTIONAL, 1);
+  if (lifted) cpu_set_breakpoint(cpu, pc, true);
+
+  // simulator_advance leaves running set unless the program stopped
+  if (!step && (!lifted || sim->running)){
+    do simulator_advance(sim, stub->mode, GDBSTUB_CHUNK);
+    while (sim->running && !(stub->interrupted = stub_poll_interrupt(stub)));
+    if (stub->interrupted) stub->interrupts++;
+  }
+  if (sim->running){   // Stepped or interrupted
+    sim->running = false;
+    sim->paused = true;
+    sim->stop_reason = STOP_BREAK;
+  }
+  stub_stop_reply(stub);
+}
+
+//===========================================================================================
+//                                PACKETS
+//===========================================================================================
+
+static void stub_read_registers(gdbstub_t* stub){
+  char* out = stub->reply;
+  for (uint8_t i = 0; i < NUM_REGISTERS; ++i) out = put_register(out, register_read(&stub->sim->cpu, i));
+  put_register(out, stub->sim->cpu.pc);
+}
+
+
+static bool stub_write_register(gdbstub_t* stub, uint32_t regnum, uint32_t value){
+  if (regnum == GDBSTUB_PC_REGNUM) stub->sim->cpu.pc = value;
+  else if (regnum < NUM_REGISTERS) register_write(&stub->sim->cpu, (uint8_t) regnum, value);
+  else return false;
+  return true;
+}
+
+
+// m addr,length: as much as is mapped, an error if none of it is
+static void stub_read_memory(gdbstub_t* stub, const char* args){
+  uint32_t address, length;
+  if (!parse_range(&args, &address, &length)){
+    strcpy(stub->reply, "E01");
+    return;
+  }
+  if (length > GDBSTUB_MAX_PACKET / 2) length = GDBSTUB_MAX_PACKET / 2;
+
+  char* out = stub->reply;
+  for (uint32_t i = 0; i < length; ++i){
+    const uint8_t* byte = cpu_memory_span(&stub->sim->cpu, address + i, 1, false);
+    if (!byte) break;
+    out += sprintf(out, "%02x", *byte);
+  }
+  if (out == stub->reply) strcpy(stub->reply, "E14");
+}
+
+
+// M addr,length:bytes
+static void stub_write_memory(gdbstub_t* stub, const char* args){
+  uint32_t address, length;
+  if (!parse_range(&args, &address, &length) || *args++ != ':' || strlen(args) != 2 * (size_t) length){
+    strcpy(stub->reply, "E01");
+    return;
+  }
+  for (uint32_t i = 0; i < length; ++i){
+    int high = hex_digit(args[2 * i]), low = hex_digit(args[2 * i + 1]);
+    uint8_t* byte = cpu_memory_span(&stub->sim->cpu, address + i, 1, true);   // Drops stale decodes
+    if (high < 0 || low < 0 || !byte){
+      strcpy(stub->reply, "E14");
+      return;
+    }
+    *byte = (uint8_t) (high << 4 | low);
+  }
+  strcpy(stub->reply, "OK");
+}
+
+
+// Z/z type,addr,kind: breakpoints (0, 1) and write watchpoints (2)
+static void stub_mark(gdbstub_t* stub, const char* args, bool insert){
+  cpu_state_t* cpu = &stub->sim->cpu;
+  uint32_t type, address, kind;
+  if (!parse_hex(&args, &type) || *args++ != ',' || !parse_range(&args, &address, &kind)){
+    strcpy(stub->reply, "E01");
+    return;
+  }
+
+  bool done;
+  if (type <= 1) done = cpu_set_breakpoint(cpu, address, insert) || !insert;
+  else if (type == 2) done = cpu_set_watchpoint(cpu, address, kind, insert) || !insert;
+  else {
+    stub->reply[0] = '\0';   // Read and access watchpoints are not supported
+    return;
+  }
+  strcpy(stub->reply, done ? "OK" : "E0e");
+}
+
+
+// qXfer:features:read:target.xml:offset,length
+static void stub_read_features(gdbstub_t* stub, const char* args){
+  uint32_t offset, length;
+  if (strncmp(args, "target.xml:", 11) != 0){
+    strcpy(stub->reply, "E00");
+    return;
+  }
+  args += 11;
+  if (!parse_range(&args, &offset, &length)){
+    strcpy(stub->reply, "E01");
+    return;
+  }
+
+  size_t size = strlen(stub->target_xml);
+  if (length > GDBSTUB_MAX_PACKET - 8) length = GDBSTUB_MAX_PACKET - 8;
+  if (offset >= size){
+    strcpy(stub->reply, "l");
+    return;
+  }
+  size_t chunk = size - offset < length ? size - offset : length;
+  stub->reply[0] = offset + chunk < size ? 'm' : 'l';
+  memcpy(stub->reply + 1, stub->target_xml + offset, chunk);
+  stub->reply[chunk + 1] = '\0';
+}
+
+
+static void stub_query(gdbstub_t* stub, const char* packet){
+  if (strncmp(packet, "qSupported", 10) == 0){
+    sprintf(stub->reply, "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+", GDBSTUB_MAX_PACKET);
+  }
+  else if (strncmp(packet, "qXfer:features:read:", 20) == 0) stub_read_features(stub, packet + 20);
+  else if (strcmp(packet, "qAttached") == 0) strcpy(stub->reply, "1");
+  else if (strcmp(packet, "qC") == 0) strcpy(stub->reply, "QC1");
+  else if (strcmp(packet, "qfThreadInfo") == 0) strcpy(stub->reply, "m1");
+  else if (strcmp(packet, "qsThreadInfo") == 0) strcpy(stub->reply, "l");
+  else stub->reply[0] = '\0';
+}
+
+
+// vCont;action[:thread]... with one thread, the first action applies
+static void stub_vcont(gdbstub_t* stub, const char* packet){
+  if (strcmp(packet, "vCont?") == 0){
+    strcpy(stub->reply, "vCont;c;C;s;S");
+    return;
+  }
+  if (strncmp(packet, "vCont;", 6) != 0){
+    stub->reply[0] = '\0';
+    return;
+  }
+  char action = packet[6];
+  if (action == 's' || action == 'S') stub_resume(stub, true);
+  else if (action == 'c' || action == 'C') stub_resume(stub, false);
+  else strcpy(stub->reply, "E01");
+}
+
+
+// Fill stub->reply for stub->packet, false when the session ends
+static bool stub_handle(gdbstub_t* stub, bool* detached){
+  const char* packet = stub->packet;
+  const char* args = packet + 1;
+  uint32_t value, regnum;
+  stub->reply[0] = '\0';
+
+  switch (packet[0]){
+    case '?':
+      stub_stop_reply(stub);
+      break;
+    case 'g':
+      stub_read_registers(stub);
+      break;
+    case 'G':
+      for (uint32_t i = 0; i <= GDBSTUB_PC_REGNUM; ++i){
+        if (!get_register(&args, &value)){
+          strcpy(stub->reply, "E01");
+          return true;
+        }
+        stub_write_register(stub, i, value);
+      }
+      strcpy(stub->reply, "OK");
+      break;
+    case 'p':
+      if (!parse_hex(&args, &regnum) || regnum > GDBSTUB_PC_REGNUM) strcpy(stub->reply, "E01");
+      else put_register(stub->reply, regnum == GDBSTUB_PC_REGNUM ? stub->sim->cpu.pc
+                                                                 : register_read(&stub->sim->cpu, (uint8_t) regnum));
+      break;
+    case 'P':
+      if (!parse_hex(&args, &regnum) || *args++ != '=' || !get_register(&args, &value) ||
+          !stub_write_register(stub, regnum, value)) strcpy(stub->reply, "E01");
+      else strcpy(stub->reply, "OK");
+      break;
+    case 'm':
+      stub_read_memory(stub, args);
+      break;
+    case 'M':
+      stub_write_memory(stub, args);
+      break;
+    case 'c':
+    case 's':
+      if (*args && parse_hex(&args, &value)) stub->sim->cpu.pc = value;   // Resume address
+      stub_resume(stub, packet[0] == 's');
+      break;
+    case 'Z':
+    case 'z':
+      stub_mark(stub, args, packet[0] == 'Z');
+      break;
+    case 'H':
+    case 'T':
+      strcpy(stub->reply, "OK");
+      break;
+    case 'q':
+      stub_query(stub, packet);
+      break;
+    case 'Q':
+      if (strcmp(packet, "QStartNoAckMode") == 0) strcpy(stub->reply, "OK");
+      break;
+    case 'v':
+      if (strncmp(packet, "vCont", 5) == 0) stub_vcont(stub, packet);
+      else if (strncmp(packet, "vKill", 5) == 0){
+        stub_send(stub, "OK");
+        return false;
+      }
+      break;
+    case 'k':
+      return false;
+    case 'D':
+      stub_send(stub, "OK");
+      *detached = true;
+      return false;
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                SERVER
+//===========================================================================================
+
+bool gdbstub_init(gdbstub_t* stub, simulator_t* sim, const char* address){
+  if (!stub || !sim || !address){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in gdbstub_init.\n");
+    return false;
+  }
+
+  memset(stub, 0, sizeof(gdbstub_t));
+  stub->sim = sim;
+  stub->listen_fd = -1;
+  stub->fd = -1;
+  stub->mode = sim->config.execution_mode == EXEC_MODE_JIT ? EXEC_MODE_JIT : EXEC_MODE_FUNCTIONAL;
+  stub->target_xml = build_target_xml();
+  if (!stub->target_xml || !debug_marks_init(&stub->marks)){ // Error Check
+    fprintf(stderr, "Error: Allocating memory error in gdbstub_init.\n");
+    gdbstub_destroy(stub);
+    return false;
+  }
+  if (!open_listener(stub, address)){
+    fprintf(stderr, "Error: Cannot listen on '%s' in gdbstub_init: %s.\n", address, strerror(errno));
+    gdbstub_destroy(stub);
+    return false;
+  }
+  return true;
+}
+
+
+void gdbstub_destroy(gdbstub_t* stub){
+  if (!stub){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in gdbstub_destroy.\n");
+    return;
+  }
+
+  if (stub->fd >= 0) close(stub->fd);
+  if (stub->listen_fd >= 0) close(stub->listen_fd);
+  if (stub->unix_path[0]) unlink(stub->unix_path);
+  if (stub->marks.page_flags) debug_marks_destroy(&stub->marks);
+  free(stub->target_xml);
+  stub->fd = stub->listen_fd = -1;
+  stub->unix_path[0] = '\0';
+  stub->target_xml = NULL;
+}
+
+
+bool gdbstub_serve(gdbstub_t* stub){
+  if (!stub){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in gdbstub_serve.\n");
+    return false;
+  }
+
+  simulator_t* sim = stub->sim;
+  fprintf(stderr, "Waiting for GDB on %s...\n", stub->unix_path[0] ? stub->unix_path : "TCP");
+  do stub->fd = accept(stub->listen_fd, NULL, NULL); while (stub->fd < 0 && errno == EINTR);
+  if (stub->fd < 0){
+    fprintf(stderr, "Error: Cannot accept a connection in gdbstub_serve: %s.\n", strerror(errno));
+    return false;
+  }
+  int on = 1;
+  setsockopt(stub->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));   // Fails harmlessly on Unix sockets
+
+  sim->running = false;
+  sim->paused = true;
+  sim->stop_reason = STOP_BREAK;
+  cpu_debug_attach(&sim->cpu, &stub->marks);
+
+  bool detached = false;
+  while (stub_receive(stub)){
+    if (!stub_handle(stub, &detached)) break;
+    if (!stub_send(stub, stub->reply)) break;
+    if (strcmp(stub->packet, "QStartNoAckMode") == 0) stub->no_ack = true;   // After its own ack
+  }
+
+  cpu_debug_attach(&sim->cpu, NULL);
+  close(stub->fd);
+  stub->fd = -1;
+  return detached && !stub->exited && sim->stop_reason != STOP_FAULT && sim->stop_reason != STOP_LIMIT;
+}
+
+
+void gdbstub_print_stats(const gdbstub_t* stub, FILE* out){
+  if (!stub){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in gdbstub_print_stats.\n");
+    return;
+  }
+  if (!out) out = stdout;
+
+  fprintf(out, "GDB PACKETS            --- %lu\n", stub->packets);
+  fprintf(out, "GDB RESUMES            --- %lu\n", stub->resumes);
+  fprintf(out, "GDB INTERRUPTS         --- %lu\n", stub->interrupts);
+  fprintf(out, "BREAKPOINT HITS        --- %lu\n", stub->marks.breakpoint_hits);
+  fprintf(out, "WATCHPOINT HITS        --- %lu\n", stub->marks.watchpoint_hits);
+}
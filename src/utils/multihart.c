@@ -0,0 +1,353 @@
+#include "utils/multihart.h"
+#include "utils/defs.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Shared by the threads of one multihart_run
+typedef struct {
+  multihart_t* mh;
+  execution_mode_t mode;
+  pthread_barrier_t barrier;      // Closes every quantum
+  pthread_mutex_t lock;           // Guards num_threads until the run starts
+  pthread_cond_t start;
+  uint32_t num_threads;           // 0 until every thread that could start has
+  bool finished;                  // Written by the barrier's serial thread only
+} multihart_run_t;
+
+// One host thread, runs harts index, index + num_threads, ...
+typedef struct {
+  multihart_run_t* run;
+  uint32_t index;
+  pthread_t thread;
+} multihart_worker_t;
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static double now_seconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+static bool parse_count(const char* value, uint64_t* result){
+  char* end;
+  if (!value || !*value) return false;
+  *result = strtoull(value, &end, 0);
+  return *end == '\0';
+}
+
+
+static bool hart_stopped(const simulator_t* hart){
+  return hart->stop_reason != STOP_NONE;
+}
+
+//===========================================================================================
+//                                CONFIGURATION
+//===========================================================================================
+
+void multihart_default_config(multihart_config_t* config){
+  if (!config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in multihart_default_config.\n");
+    return;
+  }
+
+  memset(config, 0, sizeof(multihart_config_t));
+  config->num_harts = 1;
+  config->quantum = 100000;
+  config->stack_size = 4096;
+}
+
+
+bool multihart_parse_option(multihart_config_t* config, const char* option){
+  if (!config || !option){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in multihart_parse_option.\n");
+    return false;
+  }
+
+  char key[32];
+  const char* value = strchr(option, '=');
+  size_t key_length = value ? (size_t) (value - option) : strlen(option);
+  if (key_length >= sizeof(key)) key_length = sizeof(key) - 1;
+  memcpy(key, option, key_length);
+  key[key_length] = '\0';
+  if (value) value++;
+
+  uint64_t number = 0;
+  bool parsed = false;
+  if (!parse_count(value, &number)) parsed = false;
+  else if (strcmp(key, "harts") == 0){
+    parsed = number >= 1 && number <= MULTIHART_MAX_HARTS;
+    config->num_harts = (uint32_t) number;
+  }
+  else if (strcmp(key, "hart_quantum") == 0){
+    parsed = number > 0;
+    config->quantum = number;
+  }
+  else if (strcmp(key, "hart_deterministic") == 0){
+    config->deterministic = number != 0;
+    parsed = true;
+  }
+  else if (strcmp(key, "hart_stack") == 0){
+    parsed = number > 0 && number <= UINT32_MAX && number % 16 == 0;   // ABI stack alignment
+    config->stack_size = (uint32_t) number;
+  }
+
+  if (!parsed) fprintf(stderr, "Error: Invalid option '%s' in multihart_parse_option.\n", option);
+  return parsed;
+}
+
+//===========================================================================================
+//                                LIFECYCLE
+//===========================================================================================
+
+bool multihart_init(multihart_t* mh, const multihart_config_t* config, const simulator_config_t* sim_config){
+  if (!mh || !config || !sim_config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in multihart_init.\n");
+    return false;
+  }
+  if (config->num_harts == 0 || config->num_harts > MULTIHART_MAX_HARTS || config->quantum == 0){
+    fprintf(stderr, "Error: Invalid hart count or quantum in multihart_init.\n");
+    return false;
+  }
+  if (sim_config->memory_backend != MEMORY_BACKEND_BANKED){
+    fprintf(stderr, "Error: Harts can only share banked memory in multihart_init.\n");
+    return false;
+  }
+  if ((uint64_t) config->num_harts * config->stack_size > DATA_MEMORY_SIZE){
+    fprintf(stderr, "Error: Hart stacks do not fit in data memory in multihart_init.\n");
+    return false;
+  }
+
+  memset(mh, 0, sizeof(multihart_t));
+  mh->config = *config;
+  mh->harts = (simulator_t *) calloc(config->num_harts, sizeof(simulator_t));
+  if (!mh->harts){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in multihart_init.\n");
+    return false;
+  }
+
+  // Output files are hart 0's, the others would overwrite them
+  simulator_config_t hart_config = *sim_config;
+  hart_config.trace_file = NULL;
+  hart_config.profile_json = NULL;
+  hart_config.profile_csv = NULL;
+
+  for (uint32_t i = 0; i < config->num_harts; ++i){
+    simulator_t* hart = &mh->harts[i];
+    bool ready = simulator_init(hart, i == 0 ? sim_config : &hart_config);
+    if (ready && i > 0 && !cpu_memory_share(&hart->cpu, &mh->harts[0].cpu)){
+      simulator_destroy(hart);
+      ready = false;
+    }
+    if (!ready){
+      // Sharers before the owner
+      while (i-- > 0) simulator_destroy(&mh->harts[i]);
+      free(mh->harts);
+      mh->harts = NULL;
+      return false;
+    }
+  }
+  return true;
+}
+
+
+void multihart_destroy(multihart_t* mh){
+  if (!mh){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in multihart_destroy.\n");
+    return;
+  }
+  if (!mh->harts) return;
+
+  for (uint32_t i = mh->config.num_harts; i-- > 0;) simulator_destroy(&mh->harts[i]);
+  free(mh->harts);
+  mh->harts = NULL;
+}
+
+//===========================================================================================
+//                                PROGRAM LOADING
+//===========================================================================================
+
+// Hart 0 has the program loaded, the others start where it does
+static void start_harts(multihart_t* mh){
+  simulator_t* owner = &mh->harts[0];
+  uint32_t stack_top = owner->cpu.data_memory.base_address + (uint32_t) owner->cpu.data_memory.size;
+
+  for (uint32_t i = 0; i < mh->config.num_harts; ++i){
+    simulator_t* hart = &mh->harts[i];
+    cpu_state_t* cpu = &hart->cpu;
+    if (i > 0){
+      cpu->pc = owner->cpu.pc;
+      predecode_invalidate_all(&cpu->predecode);
+      if (hart->config.syscalls) syscall_reset(&hart->syscalls, owner->syscalls.initial_break);
+    }
+    register_write(cpu, 2, stack_top - i * mh->config.stack_size);
+    register_write(cpu, 10, i);
+    register_write(cpu, 11, mh->config.num_harts);
+    hart->stop_reason = STOP_NONE;
+  }
+}
+
+
+bool multihart_load_program(multihart_t* mh, const char* filename){
+  if (!mh || !filename || !mh->harts){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in multihart_load_program.\n");
+    return false;
+  }
+
+  if (!simulator_load_program(&mh->harts[0], filename)) return false;
+  start_harts(mh);
+  return true;
+}
+
+
+bool multihart_load_binary(multihart_t* mh, const uint32_t* program, size_t size){
+  if (!mh || !program || !mh->harts){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in multihart_load_binary.\n");
+    return false;
+  }
+
+  if (!simulator_load_binary(&mh->harts[0], program, size)) return false;
+  start_harts(mh);
+  return true;
+}
+
+//===========================================================================================
+//                                EXECUTION
+//===========================================================================================
+
+static void* worker_main(void* argument){
+  multihart_worker_t* worker = (multihart_worker_t *) argument;
+  multihart_run_t* run = worker->run;
+  multihart_t* mh = run->mh;
+  uint32_t num_harts = mh->config.num_harts;
+
+  pthread_mutex_lock(&run->lock);
+  while (run->num_threads == 0) pthread_cond_wait(&run->start, &run->lock);
+  uint32_t stride = run->num_threads;
+  pthread_mutex_unlock(&run->lock);
+
+  // Barriers order every quantum before the next, including the serial thread's check
+  for (;;){
+    for (uint32_t i = worker->index; i < num_harts; i += stride){
+      simulator_t* hart = &mh->harts[i];
+      if (!hart_stopped(hart)) simulator_advance(hart, run->mode, mh->config.quantum);
+    }
+
+    if (pthread_barrier_wait(&run->barrier) == PTHREAD_BARRIER_SERIAL_THREAD){
+      bool finished = true;
+      for (uint32_t i = 0; i < num_harts && finished; ++i) finished = hart_stopped(&mh->harts[i]);
+      run->finished = finished;
+      mh->quanta++;
+    }
+    pthread_barrier_wait(&run->barrier);
+    if (run->finished) break;
+  }
+  return NULL;
+}
+
+
+void multihart_run(multihart_t* mh){
+  if (!mh || !mh->harts){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in multihart_run.\n");
+    return;
+  }
+
+  uint32_t num_harts = mh->config.num_harts;
+  multihart_worker_t* workers = (multihart_worker_t *) calloc(num_harts, sizeof(multihart_worker_t));
+  if (!workers){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in multihart_run.\n");
+    return;
+  }
+
+  multihart_run_t run = {
+    .mh = mh,
+    .mode = mh->harts[0].config.execution_mode
+  };
+  pthread_mutex_init(&run.lock, NULL);
+  pthread_cond_init(&run.start, NULL);
+  mh->quanta = 0;
+  double start = now_seconds();
+  uint64_t start_instructions[MULTIHART_MAX_HARTS];
+  for (uint32_t i = 0; i < num_harts; ++i) start_instructions[i] = mh->harts[i].cpu.total_instructions;
+
+  // The calling thread is worker 0; threads that fail to start leave their harts to the others
+  uint32_t started = 1;
+  for (uint32_t i = 0; i < num_harts; ++i){
+    workers[i].run = &run;
+    workers[i].index = i;
+  }
+  if (!mh->config.deterministic){
+    for (; started < num_harts; ++started){
+      if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0){
+        fprintf(stderr, "Error: Cannot start hart thread in multihart_run.\n");
+        break;
+      }
+    }
+  }
+
+  pthread_barrier_init(&run.barrier, NULL, started);
+  pthread_mutex_lock(&run.lock);
+  run.num_threads = started;
+  pthread_cond_broadcast(&run.start);
+  pthread_mutex_unlock(&run.lock);
+
+  worker_main(&workers[0]);
+  for (uint32_t i = 1; i < started; ++i) pthread_join(workers[i].thread, NULL);
+
+  mh->num_threads = started;
+  mh->simulation_time_seconds = now_seconds() - start;
+  for (uint32_t i = 0; i < num_harts; ++i){
+    simulator_t* hart = &mh->harts[i];
+    uint64_t executed = hart->cpu.total_instructions - start_instructions[i];
+    hart->simulation_time_seconds = mh->simulation_time_seconds;
+    hart->instructions_per_second = mh->simulation_time_seconds > 0.0
+                                  ? (double) executed / mh->simulation_time_seconds
+                                  : 0.0;
+  }
+
+  pthread_barrier_destroy(&run.barrier);
+  pthread_cond_destroy(&run.start);
+  pthread_mutex_destroy(&run.lock);
+  free(workers);
+}
+
+//===========================================================================================
+//                                STATISTICS
+//===========================================================================================
+
+void multihart_print_stats(const multihart_t* mh, FILE* out){
+  if (!mh || !mh->harts){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in multihart_print_stats.\n");
+    return;
+  }
+  if (!out) out = stdout;
+
+  uint64_t instructions = 0;
+  for (uint32_t i = 0; i < mh->config.num_harts; ++i) instructions += mh->harts[i].cpu.total_instructions;
+  double seconds = mh->simulation_time_seconds;
+
+  fprintf(out, "MULTI-HART SIMULATION\n");
+  fprintf(out, "=====================\n");
+  fprintf(out, "HARTS                  --- %u\n", mh->config.num_harts);
+  fprintf(out, "HOST THREADS           --- %u%s\n", mh->num_threads, mh->config.deterministic ? " (deterministic)" : "");
+  fprintf(out, "QUANTUM                --- %lu\n", mh->config.quantum);
+  fprintf(out, "QUANTA                 --- %lu\n", mh->quanta);
+  fprintf(out, "TOTAL INSTRUCTIONS     --- %lu\n", instructions);
+  fprintf(out, "SIMULATION TIME        --- %.6f s\n", seconds);
+  fprintf(out, "INSTRUCTIONS / SECOND  --- %.0f\n", seconds > 0.0 ? (double) instructions / seconds : 0.0);
+
+  fprintf(out, "%6s %14s %14s %8s %10s %s\n", "HART", "INSTRUCTIONS", "CYCLES", "CPI", "EXIT CODE", "STOP");
+  for (uint32_t i = 0; i < mh->config.num_harts; ++i){
+    const cpu_state_t* cpu = &mh->harts[i].cpu;
+    double cpi = cpu->total_instructions ? (double) cpu->total_cycles / (double) cpu->total_instructions : 0.0;
+    fprintf(out, "%6u %14lu %14lu %8.4f %10u %s\n", i, cpu->total_instructions, cpu->total_cycles, cpi,
+            mh->harts[i].exit_code, simulator_stop_reason_name(mh->harts[i].stop_reason));
+  }
+}
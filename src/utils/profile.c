@@ -0,0 +1,202 @@
+#include "utils/profile.h"
+#include "decode/instruction.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const stall_names[] = {
+  [PROFILE_STALL_LOAD_USE] = "load_use",
+  [PROFILE_STALL_CONTROL] = "control",
+  [PROFILE_STALL_ICACHE] = "icache",
+  [PROFILE_STALL_DCACHE] = "dcache",
+  [PROFILE_STALL_SERIALIZE] = "serialize"
+};
+
+//===========================================================================================
+//                                PROFILE LIFECYCLE
+//===========================================================================================
+
+bool profile_init(profile_t* profile, uint32_t base_address, size_t size){
+  if (!profile){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in profile_init.\n");
+    return false;
+  }
+
+  memset(profile, 0, sizeof(profile_t));
+  if (!PROFILE_COUNTERS){
+    fprintf(stderr, "Error: Built without performance counters (PROFILE_COUNTERS=0) in profile_init.\n");
+    return false;
+  }
+
+  // calloc leaves large arrays to the host's zero pages until they are written
+  profile->base_address = base_address;
+  profile->num_slots = size / 4;
+  profile->executions = (uint64_t *) calloc(profile->num_slots, sizeof(uint64_t));
+  profile->branch_executions = (uint64_t *) calloc(profile->num_slots, sizeof(uint64_t));
+  profile->branch_taken = (uint64_t *) calloc(profile->num_slots, sizeof(uint64_t));
+  profile->branch_mispredictions = (uint64_t *) calloc(profile->num_slots, sizeof(uint64_t));
+  if (!profile->executions || !profile->branch_executions || !profile->branch_taken ||
+      !profile->branch_mispredictions){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in profile_init.\n");
+    profile_destroy(profile);
+    return false;
+  }
+
+  profile->first_slot = SIZE_MAX;
+  return true;
+}
+
+
+void profile_destroy(profile_t* profile){
+  if (!profile){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in profile_destroy.\n");
+    return;
+  }
+
+  free(profile->executions);
+  free(profile->branch_executions);
+  free(profile->branch_taken);
+  free(profile->branch_mispredictions);
+  memset(profile, 0, sizeof(profile_t));
+}
+
+
+void profile_reset(profile_t* profile){
+  if (!profile){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in profile_reset.\n");
+    return;
+  }
+
+  // Only the touched range can be non-zero
+  if (profile->first_slot <= profile->last_slot){
+    size_t count = profile->last_slot - profile->first_slot + 1;
+    memset(profile->executions + profile->first_slot, 0, count * sizeof(uint64_t));
+    memset(profile->branch_executions + profile->first_slot, 0, count * sizeof(uint64_t));
+    memset(profile->branch_taken + profile->first_slot, 0, count * sizeof(uint64_t));
+    memset(profile->branch_mispredictions + profile->first_slot, 0, count * sizeof(uint64_t));
+  }
+  profile->first_slot = SIZE_MAX;
+  profile->last_slot = 0;
+  profile->outside = 0;
+  memset(profile->classes, 0, sizeof(profile->classes));
+  memset(profile->stall_cycles, 0, sizeof(profile->stall_cycles));
+}
+
+//===========================================================================================
+//                                EXPORT
+//===========================================================================================
+
+static uint64_t total_retired(const profile_t* profile){
+  uint64_t total = 0;
+  for (size_t i = 0; i <= INST_INVALID; ++i) total += profile->classes[i];
+  return total;
+}
+
+
+void profile_write_json(const profile_t* profile, FILE* out){
+  if (!profile || !out){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in profile_write_json.\n");
+    return;
+  }
+
+  fprintf(out, "{\n  \"instructions\": %lu,\n  \"outside\": %lu,\n", total_retired(profile), profile->outside);
+
+  fprintf(out, "  \"stall_cycles\": {");
+  for (size_t i = 0; i < PROFILE_STALL_COUNT; ++i){
+    fprintf(out, "%s\"%s\": %lu", i ? ", " : "", stall_names[i], profile->stall_cycles[i]);
+  }
+  fprintf(out, "},\n");
+
+  fprintf(out, "  \"classes\": {");
+  bool first = true;
+  for (size_t i = 0; i <= INST_INVALID; ++i){
+    if (!profile->classes[i]) continue;
+    fprintf(out, "%s\n    \"%s\": %lu", first ? "" : ",", instruction_type_name((instruction_type_t) i),
+            profile->classes[i]);
+    first = false;
+  }
+  fprintf(out, "%s},\n", first ? "" : "\n  ");
+
+  fprintf(out, "  \"pcs\": [");
+  first = true;
+  for (size_t slot = profile->first_slot; slot <= profile->last_slot && slot < profile->num_slots; ++slot){
+    if (!profile->executions[slot] && !profile->branch_executions[slot]) continue;
+    uint32_t pc = profile->base_address + (uint32_t) (slot * 4);
+    fprintf(out, "%s\n    {\"pc\": \"0x%08x\", \"count\": %lu", first ? "" : ",", pc, profile->executions[slot]);
+    if (profile->branch_executions[slot]){
+      fprintf(out, ", \"branches\": %lu, \"taken\": %lu, \"mispredicted\": %lu",
+              profile->branch_executions[slot], profile->branch_taken[slot],
+              profile->branch_mispredictions[slot]);
+    }
+    fprintf(out, "}");
+    first = false;
+  }
+  fprintf(out, "%s]\n}\n", first ? "" : "\n  ");
+}
+
+
+// One table: kind (stall, class, pc), name, count, then the branch columns of pc rows
+void profile_write_csv(const profile_t* profile, FILE* out){
+  if (!profile || !out){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in profile_write_csv.\n");
+    return;
+  }
+
+  fprintf(out, "kind,name,count,branches,taken,mispredicted\n");
+  for (size_t i = 0; i < PROFILE_STALL_COUNT; ++i){
+    fprintf(out, "stall,%s,%lu,,,\n", stall_names[i], profile->stall_cycles[i]);
+  }
+  for (size_t i = 0; i <= INST_INVALID; ++i){
+    if (profile->classes[i]) fprintf(out, "class,%s,%lu,,,\n", instruction_type_name((instruction_type_t) i), profile->classes[i]);
+  }
+  for (size_t slot = profile->first_slot; slot <= profile->last_slot && slot < profile->num_slots; ++slot){
+    if (!profile->executions[slot] && !profile->branch_executions[slot]) continue;
+    uint32_t pc = profile->base_address + (uint32_t) (slot * 4);
+    if (profile->branch_executions[slot]){
+      fprintf(out, "pc,0x%08x,%lu,%lu,%lu,%lu\n", pc, profile->executions[slot], profile->branch_executions[slot],
+              profile->branch_taken[slot], profile->branch_mispredictions[slot]);
+    }
+    else {
+      fprintf(out, "pc,0x%08x,%lu,,,\n", pc, profile->executions[slot]);
+    }
+  }
+}
+
+
+bool profile_export(const profile_t* profile, const char* filename, profile_format_t format){
+  if (!profile || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in profile_export.\n");
+    return false;
+  }
+
+  FILE* out = fopen(filename, "w");
+  if (!out){
+    fprintf(stderr, "Error: Cannot open %s in profile_export.\n", filename);
+    return false;
+  }
+  if (format == PROFILE_FORMAT_CSV) profile_write_csv(profile, out);
+  else profile_write_json(profile, out);
+
+  bool written = !ferror(out);
+  if (fclose(out) != 0) written = false;
+  if (!written) fprintf(stderr, "Error: Write to %s failed in profile_export.\n", filename);
+  return written;
+}
+
+//===========================================================================================
+//                                STATISTICS
+//===========================================================================================
+
+void profile_print_stats(const profile_t* profile){
+  if (!profile){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in profile_print_stats.\n");
+    return;
+  }
+
+  printf("LOAD-USE STALL CYCLES  --- %lu\n", profile->stall_cycles[PROFILE_STALL_LOAD_USE]);
+  printf("CONTROL STALL CYCLES   --- %lu\n", profile->stall_cycles[PROFILE_STALL_CONTROL]);
+  printf("L1I STALL CYCLES       --- %lu\n", profile->stall_cycles[PROFILE_STALL_ICACHE]);
+  printf("L1D STALL CYCLES       --- %lu\n", profile->stall_cycles[PROFILE_STALL_DCACHE]);
+  printf("SERIALIZE STALL CYCLES --- %lu\n", profile->stall_cycles[PROFILE_STALL_SERIALIZE]);
+}
@@ -0,0 +1,471 @@
+#include "utils/reverse.h"
+#include "cpu/interpreter.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static bool parse_count(const char* value, uint64_t* result){
+  char* end;
+  if (!value || !*value) return false;
+  *result = strtoull(value, &end, 0);
+  return *end == '\0';
+}
+
+
+static inline reverse_checkpoint_t* newest_checkpoint(reverse_t* rev){
+  return &rev->checkpoints[rev->num_checkpoints - 1];
+}
+
+
+// Recorded system call of the ECALL at position, NULL if there is none
+static reverse_syscall_t* find_syscall(const reverse_t* rev, uint64_t position){
+  size_t low = 0, high = rev->num_syscalls;
+  while (low < high){
+    size_t middle = low + (high - low) / 2;
+    if (rev->syscall_log[middle].instret < position) low = middle + 1;
+    else high = middle;
+  }
+  return low < rev->num_syscalls && rev->syscall_log[low].instret == position ? &rev->syscall_log[low] : NULL;
+}
+
+
+static void free_syscall(reverse_syscall_t* record){
+  free(record->old_bytes);
+  free(record->new_bytes);
+}
+
+
+static void free_checkpoint(reverse_checkpoint_t* checkpoint){
+  for (size_t i = 0; i < checkpoint->num_pages; ++i) free(checkpoint->pages[i].data);
+  free(checkpoint->pages);
+}
+
+//===========================================================================================
+//                                CHECKPOINTS
+//===========================================================================================
+
+// Copy the pages of [address, address + size) not yet copied since the newest checkpoint
+static void reverse_save_pages(reverse_t* rev, uint32_t address, uint32_t size){
+  reverse_checkpoint_t* checkpoint = newest_checkpoint(rev);
+  uint32_t first = address >> GUEST_PAGE_SHIFT;
+  uint32_t last = (uint32_t) (((uint64_t) address + size - 1) >> GUEST_PAGE_SHIFT);
+
+  for (uint32_t page = first; page <= last && page < GUEST_NUM_PAGES; ++page){
+    if (rev->page_serial[page] == checkpoint->serial) continue;
+
+    uint32_t page_address = page << GUEST_PAGE_SHIFT;
+    const uint8_t* data = cpu_memory_span(rev->cpu, page_address, GUEST_PAGE_SIZE, false);
+    if (!data) continue;   // Not guest memory, the write faults
+
+    if (checkpoint->num_pages == checkpoint->capacity){
+      size_t capacity = checkpoint->capacity ? checkpoint->capacity * 2 : 16;
+      reverse_page_t* pages = (reverse_page_t *) realloc(checkpoint->pages, capacity * sizeof(reverse_page_t));
+      if (!pages){ // Error Check
+        fprintf(stderr, "Error: Allocating memory error in reverse_save_pages.\n");
+        return;
+      }
+      checkpoint->pages = pages;
+      checkpoint->capacity = capacity;
+    }
+    uint8_t* copy = (uint8_t *) malloc(GUEST_PAGE_SIZE);
+    if (!copy){ // Error Check
+      fprintf(stderr, "Error: Allocating memory error in reverse_save_pages.\n");
+      return;
+    }
+    memcpy(copy, data, GUEST_PAGE_SIZE);
+    checkpoint->pages[checkpoint->num_pages++] = (reverse_page_t) { .address = page_address, .data = copy };
+    rev->page_serial[page] = checkpoint->serial;
+    rev->page_copies++;
+  }
+}
+
+
+// Save the current state as the newest checkpoint, dropping the oldest when full
+static void reverse_checkpoint(reverse_t* rev){
+  cpu_state_t* cpu = rev->cpu;
+
+  if (rev->num_checkpoints == rev->config.max_checkpoints){
+    free_checkpoint(&rev->checkpoints[0]);
+    memmove(rev->checkpoints, rev->checkpoints + 1, (rev->num_checkpoints - 1) * sizeof(reverse_checkpoint_t));
+    rev->num_checkpoints--;
+
+    // The history now starts at the next checkpoint
+    uint64_t start = rev->checkpoints[0].instret;
+    size_t dropped = 0;
+    while (dropped < rev->num_syscalls && rev->syscall_log[dropped].instret < start){
+      free_syscall(&rev->syscall_log[dropped++]);
+    }
+    memmove(rev->syscall_log, rev->syscall_log + dropped, (rev->num_syscalls - dropped) * sizeof(reverse_syscall_t));
+    rev->num_syscalls -= dropped;
+    if (rev->log_start < start) rev->log_start = start;
+  }
+
+  reverse_checkpoint_t* checkpoint = &rev->checkpoints[rev->num_checkpoints++];
+  memset(checkpoint, 0, sizeof(reverse_checkpoint_t));
+  checkpoint->instret = cpu->total_instructions;
+  checkpoint->cycles = cpu->total_cycles;
+  checkpoint->pc = cpu->pc;
+  checkpoint->reg_file = cpu->reg_file;
+  checkpoint->program_break = rev->syscalls ? rev->syscalls->program_break : 0;
+  checkpoint->serial = rev->next_serial++;
+}
+
+
+// Roll the state back to checkpoint index from position (no later than the
+// checkpoint after the one position is in); the undo log starts over there
+static void reverse_restore(reverse_t* rev, size_t index, uint64_t position){
+  cpu_state_t* cpu = rev->cpu;
+
+  // Pages of the intervals between it and position, newest first, leave each
+  // page as it was at the checkpoint
+  size_t newest = index;
+  while (newest + 1 < rev->num_checkpoints && rev->checkpoints[newest + 1].instret <= position) newest++;
+  for (size_t i = newest + 1; i-- > index;){
+    const reverse_checkpoint_t* checkpoint = &rev->checkpoints[i];
+    for (size_t p = 0; p < checkpoint->num_pages; ++p){
+      uint8_t* data = cpu_memory_span(cpu, checkpoint->pages[p].address, GUEST_PAGE_SIZE, true);
+      if (data) memcpy(data, checkpoint->pages[p].data, GUEST_PAGE_SIZE);
+    }
+  }
+
+  const reverse_checkpoint_t* checkpoint = &rev->checkpoints[index];
+  cpu->pc = checkpoint->pc;
+  cpu->reg_file = checkpoint->reg_file;
+  cpu->total_instructions = checkpoint->instret;
+  cpu->total_cycles = checkpoint->cycles;
+  cpu->pending_event = CPU_EVENT_NONE;
+  if (rev->syscalls) rev->syscalls->program_break = checkpoint->program_break;
+  rev->log_start = checkpoint->instret;
+}
+
+
+// Rebuild the undo log up to the current position from the checkpoint before it,
+// false at the start of the history
+static bool reverse_refill(reverse_t* rev){
+  cpu_state_t* cpu = rev->cpu;
+  uint64_t position = cpu->total_instructions;
+  if (position <= rev->checkpoints[0].instret) return false;
+
+  size_t index = rev->num_checkpoints - 1;
+  while (rev->checkpoints[index].instret >= position) index--;
+  reverse_restore(rev, index, position);
+
+  // Everything up to position was recorded, system calls replay
+  while (cpu->total_instructions < position){
+    if (!reverse_step(rev)) return false;
+    cpu->pending_event = CPU_EVENT_NONE;
+    rev->replayed++;
+  }
+  rev->exited = false;
+  return true;
+}
+
+//===========================================================================================
+//                                RECORDING
+//===========================================================================================
+
+// What the instruction at pc is about to overwrite, into rev->pending
+static void reverse_capture(reverse_t* rev, bool recording){
+  cpu_state_t* cpu = rev->cpu;
+  const predecoded_instruction_t* decoded = predecode_lookup(&cpu->predecode, cpu->pc);
+  const micro_op_t* op = &(decoded ? decoded : cpu_fetch_decoded(cpu, cpu->pc))->micro_op;
+  reverse_entry_t* entry = &rev->pending;
+
+  *entry = (reverse_entry_t) { .pc = cpu->pc };
+  if (op->reg_write_enable && op->rd){
+    entry->rd = (uint8_t) op->rd;
+    entry->old_value = cpu->reg_file.registers[op->rd];
+  }
+  else if (op->mem_op == MEM_WRITE){
+    uint32_t size = 1u << op->mem_size;
+    uint32_t address = cpu->reg_file.registers[(op->raw_instruction >> 15) & 0x1F] + (uint32_t) op->immediate;
+    const uint8_t* data = cpu_memory_span(cpu, address, size, false);
+    if (!data) return;   // Faults, never retires
+
+    memcpy(&entry->old_value, data, size);
+    entry->address = address;
+    entry->size = (uint8_t) size;
+    if (recording) reverse_save_pages(rev, address, size);
+  }
+}
+
+
+// Service the ECALL at position and record it, or replay its record
+static void reverse_syscall(reverse_t* rev, uint64_t position, bool recording){
+  cpu_state_t* cpu = rev->cpu;
+  syscall_state_t* sys = rev->syscalls;
+  reverse_entry_t* entry = &rev->pending;
+  entry->rd = 10;
+  entry->old_value = cpu->reg_file.registers[10];
+  entry->flags |= REVERSE_ENTRY_SYSCALL;
+
+  reverse_syscall_t* record = recording ? NULL : find_syscall(rev, position);
+  if (record){
+    uint8_t* data = record->length ? cpu_memory_span(cpu, record->address, record->length, true) : NULL;
+    if (data) memcpy(data, record->new_bytes, record->length);
+    sys->program_break = record->new_break;
+    if (record->exited){
+      rev->exited = true;
+      rev->exit_code = record->result;
+    }
+    else register_write(cpu, 10, record->result);
+    return;
+  }
+
+  if (rev->num_syscalls == rev->syscall_capacity){
+    size_t capacity = rev->syscall_capacity ? rev->syscall_capacity * 2 : 64;
+    reverse_syscall_t* log = (reverse_syscall_t *) realloc(rev->syscall_log, capacity * sizeof(reverse_syscall_t));
+    if (!log){ // Error Check
+      fprintf(stderr, "Error: Allocating memory error in reverse_syscall.\n");
+      rev->exited = syscall_handle(sys, cpu, &rev->exit_code);
+      return;
+    }
+    rev->syscall_log = log;
+    rev->syscall_capacity = capacity;
+  }
+  record = &rev->syscall_log[rev->num_syscalls];
+  memset(record, 0, sizeof(reverse_syscall_t));
+  record->instret = position;
+  record->old_break = sys->program_break;
+
+  // Only a buffer the call can write is kept, it fails with EFAULT otherwise
+  uint32_t address, length;
+  const uint8_t* data = NULL;
+  if (syscall_output_range(cpu, &address, &length)) data = cpu_memory_span(cpu, address, length, false);
+  if (data){
+    record->old_bytes = (uint8_t *) malloc(length);
+    record->new_bytes = (uint8_t *) malloc(length);
+    if (record->old_bytes && record->new_bytes){
+      record->address = address;
+      record->length = length;
+      memcpy(record->old_bytes, data, length);
+      reverse_save_pages(rev, address, length);
+    }
+  }
+
+  record->exited = syscall_handle(sys, cpu, &rev->exit_code);
+  rev->exited = record->exited;
+  record->result = record->exited ? rev->exit_code : cpu->reg_file.registers[10];
+  record->new_break = sys->program_break;
+  if (record->length) memcpy(record->new_bytes, data, record->length);
+  rev->num_syscalls++;
+}
+
+
+uint64_t reverse_step(reverse_t* rev){
+  if (!rev){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_step.\n");
+    return 0;
+  }
+
+  cpu_state_t* cpu = rev->cpu;
+  uint64_t position = cpu->total_instructions;
+  bool recording = position >= rev->frontier;
+  rev->exited = false;
+
+  reverse_capture(rev, recording);
+  if (!interpreter_step(cpu)) return 0;
+  if (cpu->pending_event == CPU_EVENT_ECALL && rev->syscalls){
+    cpu->pending_event = CPU_EVENT_NONE;
+    reverse_syscall(rev, position, recording);
+  }
+
+  rev->log[position & rev->log_mask] = rev->pending;
+  if (position - rev->log_start == rev->log_mask) rev->log_start++;   // Ring full, oldest goes
+  if (recording){
+    rev->frontier = position + 1;
+    if (rev->frontier - newest_checkpoint(rev)->instret >= rev->config.interval) reverse_checkpoint(rev);
+  }
+  return 1;
+}
+
+//===========================================================================================
+//                                STEPPING BACK
+//===========================================================================================
+
+// Undo the instruction before the current position
+static const reverse_entry_t* reverse_undo(reverse_t* rev){
+  cpu_state_t* cpu = rev->cpu;
+  uint64_t position = cpu->total_instructions - 1;
+  const reverse_entry_t* entry = &rev->log[position & rev->log_mask];
+
+  if (entry->flags & REVERSE_ENTRY_SYSCALL){
+    const reverse_syscall_t* record = find_syscall(rev, position);
+    if (record){
+      uint8_t* data = record->length ? cpu_memory_span(cpu, record->address, record->length, true) : NULL;
+      if (data) memcpy(data, record->old_bytes, record->length);
+      rev->syscalls->program_break = record->old_break;
+    }
+  }
+  if (entry->rd) cpu->reg_file.registers[entry->rd] = entry->old_value;
+  else if (entry->size){
+    uint8_t* data = cpu_memory_span(cpu, entry->address, entry->size, true);
+    if (data) memcpy(data, &entry->old_value, entry->size);
+  }
+
+  cpu->pc = entry->pc;
+  cpu->total_instructions = position;
+  cpu->total_cycles--;   // The interpreter counts one cycle per instruction
+  cpu->pending_event = CPU_EVENT_NONE;
+  rev->undone++;
+  return entry;
+}
+
+
+uint64_t reverse_back(reverse_t* rev, uint64_t max_steps, reverse_stop_t stop, void* context){
+  if (!rev){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_back.\n");
+    return 0;
+  }
+
+  uint64_t steps = 0;
+  rev->exited = false;
+  while (steps < max_steps){
+    if (rev->cpu->total_instructions == rev->log_start && !reverse_refill(rev)) break;
+
+    const reverse_entry_t* entry = reverse_undo(rev);
+    steps++;
+    if (stop && stop(rev, entry, context)) break;
+  }
+  return steps;
+}
+
+
+bool reverse_entry_writes(const reverse_t* rev, const reverse_entry_t* entry, uint32_t address, uint32_t size){
+  if (!rev || !entry){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_entry_writes.\n");
+    return false;
+  }
+
+  uint64_t end = (uint64_t) address + size;
+  if (entry->size && entry->address < end && address < (uint64_t) entry->address + entry->size) return true;
+  if (entry->flags & REVERSE_ENTRY_SYSCALL){
+    // Undone already, so its record is the one at the current position
+    const reverse_syscall_t* record = find_syscall(rev, rev->cpu->total_instructions);
+    return record && record->length && record->address < end && address < (uint64_t) record->address + record->length;
+  }
+  return false;
+}
+
+
+uint64_t reverse_history_start(const reverse_t* rev){
+  if (!rev){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_history_start.\n");
+    return 0;
+  }
+  return rev->num_checkpoints ? rev->checkpoints[0].instret : 0;
+}
+
+//===========================================================================================
+//                                CONFIGURATION AND LIFECYCLE
+//===========================================================================================
+
+void reverse_default_config(reverse_config_t* config){
+  if (!config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_default_config.\n");
+    return;
+  }
+
+  config->log_size = REVERSE_DEFAULT_LOG_SIZE;
+  config->interval = REVERSE_DEFAULT_INTERVAL;
+  config->max_checkpoints = REVERSE_DEFAULT_CHECKPOINTS;
+}
+
+
+bool reverse_parse_option(reverse_config_t* config, const char* field, const char* value){
+  if (!config || !field){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_parse_option.\n");
+    return false;
+  }
+
+  uint64_t count;
+  if (!parse_count(value, &count) || count > UINT32_MAX) return false;
+  if (strcmp(field, "log") == 0) config->log_size = (uint32_t) count;
+  else if (strcmp(field, "interval") == 0 && count > 0) config->interval = (uint32_t) count;
+  else if (strcmp(field, "checkpoints") == 0 && count > 0) config->max_checkpoints = (uint32_t) count;
+  else return false;
+  return true;
+}
+
+
+bool reverse_init(reverse_t* rev, const reverse_config_t* config, cpu_state_t* cpu, syscall_state_t* syscalls){
+  if (!rev || !config || !cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_init.\n");
+    return false;
+  }
+  memset(rev, 0, sizeof(reverse_t));
+  if (config->log_size == 0 || config->max_checkpoints == 0){
+    fprintf(stderr, "Error: Reverse execution needs an undo log and a checkpoint in reverse_init.\n");
+    return false;
+  }
+
+  rev->cpu = cpu;
+  rev->syscalls = syscalls;
+  rev->config = *config;
+
+  // The log holds at least one interval, so a refill never overruns it
+  uint64_t log_size = 1;
+  while (log_size < config->log_size) log_size <<= 1;
+  if (rev->config.interval == 0 || rev->config.interval > log_size - 1) rev->config.interval = (uint32_t) (log_size - 1);
+  if (rev->config.interval == 0) rev->config.interval = 1;
+  if (log_size < 2) log_size = 2;
+  rev->log_mask = log_size - 1;
+
+  rev->log = (reverse_entry_t *) malloc(log_size * sizeof(reverse_entry_t));
+  rev->checkpoints = (reverse_checkpoint_t *) calloc(config->max_checkpoints, sizeof(reverse_checkpoint_t));
+  rev->page_serial = (uint32_t *) calloc(GUEST_NUM_PAGES, sizeof(uint32_t));
+  if (!rev->log || !rev->checkpoints || !rev->page_serial){ // Error Check
+    fprintf(stderr, "Error: Allocating memory error in reverse_init.\n");
+    reverse_destroy(rev);
+    return false;
+  }
+
+  rev->next_serial = 1;
+  rev->frontier = cpu->total_instructions;
+  rev->log_start = cpu->total_instructions;
+  reverse_checkpoint(rev);
+  return true;
+}
+
+
+void reverse_destroy(reverse_t* rev){
+  if (!rev){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_destroy.\n");
+    return;
+  }
+
+  for (size_t i = 0; i < rev->num_checkpoints; ++i) free_checkpoint(&rev->checkpoints[i]);
+  for (size_t i = 0; i < rev->num_syscalls; ++i) free_syscall(&rev->syscall_log[i]);
+  free(rev->checkpoints);
+  free(rev->syscall_log);
+  free(rev->page_serial);
+  free(rev->log);
+  memset(rev, 0, sizeof(reverse_t));
+}
+
+
+void reverse_print_stats(const reverse_t* rev, FILE* out){
+  if (!rev){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in reverse_print_stats.\n");
+    return;
+  }
+  if (!out) out = stdout;
+
+  size_t pages = 0;
+  for (size_t i = 0; i < rev->num_checkpoints; ++i) pages += rev->checkpoints[i].num_pages;
+
+  fprintf(out, "HISTORY START          --- %lu\n", reverse_history_start(rev));
+  fprintf(out, "HISTORY END            --- %lu\n", rev->frontier);
+  fprintf(out, "UNDO LOG               --- %lu of %lu entries\n", rev->cpu->total_instructions - rev->log_start,
+          rev->log_mask);
+  fprintf(out, "CHECKPOINTS            --- %zu (%zu pages, %zu KB)\n", rev->num_checkpoints, pages,
+          pages * GUEST_PAGE_SIZE / 1024);
+  fprintf(out, "SYSTEM CALLS           --- %zu\n", rev->num_syscalls);
+  fprintf(out, "STEPPED BACK           --- %lu\n", rev->undone);
+  fprintf(out, "REPLAYED               --- %lu\n", rev->replayed);
+}
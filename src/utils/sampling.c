@@ -0,0 +1,438 @@
+#include "utils/sampling.h"
+#include "pipeline/pipeline.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BBV_INITIAL_CAPACITY 1024           // Basic-block table slots, power of two
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static double now_seconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+static bool parse_count(const char* value, uint64_t* result){
+  char* end;
+  if (!value || !*value) return false;
+  *result = strtoull(value, &end, 0);
+  return *end == '\0';
+}
+
+
+static sample_t* add_sample(sampling_result_t* result){
+  if (result->num_samples == result->capacity){
+    size_t capacity = result->capacity ? result->capacity * 2 : 64;
+    sample_t* samples = (sample_t *) realloc(result->samples, capacity * sizeof(sample_t));
+    if (!samples){ // Error Check
+      fprintf(stderr, "Error: Memory allocation error in sampling_run.\n");
+      return NULL;
+    }
+    result->samples = samples;
+    result->capacity = capacity;
+  }
+  sample_t* sample = &result->samples[result->num_samples++];
+  memset(sample, 0, sizeof(sample_t));
+  return sample;
+}
+
+//===========================================================================================
+//                                CONFIGURATION
+//===========================================================================================
+
+void sampling_default_config(sampling_config_t* config){
+  if (!config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sampling_default_config.\n");
+    return;
+  }
+
+  memset(config, 0, sizeof(sampling_config_t));
+  config->fast_forward = 10000000;
+  config->warmup = 10000;
+  config->fast_forward_mode = EXEC_MODE_JIT;
+}
+
+
+bool sampling_parse_option(sampling_config_t* config, const char* option){
+  if (!config || !option){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sampling_parse_option.\n");
+    return false;
+  }
+
+  char key[32];
+  const char* value = strchr(option, '=');
+  size_t key_length = value ? (size_t) (value - option) : strlen(option);
+  if (key_length >= sizeof(key)) key_length = sizeof(key) - 1;
+  memcpy(key, option, key_length);
+  key[key_length] = '\0';
+  if (value) value++;
+
+  // File names point into option, it has to outlive the configuration
+  bool parsed = false;
+  if (!value || !*value) parsed = false;
+  else if (strcmp(key, "sample_fast_forward") == 0) parsed = parse_count(value, &config->fast_forward);
+  else if (strcmp(key, "sample_warmup") == 0) parsed = parse_count(value, &config->warmup);
+  else if (strcmp(key, "sample_interval") == 0) parsed = parse_count(value, &config->interval);
+  else if (strcmp(key, "sample_max") == 0) parsed = parse_count(value, &config->max_samples);
+  else if (strcmp(key, "sample_mode") == 0){
+    if ((parsed = strcmp(value, "functional") == 0)) config->fast_forward_mode = EXEC_MODE_FUNCTIONAL;
+    else if ((parsed = strcmp(value, "jit") == 0)) config->fast_forward_mode = EXEC_MODE_JIT;
+  }
+  else if (strcmp(key, "sample_points") == 0){
+    config->points_file = value;
+    parsed = true;
+  }
+  else if (strcmp(key, "sample_weights") == 0){
+    config->weights_file = value;
+    parsed = true;
+  }
+  else if (strcmp(key, "sample_bbv") == 0){
+    config->bbv_file = value;
+    parsed = true;
+  }
+
+  if (!parsed) fprintf(stderr, "Error: Invalid option '%s' in sampling_parse_option.\n", option);
+  return parsed;
+}
+
+//===========================================================================================
+//                                SIMPOINT FILES
+//===========================================================================================
+
+// Interval to measure and its weight
+typedef struct {
+  uint64_t interval;
+  uint64_t cluster;
+  double weight;
+} sample_point_t;
+
+
+static int compare_points(const void* a, const void* b){
+  const sample_point_t* x = (const sample_point_t *) a;
+  const sample_point_t* y = (const sample_point_t *) b;
+  return (x->interval > y->interval) - (x->interval < y->interval);
+}
+
+
+// "interval cluster" lines, weights from "weight cluster" lines; sorted by interval
+static sample_point_t* load_points(const sampling_config_t* config, size_t* count){
+  FILE* file = fopen(config->points_file, "r");
+  if (!file){ // Error Check
+    fprintf(stderr, "Error: Cannot open %s in sampling_run.\n", config->points_file);
+    return NULL;
+  }
+
+  sample_point_t* points = NULL;
+  size_t num_points = 0, capacity = 0;
+  unsigned long long interval, cluster;
+  while (fscanf(file, "%llu %llu", &interval, &cluster) == 2){
+    if (num_points == capacity){
+      capacity = capacity ? capacity * 2 : 32;
+      sample_point_t* grown = (sample_point_t *) realloc(points, capacity * sizeof(sample_point_t));
+      if (!grown){ // Error Check
+        fprintf(stderr, "Error: Memory allocation error in sampling_run.\n");
+        free(points);
+        fclose(file);
+        return NULL;
+      }
+      points = grown;
+    }
+    points[num_points++] = (sample_point_t) { .interval = interval, .cluster = cluster, .weight = 1.0 };
+  }
+  fclose(file);
+
+  if (config->weights_file){
+    file = fopen(config->weights_file, "r");
+    if (!file){ // Error Check
+      fprintf(stderr, "Error: Cannot open %s in sampling_run.\n", config->weights_file);
+      free(points);
+      return NULL;
+    }
+    double weight;
+    while (fscanf(file, "%lf %llu", &weight, &cluster) == 2){
+      for (size_t i = 0; i < num_points; ++i){
+        if (points[i].cluster == cluster) points[i].weight = weight;
+      }
+    }
+    fclose(file);
+  }
+
+  qsort(points, num_points, sizeof(sample_point_t), compare_points);
+  *count = num_points;
+  return points;
+}
+
+//===========================================================================================
+//                                SAMPLED SIMULATION
+//===========================================================================================
+
+// Measure one interval in the pipeline, then drain it back to an architectural state
+static bool measure_sample(simulator_t* sim, const sampling_config_t* config, sampling_result_t* result, double weight){
+  cpu_state_t* cpu = &sim->cpu;
+
+  result->warmed += simulator_advance(sim, EXEC_MODE_PIPELINE, config->warmup);
+
+  sample_t* sample = add_sample(result);
+  if (!sample) return false;
+  sample->start = cpu->total_instructions;
+  sample->weight = weight;
+  uint64_t cycles = cpu->total_cycles;
+  uint64_t stalls = cpu->pipeline_stalls;
+  uint64_t branches = cpu->branch_instructions;
+  uint64_t mispredictions = cpu->branch_mispredictions;
+
+  if (sim->running) sample->instructions = simulator_advance(sim, EXEC_MODE_PIPELINE, config->interval);
+  sample->cycles = cpu->total_cycles - cycles;
+  sample->pipeline_stalls = cpu->pipeline_stalls - stalls;
+  sample->branch_instructions = cpu->branch_instructions - branches;
+  sample->branch_mispredictions = cpu->branch_mispredictions - mispredictions;
+  if (sample->instructions == 0) result->num_samples--;   // Program ended during warm-up
+
+  pipeline_flush(cpu);
+  return true;
+}
+
+
+bool sampling_run(simulator_t* sim, const sampling_config_t* config, sampling_result_t* result){
+  if (!sim || !config || !result){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sampling_run.\n");
+    return false;
+  }
+  if (config->interval == 0 || config->fast_forward_mode == EXEC_MODE_PIPELINE){
+    fprintf(stderr, "Error: Sampling needs an interval and a functional fast-forward mode in sampling_run.\n");
+    return false;
+  }
+
+  memset(result, 0, sizeof(sampling_result_t));
+  size_t num_points = 0;
+  sample_point_t* points = NULL;
+  if (config->points_file && !(points = load_points(config, &num_points))) return false;
+
+  cpu_state_t* cpu = &sim->cpu;
+  uint64_t origin = cpu->total_instructions;
+  double start_time = now_seconds();
+  bool ok = true;
+  sim->running = true;
+
+  for (size_t i = 0; ok && sim->running; ++i){
+    if (config->max_samples && result->num_samples >= config->max_samples) break;
+
+    // Functional part up to the warm-up of the next sample
+    uint64_t skip = config->fast_forward;
+    double weight = 1.0;
+    if (points){
+      if (i == num_points) break;
+      uint64_t target = origin + points[i].interval * config->interval;
+      target = target > config->warmup ? target - config->warmup : 0;
+      skip = target > cpu->total_instructions ? target - cpu->total_instructions : 0;
+      weight = points[i].weight;
+    }
+    if (skip) result->fast_forwarded += simulator_advance(sim, config->fast_forward_mode, skip);
+    if (!sim->running) break;
+
+    ok = measure_sample(sim, config, result, weight);
+  }
+  free(points);
+
+  // Whole-program estimate
+  double cycles = 0.0, instructions = 0.0, weights = 0.0, weighted_cpi = 0.0;
+  for (size_t i = 0; i < result->num_samples; ++i){
+    const sample_t* sample = &result->samples[i];
+    cycles += (double) sample->cycles;
+    instructions += (double) sample->instructions;
+    weights += sample->weight;
+    weighted_cpi += sample->weight * (double) sample->cycles / (double) sample->instructions;
+  }
+  if (config->points_file) result->cpi = weights > 0.0 ? weighted_cpi / weights : 0.0;
+  else result->cpi = instructions > 0.0 ? cycles / instructions : 0.0;
+
+  result->seconds = now_seconds() - start_time;
+  if (sim->running){   // Sampling ended before the program
+    sim->running = false;
+    sim->stop_reason = STOP_LIMIT;
+  }
+  return ok;
+}
+
+//===========================================================================================
+//                                BASIC-BLOCK VECTORS
+//===========================================================================================
+
+// Basic blocks by start PC, ids numbered from 1 in order of first execution
+typedef struct {
+  uint32_t* pcs;                  // Open-addressed, slot holds pc + 1, 0 = free
+  uint32_t* ids;
+  size_t capacity;                // Power of two
+  size_t num_blocks;
+
+  uint64_t* counts;               // Instructions per block id in the current interval
+  uint32_t* touched;              // Ids with a non-zero count
+  size_t num_touched;
+} bbv_table_t;
+
+
+static size_t bbv_slot(const bbv_table_t* table, uint32_t pc){
+  size_t mask = table->capacity - 1;
+  size_t slot = ((size_t) (pc >> 2) * 0x9E3779B1u) & mask;
+  while (table->pcs[slot] && table->pcs[slot] != pc + 1) slot = (slot + 1) & mask;
+  return slot;
+}
+
+
+static bool bbv_grow(bbv_table_t* table){
+  size_t capacity = table->capacity ? table->capacity * 2 : BBV_INITIAL_CAPACITY;
+  uint32_t* pcs = (uint32_t *) calloc(capacity, sizeof(uint32_t));
+  uint32_t* ids = (uint32_t *) malloc(capacity * sizeof(uint32_t));
+  uint64_t* counts = (uint64_t *) realloc(table->counts, (capacity / 2 + 1) * sizeof(uint64_t));
+  if (counts) table->counts = counts;
+  uint32_t* touched = (uint32_t *) realloc(table->touched, (capacity / 2 + 1) * sizeof(uint32_t));
+  if (touched) table->touched = touched;
+  if (!pcs || !ids || !counts || !touched){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in sampling_profile_bbv.\n");
+    free(pcs);
+    free(ids);
+    return false;
+  }
+  memset(table->counts + table->num_blocks + 1, 0, (capacity / 2 - table->num_blocks) * sizeof(uint64_t));
+
+  bbv_table_t old = *table;
+  table->pcs = pcs;
+  table->ids = ids;
+  table->capacity = capacity;
+  for (size_t i = 0; i < old.capacity; ++i){
+    if (!old.pcs[i]) continue;
+    size_t slot = bbv_slot(table, old.pcs[i] - 1);
+    table->pcs[slot] = old.pcs[i];
+    table->ids[slot] = old.ids[i];
+  }
+  free(old.pcs);
+  free(old.ids);
+  return true;
+}
+
+
+// Id of the block starting at pc, 0 when out of memory
+static uint32_t bbv_block(bbv_table_t* table, uint32_t pc){
+  if ((table->num_blocks + 1) * 2 > table->capacity && !bbv_grow(table)) return 0;
+
+  size_t slot = bbv_slot(table, pc);
+  if (!table->pcs[slot]){
+    table->pcs[slot] = pc + 1;
+    table->ids[slot] = (uint32_t) ++table->num_blocks;
+  }
+  return table->ids[slot];
+}
+
+
+// One "T:id:count ..." line, then start a new interval
+static void bbv_write_interval(bbv_table_t* table, FILE* out){
+  fputc('T', out);
+  for (size_t i = 0; i < table->num_touched; ++i){
+    uint32_t id = table->touched[i];
+    fprintf(out, ":%u:%lu ", id, table->counts[id]);
+    table->counts[id] = 0;
+  }
+  fputc('\n', out);
+  table->num_touched = 0;
+}
+
+
+bool sampling_profile_bbv(simulator_t* sim, const sampling_config_t* config){
+  if (!sim || !config || !config->bbv_file){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sampling_profile_bbv.\n");
+    return false;
+  }
+  if (config->interval == 0){
+    fprintf(stderr, "Error: BBV profiling needs an interval in sampling_profile_bbv.\n");
+    return false;
+  }
+
+  FILE* out = fopen(config->bbv_file, "w");
+  if (!out){ // Error Check
+    fprintf(stderr, "Error: Cannot open %s in sampling_profile_bbv.\n", config->bbv_file);
+    return false;
+  }
+
+  cpu_state_t* cpu = &sim->cpu;
+  bbv_table_t table = {0};
+  uint64_t in_interval = 0;
+  uint32_t block = 0;
+  bool ok = true;
+  sim->running = true;
+
+  // Instruction by instruction, blocks end at control transfers and system instructions
+  while (ok && sim->running){
+    uint32_t pc = cpu->pc;
+    const control_signals_t* ctrl = &cpu_fetch_decoded(cpu, pc)->control;
+    bool ends_block = ctrl->is_branch || ctrl->is_jump || ctrl->is_system_call || ctrl->is_breakpoint || ctrl->is_fence;
+
+    if (!block && !(block = bbv_block(&table, pc))) ok = false;
+    if (!ok || !simulator_advance(sim, EXEC_MODE_FUNCTIONAL, 1)) break;
+
+    if (table.counts[block]++ == 0) table.touched[table.num_touched++] = block;
+    if (ends_block || cpu->pc != pc + 4) block = 0;
+    if (++in_interval == config->interval){
+      bbv_write_interval(&table, out);
+      in_interval = 0;
+    }
+  }
+  if (in_interval) bbv_write_interval(&table, out);   // Partial last interval
+
+  free(table.pcs);
+  free(table.ids);
+  free(table.counts);
+  free(table.touched);
+  fclose(out);
+  return ok;
+}
+
+//===========================================================================================
+//                                RESULTS
+//===========================================================================================
+
+void sampling_result_destroy(sampling_result_t* result){
+  if (!result){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sampling_result_destroy.\n");
+    return;
+  }
+  free(result->samples);
+  memset(result, 0, sizeof(sampling_result_t));
+}
+
+
+void sampling_print_result(const sampling_result_t* result, FILE* out){
+  if (!result){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sampling_print_result.\n");
+    return;
+  }
+  if (!out) out = stdout;
+
+  uint64_t measured = 0;
+  for (size_t i = 0; i < result->num_samples; ++i) measured += result->samples[i].instructions;
+
+  fprintf(out, "SAMPLED SIMULATION\n");
+  fprintf(out, "==================\n");
+  fprintf(out, "SAMPLES                --- %zu\n", result->num_samples);
+  fprintf(out, "MEASURED INSTRUCTIONS  --- %lu\n", measured);
+  fprintf(out, "WARM-UP INSTRUCTIONS   --- %lu\n", result->warmed);
+  fprintf(out, "FAST-FORWARDED         --- %lu\n", result->fast_forwarded);
+  fprintf(out, "ESTIMATED CPI          --- %.4f\n", result->cpi);
+  fprintf(out, "SIMULATION TIME        --- %.6f s\n", result->seconds);
+
+  fprintf(out, "%8s %14s %12s %12s %8s %10s %12s %8s\n",
+          "SAMPLE", "START", "INSTRUCTIONS", "CYCLES", "CPI", "STALLS", "MISPREDICTS", "WEIGHT");
+  for (size_t i = 0; i < result->num_samples; ++i){
+    const sample_t* sample = &result->samples[i];
+    fprintf(out, "%8zu %14lu %12lu %12lu %8.4f %10lu %12lu %8.4f\n",
+            i, sample->start, sample->instructions, sample->cycles,
+            (double) sample->cycles / (double) sample->instructions,
+            sample->pipeline_stalls, sample->branch_mispredictions, sample->weight);
+  }
+}
@@ -0,0 +1,1117 @@
+#include "utils/simulator.h"
+#include "cpu/interpreter.h"
+#include "cpu/jit.h"
+#include "memory/memory.h"
+#include "pipeline/pipeline.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static uint64_t now_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+
+static void simulator_stop(simulator_t* sim, stop_reason_t reason, uint32_t exit_code){
+  sim->running = false;
+  sim->stop_reason = reason;
+  sim->exit_code = exit_code;
+}
+
+
+static bool simulator_limit_reached(const simulator_t* sim){
+  const cpu_state_t* cpu = &sim->cpu;
+  if (sim->config.max_cycles && cpu->total_cycles >= sim->config.max_cycles) return true;
+  if (sim->config.max_instructions && cpu->total_instructions >= sim->config.max_instructions) return true;
+  return false;
+}
+
+
+// Instructions the functional engine may run before hitting a limit or stop_at (0 = unlimited)
+static uint64_t simulator_instruction_budget(const simulator_t* sim, uint64_t stop_at){
+  const cpu_state_t* cpu = &sim->cpu;
+  uint64_t budget = stop_at != UINT64_MAX ? stop_at - cpu->total_instructions : 0;
+
+  if (sim->config.max_instructions && (!budget || sim->config.max_instructions - cpu->total_instructions < budget)){
+    budget = sim->config.max_instructions - cpu->total_instructions;
+  }
+  if (sim->config.max_cycles){
+    uint64_t cycles_left = sim->config.max_cycles - cpu->total_cycles;
+    if (!budget || cycles_left < budget) budget = cycles_left;
+  }
+  return budget;
+}
+
+
+// Act on the event raised by the last instruction; cpu->pc is architectural here
+static void simulator_handle_event(simulator_t* sim){
+  cpu_state_t* cpu = &sim->cpu;
+  cpu_event_t event = cpu->pending_event;
+  cpu->pending_event = CPU_EVENT_NONE;
+
+  switch (event){
+    case CPU_EVENT_NONE:
+      break;
+    case CPU_EVENT_ECALL:
+      if (sim->config.syscalls){
+        uint32_t exit_code;
+        if (syscall_handle(&sim->syscalls, cpu, &exit_code)) simulator_stop(sim, STOP_EXIT, exit_code);
+      }
+      else if (sim->config.break_on_ecall){
+        simulator_stop(sim, STOP_EXIT, register_read(cpu, 10));
+      }
+      break;
+    case CPU_EVENT_EBREAK:
+      if (sim->config.break_on_ebreak){
+        sim->running = false;
+        sim->paused = true;
+        sim->stop_reason = STOP_BREAK;
+      }
+      break;
+    case CPU_EVENT_ILLEGAL_INSTRUCTION:
+      if (cpu_breakpoint_hit(cpu)){   // Debugger breakpoints decode as illegal instructions
+        cpu->debug->breakpoint_hits++;
+        sim->running = false;
+        sim->paused = true;
+        sim->stop_reason = STOP_BREAK;
+        break;
+      }
+      fprintf(stderr, "Error: Illegal instruction at PC 0x%08x.\n", cpu->pc);
+      simulator_stop(sim, STOP_FAULT, 1);
+      break;
+    case CPU_EVENT_MEMORY_FAULT:
+      fprintf(stderr, "Error: Memory fault at PC 0x%08x.\n", cpu->pc);
+      simulator_stop(sim, STOP_FAULT, 1);
+      break;
+    case CPU_EVENT_WATCHPOINT:
+      sim->running = false;
+      sim->paused = true;
+      sim->stop_reason = STOP_BREAK;
+      break;
+  }
+}
+
+//===========================================================================================
+//                                CONFIGURATION
+//===========================================================================================
+
+static const char* const mode_names[] = {
+  [EXEC_MODE_PIPELINE] = "pipeline",
+  [EXEC_MODE_FUNCTIONAL] = "functional",
+  [EXEC_MODE_JIT] = "jit"
+};
+
+static const char* const backend_names[] = {
+  [MEMORY_BACKEND_BANKED] = "banked",
+  [MEMORY_BACKEND_SPARSE] = "sparse"
+};
+
+static const char* const replacement_names[] = {
+  [CACHE_REPLACE_LRU] = "lru",
+  [CACHE_REPLACE_FIFO] = "fifo",
+  [CACHE_REPLACE_RANDOM] = "random"
+};
+
+static const char* const trace_full_names[] = {
+  [TRACE_FULL_BLOCK] = "block",
+  [TRACE_FULL_DROP] = "drop",
+  [TRACE_FULL_SAMPLE] = "sample"
+};
+
+static const char* const stop_reason_names[] = {
+  [STOP_NONE] = "none",
+  [STOP_EXIT] = "exit",
+  [STOP_LIMIT] = "limit",
+  [STOP_BREAK] = "break",
+  [STOP_FAULT] = "fault"
+};
+
+
+// Index of name in a name table, -1 if it is not there
+static int find_name(const char* const* names, size_t count, const char* name){
+  for (size_t i = 0; i < count; ++i){
+    if (strcmp(names[i], name) == 0) return (int) i;
+  }
+  return -1;
+}
+
+
+static bool parse_bool(const char* value, bool* result){
+  if (!value || strcmp(value, "1") == 0 || strcmp(value, "true") == 0) *result = true;
+  else if (strcmp(value, "0") == 0 || strcmp(value, "false") == 0) *result = false;
+  else return false;
+  return true;
+}
+
+
+static bool parse_count(const char* value, uint64_t* result){
+  char* end;
+  if (!value || !*value) return false;
+  *result = strtoull(value, &end, 0);
+  return *end == '\0';
+}
+
+
+void simulator_default_config(simulator_config_t* config){
+  if (!config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_default_config.\n");
+    return;
+  }
+
+  memset(config, 0, sizeof(simulator_config_t));
+  config->break_on_ecall = true;
+  config->break_on_ebreak = true;
+  config->trace_ring_size = TRACE_DEFAULT_RING_SIZE;
+
+  // Geometry used once a size is given
+  config->icache = (cache_config_t) {
+    .ways = 2, .line_size = 64, .replacement = CACHE_REPLACE_LRU, .hit_latency = 1, .miss_penalty = 20
+  };
+  config->dcache = (cache_config_t) {
+    .ways = 4, .line_size = 64, .replacement = CACHE_REPLACE_LRU, .hit_latency = 1, .miss_penalty = 20
+  };
+  config->predictor = (branch_predictor_config_t) {
+    .type = BP_STATIC, .table_bits = 12, .history_bits = 12, .btb_bits = 9, .ras_size = 16
+  };
+  reverse_default_config(&config->reverse);
+}
+
+
+// "l1i_<field>" and "l1d_<field>" options
+static bool parse_cache_option(cache_config_t* cache, const char* field, const char* value){
+  uint64_t count;
+  int index;
+  if (strcmp(field, "policy") == 0 && value){
+    index = find_name(replacement_names, sizeof(replacement_names) / sizeof(replacement_names[0]), value);
+    if (index < 0) return false;
+    cache->replacement = (cache_replacement_t) index;
+    return true;
+  }
+  if (!parse_count(value, &count) || count > UINT32_MAX) return false;
+  if (strcmp(field, "size") == 0) cache->size = (uint32_t) count;
+  else if (strcmp(field, "ways") == 0) cache->ways = (uint32_t) count;
+  else if (strcmp(field, "line") == 0) cache->line_size = (uint32_t) count;
+  else if (strcmp(field, "hit_latency") == 0) cache->hit_latency = (uint32_t) count;
+  else if (strcmp(field, "miss_penalty") == 0) cache->miss_penalty = (uint32_t) count;
+  else return false;
+  return true;
+}
+
+
+// "bp_<field>" options
+static bool parse_predictor_option(branch_predictor_config_t* predictor, const char* field, const char* value){
+  uint64_t count;
+  if (!parse_count(value, &count) || count > UINT32_MAX) return false;
+  if (strcmp(field, "table_bits") == 0) predictor->table_bits = (uint32_t) count;
+  else if (strcmp(field, "history_bits") == 0) predictor->history_bits = (uint32_t) count;
+  else if (strcmp(field, "btb_bits") == 0) predictor->btb_bits = (uint32_t) count;
+  else if (strcmp(field, "ras_size") == 0) predictor->ras_size = (uint32_t) count;
+  else return false;
+  return true;
+}
+
+
+bool simulator_parse_option(simulator_config_t* config, const char* option){
+  if (!config || !option){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_parse_option.\n");
+    return false;
+  }
+
+  char key[32];
+  const char* value = strchr(option, '=');
+  size_t key_length = value ? (size_t) (value - option) : strlen(option);
+  if (key_length >= sizeof(key)) key_length = sizeof(key) - 1;
+  memcpy(key, option, key_length);
+  key[key_length] = '\0';
+  if (value) value++;
+
+  bool parsed = false;
+  uint64_t count;
+  int index;
+  if (strcmp(key, "mode") == 0 && value){
+    index = find_name(mode_names, sizeof(mode_names) / sizeof(mode_names[0]), value);
+    if ((parsed = index >= 0)) config->execution_mode = (execution_mode_t) index;
+  }
+  else if (strcmp(key, "memory") == 0 && value){
+    index = find_name(backend_names, sizeof(backend_names) / sizeof(backend_names[0]), value);
+    if ((parsed = index >= 0)) config->memory_backend = (memory_backend_t) index;
+  }
+  else if (strcmp(key, "max_cycles") == 0){
+    if ((parsed = parse_count(value, &count))) config->max_cycles = count;
+  }
+  else if (strcmp(key, "max_instructions") == 0){
+    if ((parsed = parse_count(value, &count) && count <= UINT32_MAX)) config->max_instructions = (uint32_t) count;
+  }
+  else if (strcmp(key, "break_on_ecall") == 0) parsed = parse_bool(value, &config->break_on_ecall);
+  else if (strcmp(key, "break_on_ebreak") == 0) parsed = parse_bool(value, &config->break_on_ebreak);
+  else if (strcmp(key, "syscalls") == 0) parsed = parse_bool(value, &config->syscalls);
+  else if (strcmp(key, "single_step") == 0) parsed = parse_bool(value, &config->single_step);
+  else if (strcmp(key, "pipeline_debug") == 0) parsed = parse_bool(value, &config->enable_pipeline_debug);
+  else if (strcmp(key, "predictor") == 0 && value) parsed = branch_predictor_find_type(value, &config->predictor.type);
+  else if (strncmp(key, "bp_", 3) == 0) parsed = parse_predictor_option(&config->predictor, key + 3, value);
+  else if (strncmp(key, "l1i_", 4) == 0) parsed = parse_cache_option(&config->icache, key + 4, value);
+  else if (strncmp(key, "l1d_", 4) == 0) parsed = parse_cache_option(&config->dcache, key + 4, value);
+  else if (strncmp(key, "reverse_", 8) == 0) parsed = reverse_parse_option(&config->reverse, key + 8, value);
+  else if (strcmp(key, "trace_file") == 0){   // File names point into option
+    if ((parsed = value && *value)){
+      config->trace_file = value;
+      config->enable_tracing = true;
+    }
+  }
+  else if (strcmp(key, "trace_ring") == 0){
+    if ((parsed = parse_count(value, &count) && count <= UINT32_MAX)) config->trace_ring_size = (uint32_t) count;
+  }
+  else if (strcmp(key, "trace_full") == 0 && value){
+    index = find_name(trace_full_names, sizeof(trace_full_names) / sizeof(trace_full_names[0]), value);
+    if ((parsed = index >= 0)) config->trace_full = (trace_full_policy_t) index;
+  }
+  else if (strcmp(key, "profile_json") == 0){
+    if ((parsed = value && *value)) config->profile_json = value;
+  }
+  else if (strcmp(key, "profile_csv") == 0){
+    if ((parsed = value && *value)) config->profile_csv = value;
+  }
+  else if (strcmp(key, "gdb") == 0){
+    if ((parsed = value && *value)) config->gdb_listen = value;
+  }
+
+  if (!parsed) fprintf(stderr, "Error: Invalid option '%s' in simulator_parse_option.\n", option);
+  return parsed;
+}
+
+
+const char* simulator_mode_name(execution_mode_t mode){
+  return (size_t) mode < sizeof(mode_names) / sizeof(mode_names[0]) ? mode_names[mode] : "unknown";
+}
+
+
+const char* simulator_stop_reason_name(stop_reason_t reason){
+  return (size_t) reason < sizeof(stop_reason_names) / sizeof(stop_reason_names[0]) ? stop_reason_names[reason] : "unknown";
+}
+
+//===========================================================================================
+//                                TRACING
+//===========================================================================================
+
+static uint32_t access_mask(memory_size_t size){
+  return size == MEM_SIZE_WORD ? 0xFFFFFFFF : (1u << (8u << size)) - 1;
+}
+
+
+// One pipeline cycle, tracing the instruction that retires in it
+static void simulator_trace_cycle(simulator_t* sim){
+  cpu_state_t* cpu = &sim->cpu;
+  mem_wb_register_t retiring = cpu->mem_wb;
+  uint64_t retired = cpu->total_instructions;
+
+  pipeline_clock_cycle(cpu);
+  if (cpu->total_instructions == retired) return;
+
+  const micro_op_t* op = &retiring.micro_op;
+  trace_record_t record = {
+    .cycle_number = cpu->total_cycles,
+    .pc = op->pc,
+    .instruction = op->raw_instruction
+  };
+  if (op->reg_write_enable){
+    record.rd = op->rd;
+    record.rd_value = cpu->reg_file.registers[record.rd];
+  }
+  if (op->mem_op != MEM_NOP){
+    record.memory_access = true;
+    record.memory_write = op->mem_op == MEM_WRITE;
+    record.memory_address = retiring.alu_result;
+    record.memory_data = record.memory_write
+                       ? retiring.memory_write_data & access_mask((memory_size_t) op->mem_size)
+                       : retiring.memory_data;
+  }
+  trace_instruction_execution(&sim->tracer, &record);
+}
+
+
+// One interpreted instruction, traced from its operands and the state it leaves
+static void simulator_trace_instruction(simulator_t* sim){
+  cpu_state_t* cpu = &sim->cpu;
+  const predecoded_instruction_t* pre = cpu_fetch_decoded(cpu, cpu->pc);
+  instruction_t inst = pre->instruction;    // Copies, a store may invalidate the entry
+  control_signals_t ctrl = pre->control;
+  uint32_t rs1 = cpu->reg_file.registers[inst.rs1];
+  uint32_t rs2 = cpu->reg_file.registers[inst.rs2];
+  uint64_t retired = cpu->total_instructions;
+
+  interpreter_step(cpu);
+  if (cpu->total_instructions == retired) return;
+
+  trace_record_t record = {
+    .cycle_number = cpu->total_cycles,
+    .pc = inst.pc,
+    .instruction = inst.raw_instruction
+  };
+  if (ctrl.reg_write_enable){
+    record.rd = inst.rd;
+    record.rd_value = cpu->reg_file.registers[inst.rd];
+  }
+  if (ctrl.mem_op != MEM_NOP){
+    record.memory_access = true;
+    record.memory_write = ctrl.mem_op == MEM_WRITE;
+    record.memory_address = rs1 + (uint32_t) (record.memory_write ? inst.imm_s : inst.imm_i);
+    if (record.memory_write) record.memory_data = rs2 & access_mask(ctrl.mem_size);
+    else if (record.rd) record.memory_data = record.rd_value;
+    else record.memory_data = cpu_memory_load(cpu, record.memory_address, ctrl.mem_size, ctrl.mem_load_unsigned);
+  }
+  trace_instruction_execution(&sim->tracer, &record);
+}
+
+//===========================================================================================
+//                                SIMULATOR LIFECYCLE
+//===========================================================================================
+
+// Counters over the instruction memory when an output file is configured, zeroed otherwise
+static bool simulator_setup_profile(simulator_t* sim){
+  cpu_state_t* cpu = &sim->cpu;
+  bool wanted = sim->config.profile_json || sim->config.profile_csv;
+
+  if (!wanted){
+    if (cpu->profile) profile_destroy(&sim->profile);
+    cpu->profile = NULL;
+    return true;
+  }
+  if (cpu->profile){
+    profile_reset(&sim->profile);
+    return true;
+  }
+  if (!profile_init(&sim->profile, cpu->instruction_memory.base_address, cpu->instruction_memory.size)) return false;
+  cpu->profile = &sim->profile;
+  return true;
+}
+
+
+bool simulator_init(simulator_t* sim, const simulator_config_t* config){
+  if (!sim || !config){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_init.\n");
+    return false;
+  }
+
+  memset(sim, 0, sizeof(simulator_t));
+  sim->config = *config;
+
+  bool memory_ready = config->memory_backend == MEMORY_BACKEND_SPARSE
+                    ? cpu_memory_init_sparse(&sim->cpu)
+                    : cpu_memory_init(&sim->cpu);
+  if (!memory_ready) return false;
+  if (!cpu_cache_init(&sim->cpu, &config->icache, &config->dcache)){
+    cpu_memory_destroy(&sim->cpu);
+    return false;
+  }
+  if (!branch_predictor_init(&sim->cpu.predictor, &config->predictor)){
+    cpu_cache_destroy(&sim->cpu);
+    cpu_memory_destroy(&sim->cpu);
+    return false;
+  }
+  if (!simulator_setup_profile(sim)){
+    branch_predictor_destroy(&sim->cpu.predictor);
+    cpu_cache_destroy(&sim->cpu);
+    cpu_memory_destroy(&sim->cpu);
+    return false;
+  }
+  if (config->syscalls && !syscall_init(&sim->syscalls)){
+    profile_destroy(&sim->profile);
+    branch_predictor_destroy(&sim->cpu.predictor);
+    cpu_cache_destroy(&sim->cpu);
+    cpu_memory_destroy(&sim->cpu);
+    return false;
+  }
+  cpu_reset(&sim->cpu);
+  sim->cpu.single_step_mode = config->single_step;
+  sim->cpu.trace_enabled = config->enable_tracing;
+
+  if (config->enable_tracing){
+    if (!tracer_init(&sim->tracer, TRACE_DEFAULT_CAPACITY)){
+      syscall_destroy(&sim->syscalls);
+      profile_destroy(&sim->profile);
+      branch_predictor_destroy(&sim->cpu.predictor);
+      cpu_cache_destroy(&sim->cpu);
+      cpu_memory_destroy(&sim->cpu);
+      return false;
+    }
+    if (config->trace_file){
+      tracer_set_file_output(&sim->tracer, config->trace_file);
+      if (config->trace_ring_size) tracer_start_writer(&sim->tracer, config->trace_ring_size, config->trace_full);
+    }
+  }
+
+  return true;
+}
+
+
+void simulator_destroy(simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_destroy.\n");
+    return;
+  }
+  cpu_snapshot_destroy(&sim->cpu, &sim->snapshot);
+  tracer_destroy(&sim->tracer);
+  jit_destroy(&sim->jit);
+  elf_close(&sim->program);
+  syscall_destroy(&sim->syscalls);
+  profile_destroy(&sim->profile);
+  branch_predictor_destroy(&sim->cpu.predictor);
+  cpu_cache_destroy(&sim->cpu);
+  cpu_memory_destroy(&sim->cpu);
+}
+
+//===========================================================================================
+//                                PROGRAM LOADING
+//===========================================================================================
+
+// Memory of the previous program back to zeros before loading another
+static void simulator_drop_image(simulator_t* sim){
+  cpu_memory_drop_image(&sim->cpu);
+  sim->image_kept = false;
+}
+
+
+// Memory, pc and program break as loaded become the state simulator_reset returns to
+static void simulator_keep_image(simulator_t* sim, uint32_t program_break){
+  sim->image_kept = cpu_memory_keep_image(&sim->cpu);
+  sim->image_entry = sim->cpu.pc;
+  sim->image_break = program_break;
+}
+
+
+bool simulator_load_program(simulator_t* sim, const char* filename){
+  if (!sim || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_load_program.\n");
+    return false;
+  }
+
+  cpu_state_t* cpu = &sim->cpu;
+  elf_close(&sim->program);
+  if (!elf_open(&sim->program, filename)) return false;
+  simulator_drop_image(sim);
+  if (!elf_load(&sim->program, cpu)){
+    elf_close(&sim->program);
+    return false;
+  }
+
+  cpu->pc = sim->program.entry;
+  register_write(cpu, 2, cpu->data_memory.base_address + (uint32_t) cpu->data_memory.size);
+  uint32_t program_break = elf_end_address(&sim->program);   // Heap after .bss
+  if (sim->config.syscalls) syscall_reset(&sim->syscalls, program_break);
+  simulator_keep_image(sim, program_break);
+
+  return true;
+}
+
+
+bool simulator_load_binary(simulator_t* sim, const uint32_t* program, size_t size){
+  if (!sim || !program){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_load_binary.\n");
+    return false;
+  }
+
+  cpu_state_t* cpu = &sim->cpu;
+  simulator_drop_image(sim);
+  if (!load_program_from_array(&cpu->instruction_memory, program, size)) return false;
+  predecode_invalidate_all(&cpu->predecode);
+
+  // Execution starts at the first instruction, stack grows down from the top of data memory
+  cpu->pc = cpu->instruction_memory.base_address;
+  register_write(cpu, 2, cpu->data_memory.base_address + (uint32_t) cpu->data_memory.size);
+  if (sim->config.syscalls) syscall_reset(&sim->syscalls, cpu->data_memory.base_address);
+  simulator_keep_image(sim, cpu->data_memory.base_address);
+
+  return true;
+}
+
+//===========================================================================================
+//                                EXECUTION CONTROL
+//===========================================================================================
+
+// Engines run until the program stops or stop_at instructions have retired
+static void simulator_run_pipeline(simulator_t* sim, uint64_t stop_at){
+  cpu_state_t* cpu = &sim->cpu;
+
+  while (sim->running && cpu->total_instructions < stop_at){
+    if (simulator_limit_reached(sim)){
+      sim->running = false;
+      sim->stop_reason = STOP_LIMIT;
+      break;
+    }
+
+    if (sim->config.enable_tracing) simulator_trace_cycle(sim);
+    else pipeline_clock_cycle(cpu);
+    if (cpu->pending_event != CPU_EVENT_NONE){
+      pipeline_flush(cpu);   // Squash younger instructions, PC back to the retire point
+      simulator_handle_event(sim);
+    }
+  }
+}
+
+
+static void simulator_run_functional(simulator_t* sim, uint64_t stop_at){
+  cpu_state_t* cpu = &sim->cpu;
+
+  while (sim->running && cpu->total_instructions < stop_at){
+    if (simulator_limit_reached(sim)){
+      sim->running = false;
+      sim->stop_reason = STOP_LIMIT;
+      break;
+    }
+
+    if (sim->config.enable_tracing) simulator_trace_instruction(sim);
+    else interpreter_run(cpu, simulator_instruction_budget(sim, stop_at));
+    simulator_handle_event(sim);
+  }
+}
+
+
+static void simulator_run_jit(simulator_t* sim, uint64_t stop_at){
+  cpu_state_t* cpu = &sim->cpu;
+
+  while (sim->running && cpu->total_instructions < stop_at){
+    if (simulator_limit_reached(sim)){
+      sim->running = false;
+      sim->stop_reason = STOP_LIMIT;
+      break;
+    }
+
+    // Translated code is neither traced nor profiled
+    if (sim->config.enable_tracing) simulator_trace_instruction(sim);
+    else if (profile_enabled(cpu->profile)) interpreter_run(cpu, simulator_instruction_budget(sim, stop_at));
+    else jit_run(&sim->jit, cpu, simulator_instruction_budget(sim, stop_at));
+    simulator_handle_event(sim);
+  }
+}
+
+
+void simulator_run(simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_run.\n");
+    return;
+  }
+
+  if (sim->config.single_step){
+    simulator_step(sim);
+    return;
+  }
+
+  uint64_t start_instructions = sim->cpu.total_instructions;
+  sim->running = true;
+  sim->paused = false;
+  sim->stop_reason = STOP_NONE;
+  sim->start_time = now_ns();
+  if (sim->config.enable_tracing) tracer_sync(&sim->tracer, &sim->cpu);
+
+  switch (sim->config.execution_mode){
+    case EXEC_MODE_PIPELINE:   simulator_run_pipeline(sim, UINT64_MAX);   break;
+    case EXEC_MODE_FUNCTIONAL: simulator_run_functional(sim, UINT64_MAX); break;
+    case EXEC_MODE_JIT:        simulator_run_jit(sim, UINT64_MAX);        break;
+  }
+  syscall_flush(&sim->syscalls);   // Guest console output before anything the caller prints
+  if (sim->config.enable_tracing) tracer_flush(&sim->tracer);
+
+  // Wall clock metrics for this run
+  sim->simulation_time_seconds = (double) (now_ns() - sim->start_time) / 1e9;
+  uint64_t executed = sim->cpu.total_instructions - start_instructions;
+  sim->instructions_per_second = sim->simulation_time_seconds > 0.0
+                               ? (double) executed / sim->simulation_time_seconds
+                               : 0.0;
+}
+
+
+uint64_t simulator_advance(simulator_t* sim, execution_mode_t mode, uint64_t count){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_advance.\n");
+    return 0;
+  }
+
+  cpu_state_t* cpu = &sim->cpu;
+  uint64_t start = cpu->total_instructions;
+  uint64_t stop_at = count < UINT64_MAX - start ? start + count : UINT64_MAX;
+  sim->running = true;
+  sim->paused = false;
+  sim->stop_reason = STOP_NONE;
+  if (sim->config.enable_tracing) tracer_sync(&sim->tracer, cpu);
+
+  switch (mode){
+    case EXEC_MODE_PIPELINE:   simulator_run_pipeline(sim, stop_at);   break;
+    case EXEC_MODE_FUNCTIONAL: simulator_run_functional(sim, stop_at); break;
+    case EXEC_MODE_JIT:        simulator_run_jit(sim, stop_at);        break;
+  }
+  syscall_flush(&sim->syscalls);
+  return cpu->total_instructions - start;
+}
+
+
+void simulator_step(simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_step.\n");
+    return;
+  }
+
+  cpu_state_t* cpu = &sim->cpu;
+  bool tracing = sim->config.enable_tracing;
+  sim->running = true;
+  if (tracing) tracer_sync(&sim->tracer, cpu);
+
+  switch (sim->config.execution_mode){
+    case EXEC_MODE_PIPELINE:
+      if (tracing) simulator_trace_cycle(sim);
+      else pipeline_clock_cycle(cpu);
+      if (cpu->pending_event != CPU_EVENT_NONE) pipeline_flush(cpu);
+      break;
+    case EXEC_MODE_FUNCTIONAL:
+    case EXEC_MODE_JIT:       // Single instructions are not worth translating
+      if (tracing) simulator_trace_instruction(sim);
+      else interpreter_step(cpu);
+      break;
+  }
+  simulator_handle_event(sim);
+  syscall_flush(&sim->syscalls);
+
+  // Stepping leaves the simulator paused unless the program ended
+  if (sim->running){
+    sim->running = false;
+    sim->paused = true;
+    sim->stop_reason = STOP_BREAK;
+  }
+}
+
+
+void simulator_pause(simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_pause.\n");
+    return;
+  }
+  sim->running = false;
+  sim->paused = true;
+  sim->stop_reason = STOP_BREAK;
+}
+
+
+void simulator_reset(simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_reset.\n");
+    return;
+  }
+
+  cpu_snapshot_destroy(&sim->cpu, &sim->snapshot);   // Its memory is cleared below
+
+  // The configuration may have changed since simulator_init (batch workers reuse simulators)
+  if (memcmp(&sim->cpu.icache.config, &sim->config.icache, sizeof(cache_config_t)) != 0 ||
+      memcmp(&sim->cpu.dcache.config, &sim->config.dcache, sizeof(cache_config_t)) != 0){
+    cpu_cache_init(&sim->cpu, &sim->config.icache, &sim->config.dcache);
+  }
+  if (memcmp(&sim->cpu.predictor.config, &sim->config.predictor, sizeof(branch_predictor_config_t)) != 0){
+    branch_predictor_destroy(&sim->cpu.predictor);
+    branch_predictor_init(&sim->cpu.predictor, &sim->config.predictor);
+  }
+  simulator_setup_profile(sim);
+  if (sim->config.syscalls && !sim->syscalls.output) syscall_init(&sim->syscalls);
+  uint32_t program_break = sim->image_kept ? sim->image_break : sim->cpu.data_memory.base_address;
+  if (sim->syscalls.output) syscall_reset(&sim->syscalls, program_break);
+  cpu_reset(&sim->cpu);   // Memory back to the loaded image, written pages only
+  sim->cpu.single_step_mode = sim->config.single_step;
+  sim->cpu.trace_enabled = sim->config.enable_tracing;
+  if (sim->image_kept){
+    sim->cpu.pc = sim->image_entry;
+    register_write(&sim->cpu, 2, sim->cpu.data_memory.base_address + (uint32_t) sim->cpu.data_memory.size);
+  }
+
+  sim->running = false;
+  sim->paused = false;
+  sim->stop_reason = STOP_NONE;
+  sim->exit_code = 0;
+  sim->start_time = 0;
+  sim->simulation_time_seconds = 0.0;
+  sim->instructions_per_second = 0.0;
+}
+
+
+bool simulator_snapshot(simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_snapshot.\n");
+    return false;
+  }
+  sim->snapshot_break = sim->syscalls.program_break;
+  return cpu_snapshot(&sim->cpu, &sim->snapshot);
+}
+
+
+bool simulator_restore(simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_restore.\n");
+    return false;
+  }
+  if (!cpu_restore(&sim->cpu, &sim->snapshot)) return false;
+  sim->syscalls.program_break = sim->snapshot_break;   // Open files are not part of a snapshot
+
+  // Ready to run from the snapshot, as after a reset
+  sim->running = false;
+  sim->paused = false;
+  sim->stop_reason = STOP_NONE;
+  sim->exit_code = 0;
+  return true;
+}
+
+bool simulator_export_profile(const simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_export_profile.\n");
+    return false;
+  }
+  if (!profile_enabled(sim->cpu.profile)){
+    fprintf(stderr, "Error: No profile_json or profile_csv configured in simulator_export_profile.\n");
+    return false;
+  }
+
+  bool written = true;
+  if (sim->config.profile_json) written &= profile_export(&sim->profile, sim->config.profile_json, PROFILE_FORMAT_JSON);
+  if (sim->config.profile_csv) written &= profile_export(&sim->profile, sim->config.profile_csv, PROFILE_FORMAT_CSV);
+  return written;
+}
+
+//===========================================================================================
+//                                STATUS AND DEBUGGING
+//===========================================================================================
+
+void simulator_print_status(const simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_print_status.\n");
+    return;
+  }
+
+  printf("EXECUTION MODE         --- %s\n", mode_names[sim->config.execution_mode]);
+  printf("MEMORY BACKEND         --- %s\n", backend_names[sim->config.memory_backend]);
+  printf("RUNNING                --- %s\n", sim->running ? "true" : "false");
+  printf("PAUSED                 --- %s\n", sim->paused ? "true" : "false");
+  printf("STOP REASON            --- %s\n", stop_reason_names[sim->stop_reason]);
+  printf("EXIT CODE              --- %u\n", sim->exit_code);
+  print_cpu_state(&sim->cpu);
+}
+
+
+void simulator_print_performance_stats(const simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_print_performance_stats.\n");
+    return;
+  }
+
+  const cpu_state_t* cpu = &sim->cpu;
+  double cpi = cpu->total_instructions ? (double) cpu->total_cycles / (double) cpu->total_instructions : 0.0;
+  uint64_t lookups = cpu->predecode.hits + cpu->predecode.misses;
+  double hit_rate = lookups ? 100.0 * (double) cpu->predecode.hits / (double) lookups : 0.0;
+
+  printf("PERFORMANCE STATISTICS\n");
+  printf("======================\n");
+  printf("TOTAL CYCLES           --- %lu\n", cpu->total_cycles);
+  printf("TOTAL INSTRUCTIONS     --- %lu\n", cpu->total_instructions);
+  printf("CPI                    --- %.3f\n", cpi);
+  printf("PIPELINE STALLS        --- %lu\n", cpu->pipeline_stalls);
+  printf("BRANCH INSTRUCTIONS    --- %lu\n", cpu->branch_instructions);
+  printf("BRANCH MISPREDICTIONS  --- %lu\n", cpu->branch_mispredictions);
+  printf("PREDECODE HIT RATE     --- %.2f%%\n", hit_rate);
+  if (cpu->predictor.config.type != BP_STATIC) branch_predictor_print_stats(&cpu->predictor);
+  if (cache_enabled(&cpu->icache)) cache_print_stats(&cpu->icache, "L1I");
+  if (cache_enabled(&cpu->dcache)) cache_print_stats(&cpu->dcache, "L1D");
+  if (profile_enabled(cpu->profile)) profile_print_stats(cpu->profile);
+  if (sim->config.syscalls) syscall_print_stats(&sim->syscalls);
+  if (cpu->sparse.base){
+    printf("GUEST PAGES MAPPED     --- %zu\n", cpu->sparse.mapped_pages);
+    printf("GUEST MEMORY FAULTS    --- %lu\n", cpu->sparse.faults);
+  }
+  if (sim->jit.code){
+    const jit_state_t* jit = &sim->jit;
+    printf("JIT TRANSLATED BLOCKS  --- %lu\n", jit->translated_blocks);
+    printf("JIT CHAINED EXITS      --- %lu\n", jit->chained_exits);
+    printf("JIT CACHE FLUSHES      --- %lu\n", jit->flushes);
+    printf("JIT CODE CACHE         --- %zu / %zu KB\n", jit->code_used / 1024, jit->code_size / 1024);
+    printf("JIT NATIVE INSTRS      --- %lu\n", jit->native_instructions);
+  }
+  printf("SIMULATION TIME        --- %.6f s\n", sim->simulation_time_seconds);
+  printf("INSTRUCTIONS / SECOND  --- %.0f\n", sim->instructions_per_second);
+
+  // Records written, and dropped or stalled on a full writer ring
+  if (sim->config.enable_tracing){
+    printf("\n");
+    print_trace_summary(&sim->tracer);
+  }
+}
+
+//===========================================================================================
+//                                INTERACTIVE DEBUGGING
+//===========================================================================================
+
+#define SIMULATOR_MAX_COMMAND 256
+
+typedef struct {
+  simulator_t* sim;
+  reverse_t reverse;
+  bool reversible;                // reverse is recording
+  debug_marks_t marks;            // Breakpoints, attached to the CPU while going forward
+  bool marked;                    // marks initialised
+
+  // Target of reverse-write
+  uint8_t watch_register;         // 0 = memory
+  uint32_t watch_address;
+  uint32_t watch_size;
+} debug_session_t;
+
+
+static bool session_breakpoint(const debug_session_t* session, uint32_t pc){
+  return session->marked && debug_breakpoint_at(&session->marks, pc);
+}
+
+
+static bool stop_at_breakpoint(const reverse_t* rev, const reverse_entry_t* entry, void* context){
+  (void) rev;
+  return session_breakpoint((const debug_session_t *) context, entry->pc);
+}
+
+
+static bool stop_at_write(const reverse_t* rev, const reverse_entry_t* entry, void* context){
+  const debug_session_t* session = (const debug_session_t *) context;
+  if (session->watch_register) return entry->rd == session->watch_register;
+  return reverse_entry_writes(rev, entry, session->watch_address, session->watch_size);
+}
+
+
+static void session_print_location(debug_session_t* session){
+  simulator_t* sim = session->sim;
+  cpu_state_t* cpu = &sim->cpu;
+  uint32_t word = cpu_fetch_instruction(cpu, cpu->pc);   // The decode of a breakpoint is illegal
+  printf("0x%08x: %08x %-7s instret %lu", cpu->pc, word,
+         instruction_type_name(decode_instruction(word, cpu->pc).type), cpu->total_instructions);
+  if (sim->stop_reason == STOP_EXIT) printf("  (exited with %u)", sim->exit_code);
+  else if (sim->stop_reason != STOP_BREAK) printf("  (%s)", stop_reason_names[sim->stop_reason]);
+  printf("\n");
+}
+
+
+// Run forward until count instructions retire, a breakpoint is reached (until_break)
+// or the program stops
+static void session_forward(debug_session_t* session, uint64_t count, bool until_break){
+  simulator_t* sim = session->sim;
+  cpu_state_t* cpu = &sim->cpu;
+  if (sim->stop_reason == STOP_EXIT || sim->stop_reason == STOP_FAULT || sim->stop_reason == STOP_LIMIT){
+    printf("The program has stopped (%s), step back first.\n", stop_reason_names[sim->stop_reason]);
+    return;
+  }
+
+  sim->running = true;
+  sim->stop_reason = STOP_NONE;
+  for (uint64_t i = 0; i < count && sim->running; ++i){
+    if (simulator_limit_reached(sim)){
+      sim->running = false;
+      sim->stop_reason = STOP_LIMIT;
+      break;
+    }
+
+    // A breakpoint at pc decodes as illegal: lift it for this instruction
+    uint32_t pc = cpu->pc;
+    bool lifted = cpu_breakpoint_hit(cpu) && cpu_set_breakpoint(cpu, pc, false);
+    if (session->reversible){
+      reverse_step(&session->reverse);
+      if (session->reverse.exited) simulator_stop(sim, STOP_EXIT, session->reverse.exit_code);
+    }
+    else interpreter_step(cpu);
+    if (lifted) cpu_set_breakpoint(cpu, pc, true);
+    simulator_handle_event(sim);
+    if (until_break && sim->running && session_breakpoint(session, cpu->pc)) break;
+  }
+  syscall_flush(&sim->syscalls);
+
+  if (sim->running){
+    sim->running = false;
+    sim->paused = true;
+    sim->stop_reason = STOP_BREAK;
+  }
+}
+
+
+static void session_backward(debug_session_t* session, uint64_t count, reverse_stop_t stop){
+  simulator_t* sim = session->sim;
+  if (!session->reversible){
+    printf("Reverse execution is off (reverse_log=0).\n");
+    return;
+  }
+
+  // Replay from a checkpoint must run through breakpoints, stop() looks at the marks
+  cpu_debug_attach(&sim->cpu, NULL);
+  uint64_t steps = reverse_back(&session->reverse, count, stop, session);
+  if (session->marked) cpu_debug_attach(&sim->cpu, &session->marks);
+  sim->running = false;
+  sim->paused = true;
+  sim->stop_reason = STOP_BREAK;
+  sim->exit_code = 0;
+  if (steps < count && sim->cpu.total_instructions == reverse_history_start(&session->reverse)){
+    printf("Reached the start of the history.\n");
+  }
+}
+
+
+static bool parse_address(const char* text, uint32_t* address){
+  uint64_t value;
+  if (!parse_count(text, &value) || value > UINT32_MAX) return false;
+  *address = (uint32_t) value;
+  return true;
+}
+
+
+static void session_print_memory(debug_session_t* session, uint32_t address, uint64_t words){
+  for (uint64_t i = 0; i < words; ++i, address += 4){
+    const uint8_t* data = cpu_memory_span(&session->sim->cpu, address, 4, false);
+    if (!data){
+      printf("0x%08x: unmapped\n", address);
+      return;
+    }
+    uint32_t word;
+    memcpy(&word, data, sizeof(word));
+    printf("0x%08x: 0x%08x\n", address, word);
+  }
+}
+
+
+static void session_print_help(void){
+  printf("s, step [n]              run n instructions (1)\n");
+  printf("rs, reverse-step [n]     step back n instructions (1)\n");
+  printf("c, continue              run to a breakpoint or the end of the program\n");
+  printf("rc, reverse-continue     run back to a breakpoint or the start of the history\n");
+  printf("rw, reverse-write xN     run back to the last write of register xN\n");
+  printf("rw ADDR [size]           run back to the last write of memory (size bytes, 4)\n");
+  printf("b, break ADDR            set a breakpoint\n");
+  printf("d, delete [ADDR]         delete one or every breakpoint\n");
+  printf("r, regs                  print the registers\n");
+  printf("x ADDR [n]               print n memory words (1)\n");
+  printf("i, info                  status and history\n");
+  printf("q, quit\n");
+}
+
+
+// One command line, false on quit
+static bool session_command(debug_session_t* session, char* line){
+  simulator_t* sim = session->sim;
+  char* command = strtok(line, " \t\r\n");
+  char* first = strtok(NULL, " \t\r\n");
+  char* second = strtok(NULL, " \t\r\n");
+  uint64_t count = 1;
+  uint32_t address;
+  if (!command) return true;
+
+  #define IS(name, alias) (strcmp(command, name) == 0 || strcmp(command, alias) == 0)
+  if (IS("quit", "q")) return false;
+
+  if (IS("step", "s") || IS("reverse-step", "rs")){
+    if (first && (!parse_count(first, &count) || count == 0)){
+      printf("Invalid count '%s'.\n", first);
+      return true;
+    }
+    if (command[0] == 's') session_forward(session, count, false);
+    else session_backward(session, count, NULL);
+    session_print_location(session);
+  }
+  else if (IS("continue", "c")){
+    session_forward(session, UINT64_MAX, true);
+    session_print_location(session);
+  }
+  else if (IS("reverse-continue", "rc")){
+    session_backward(session, UINT64_MAX, stop_at_breakpoint);
+    session_print_location(session);
+  }
+  else if (IS("reverse-write", "rw")){
+    session->watch_register = 0;
+    session->watch_size = 4;
+    if (first && first[0] == 'x' && parse_count(first + 1, &count) && count > 0 && count < NUM_REGISTERS){
+      session->watch_register = (uint8_t) count;
+    }
+    else if (first && parse_address(first, &session->watch_address) &&
+             (!second || (parse_count(second, &count) && count > 0 && count <= UINT32_MAX))){
+      if (second) session->watch_size = (uint32_t) count;
+    }
+    else {
+      printf("Usage: rw x1-x31 | rw ADDR [size]\n");
+      return true;
+    }
+    session_backward(session, UINT64_MAX, stop_at_write);
+    session_print_location(session);
+  }
+  else if (IS("break", "b")){
+    if (!first || !parse_address(first, &address)) printf("Usage: break ADDR\n");
+    else if (!session->marked) printf("Breakpoints are unavailable.\n");
+    else if (session_breakpoint(session, address)) printf("Breakpoint at 0x%08x already set.\n", address);
+    else cpu_set_breakpoint(&sim->cpu, address, true);
+  }
+  else if (IS("delete", "d")){
+    if (first && !parse_address(first, &address)) printf("Usage: delete [ADDR]\n");
+    else if (!session->marked) printf("Breakpoints are unavailable.\n");
+    else if (first) cpu_set_breakpoint(&sim->cpu, address, false);
+    else {
+      while (session->marks.num_breakpoints) cpu_set_breakpoint(&sim->cpu, session->marks.breakpoints[0], false);
+    }
+  }
+  else if (IS("regs", "r")){
+    printf("pc          0x%08x\n", sim->cpu.pc);
+    print_register_file(&sim->cpu);
+  }
+  else if (strcmp(command, "x") == 0){
+    if (!first || !parse_address(first, &address) || (second && !parse_count(second, &count))){
+      printf("Usage: x ADDR [n]\n");
+      return true;
+    }
+    session_print_memory(session, address, count);
+  }
+  else if (IS("info", "i")){
+    session_print_location(session);
+    for (size_t i = 0; i < session->marks.num_breakpoints; ++i){
+      printf("BREAKPOINT             --- 0x%08x\n", session->marks.breakpoints[i]);
+    }
+    if (session->reversible) reverse_print_stats(&session->reverse, stdout);
+  }
+  else if (IS("help", "h")) session_print_help();
+  else printf("Unknown command '%s', try help.\n", command);
+  #undef IS
+  return true;
+}
+
+
+void simulator_interactive_mode(simulator_t* sim){
+  if (!sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in simulator_interactive_mode.\n");
+    return;
+  }
+
+  debug_session_t session = { .sim = sim };
+  session.marked = debug_marks_init(&session.marks);
+  if (session.marked) cpu_debug_attach(&sim->cpu, &session.marks);
+  if (sim->config.reverse.log_size){
+    session.reversible = reverse_init(&session.reverse, &sim->config.reverse, &sim->cpu,
+                                      sim->config.syscalls ? &sim->syscalls : NULL);
+  }
+
+  sim->running = false;
+  sim->paused = true;
+  sim->stop_reason = STOP_BREAK;
+  session_print_location(&session);
+
+  char line[SIMULATOR_MAX_COMMAND];
+  for (;;){
+    printf("(risc) ");
+    fflush(stdout);
+    if (!fgets(line, sizeof(line), stdin)) break;
+    if (!session_command(&session, line)) break;
+  }
+
+  if (session.reversible) reverse_destroy(&session.reverse);
+  if (session.marked){
+    cpu_debug_attach(&sim->cpu, NULL);
+    debug_marks_destroy(&session.marks);
+  }
+}
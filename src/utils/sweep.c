@@ -0,0 +1,384 @@
+#include "utils/sweep.h"
+#include "utils/batch.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SWEEP_PUBLISH 256                   // Records between head updates
+#define SWEEP_CHUNK 1024                    // Records a worker runs through each model at once
+
+//===========================================================================================
+//                                BROADCAST RING
+//===========================================================================================
+
+/*
+ * One producer, every worker a consumer with its own tail. A slot is free once
+ * the slowest worker has passed it; the producer rereads the tails only when
+ * its cached minimum says the ring is full.
+ */
+typedef struct {
+  _Alignas(64) _Atomic uint64_t tail;     // Records this worker is done with
+  struct sweep_run* run;
+  size_t index;                           // Worker number, owns points index, index + workers, ...
+  pthread_t thread;
+} sweep_worker_t;
+
+typedef struct sweep_run {
+  sweep_t* sweep;
+  trace_record_t* slots;
+  size_t mask;                            // Slots - 1
+  sweep_worker_t* workers;
+  size_t num_workers;
+
+  // Simulation thread
+  _Alignas(64) _Atomic uint64_t head;     // Records the workers may read
+  uint64_t next;                          // Records filled
+  uint64_t tail_seen;                     // Slowest tail when last read
+
+  // Sleep and shutdown
+  _Alignas(64) atomic_uint sleepers;      // Workers waiting for records
+  atomic_bool done;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+} sweep_run_t;
+
+
+static double now_seconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+static bool parse_count(const char* value, uint64_t* result){
+  char* end;
+  if (!value || !*value) return false;
+  *result = strtoull(value, &end, 0);
+  return *end == '\0';
+}
+
+
+static void ring_publish(sweep_run_t* run){
+  atomic_store(&run->head, run->next);
+  if (atomic_load(&run->sleepers)){
+    pthread_mutex_lock(&run->lock);
+    pthread_cond_broadcast(&run->wake);
+    pthread_mutex_unlock(&run->lock);
+  }
+}
+
+
+static uint64_t slowest_tail(const sweep_run_t* run){
+  uint64_t tail = UINT64_MAX;
+  for (size_t i = 0; i < run->num_workers; ++i){
+    uint64_t t = atomic_load_explicit(&run->workers[i].tail, memory_order_acquire);
+    if (t < tail) tail = t;
+  }
+  return tail;
+}
+
+
+// Tracer sink on the simulation thread
+static void sweep_push(void* context, const trace_record_t* record){
+  sweep_run_t* run = (sweep_run_t *) context;
+
+  if (run->next - run->tail_seen > run->mask){
+    run->tail_seen = slowest_tail(run);
+    if (run->next - run->tail_seen > run->mask){
+      ring_publish(run);
+      run->sweep->producer_waits++;
+      while ((run->tail_seen = slowest_tail(run), run->next - run->tail_seen > run->mask)) sched_yield();
+    }
+  }
+
+  run->slots[run->next++ & run->mask] = *record;
+  if (run->next - atomic_load_explicit(&run->head, memory_order_relaxed) >= SWEEP_PUBLISH) ring_publish(run);
+}
+
+
+static void* worker_main(void* argument){
+  sweep_worker_t* worker = (sweep_worker_t *) argument;
+  sweep_run_t* run = worker->run;
+  sweep_t* sweep = run->sweep;
+  uint64_t tail = 0;
+
+  for (;;){
+    uint64_t head = atomic_load_explicit(&run->head, memory_order_acquire);
+    if (head == tail){
+      if (atomic_load(&run->done)){
+        if (atomic_load(&run->head) == tail) break;   // Published before done was set
+        continue;
+      }
+      pthread_mutex_lock(&run->lock);
+      atomic_fetch_add(&run->sleepers, 1);
+      while (atomic_load(&run->head) == tail && !atomic_load(&run->done)) pthread_cond_wait(&run->wake, &run->lock);
+      atomic_fetch_sub(&run->sleepers, 1);
+      pthread_mutex_unlock(&run->lock);
+      continue;
+    }
+
+    // The chunk stays in cache while every model of this worker consumes it
+    uint64_t end = head - tail > SWEEP_CHUNK ? tail + SWEEP_CHUNK : head;
+    for (size_t p = worker->index; p < sweep->num_points; p += run->num_workers){
+      timing_model_t* model = &sweep->points[p].model;
+      for (uint64_t i = tail; i < end; ++i) timing_model_push(model, &run->slots[i & run->mask]);
+    }
+    tail = end;
+    atomic_store_explicit(&worker->tail, tail, memory_order_release);
+  }
+
+  for (size_t p = worker->index; p < sweep->num_points; p += run->num_workers){
+    timing_model_finish(&sweep->points[p].model);
+  }
+  return NULL;
+}
+
+//===========================================================================================
+//                                SWEEP
+//===========================================================================================
+
+bool sweep_init(sweep_t* sweep){
+  if (!sweep){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sweep_init.\n");
+    return false;
+  }
+
+  memset(sweep, 0, sizeof(sweep_t));
+  sweep->ring_size = SWEEP_DEFAULT_RING_SIZE;
+  return true;
+}
+
+
+void sweep_destroy(sweep_t* sweep){
+  if (!sweep){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sweep_destroy.\n");
+    return;
+  }
+
+  for (size_t i = 0; i < sweep->num_points; ++i){
+    timing_model_destroy(&sweep->points[i].model);
+    free(sweep->points[i].options);
+  }
+  free(sweep->points);
+  memset(sweep, 0, sizeof(sweep_t));
+}
+
+
+bool sweep_parse_option(sweep_t* sweep, const char* option){
+  if (!sweep || !option){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sweep_parse_option.\n");
+    return false;
+  }
+
+  char key[32];
+  const char* value = strchr(option, '=');
+  size_t key_length = value ? (size_t) (value - option) : strlen(option);
+  if (key_length >= sizeof(key)) key_length = sizeof(key) - 1;
+  memcpy(key, option, key_length);
+  key[key_length] = '\0';
+  if (value) value++;
+
+  uint64_t number = 0;
+  bool parsed = false;
+  if (strcmp(key, "sweep_points") == 0){
+    parsed = value && *value;
+    sweep->points_file = value;
+  }
+  else if (!parse_count(value, &number)) parsed = false;
+  else if (strcmp(key, "sweep_threads") == 0){
+    sweep->num_threads = (size_t) number;
+    parsed = true;
+  }
+  else if (strcmp(key, "sweep_ring") == 0){
+    parsed = number >= SWEEP_CHUNK && (number & (number - 1)) == 0;
+    sweep->ring_size = (size_t) number;
+  }
+
+  if (!parsed) fprintf(stderr, "Error: Invalid option '%s' in sweep_parse_option.\n", option);
+  return parsed;
+}
+
+
+bool sweep_add_point(sweep_t* sweep, const simulator_config_t* base, const char* options){
+  if (!sweep || !base || !options){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sweep_add_point.\n");
+    return false;
+  }
+
+  if (sweep->num_points == sweep->capacity){
+    size_t capacity = sweep->capacity ? sweep->capacity * 2 : 16;
+    sweep_point_t* points = (sweep_point_t *) realloc(sweep->points, capacity * sizeof(sweep_point_t));
+    if (!points){ // Error Check
+      fprintf(stderr, "Error: Memory allocation error in sweep_add_point.\n");
+      return false;
+    }
+    sweep->points = points;
+    sweep->capacity = capacity;
+  }
+
+  sweep_point_t* point = &sweep->points[sweep->num_points];
+  point->config = *base;
+  point->options = strdup(options);
+  if (!point->options){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in sweep_add_point.\n");
+    return false;
+  }
+
+  // Options are separated by blanks, the stored line keeps them for the report
+  char line[SWEEP_MAX_LINE];
+  snprintf(line, sizeof(line), "%s", options);
+  char* save;
+  bool ok = true;
+  for (char* option = strtok_r(line, " \t\r\n", &save); ok && option; option = strtok_r(NULL, " \t\r\n", &save)){
+    ok = simulator_parse_option(&point->config, option);
+  }
+  point->config.trace_file = NULL;     // Point into the copied line
+  point->config.profile_json = NULL;
+  point->config.profile_csv = NULL;
+  if (!ok || !timing_model_init(&point->model, &point->config)){
+    free(point->options);
+    return false;
+  }
+  sweep->num_points++;
+  return true;
+}
+
+
+bool sweep_load_points(sweep_t* sweep, const simulator_config_t* base, const char* filename){
+  if (!sweep || !base || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sweep_load_points.\n");
+    return false;
+  }
+
+  FILE* file = fopen(filename, "r");
+  if (!file){ // Error Check
+    fprintf(stderr, "Error: Cannot open points file %s in sweep_load_points.\n", filename);
+    return false;
+  }
+
+  char line[SWEEP_MAX_LINE];
+  size_t line_number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file)){
+    line_number++;
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    // Trim, the line names the point in the report
+    char* start = line + strspn(line, " \t\r\n");
+    char* end = start + strlen(start);
+    while (end > start && strchr(" \t\r\n", end[-1])) *--end = '\0';
+    if (!*start) continue;   // Blank line
+
+    ok = sweep_add_point(sweep, base, start);
+    if (!ok) fprintf(stderr, "Error: %s:%zu: bad point options in sweep_load_points.\n", filename, line_number);
+  }
+
+  fclose(file);
+  return ok;
+}
+
+
+bool sweep_run(sweep_t* sweep, simulator_t* sim){
+  if (!sweep || !sim){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sweep_run.\n");
+    return false;
+  }
+  if (!sim->config.enable_tracing){
+    fprintf(stderr, "Error: Simulator has no tracer in sweep_run.\n");
+    return false;
+  }
+  if (sweep->ring_size < SWEEP_CHUNK || (sweep->ring_size & (sweep->ring_size - 1)) != 0){
+    fprintf(stderr, "Error: Ring size %zu is not a power of two >= %d in sweep_run.\n", sweep->ring_size, SWEEP_CHUNK);
+    return false;
+  }
+  if (sweep->num_points == 0) return true;
+
+  size_t num_workers = sweep->num_threads ? sweep->num_threads : batch_default_threads();
+  if (num_workers > sweep->num_points) num_workers = sweep->num_points;
+
+  sweep_run_t run = {
+    .sweep = sweep,
+    .mask = sweep->ring_size - 1,
+    .num_workers = num_workers
+  };
+  run.slots = (trace_record_t *) malloc(sweep->ring_size * sizeof(trace_record_t));
+  run.workers = (sweep_worker_t *) aligned_alloc(64, ((num_workers * sizeof(sweep_worker_t) + 63) / 64) * 64);
+  if (!run.slots || !run.workers){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in sweep_run.\n");
+    free(run.slots);
+    free(run.workers);
+    return false;
+  }
+  pthread_mutex_init(&run.lock, NULL);
+  pthread_cond_init(&run.wake, NULL);
+
+  for (size_t i = 0; i < sweep->num_points; ++i) timing_model_reset(&sweep->points[i].model);
+  sweep->records = 0;
+  sweep->producer_waits = 0;
+
+  // Every worker must run: a missing one would hold its points' slots forever
+  size_t started = 0;
+  for (; started < num_workers; ++started){
+    sweep_worker_t* worker = &run.workers[started];
+    memset(worker, 0, sizeof(sweep_worker_t));
+    worker->run = &run;
+    worker->index = started;
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0){
+      fprintf(stderr, "Error: Cannot start worker thread in sweep_run.\n");
+      break;
+    }
+  }
+
+  double start = now_seconds();
+  bool ok = started == num_workers;
+  if (ok){
+    tracer_set_sink(&sim->tracer, sweep_push, &run);
+    simulator_run(sim);
+    tracer_set_sink(&sim->tracer, NULL, NULL);
+    sweep->records = run.next;
+    ring_publish(&run);
+  }
+
+  pthread_mutex_lock(&run.lock);
+  atomic_store(&run.done, true);
+  pthread_cond_broadcast(&run.wake);
+  pthread_mutex_unlock(&run.lock);
+  for (size_t i = 0; i < started; ++i){
+    pthread_join(run.workers[i].thread, NULL);
+  }
+  sweep->simulation_time_seconds = now_seconds() - start;   // Until the slowest model is done
+
+  pthread_cond_destroy(&run.wake);
+  pthread_mutex_destroy(&run.lock);
+  free(run.workers);
+  free(run.slots);
+  return ok;
+}
+
+
+void sweep_print_results(const sweep_t* sweep, FILE* out){
+  if (!sweep){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in sweep_print_results.\n");
+    return;
+  }
+  if (!out) out = stdout;
+
+  for (size_t i = 0; i < sweep->num_points; ++i){
+    const sweep_point_t* point = &sweep->points[i];
+    const timing_model_t* model = &point->model;
+    double cpi = model->total_instructions ? (double) model->total_cycles / (double) model->total_instructions : 0.0;
+    fprintf(out, "%zu cycles=%lu instret=%lu cpi=%.3f stalls=%lu mispredictions=%lu %s\n",
+            i, model->total_cycles, model->total_instructions, cpi, model->pipeline_stalls,
+            model->branch_mispredictions, point->options);
+  }
+  fprintf(out, "SWEEP POINTS           --- %zu\n", sweep->num_points);
+  fprintf(out, "RECORDS                --- %lu\n", sweep->records);
+  fprintf(out, "PRODUCER WAITS         --- %lu\n", sweep->producer_waits);
+  fprintf(out, "SIMULATION TIME        --- %.6f s\n", sweep->simulation_time_seconds);
+}
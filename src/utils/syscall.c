@@ -0,0 +1,394 @@
+#include "utils/syscall.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Guest open flags (asm-generic), translated to the host's
+#define GUEST_O_ACCMODE 00000003
+#define GUEST_O_CREAT   00000100
+#define GUEST_O_EXCL    00000200
+#define GUEST_O_TRUNC   00001000
+#define GUEST_O_APPEND  00002000
+#define GUEST_AT_FDCWD  (-100)
+
+#define SYSCALL_MAX_PATH 4096
+
+// libgloss struct kernel_stat, 128 bytes
+#define STAT_DEV     0
+#define STAT_INO     8
+#define STAT_MODE    16
+#define STAT_NLINK   20
+#define STAT_UID     24
+#define STAT_GID     28
+#define STAT_RDEV    32
+#define STAT_SIZE    48
+#define STAT_BLKSIZE 56
+#define STAT_BLOCKS  64
+#define STAT_ATIME   72
+#define STAT_MTIME   88
+#define STAT_CTIME   104
+#define STAT_BYTES   128
+
+// Errors are returned as -errno; Linux hosts share the guest's numbering
+
+//===========================================================================================
+//                                HELPERS
+//===========================================================================================
+
+static inline void put32(uint8_t* p, uint32_t value){
+  memcpy(p, &value, sizeof(value));   // Little-endian host
+}
+
+
+static inline void put64(uint8_t* p, uint64_t value){
+  memcpy(p, &value, sizeof(value));
+}
+
+
+static void put_timespec(uint8_t* p, int64_t seconds, int64_t nanoseconds){
+  put64(p, (uint64_t) seconds);
+  put64(p + 8, (uint64_t) nanoseconds);   // Also right for a 32-bit tv_nsec plus padding
+}
+
+
+// Host fd behind a guest fd, -1 if it is not open
+static int host_fd(const syscall_state_t* sys, uint32_t fd){
+  return fd < SYSCALL_MAX_FILES ? sys->host_fds[fd] : -1;
+}
+
+
+static bool is_console(int fd){
+  return fd == STDOUT_FILENO || fd == STDERR_FILENO;
+}
+
+
+static bool write_all(int fd, const uint8_t* data, size_t length){
+  while (length){
+    ssize_t written = write(fd, data, length);
+    if (written < 0){
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    length -= (size_t) written;
+  }
+  return true;
+}
+
+
+// NUL-terminated guest string, checked a page at a time since the next one may be unmapped
+static const char* guest_string(cpu_state_t* cpu, uint32_t address){
+  for (size_t length = 0; length < SYSCALL_MAX_PATH;){
+    uint32_t start = address + (uint32_t) length;
+    size_t chunk = GUEST_PAGE_SIZE - (start & (GUEST_PAGE_SIZE - 1));
+    const uint8_t* p = cpu_memory_span(cpu, start, chunk, false);
+    if (!p) return NULL;
+    if (memchr(p, 0, chunk)) return (const char *) cpu_memory_span(cpu, address, 1, false);
+    length += chunk;
+  }
+  return NULL;
+}
+
+
+static int host_open_flags(uint32_t flags){
+  static const int access_modes[] = {O_RDONLY, O_WRONLY, O_RDWR, O_RDWR};
+  int host = access_modes[flags & GUEST_O_ACCMODE];
+  if (flags & GUEST_O_CREAT) host |= O_CREAT;
+  if (flags & GUEST_O_EXCL) host |= O_EXCL;
+  if (flags & GUEST_O_TRUNC) host |= O_TRUNC;
+  if (flags & GUEST_O_APPEND) host |= O_APPEND;
+  return host;
+}
+
+//===========================================================================================
+//                                LIFECYCLE
+//===========================================================================================
+
+// Guest sees the host's stdin, stdout and stderr, nothing else is open
+static void syscall_close_files(syscall_state_t* sys){
+  for (size_t i = 0; i < SYSCALL_MAX_FILES; ++i){
+    if (sys->host_fds[i] > STDERR_FILENO) close(sys->host_fds[i]);
+    sys->host_fds[i] = i <= STDERR_FILENO ? (int) i : -1;
+  }
+}
+
+
+bool syscall_init(syscall_state_t* sys){
+  if (!sys){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in syscall_init.\n");
+    return false;
+  }
+
+  memset(sys, 0, sizeof(syscall_state_t));
+  sys->output = (char *) malloc(SYSCALL_OUTPUT_SIZE);
+  if (!sys->output){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in syscall_init.\n");
+    return false;
+  }
+  sys->output_fd = STDOUT_FILENO;
+  syscall_close_files(sys);
+  return true;
+}
+
+
+void syscall_destroy(syscall_state_t* sys){
+  if (!sys){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in syscall_destroy.\n");
+    return;
+  }
+
+  syscall_flush(sys);
+  for (size_t i = 0; i < SYSCALL_MAX_FILES; ++i){
+    if (sys->host_fds[i] > STDERR_FILENO) close(sys->host_fds[i]);
+  }
+  free(sys->output);
+  memset(sys, 0, sizeof(syscall_state_t));
+}
+
+
+void syscall_reset(syscall_state_t* sys, uint32_t program_break){
+  if (!sys){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in syscall_reset.\n");
+    return;
+  }
+
+  syscall_flush(sys);
+  syscall_close_files(sys);
+  sys->program_break = program_break;
+  sys->initial_break = program_break;
+  sys->calls = 0;
+  sys->bytes_read = 0;
+  sys->bytes_written = 0;
+  sys->console_writes = 0;
+}
+
+
+void syscall_flush(syscall_state_t* sys){
+  if (!sys || !sys->output_length) return;
+
+  fflush(stdout);   // Simulator output printed before stays in front
+  fflush(stderr);
+  write_all(sys->output_fd, (const uint8_t *) sys->output, sys->output_length);
+  sys->output_length = 0;
+  sys->console_writes++;
+}
+
+//===========================================================================================
+//                                SYSTEM CALLS
+//===========================================================================================
+
+static int64_t sys_read(syscall_state_t* sys, cpu_state_t* cpu, uint32_t fd, uint32_t buffer, uint32_t count){
+  int host = host_fd(sys, fd);
+  if (host < 0) return -EBADF;
+  if (count == 0) return 0;
+
+  uint8_t* data = cpu_memory_span(cpu, buffer, count, true);
+  if (!data) return -EFAULT;
+  if (host == STDIN_FILENO) syscall_flush(sys);   // Prompts show up before the program blocks
+
+  ssize_t n = read(host, data, count);
+  if (n < 0) return -errno;
+  sys->bytes_read += (uint64_t) n;
+  return n;
+}
+
+
+static int64_t sys_write(syscall_state_t* sys, cpu_state_t* cpu, uint32_t fd, uint32_t buffer, uint32_t count){
+  int host = host_fd(sys, fd);
+  if (host < 0) return -EBADF;
+  if (count == 0) return 0;
+
+  const uint8_t* data = cpu_memory_span(cpu, buffer, count, false);
+  if (!data) return -EFAULT;
+
+  if (!is_console(host)){
+    ssize_t n = write(host, data, count);
+    if (n < 0) return -errno;
+    sys->bytes_written += (uint64_t) n;
+    return n;
+  }
+
+  // Console: append, the buffer goes out when full or the other stream is used
+  if (host != sys->output_fd || count > SYSCALL_OUTPUT_SIZE - sys->output_length){
+    syscall_flush(sys);
+    sys->output_fd = host;
+  }
+  if (count >= SYSCALL_OUTPUT_SIZE){
+    fflush(stdout);
+    fflush(stderr);
+    if (!write_all(host, data, count)) return -errno;
+    sys->console_writes++;
+  }
+  else {
+    memcpy(sys->output + sys->output_length, data, count);
+    sys->output_length += count;
+  }
+  sys->bytes_written += count;
+  return count;
+}
+
+
+static int64_t sys_openat(syscall_state_t* sys, cpu_state_t* cpu, int32_t dirfd, uint32_t path, uint32_t flags,
+                          uint32_t mode){
+  int host_dir = AT_FDCWD;
+  if (dirfd != GUEST_AT_FDCWD && (host_dir = host_fd(sys, (uint32_t) dirfd)) < 0) return -EBADF;
+
+  const char* name = guest_string(cpu, path);
+  if (!name) return -EFAULT;
+
+  size_t fd = 0;
+  while (fd < SYSCALL_MAX_FILES && sys->host_fds[fd] >= 0) fd++;
+  if (fd == SYSCALL_MAX_FILES) return -EMFILE;
+
+  int host = openat(host_dir, name, host_open_flags(flags), (mode_t) mode);
+  if (host < 0) return -errno;
+  sys->host_fds[fd] = host;
+  return (int64_t) fd;
+}
+
+
+static int64_t sys_close(syscall_state_t* sys, uint32_t fd){
+  int host = host_fd(sys, fd);
+  if (host < 0) return -EBADF;
+
+  if (host == sys->output_fd) syscall_flush(sys);
+  sys->host_fds[fd] = -1;
+  if (host > STDERR_FILENO && close(host) != 0) return -errno;
+  return 0;
+}
+
+
+static int64_t sys_lseek(syscall_state_t* sys, uint32_t fd, int32_t offset, uint32_t whence){
+  int host = host_fd(sys, fd);
+  if (host < 0) return -EBADF;
+  if (whence > SEEK_END) return -EINVAL;
+
+  off_t position = lseek(host, (off_t) offset, (int) whence);
+  if (position < 0) return -errno;
+  return position > INT32_MAX ? -EOVERFLOW : (int64_t) position;
+}
+
+
+static int64_t sys_fstat(syscall_state_t* sys, cpu_state_t* cpu, uint32_t fd, uint32_t buffer){
+  int host = host_fd(sys, fd);
+  if (host < 0) return -EBADF;
+
+  struct stat st;
+  if (is_console(host)) syscall_flush(sys);
+  if (fstat(host, &st) != 0) return -errno;
+
+  uint8_t* out = cpu_memory_span(cpu, buffer, STAT_BYTES, true);
+  if (!out) return -EFAULT;
+  memset(out, 0, STAT_BYTES);
+  put64(out + STAT_DEV, (uint64_t) st.st_dev);
+  put64(out + STAT_INO, (uint64_t) st.st_ino);
+  put32(out + STAT_MODE, (uint32_t) st.st_mode);
+  put32(out + STAT_NLINK, (uint32_t) st.st_nlink);
+  put32(out + STAT_UID, (uint32_t) st.st_uid);
+  put32(out + STAT_GID, (uint32_t) st.st_gid);
+  put64(out + STAT_RDEV, (uint64_t) st.st_rdev);
+  put64(out + STAT_SIZE, (uint64_t) st.st_size);
+  put32(out + STAT_BLKSIZE, (uint32_t) st.st_blksize);
+  put64(out + STAT_BLOCKS, (uint64_t) st.st_blocks);
+  put_timespec(out + STAT_ATIME, st.st_atim.tv_sec, st.st_atim.tv_nsec);
+  put_timespec(out + STAT_MTIME, st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+  put_timespec(out + STAT_CTIME, st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+  return 0;
+}
+
+
+static int64_t sys_clock_gettime(cpu_state_t* cpu, uint32_t clock, uint32_t buffer){
+  struct timespec ts;
+  if (clock_gettime((clockid_t) clock, &ts) != 0) return -errno;
+
+  uint8_t* out = cpu_memory_span(cpu, buffer, 16, true);
+  if (!out) return -EFAULT;
+  put_timespec(out, ts.tv_sec, ts.tv_nsec);
+  return 0;
+}
+
+
+// Moves the break if [initial break, address) is guest memory, returns the break either way
+static int64_t sys_brk(syscall_state_t* sys, cpu_state_t* cpu, uint32_t address){
+  if (address >= sys->initial_break &&
+      (address == sys->initial_break || cpu_memory_span(cpu, sys->initial_break, address - sys->initial_break, false))){
+    sys->program_break = address;
+  }
+  return sys->program_break;
+}
+
+
+bool syscall_handle(syscall_state_t* sys, cpu_state_t* cpu, uint32_t* exit_code){
+  if (!sys || !cpu || !exit_code){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in syscall_handle.\n");
+    return false;
+  }
+
+  const uint32_t* x = cpu->reg_file.registers;
+  int64_t result;
+  sys->calls++;
+
+  switch (x[17]){
+    case SYS_READ:            result = sys_read(sys, cpu, x[10], x[11], x[12]); break;
+    case SYS_WRITE:           result = sys_write(sys, cpu, x[10], x[11], x[12]); break;
+    case SYS_OPENAT:          result = sys_openat(sys, cpu, (int32_t) x[10], x[11], x[12], x[13]); break;
+    case SYS_CLOSE:           result = sys_close(sys, x[10]); break;
+    case SYS_LSEEK:           result = sys_lseek(sys, x[10], (int32_t) x[11], x[12]); break;
+    case SYS_FSTAT:           result = sys_fstat(sys, cpu, x[10], x[11]); break;
+    case SYS_CLOCK_GETTIME:
+    case SYS_CLOCK_GETTIME64: result = sys_clock_gettime(cpu, x[10], x[11]); break;
+    case SYS_BRK:             result = sys_brk(sys, cpu, x[10]); break;
+    case SYS_EXIT:
+    case SYS_EXIT_GROUP:
+      *exit_code = x[10];
+      syscall_flush(sys);
+      return true;
+    default:
+      result = -ENOSYS;
+      break;
+  }
+
+  register_write(cpu, 10, (uint32_t) result);
+  return false;
+}
+
+
+bool syscall_output_range(const cpu_state_t* cpu, uint32_t* address, uint32_t* length){
+  if (!cpu || !address || !length){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in syscall_output_range.\n");
+    return false;
+  }
+
+  const uint32_t* x = cpu->reg_file.registers;
+  *address = x[11];
+  switch (x[17]){
+    case SYS_READ:            *length = x[12];      break;
+    case SYS_FSTAT:           *length = STAT_BYTES; break;
+    case SYS_CLOCK_GETTIME:
+    case SYS_CLOCK_GETTIME64: *length = 16;         break;
+    default:                  *length = 0;          break;
+  }
+  return *length > 0;
+}
+
+//===========================================================================================
+//                                STATISTICS
+//===========================================================================================
+
+void syscall_print_stats(const syscall_state_t* sys){
+  if (!sys){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in syscall_print_stats.\n");
+    return;
+  }
+
+  printf("SYSTEM CALLS           --- %lu\n", sys->calls);
+  printf("SYSCALL BYTES READ     --- %lu\n", sys->bytes_read);
+  printf("SYSCALL BYTES WRITTEN  --- %lu\n", sys->bytes_written);
+  printf("CONSOLE WRITES         --- %lu\n", sys->console_writes);
+}
@@ -0,0 +1,1015 @@
+#include "utils/trace.h"
+#include "pipeline/hazards.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The filters only select what is printed and kept in the in-memory ring. The
+ * binary file always gets every retired instruction, register state can only be
+ * rebuilt from an unbroken chain of deltas.
+ */
+
+static const char TRACE_MAGIC[8] = {'R', 'V', '3', '2', 'T', 'R', 'C', '1'};
+static const char TRACE_INDEX_MAGIC[8] = {'R', 'V', '3', '2', 'T', 'I', 'D', 'X'};
+
+#define TRACE_HEADER_SIZE 16
+#define TRACE_KEYFRAME_SIZE (1 + 8 + 8 + 4 + 4 + 4 * NUM_REGISTERS)
+#define TRACE_MAX_RECORD_SIZE 48
+#define TRACE_FILE_BUFFER_SIZE (1 << 20)
+#define TRACE_READ_BUFFER_SIZE (64 * 1024)   // Reader: long sequential runs, but seeks refill it
+
+//===========================================================================================
+//                                ENCODING HELPERS
+//===========================================================================================
+
+static size_t put_varint(uint8_t* out, uint64_t value){
+  size_t n = 0;
+  while (value >= 0x80){
+    out[n++] = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t) value;
+  return n;
+}
+
+
+static size_t put_u32(uint8_t* out, uint32_t value){
+  memcpy(out, &value, sizeof(value));
+  return sizeof(value);
+}
+
+
+static size_t put_u64(uint8_t* out, uint64_t value){
+  memcpy(out, &value, sizeof(value));
+  return sizeof(value);
+}
+
+
+static uint32_t zigzag_encode(int32_t value){
+  return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+
+static int32_t zigzag_decode(uint32_t value){
+  return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+
+static bool get_varint(FILE* file, uint64_t* value){
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7){
+    int c = getc_unlocked(file);
+    if (c == EOF) return false;
+    *value |= (uint64_t) (c & 0x7F) << shift;
+    if (!(c & 0x80)) return true;
+  }
+  return false;
+}
+
+
+static bool get_bytes(FILE* file, void* out, size_t size){
+  return fread(out, 1, size, file) == size;
+}
+
+
+// Little-endian word without the per-call locking of fread, for the record loop
+static bool get_word(FILE* file, uint32_t* value){
+  *value = 0;
+  for (int shift = 0; shift < 32; shift += 8){
+    int c = getc_unlocked(file);
+    if (c == EOF) return false;
+    *value |= (uint32_t) c << shift;
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                BINARY WRITER
+//===========================================================================================
+
+static void tracer_write(execution_tracer_t* tracer, const uint8_t* bytes, size_t size){
+  if (fwrite(bytes, 1, size, tracer->trace_file) != size){
+    fprintf(stderr, "Error: Write failed in tracer_write, trace output disabled.\n");
+    tracer->trace_to_file = false;
+    return;
+  }
+  tracer->bytes_written += size;
+}
+
+
+// registers: the register file before the next record executes
+static void tracer_write_keyframe(execution_tracer_t* tracer, const uint32_t* registers){
+  if (tracer->num_keyframes == tracer->keyframe_capacity){
+    size_t capacity = tracer->keyframe_capacity ? tracer->keyframe_capacity * 2 : 64;
+    uint64_t* offsets = (uint64_t *) realloc(tracer->keyframe_offsets, capacity * sizeof(uint64_t));
+    if (!offsets){ // Error Check, the trace stays readable by scanning
+      fprintf(stderr, "Error: Memory allocation error in tracer_write_keyframe.\n");
+      return;
+    }
+    tracer->keyframe_offsets = offsets;
+    tracer->keyframe_capacity = capacity;
+  }
+  tracer->keyframe_offsets[tracer->num_keyframes++] = tracer->bytes_written;
+
+  uint8_t buffer[TRACE_KEYFRAME_SIZE];
+  size_t n = 0;
+  buffer[n++] = TRACE_KEYFRAME_MARKER;
+  n += put_u64(buffer + n, tracer->records_written);
+  n += put_u64(buffer + n, tracer->last_cycle);
+  n += put_u32(buffer + n, tracer->last_pc);
+  n += put_u32(buffer + n, tracer->last_memory_address);
+  for (int i = 0; i < NUM_REGISTERS; ++i){
+    n += put_u32(buffer + n, registers[i]);
+  }
+  tracer_write(tracer, buffer, n);
+
+  tracer->next_keyframe = tracer->records_written + tracer->keyframe_interval;
+}
+
+
+static void tracer_write_record(execution_tracer_t* tracer, const uint32_t* registers, const trace_record_t* record){
+  if (tracer->records_written >= tracer->next_keyframe) tracer_write_keyframe(tracer, registers);
+
+  uint8_t buffer[TRACE_MAX_RECORD_SIZE];
+  size_t n = 1;
+  uint8_t flags = 0;
+  uint64_t cycles = record->cycle_number - tracer->last_cycle;
+
+  n += put_u32(buffer + n, record->instruction);
+  if (record->pc != tracer->last_pc + 4){
+    flags |= TRACE_FLAG_PC_JUMP;
+    n += put_varint(buffer + n, zigzag_encode((int32_t) (record->pc - (tracer->last_pc + 4))));
+  }
+  if (cycles != 1){
+    flags |= TRACE_FLAG_CYCLES;
+    n += put_varint(buffer + n, cycles);
+  }
+  if (record->rd != 0){
+    flags |= TRACE_FLAG_REG_WRITE;
+    buffer[n++] = record->rd;
+    n += put_varint(buffer + n, record->rd_value);
+  }
+  if (record->memory_access){
+    flags |= TRACE_FLAG_MEM_ACCESS | (record->memory_write ? TRACE_FLAG_MEM_WRITE : 0);
+    n += put_varint(buffer + n, zigzag_encode((int32_t) (record->memory_address - tracer->last_memory_address)));
+    n += put_varint(buffer + n, record->memory_data);
+    tracer->last_memory_address = record->memory_address;
+  }
+  buffer[0] = flags;
+  tracer_write(tracer, buffer, n);
+
+  tracer->last_pc = record->pc;
+  tracer->last_cycle = record->cycle_number;
+  tracer->records_written++;
+}
+
+
+//===========================================================================================
+//                                WRITER THREAD
+//===========================================================================================
+
+/*
+ * head and tail count slots since the writer started. The simulation thread
+ * fills slots past head and publishes them TRACE_RING_PUBLISH at a time, the
+ * writer encodes up to head and then advances tail. Each side reads the other's
+ * index only when its cached copy says the ring is full or empty, so the shared
+ * cache lines move once per batch rather than once per record.
+ *
+ * A gap marker (rd = TRACE_RESYNC_RD) ends a stretch of dropped records. The
+ * register file before the next record follows it in TRACE_RESYNC_SLOTS slots
+ * and becomes a keyframe.
+ */
+
+#define TRACE_RING_PUBLISH 64             // Records per head update
+#define TRACE_WRITER_CHUNK 4096           // Records per tail update
+#define TRACE_RESYNC_RD 0xFF
+#define TRACE_RESYNC_SLOTS ((sizeof(uint32_t) * NUM_REGISTERS + sizeof(trace_record_t) - 1) / sizeof(trace_record_t))
+#define TRACE_MIN_RING_SIZE 64
+
+struct trace_ring {
+  trace_record_t* slots;
+  size_t mask;                            // Slots - 1
+  trace_full_policy_t policy;
+  execution_tracer_t* tracer;
+
+  // Simulation thread
+  _Alignas(64) _Atomic uint64_t head;     // Slots the writer may read
+  uint64_t next;                          // Slots filled
+  uint64_t tail_seen;                     // tail when last read
+  bool dropping;                          // Inside a gap
+  uint64_t dropped;                       // Records not written
+  uint64_t gaps;                          // Stretches of dropped records
+  uint64_t stalls;                        // Waits for the writer
+
+  // Writer thread
+  _Alignas(64) _Atomic uint64_t tail;     // Slots the writer is done with
+  uint32_t registers[NUM_REGISTERS];      // Register file as of the last record written
+
+  // Sleep and shutdown
+  _Alignas(64) atomic_bool sleeping;
+  atomic_bool stop;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t thread;
+};
+
+
+// seq_cst store and load: either the writer sees the new head or this sees it asleep
+static void ring_publish(trace_ring_t* ring){
+  atomic_store(&ring->head, ring->next);
+  if (atomic_load(&ring->sleeping)){
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_signal(&ring->wake);
+    pthread_mutex_unlock(&ring->lock);
+  }
+}
+
+
+static bool ring_has_room(trace_ring_t* ring, uint64_t room){
+  uint64_t capacity = ring->mask + 1;
+  if (ring->next - ring->tail_seen + room <= capacity) return true;
+  ring->tail_seen = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  return ring->next - ring->tail_seen + room <= capacity;
+}
+
+
+static void ring_wait(trace_ring_t* ring, uint64_t room){
+  ring_publish(ring);
+  ring->stalls++;
+  while (!ring_has_room(ring, room)) sched_yield();
+}
+
+
+// Register files span several slots, which may wrap around the end of the ring
+static void ring_push_registers(trace_ring_t* ring, const uint32_t* registers){
+  const uint8_t* bytes = (const uint8_t *) registers;
+  size_t remaining = sizeof(uint32_t) * NUM_REGISTERS;
+  for (size_t i = 0; i < TRACE_RESYNC_SLOTS; ++i){
+    size_t size = remaining < sizeof(trace_record_t) ? remaining : sizeof(trace_record_t);
+    memcpy(&ring->slots[ring->next++ & ring->mask], bytes, size);
+    bytes += size;
+    remaining -= size;
+  }
+}
+
+
+static void ring_pop_registers(trace_ring_t* ring, uint64_t index){
+  uint8_t* bytes = (uint8_t *) ring->registers;
+  size_t remaining = sizeof(ring->registers);
+  for (size_t i = 0; i < TRACE_RESYNC_SLOTS; ++i){
+    size_t size = remaining < sizeof(trace_record_t) ? remaining : sizeof(trace_record_t);
+    memcpy(bytes, &ring->slots[(index + i) & ring->mask], size);
+    bytes += size;
+    remaining -= size;
+  }
+}
+
+
+// Slow path of ring_push: the ring is full or a gap is open. True once record fits.
+static bool ring_make_room(execution_tracer_t* tracer, const trace_record_t* record){
+  trace_ring_t* ring = tracer->ring;
+  if (ring->policy == TRACE_FULL_BLOCK){
+    ring_wait(ring, 1);
+    return true;
+  }
+
+  if (!ring->dropping){
+    if (ring_has_room(ring, 1)) return true;
+    ring->dropping = true;
+    ring->gaps++;
+    ring_publish(ring);
+    return false;
+  }
+
+  // Close the gap once there is room for the marker and, when sampling, half the ring
+  uint64_t room = ring->policy == TRACE_FULL_SAMPLE ? (ring->mask + 1) / 2 : 2 + TRACE_RESYNC_SLOTS;
+  if (!ring_has_room(ring, room)) return false;
+  ring->slots[ring->next++ & ring->mask] = (trace_record_t) {
+    .cycle_number = record->cycle_number - 1,
+    .pc = record->pc - 4,
+    .rd = TRACE_RESYNC_RD
+  };
+  ring_push_registers(ring, tracer->registers);   // Not yet updated by record
+  ring->dropping = false;
+  return true;
+}
+
+
+static inline void ring_push(execution_tracer_t* tracer, const trace_record_t* record){
+  trace_ring_t* ring = tracer->ring;
+  if ((ring->dropping || !ring_has_room(ring, 1)) && !ring_make_room(tracer, record)){
+    ring->dropped++;
+    return;
+  }
+
+  ring->slots[ring->next++ & ring->mask] = *record;
+  if (ring->next - atomic_load_explicit(&ring->head, memory_order_relaxed) >= TRACE_RING_PUBLISH) ring_publish(ring);
+}
+
+
+static void* writer_main(void* argument){
+  trace_ring_t* ring = (trace_ring_t *) argument;
+  execution_tracer_t* tracer = ring->tracer;
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  for (;;){
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail){
+      if (atomic_load(&ring->stop)){
+        if (atomic_load(&ring->head) == tail) break;   // Published before stop was set
+        continue;
+      }
+      pthread_mutex_lock(&ring->lock);
+      atomic_store(&ring->sleeping, true);
+      while (atomic_load(&ring->head) == tail && !atomic_load(&ring->stop)) pthread_cond_wait(&ring->wake, &ring->lock);
+      atomic_store(&ring->sleeping, false);
+      pthread_mutex_unlock(&ring->lock);
+      continue;
+    }
+
+    // A gap marker and its registers are published together, the chunk end may fall inside them
+    uint64_t end = head - tail > TRACE_WRITER_CHUNK ? tail + TRACE_WRITER_CHUNK : head;
+    while (tail < end){
+      const trace_record_t* record = &ring->slots[tail & ring->mask];
+      if (record->rd == TRACE_RESYNC_RD){
+        ring_pop_registers(ring, tail + 1);
+        tracer->last_pc = record->pc;
+        tracer->last_cycle = record->cycle_number;
+        if (tracer->trace_to_file) tracer_write_keyframe(tracer, ring->registers);
+        tail += 1 + TRACE_RESYNC_SLOTS;
+        continue;
+      }
+      if (tracer->trace_to_file) tracer_write_record(tracer, ring->registers, record);
+      if (record->rd) ring->registers[record->rd] = record->rd_value;
+      tail++;
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  }
+  return NULL;
+}
+
+
+// Drains the ring and joins the writer, records go straight to the file again
+static void ring_stop(execution_tracer_t* tracer){
+  trace_ring_t* ring = tracer->ring;
+  if (!ring) return;
+
+  ring_publish(ring);
+  pthread_mutex_lock(&ring->lock);
+  atomic_store(&ring->stop, true);
+  pthread_cond_signal(&ring->wake);
+  pthread_mutex_unlock(&ring->lock);
+  pthread_join(ring->thread, NULL);
+
+  pthread_cond_destroy(&ring->wake);
+  pthread_mutex_destroy(&ring->lock);
+  free(ring->slots);
+  free(ring);
+  tracer->ring = NULL;
+}
+
+
+// Keyframe index, lets readers seek without scanning
+static void tracer_close_file(execution_tracer_t* tracer){
+  ring_stop(tracer);
+  if (!tracer->trace_file) return;
+
+  uint64_t index_offset = tracer->bytes_written;
+  uint8_t buffer[16];
+  buffer[0] = TRACE_INDEX_MARKER;
+  fwrite(buffer, 1, 1, tracer->trace_file);
+  put_u64(buffer, tracer->num_keyframes);
+  fwrite(buffer, 1, 8, tracer->trace_file);
+  fwrite(tracer->keyframe_offsets, sizeof(uint64_t), tracer->num_keyframes, tracer->trace_file);
+  put_u64(buffer, index_offset);
+  memcpy(buffer + 8, TRACE_INDEX_MAGIC, sizeof(TRACE_INDEX_MAGIC));
+  fwrite(buffer, 1, 16, tracer->trace_file);
+
+  fclose(tracer->trace_file);
+  tracer->trace_file = NULL;
+  tracer->trace_to_file = false;
+}
+
+//===========================================================================================
+//                                TRACER MANAGEMENT
+//===========================================================================================
+
+bool tracer_init(execution_tracer_t* tracer, size_t capacity){
+  if (!tracer){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in tracer_init.\n");
+    return false;
+  }
+
+  memset(tracer, 0, sizeof(execution_tracer_t));
+  tracer->entries = (trace_record_t *) calloc(capacity, sizeof(trace_record_t));
+  if (capacity && !tracer->entries){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in tracer_init.\n");
+    return false;
+  }
+
+  tracer->capacity = capacity;
+  tracer->trace_all_instructions = true;
+  tracer->keyframe_interval = TRACE_DEFAULT_KEYFRAME_INTERVAL;
+  return true;
+}
+
+
+void tracer_destroy(execution_tracer_t* tracer){
+  if (!tracer){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in tracer_destroy.\n");
+    return;
+  }
+
+  tracer_close_file(tracer);
+  free(tracer->keyframe_offsets);
+  free(tracer->entries);
+  memset(tracer, 0, sizeof(execution_tracer_t));
+}
+
+
+void tracer_set_file_output(execution_tracer_t* tracer, const char* filename){
+  if (!tracer || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in tracer_set_file_output.\n");
+    return;
+  }
+
+  // A running writer moves on to the new file
+  size_t ring_size = tracer->ring ? tracer->ring->mask + 1 : 0;
+  trace_full_policy_t policy = tracer->ring ? tracer->ring->policy : TRACE_FULL_BLOCK;
+  tracer_close_file(tracer);
+  tracer->trace_file = fopen(filename, "wb");
+  if (!tracer->trace_file){ // Error Check
+    fprintf(stderr, "Error: Cannot open trace file %s in tracer_set_file_output.\n", filename);
+    return;
+  }
+  setvbuf(tracer->trace_file, NULL, _IOFBF, TRACE_FILE_BUFFER_SIZE);
+
+  // Fresh file: no records, no keyframes
+  tracer->trace_to_file = true;
+  tracer->records_written = 0;
+  tracer->bytes_written = 0;
+  tracer->num_keyframes = 0;
+  tracer->next_keyframe = 0;
+  tracer->keyframe_pending = true;
+
+  uint8_t header[TRACE_HEADER_SIZE];
+  memcpy(header, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  put_u32(header + 8, TRACE_FORMAT_VERSION);
+  put_u32(header + 12, tracer->keyframe_interval);
+  tracer_write(tracer, header, sizeof(header));
+  if (ring_size) tracer_start_writer(tracer, ring_size, policy);
+}
+
+
+void tracer_sync(execution_tracer_t* tracer, const cpu_state_t* cpu){
+  if (!tracer || !cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in tracer_sync.\n");
+    return;
+  }
+
+  // Registers changed outside of traced execution (loader, debugger): resynchronise readers
+  bool changed = memcmp(tracer->registers, cpu->reg_file.registers, sizeof(tracer->registers)) != 0;
+  if (!changed && !tracer->keyframe_pending) return;
+
+  // An idle writer leaves the file state to this thread until the next record
+  tracer_flush(tracer);
+  memcpy(tracer->registers, cpu->reg_file.registers, sizeof(tracer->registers));
+  if (tracer->ring) memcpy(tracer->ring->registers, cpu->reg_file.registers, sizeof(tracer->registers));
+  if (tracer->records_seen == 0){
+    tracer->last_pc = cpu->pc - 4;
+    tracer->last_cycle = cpu->total_cycles;
+  }
+  if (tracer->trace_to_file){
+    tracer_write_keyframe(tracer, tracer->registers);
+    tracer->keyframe_pending = false;
+  }
+}
+
+
+void tracer_set_sink(execution_tracer_t* tracer, trace_sink_t sink, void* context){
+  if (!tracer){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in tracer_set_sink.\n");
+    return;
+  }
+  tracer->sink = sink;
+  tracer->sink_context = context;
+}
+
+
+bool tracer_start_writer(execution_tracer_t* tracer, size_t ring_size, trace_full_policy_t policy){
+  if (!tracer){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in tracer_start_writer.\n");
+    return false;
+  }
+  if (ring_size < TRACE_MIN_RING_SIZE || (ring_size & (ring_size - 1)) != 0){
+    fprintf(stderr, "Error: Ring size %zu is not a power of two >= %d in tracer_start_writer.\n", ring_size, TRACE_MIN_RING_SIZE);
+    return false;
+  }
+  if (!tracer->trace_to_file){
+    fprintf(stderr, "Error: No trace file in tracer_start_writer.\n");
+    return false;
+  }
+
+  ring_stop(tracer);
+  trace_ring_t* ring = (trace_ring_t *) aligned_alloc(64, ((sizeof(trace_ring_t) + 63) / 64) * 64);
+  trace_record_t* slots = (trace_record_t *) malloc(ring_size * sizeof(trace_record_t));
+  if (!ring || !slots){ // Error Check
+    fprintf(stderr, "Error: Memory allocation error in tracer_start_writer.\n");
+    free(ring);
+    free(slots);
+    return false;
+  }
+
+  memset(ring, 0, sizeof(trace_ring_t));
+  ring->slots = slots;
+  ring->mask = ring_size - 1;
+  ring->policy = policy;
+  ring->tracer = tracer;
+  memcpy(ring->registers, tracer->registers, sizeof(ring->registers));
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->sleeping, false);
+  atomic_init(&ring->stop, false);
+  pthread_mutex_init(&ring->lock, NULL);
+  pthread_cond_init(&ring->wake, NULL);
+
+  if (pthread_create(&ring->thread, NULL, writer_main, ring) != 0){
+    fprintf(stderr, "Error: Cannot start writer thread in tracer_start_writer.\n");
+    pthread_cond_destroy(&ring->wake);
+    pthread_mutex_destroy(&ring->lock);
+    free(slots);
+    free(ring);
+    return false;   // Records keep going to the file directly
+  }
+  tracer->ring = ring;
+  return true;
+}
+
+
+void tracer_flush(execution_tracer_t* tracer){
+  if (!tracer){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in tracer_flush.\n");
+    return;
+  }
+
+  trace_ring_t* ring = tracer->ring;
+  if (ring && atomic_load_explicit(&ring->tail, memory_order_acquire) != ring->next){
+    ring_wait(ring, ring->mask + 1);   // Room for a full ring = empty
+  }
+  if (tracer->trace_file) fflush(tracer->trace_file);
+}
+
+//===========================================================================================
+//                                TRACING FUNCTIONS
+//===========================================================================================
+
+static bool tracer_selects(const execution_tracer_t* tracer, const trace_record_t* record){
+  if (tracer->trace_end_pc && (record->pc < tracer->trace_start_pc || record->pc > tracer->trace_end_pc)){
+    return false;
+  }
+  if (tracer->trace_all_instructions) return true;
+
+  uint8_t opcode = record->instruction & 0x7F;
+  bool is_branch = opcode == OPCODE_BRANCH || opcode == OPCODE_JAL || opcode == OPCODE_JALR;
+  if (tracer->trace_branches_only && is_branch) return true;
+  if (tracer->trace_memory_only && record->memory_access) return true;
+  return false;
+}
+
+
+static void print_record(const trace_record_t* record){
+  instruction_t inst = decode_instruction(record->instruction, record->pc);
+
+  printf("%10lu  0x%08x: 0x%08x  %-6s", record->cycle_number, record->pc, record->instruction,
+         instruction_to_string(&inst));
+  if (record->rd) printf("  x%d = 0x%08x", record->rd, record->rd_value);
+  if (record->memory_access){
+    printf("  %s [0x%08x] = 0x%08x", record->memory_write ? "ST" : "LD",
+           record->memory_address, record->memory_data);
+  }
+  printf("\n");
+}
+
+
+void trace_instruction_execution(execution_tracer_t* tracer, const trace_record_t* record){
+  tracer->records_seen++;
+
+  if (tracer->ring) ring_push(tracer, record);
+  else if (tracer->trace_to_file) tracer_write_record(tracer, tracer->registers, record);
+  if (tracer->sink) tracer->sink(tracer->sink_context, record);
+  if (record->rd) tracer->registers[record->rd] = record->rd_value;
+
+  if (!tracer_selects(tracer, record)) return;
+  if (tracer->capacity){
+    tracer->entries[tracer->write_index] = *record;
+    if (++tracer->write_index == tracer->capacity) tracer->write_index = 0;   // No division per record
+    if (tracer->count < tracer->capacity) tracer->count++;
+  }
+  if (tracer->trace_to_console) print_record(record);
+}
+
+
+void print_trace_summary(const execution_tracer_t* tracer){
+  if (!tracer){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in print_trace_summary.\n");
+    return;
+  }
+
+  double bytes_per_record = tracer->records_written
+                          ? (double) tracer->bytes_written / (double) tracer->records_written
+                          : 0.0;
+
+  printf("TRACE SUMMARY\n");
+  printf("=============\n");
+  printf("RECORDS SEEN           --- %lu\n", tracer->records_seen);
+  printf("RECORDS IN MEMORY      --- %zu\n", tracer->count);
+  printf("RECORDS WRITTEN        --- %lu\n", tracer->records_written);
+  printf("KEYFRAMES              --- %zu\n", tracer->num_keyframes);
+  printf("BYTES WRITTEN          --- %lu\n", tracer->bytes_written);
+  printf("BYTES / RECORD         --- %.2f\n", bytes_per_record);
+  if (tracer->ring){
+    printf("RECORDS DROPPED        --- %lu\n", tracer->ring->dropped);
+    printf("TRACE GAPS             --- %lu\n", tracer->ring->gaps);
+    printf("WRITER STALLS          --- %lu\n", tracer->ring->stalls);
+  }
+}
+
+
+void print_recent_trace(const execution_tracer_t* tracer, size_t num_entries){
+  if (!tracer){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in print_recent_trace.\n");
+    return;
+  }
+
+  if (num_entries > tracer->count) num_entries = tracer->count;
+  size_t start = (tracer->write_index + tracer->capacity - num_entries) % (tracer->capacity ? tracer->capacity : 1);
+  for (size_t i = 0; i < num_entries; ++i){
+    print_record(&tracer->entries[(start + i) % tracer->capacity]);
+  }
+}
+
+//===========================================================================================
+//                                TRACE READING
+//===========================================================================================
+
+static void reader_reset(trace_reader_t* reader){
+  reader->record_index = 0;
+  reader->cycle_number = 0;
+  reader->pc = 0;
+  reader->memory_address = 0;
+  reader->has_lookahead = false;
+  memset(reader->registers, 0, sizeof(reader->registers));
+}
+
+
+static bool reader_load_keyframe(trace_reader_t* reader){
+  uint8_t buffer[TRACE_KEYFRAME_SIZE - 1];
+  if (!get_bytes(reader->file, buffer, sizeof(buffer))) return false;
+
+  memcpy(&reader->record_index, buffer, 8);
+  memcpy(&reader->cycle_number, buffer + 8, 8);
+  memcpy(&reader->pc, buffer + 16, 4);
+  memcpy(&reader->memory_address, buffer + 20, 4);
+  memcpy(reader->registers, buffer + 24, sizeof(reader->registers));
+  return true;
+}
+
+
+// Decode the next record, applying keyframes on the way. Returns false at the end.
+// extra, if given, receives what a record does not carry: registers and stalls.
+static bool reader_decode_record(trace_reader_t* reader, trace_record_t* record, trace_entry_t* extra){
+  FILE* file = reader->file;
+  for (;;){
+    int flags = getc_unlocked(file);
+    if (flags == EOF) return false;
+    if (flags == TRACE_INDEX_MARKER){
+      ungetc(flags, file);   // Stay at the end on further calls
+      return false;
+    }
+    if (flags == TRACE_KEYFRAME_MARKER){
+      if (!reader_load_keyframe(reader)) return false;
+      continue;
+    }
+
+    uint32_t raw;
+    uint64_t value;
+    uint64_t cycles = 1;
+    uint32_t pc = reader->pc + 4;
+
+    if (!get_word(file, &raw)) return false;
+    if (flags & TRACE_FLAG_PC_JUMP){
+      if (!get_varint(file, &value)) return false;
+      pc += (uint32_t) zigzag_decode((uint32_t) value);
+    }
+    if (flags & TRACE_FLAG_CYCLES){
+      if (!get_varint(file, &cycles)) return false;
+    }
+
+    memset(record, 0, sizeof(trace_record_t));
+    record->pc = pc;
+    record->instruction = raw;
+    record->cycle_number = reader->cycle_number + cycles;
+    if (extra){
+      extra->pipeline_stalls = cycles ? (uint32_t) (cycles - 1) : 0;
+      memcpy(extra->register_state, reader->registers, sizeof(reader->registers));
+    }
+
+    if (flags & TRACE_FLAG_REG_WRITE){
+      int rd = getc_unlocked(file);
+      if (rd == EOF || !get_varint(file, &value)) return false;
+      record->rd = (uint8_t) (rd & 0x1F);
+      record->rd_value = (uint32_t) value;
+    }
+    if (flags & TRACE_FLAG_MEM_ACCESS){
+      uint64_t data;
+      if (!get_varint(file, &value) || !get_varint(file, &data)) return false;
+      reader->memory_address += (uint32_t) zigzag_decode((uint32_t) value);
+      record->memory_access = true;
+      record->memory_write = flags & TRACE_FLAG_MEM_WRITE;
+      record->memory_address = reader->memory_address;
+      record->memory_data = (uint32_t) data;
+    }
+
+    // Advance the architectural state past this record
+    if (record->rd) reader->registers[record->rd] = record->rd_value;
+    reader->pc = pc;
+    reader->cycle_number = record->cycle_number;
+    reader->record_index++;
+    return true;
+  }
+}
+
+
+// Full entry: the record plus the register file before it and the decoded instruction
+static bool reader_decode(trace_reader_t* reader, trace_entry_t* entry){
+  trace_record_t record;
+
+  memset(entry, 0, sizeof(trace_entry_t));
+  if (!reader_decode_record(reader, &record, entry)) return false;
+
+  entry->cycle_number = record.cycle_number;
+  entry->pc = record.pc;
+  entry->instruction = record.instruction;
+  entry->decoded = decode_instruction(record.instruction, record.pc);
+  entry->memory_access = record.memory_access;
+  entry->memory_address = record.memory_address;
+  entry->memory_data = record.memory_data;
+  entry->memory_write = record.memory_write;
+  entry->result_data = record.rd_value;
+  entry->result_register = record.rd;
+  return true;
+}
+
+
+// Skip one record or keyframe without decoding it, false at the end
+static bool reader_skip(trace_reader_t* reader, bool* was_keyframe){
+  *was_keyframe = false;
+  int flags = fgetc(reader->file);
+  if (flags == EOF || flags == TRACE_INDEX_MARKER) return false;
+  if (flags == TRACE_KEYFRAME_MARKER){
+    *was_keyframe = true;
+    return fseek(reader->file, TRACE_KEYFRAME_SIZE - 1, SEEK_CUR) == 0;
+  }
+
+  uint64_t value;
+  if (fseek(reader->file, 4, SEEK_CUR) != 0) return false;
+  if ((flags & TRACE_FLAG_PC_JUMP) && !get_varint(reader->file, &value)) return false;
+  if ((flags & TRACE_FLAG_CYCLES) && !get_varint(reader->file, &value)) return false;
+  if (flags & TRACE_FLAG_REG_WRITE){
+    if (fgetc(reader->file) == EOF || !get_varint(reader->file, &value)) return false;
+  }
+  if (flags & TRACE_FLAG_MEM_ACCESS){
+    if (!get_varint(reader->file, &value) || !get_varint(reader->file, &value)) return false;
+  }
+  return true;
+}
+
+
+static bool reader_add_keyframe(trace_reader_t* reader, uint64_t offset, size_t* capacity){
+  if (reader->num_keyframes == *capacity){
+    *capacity = *capacity ? *capacity * 2 : 64;
+    uint64_t* offsets = (uint64_t *) realloc(reader->keyframe_offsets, *capacity * sizeof(uint64_t));
+    if (!offsets) return false;
+    reader->keyframe_offsets = offsets;
+  }
+  reader->keyframe_offsets[reader->num_keyframes++] = offset;
+  return true;
+}
+
+
+static bool reader_load_index(trace_reader_t* reader){
+  uint8_t trailer[16];
+  uint64_t index_offset, count;
+
+  if (fseek(reader->file, -16, SEEK_END) != 0) return false;
+  long trailer_offset = ftell(reader->file);
+  if (trailer_offset < 0 || !get_bytes(reader->file, trailer, sizeof(trailer))) return false;
+  if (memcmp(trailer + 8, TRACE_INDEX_MAGIC, sizeof(TRACE_INDEX_MAGIC)) != 0) return false;
+  memcpy(&index_offset, trailer, 8);
+
+  // Marker, count and offsets must fit between index_offset and the trailer
+  uint64_t index_end = (uint64_t) trailer_offset;
+  if (index_offset > index_end || index_end - index_offset < 9) return false;
+  if (fseek(reader->file, (long) index_offset, SEEK_SET) != 0) return false;
+  if (fgetc(reader->file) != TRACE_INDEX_MARKER || !get_bytes(reader->file, &count, 8)) return false;
+  if (count > (index_end - index_offset - 9) / sizeof(uint64_t)) return false;
+
+  reader->keyframe_offsets = (uint64_t *) malloc((count ? count : 1) * sizeof(uint64_t));
+  if (!reader->keyframe_offsets) return false;
+  reader->num_keyframes = count;
+  return get_bytes(reader->file, reader->keyframe_offsets, count * sizeof(uint64_t));
+}
+
+
+// Trace without an index (writer did not close it): find the keyframes by scanning
+static void reader_scan_index(trace_reader_t* reader){
+  size_t capacity = 0;
+  bool was_keyframe;
+
+  free(reader->keyframe_offsets);
+  reader->keyframe_offsets = NULL;
+  reader->num_keyframes = 0;
+
+  fseek(reader->file, TRACE_HEADER_SIZE, SEEK_SET);
+  for (;;){
+    long offset = ftell(reader->file);
+    if (!reader_skip(reader, &was_keyframe)) break;
+    if (was_keyframe && !reader_add_keyframe(reader, (uint64_t) offset, &capacity)) break;
+  }
+}
+
+
+bool trace_reader_open(trace_reader_t* reader, const char* filename){
+  if (!reader || !filename){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in trace_reader_open.\n");
+    return false;
+  }
+
+  memset(reader, 0, sizeof(trace_reader_t));
+  reader->file = fopen(filename, "rb");
+  if (!reader->file){ // Error Check
+    fprintf(stderr, "Error: Cannot open trace file %s in trace_reader_open.\n", filename);
+    return false;
+  }
+  setvbuf(reader->file, NULL, _IOFBF, TRACE_READ_BUFFER_SIZE);
+
+  uint8_t header[TRACE_HEADER_SIZE];
+  uint32_t version;
+  if (!get_bytes(reader->file, header, sizeof(header)) || memcmp(header, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0){
+    fprintf(stderr, "Error: %s is not a trace file in trace_reader_open.\n", filename);
+    trace_reader_close(reader);
+    return false;
+  }
+  memcpy(&version, header + 8, 4);
+  memcpy(&reader->keyframe_interval, header + 12, 4);
+  if (version != TRACE_FORMAT_VERSION){
+    fprintf(stderr, "Error: Unsupported trace version %u in trace_reader_open.\n", version);
+    trace_reader_close(reader);
+    return false;
+  }
+
+  if (!reader_load_index(reader)) reader_scan_index(reader);
+
+  reader_reset(reader);
+  fseek(reader->file, TRACE_HEADER_SIZE, SEEK_SET);
+  return true;
+}
+
+
+void trace_reader_close(trace_reader_t* reader){
+  if (!reader){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in trace_reader_close.\n");
+    return;
+  }
+
+  if (reader->file) fclose(reader->file);
+  free(reader->keyframe_offsets);
+  memset(reader, 0, sizeof(trace_reader_t));
+}
+
+
+bool trace_reader_next(trace_reader_t* reader, trace_entry_t* entry){
+  if (!reader || !entry || !reader->file) return false;
+
+  if (reader->has_lookahead) *entry = reader->lookahead;
+  else if (!reader_decode(reader, entry)) return false;
+
+  // The following record tells where this one went
+  reader->has_lookahead = reader_decode(reader, &reader->lookahead);
+  entry->next_pc = reader->has_lookahead ? reader->lookahead.pc : entry->pc + 4;
+  entry->branch_taken = entry->decoded.format == FORMAT_B && entry->next_pc != entry->pc + 4;
+  return true;
+}
+
+
+bool trace_reader_next_record(trace_reader_t* reader, trace_record_t* record){
+  if (!reader || !record || !reader->file) return false;
+
+  // A record already read ahead by trace_reader_next comes first
+  if (reader->has_lookahead){
+    const trace_entry_t* entry = &reader->lookahead;
+    *record = (trace_record_t) {
+      .cycle_number = entry->cycle_number,
+      .pc = entry->pc,
+      .instruction = entry->instruction,
+      .rd_value = entry->result_data,
+      .rd = entry->result_register,
+      .memory_access = entry->memory_access,
+      .memory_write = entry->memory_write,
+      .memory_address = entry->memory_address,
+      .memory_data = entry->memory_data
+    };
+    reader->has_lookahead = false;
+    return true;
+  }
+  return reader_decode_record(reader, record, NULL);
+}
+
+
+bool trace_reader_seek(trace_reader_t* reader, uint64_t record_index){
+  if (!reader || !reader->file) return false;
+
+  // Last keyframe at or before the record (keyframe indices are increasing)
+  long offset = TRACE_HEADER_SIZE;
+  bool found = false;
+  size_t low = 0, high = reader->num_keyframes;
+  while (low < high){
+    size_t mid = (low + high) / 2;
+    uint64_t keyframe_record;
+    if (fseek(reader->file, (long) reader->keyframe_offsets[mid] + 1, SEEK_SET) != 0 ||
+        !get_bytes(reader->file, &keyframe_record, 8)) return false;
+    if (keyframe_record <= record_index){
+      offset = (long) reader->keyframe_offsets[mid];
+      found = true;
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+
+  reader_reset(reader);
+  if (fseek(reader->file, offset, SEEK_SET) != 0) return false;
+
+  // Load the keyframe, then replay deltas up to the record
+  trace_record_t skipped;
+  if (found){
+    if (fgetc(reader->file) != TRACE_KEYFRAME_MARKER || !reader_load_keyframe(reader)) return false;
+  }
+  while (reader->record_index < record_index){
+    if (!reader_decode_record(reader, &skipped, NULL)) return false;
+  }
+  return true;
+}
+
+//===========================================================================================
+//                                DEBUG SUPPORT
+//===========================================================================================
+
+void debug_print_pipeline_contents(const cpu_state_t* cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_print_pipeline_contents.\n");
+    return;
+  }
+
+  print_pipeline_state(cpu);
+  if (cpu->if_id.valid){
+    instruction_t inst = decode_instruction(cpu->if_id.instruction, cpu->if_id.pc);
+    printf("IF/ID  : ");
+    print_instruction_detailed(&inst);
+  }
+  // Later latches only keep micro-ops, decoded again for display
+  const micro_op_t* latches[] = { &cpu->id_ex.micro_op, &cpu->ex_mem.micro_op, &cpu->mem_wb.micro_op };
+  const bool valid[] = { cpu->id_ex.valid, cpu->ex_mem.valid, cpu->mem_wb.valid };
+  const char* names[] = { "ID/EX  : ", "EX/MEM : ", "MEM/WB : " };
+  for (size_t i = 0; i < 3; ++i){
+    if (!valid[i]) continue;
+    instruction_t inst = decode_instruction(latches[i]->raw_instruction, latches[i]->pc);
+    printf("%s", names[i]);
+    print_instruction_detailed(&inst);
+  }
+}
+
+
+void debug_print_hazard_status(const cpu_state_t* cpu){
+  if (!cpu){  // Check for NULL argument
+    fprintf(stderr, "Error: NULL argument in debug_print_hazard_status.\n");
+    return;
+  }
+
+  forwarding_unit_t fwd = compute_forwarding_signals(cpu);
+  static const char* sources[] = {
+    [FORWARD_NONE] = "none", [FORWARD_FROM_EX_MEM] = "EX/MEM", [FORWARD_FROM_MEM_WB] = "MEM/WB"
+  };
+
+  printf("LOAD-USE HAZARD        --- %s\n", has_load_use_hazard(cpu) ? "true" : "false");
+  printf("CONTROL HAZARD         --- %s\n", has_control_hazard(cpu) ? "true" : "false");
+  printf("FORWARD RS1            --- %s\n", sources[fwd.forward_rs1]);
+  printf("FORWARD RS2            --- %s\n", sources[fwd.forward_rs2]);
+  printf("STALL CYCLES LEFT      --- %u\n", cpu->stall_cycles);
+}